@@ -39,5 +39,7 @@
 #include "gwmodelpp/GWDR.h"
 #include "gwmodelpp/GWSS.h"
 #include "gwmodelpp/GWPCA.h"
+#include "gwmodelpp/ModelArchive.h"
+#include "gwmodelpp/GWRPredictor.h"
 
 #endif  // GWMODEL_H
\ No newline at end of file
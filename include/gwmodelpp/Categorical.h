@@ -0,0 +1,101 @@
+#ifndef CATEGORICAL_H
+#define CATEGORICAL_H
+
+#include <vector>
+#include <string>
+#include <armadillo>
+
+namespace gwm
+{
+
+/**
+ * \~english
+ * @brief Categorical variable encoded as integer codes.
+ * Levels are kept in the order of their first appearance.
+ * Codes and row indices of each level are computed once on construction,
+ * so that algorithms can work on integers instead of comparing strings repeatedly.
+ *
+ * \~chinese
+ * @brief 以整数编码表示的分类变量。
+ * 类别按其首次出现的顺序保存。
+ * 编码和每个类别的行索引在构造时一次性计算，
+ * 使算法可以使用整数计算，而不必重复比较字符串。
+ */
+class Categorical
+{
+public:
+
+    /**
+     * @brief \~english Construct a new empty Categorical object. \~chinese 构造一个新的空 Categorical 对象。
+     */
+    Categorical() {}
+
+    /**
+     * @brief \~english Construct a new Categorical object by encoding values. \~chinese 通过编码取值构造一个新的 Categorical 对象。
+     *
+     * @param values \~english Values of the categorical variable \~chinese 分类变量的取值
+     */
+    explicit Categorical(const std::vector<std::string>& values);
+
+public:
+
+    /**
+     * @brief \~english Get the number of values. \~chinese 获取取值数量。
+     *
+     * @return arma::uword \~english Number of values \~chinese 取值数量
+     */
+    arma::uword size() const { return mCodes.n_elem; }
+
+    /**
+     * @brief \~english Get the number of levels. \~chinese 获取类别数量。
+     *
+     * @return arma::uword \~english Number of levels \~chinese 类别数量
+     */
+    arma::uword nLevels() const { return mLevels.size(); }
+
+    /**
+     * @brief \~english Get levels in the order of their first appearance. \~chinese 获取按首次出现顺序排列的类别。
+     *
+     * @return const std::vector<std::string>& \~english Levels \~chinese 类别
+     */
+    const std::vector<std::string>& levels() const { return mLevels; }
+
+    /**
+     * @brief \~english Get the code of each value. \~chinese 获取每个取值的编码。
+     *
+     * @return const arma::uvec& \~english Codes, each of which is an index of levels \~chinese 编码，每个编码都是类别的索引
+     */
+    const arma::uvec& codes() const { return mCodes; }
+
+    /**
+     * @brief \~english Get row indices of values belonging to a level. \~chinese 获取属于某一类别的取值的行索引。
+     *
+     * @param level \~english Code of the level \~chinese 类别的编码
+     * @return const arma::uvec& \~english Row indices \~chinese 行索引
+     */
+    const arma::uvec& indices(arma::uword level) const { return mIndices[level]; }
+
+    /**
+     * @brief \~english Get the number of values in each level. \~chinese 获取每个类别的取值数量。
+     *
+     * @return arma::vec \~english Counts of each level \~chinese 每个类别的数量
+     */
+    arma::vec counts() const;
+
+    /**
+     * @brief \~english Convert codes back to values. \~chinese 将编码转换回取值。
+     *
+     * @param codes \~english Codes to convert \~chinese 要转换的编码
+     * @return std::vector<std::string> \~english Values \~chinese 取值
+     */
+    std::vector<std::string> decode(const arma::uvec& codes) const;
+
+private:
+    std::vector<std::string> mLevels;   //!< \~english Levels \~chinese 类别
+    arma::uvec mCodes;                  //!< \~english Codes of values \~chinese 取值的编码
+    std::vector<arma::uvec> mIndices;   //!< \~english Row indices of each level \~chinese 每个类别的行索引
+};
+
+}
+
+#endif  // CATEGORICAL_H
@@ -4,6 +4,7 @@
 #include <utility>
 #include <string>
 #include <initializer_list>
+#include <vector>
 #include "GWRBase.h"
 #include "RegressionDiagnostic.h"
 #include "IBandwidthSelectable.h"
@@ -52,6 +53,7 @@ public:
 
     typedef double (GTWR::*BandwidthSelectionCriterionCalculator)(BandwidthWeight*);//!< \~english Declaration of criterion calculator for bandwidth selection. \~chinese 带宽优选指标计算函数声明。
     typedef double (GTWR::*IndepVarsSelectCriterionCalculator)(const std::vector<std::size_t>&);//!< \~english Declaration of criterion calculator for variable selection. \~chinese 变量优选指标计算函数声明。
+    typedef arma::vec (GTWR::*JointCriterionCalculator)(const arma::mat&, const BandwidthWeight*);//!< \~english Declaration of criterion calculator for joint selection of bandwidth and lambda. \~chinese 带宽和lambda联合优选指标计算函数声明。
 
     /**
      * @brief \~english Get meta infomation of lambda and the corresponding criterion value.
@@ -333,9 +335,32 @@ public:
 public:     // Implement Algorithm
     bool isValid() override;
 
+public:     // Implement GWRBase
+    void saveModel(ModelArchive& archive) const override;
+    void loadModel(const ModelArchive& archive) override;
+
 public:     // Implement IRegressionAnalysis
     arma::mat predict(const arma::mat& locations) override;
 
+    /**
+     * \~english
+     * @brief Predict coefficients on specified locations and timestamps, which may differ from data points.
+     * A runtime_error is thrown if the distance is not a CRSSTDistance, which is the only one using timestamps.
+     * 
+     * @param locations Locations where to predict coefficients.
+     * @param times Timestamps of the locations.
+     * @return arma::mat Predicted coefficients.
+     * 
+     * \~chinese
+     * @brief 在指定位置和时间处进行回归系数预测，这些位置可以与数据点不同。
+     * 如果距离不是唯一使用时间戳的 CRSSTDistance ，则抛出 runtime_error 。
+     * 
+     * @param locations 指定位置。
+     * @param times 指定位置的时间戳。
+     * @return arma::mat 回归系数预测值。
+     */
+    arma::mat predict(const arma::mat& locations, const arma::vec& times);
+
     arma::mat fit() override;
 
 private:
@@ -343,6 +368,7 @@ private:
     /**
      * \~english 
      * @brief Predict coefficients on specified locations (serial implementation).
+     * Locations are processed in spatially coherent blocks, whose \f$X^TWX\f$ and \f$X^TWy\f$ are given by one matrix product.
      * 
      * @param locations Locations where to predict coefficients.
      * @param x Independent variables.
@@ -351,6 +377,7 @@ private:
      * 
      * \~chinese 
      * @brief 在指定位置处进行回归系数预测（单线程实现）。
+     * 位置按空间上连续的分块处理，每个分块的 \f$X^TWX\f$ 和 \f$X^TWy\f$ 由一次矩阵乘法得到。
      * 
      * @param locations 指定位置。
      * @param x 自变量矩阵。
@@ -388,6 +415,7 @@ private:
     /**
      * \~english 
      * @brief Predict coefficients on specified locations (OpenMP implementation).
+     * Blocks of locations are distributed to threads.
      * 
      * @param locations Locations where to predict coefficients.
      * @param x Independent variables.
@@ -396,6 +424,7 @@ private:
      * 
      * \~chinese 
      * @brief 在指定位置处进行回归系数预测（OpenMP 实现）。
+     * 位置分块被分配给各线程。
      * 
      * @param locations 指定位置。
      * @param x 自变量矩阵。
@@ -562,11 +591,85 @@ protected:
 
     /**
      * \~english
-     * @brief Lambda and bandwidth auto selection. not complete.
+     * @brief Joint auto selection of bandwidth, lambda and optionally the angle.
+     * A coarse grid of candidates is evaluated at once, then a compass search shrinks around the best candidate.
+     * The criterion is the bandwidth selection criterion (CV or AICc), which is comparable across all parameters.
+     * @param bandwidthWeight bandwidth weight to be updated with the selected bandwidth.
+     * \~chinese
+     * @brief 带宽、lambda 以及可选的角度的联合自动选择。
+     * 先一次性计算一组粗网格候选值，再围绕最优候选值进行逐步收缩的坐标搜索。
+     * 指标为带宽优选指标（CV 或 AICc），其在所有参数之间可比。
+     * @param bandwidthWeight 将被更新为选中带宽的带宽权重。
+     */
+    void JointAutoSelection(BandwidthWeight* bandwidthWeight);
+
+    /**
+     * \~english
+     * @brief Non-parallel implementation of criterions for candidates of joint selection.
+     * Spatial and temporal distances of each focus are calculated once and shared by all candidates.
+     * @param candidates Candidates, one row for each, columns are bandwidth, lambda and angle.
+     * @param bandwidthWeight bandwidth weight providing kernel and adaptive settings.
+     * @return arma::vec Criterion of each candidate, DBL_MAX for failed ones.
+     * \~chinese
+     * @brief 联合优选中各候选值指标的非并行实现。
+     * 每个目标点的空间距离和时间距离只计算一次，并由所有候选值共享。
+     * @param candidates 候选值，每行一个，各列依次为带宽、lambda 和角度。
+     * @param bandwidthWeight 提供核函数和是否可变带宽设置的带宽权重。
+     * @return arma::vec 各候选值的指标，失败的为 DBL_MAX 。
+     */
+    arma::vec jointCriterionSerial(const arma::mat& candidates, const BandwidthWeight* bandwidthWeight);
+
+#ifdef ENABLE_OPENMP
+    /**
+     * \~english
+     * @brief Multithreading implementation of criterions for candidates of joint selection.
+     * @param candidates Candidates, one row for each, columns are bandwidth, lambda and angle.
+     * @param bandwidthWeight bandwidth weight providing kernel and adaptive settings.
+     * @return arma::vec Criterion of each candidate, DBL_MAX for failed ones.
      * \~chinese
-     * @brief lambda和带宽自动选择。函数还没写好。
+     * @brief 联合优选中各候选值指标的多线程实现。
+     * @param candidates 候选值，每行一个，各列依次为带宽、lambda 和角度。
+     * @param bandwidthWeight 提供核函数和是否可变带宽设置的带宽权重。
+     * @return arma::vec 各候选值的指标，失败的为 DBL_MAX 。
      */
-    // void LambdaBwAutoSelection();
+    arma::vec jointCriterionOmp(const arma::mat& candidates, const BandwidthWeight* bandwidthWeight);
+#endif
+
+    /**
+     * \~english
+     * @brief Accumulate contributions of a focus to criterions of all candidates.
+     * @param focus Index of the focus.
+     * @param sdist Spatial distances to the focus.
+     * @param tdist Signed temporal distances to the focus.
+     * @param candidates Candidates, one row for each, columns are bandwidth, lambda and angle.
+     * @param weights Bandwidth weight of each candidate.
+     * @param acc [in,out] Accumulated RSS (or CV), \f$tr(S)\f$ and \f$tr(S^TS)\f$ of each candidate.
+     * @param failed [in,out] Whether each candidate has failed.
+     * \~chinese
+     * @brief 将一个目标点对所有候选值指标的贡献累加。
+     * @param focus 目标点索引。
+     * @param sdist 到目标点的空间距离。
+     * @param tdist 到目标点的带符号时间距离。
+     * @param candidates 候选值，每行一个，各列依次为带宽、lambda 和角度。
+     * @param weights 各候选值的带宽权重。
+     * @param acc [in,out] 各候选值累加的 RSS （或 CV ）、 \f$tr(S)\f$ 和 \f$tr(S^TS)\f$ 。
+     * @param failed [in,out] 各候选值是否已失败。
+     */
+    void jointCriterionFocus(arma::uword focus, const arma::vec& sdist, const arma::vec& tdist, const arma::mat& candidates, std::vector<BandwidthWeight>& weights, arma::mat& acc, arma::uvec& failed);
+
+    /**
+     * \~english
+     * @brief Get criterions from accumulated values.
+     * @param acc Accumulated RSS (or CV), \f$tr(S)\f$ and \f$tr(S^TS)\f$ of each candidate.
+     * @param failed Whether each candidate has failed.
+     * @return arma::vec Criterion of each candidate, DBL_MAX for failed ones.
+     * \~chinese
+     * @brief 由累加值得到指标。
+     * @param acc 各候选值累加的 RSS （或 CV ）、 \f$tr(S)\f$ 和 \f$tr(S^TS)\f$ 。
+     * @param failed 各候选值是否已失败。
+     * @return arma::vec 各候选值的指标，失败的为 DBL_MAX 。
+     */
+    arma::vec jointCriterionValue(const arma::mat& acc, const arma::uvec& failed);
 
     /**
      * \~english
@@ -611,6 +714,33 @@ public:
      */
     void setIsAutoselectLambda(bool isAutoSelect) { mIsAutoselectLambda = isAutoSelect; }
 
+    /**
+     * \~english
+     * @brief Set whether to select bandwidth and lambda jointly.
+     * When it is true, bandwidth and lambda are selected together by the bandwidth selection criterion,
+     * no matter whether bandwidth or lambda is set to be auto selected.
+     * 
+     * @param isAutoSelect true if select bandwidth and lambda jointly.
+     * \~chinese
+     * @brief 设置是否联合优选带宽和lambda。
+     * 为 true 时，无论是否设置了自动优选带宽或lambda，二者都将根据带宽优选指标一起优选。
+     * 
+     * @param isAutoSelect true 如果联合优选带宽和lambda。
+     */
+    void setIsJointAutoselect(bool isAutoSelect) { mIsJointAutoselect = isAutoSelect; }
+
+    /**
+     * \~english
+     * @brief Set whether to select the angle of oblique spatial temporal distance as well in joint selection.
+     * 
+     * @param isAutoSelect true if select the angle in \f$[0, \pi/2)\f$.
+     * \~chinese
+     * @brief 设置联合优选时是否同时优选斜交时空距离的角度。
+     * 
+     * @param isAutoSelect true 如果在 \f$[0, \pi/2)\f$ 中优选角度。
+     */
+    void setIsAutoselectAngle(bool isAutoSelect) { mIsAutoselectAngle = isAutoSelect; }
+
 protected:
 
     bool mHasHatMatrix = true;  //!< \~english Whether has hat-matrix. \~chinese 是否具有帽子矩阵。
@@ -619,6 +749,8 @@ protected:
 
     bool mIsAutoselectBandwidth = false;//!< \~english Whether need bandwidth autoselect. \~chinese 是否需要自动优选带宽。
     bool mIsAutoselectLambda = false;//!< \~english Whether need lambda autoselect. \~chinese 是否需要自动优选lambda。
+    bool mIsJointAutoselect = false;//!< \~english Whether to select bandwidth and lambda jointly. \~chinese 是否联合优选带宽和lambda。
+    bool mIsAutoselectAngle = false;//!< \~english Whether to select the angle in joint selection. \~chinese 联合优选时是否优选角度。
 
     BandwidthSelectionCriterionType mBandwidthSelectionCriterion = BandwidthSelectionCriterionType::AIC;//!< \~english Bandwidth Selection Criterion Type. \~chinese 默认的带宽优选方式。
     BandwidthSelectionCriterionCalculator mBandwidthSelectionCriterionFunction = &GTWR::bandwidthSizeCriterionCVSerial;//!< \~english Bandwidth Selection Criterion Function. \~chinese 默认的带宽优选函数。
@@ -627,6 +759,7 @@ protected:
 
     PredictCalculator mPredictFunction = &GTWR::predictSerial;//!< \~english Predict Function. \~chinese 默认的Predict函数。
     FitCalculator mFitFunction = &GTWR::fitSerial;//!< \~english Fit Function. \~chinese 默认的Fit函数。
+    JointCriterionCalculator mJointCriterionFunction = &GTWR::jointCriterionSerial;//!< \~english Criterion function for joint selection. \~chinese 联合优选的指标函数。
 
     ParallelType mParallelType = ParallelType::SerialOnly; //!< \~english Type of parallel method. \~chinese 并行方法类型。
     int mOmpThreadNum = 8;  //!< \~english Number of threads to create. \~chinese 并行计算创建的线程数。
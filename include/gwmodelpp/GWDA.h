@@ -1,7 +1,11 @@
 #ifndef GWDA_H
 #define GWDA_H
 
+#include <vector>
+#include <string>
+#include <unordered_map>
 #include "SpatialMonoscaleAlgorithm.h"
+#include "Categorical.h"
 #include "IMultivariableAnalysis.h"
 #include "IParallelizable.h"
 
@@ -310,7 +314,7 @@ namespace gwm
          *
          * @return std::vector<std::string> \~english Category information \~chinese 类别信息。
          */
-        std::vector<std::string> levels(std::vector<std::string> &y);
+        std::vector<std::string> levels(const std::vector<std::string> &y);
 
         /**
          * @brief \~english Calculate associated entropy. \~chinese 计算关联熵。
@@ -346,7 +350,11 @@ namespace gwm
     public: // IMultivariableAnalysis
         const arma::mat& variables() const override { return mX; }
         void setVariables(const arma::mat &x) override { mX = x; }
-        void setGroup(std::vector<std::string> &y) { mY = y; }
+        void setGroup(std::vector<std::string> &y)
+        {
+            mY = y;
+            mYCategory = Categorical(y);
+        }
         void run() override;
 
     public: // IParallelizable
@@ -380,6 +388,72 @@ namespace gwm
         void setOmpThreadNum(const int threadNum) override { mOmpThreadNum = threadNum; }
 
     private:
+        /**
+         * @brief \~english Training samples grouped by class, prepared once before the loop over focus points. \~chinese 按类别分组的训练样本，在遍历目标点之前一次性准备。
+         */
+        struct ClassSamples
+        {
+            Categorical category;               //!< \~english Encoded categories of samples \~chinese 样本的类别编码
+            std::vector<arma::mat> shifted;     //!< \~english Samples in each class shifted by the class mean \~chinese 各类别中减去类别均值后的样本
+            arma::mat center;                   //!< \~english Global mean of each class (one row per class) \~chinese 各类别的全局均值（每行一个类别）
+            arma::cube cov;                     //!< \~english Global variance-covariance matrix of each class (one slice per class) \~chinese 各类别的全局方差协方差矩阵（每层一个类别）
+            arma::vec count;                    //!< \~english Number of samples in each class \~chinese 各类别的样本数量
+        };
+
+        /**
+         * @brief \~english Group samples by class. \~chinese 按类别对样本分组。
+         *
+         * @param x \~english Independent variables. \~chinese 自变量矩阵。
+         * @param y \~english Encoded dependent variable. \~chinese 编码后的因变量。
+         *
+         * @return ClassSamples \~english Grouped samples \~chinese 分组后的样本
+         */
+        ClassSamples groupSamples(const arma::mat &x, const Categorical &y);
+
+        /**
+         * @brief \~english Calculate squared Mahalanobis distances for several differences sharing one variance-covariance matrix.
+         * The Cholesky factor of the matrix is computed once and reused by a triangular solve over all columns.
+         * \~chinese 为共用一个方差协方差矩阵的多个差值计算马氏距离平方。
+         * 该矩阵的 Cholesky 分解只计算一次，并通过三角求解用于所有列。
+         *
+         * @param sigma \~english Variance-covariance matrix \~chinese 方差协方差矩阵
+         * @param dx \~english Differences, one column for each \~chinese 差值，每列一个
+         *
+         * @return arma::rowvec \~english Squared Mahalanobis distance of each column \~chinese 每列的马氏距离平方
+         */
+        static arma::rowvec mahalanobis(const arma::mat &sigma, const arma::mat &dx);
+
+        /**
+         * @brief \~english Calculate the discriminant score of every class at one focus point.
+         * Weighted class means, variance-covariance matrices and weight sums are computed together from the weight vector,
+         * so that the \f$n \times n\f$ weight matrix is never needed.
+         * \~chinese 计算一个目标点处各类别的判别值。
+         * 加权的类别均值、方差协方差矩阵和权重和由权重向量一次计算得到，因此不需要 \f$n \times n\f$ 的权重矩阵。
+         *
+         * @param samples \~english Grouped samples \~chinese 分组后的样本
+         * @param w \~english Weight vector of the focus point \~chinese 目标点的权重向量
+         * @param xpr \~english Variables of the focus point \~chinese 目标点的自变量
+         * @param isWqda \~english Whether weighted quadratic discriminant analysis will be applied \~chinese 是否应用加权二次判别分析
+         * @param hasCov \~english Whether localised variance-covariance matrix is used \~chinese 是否使用局部方差协方差矩阵
+         * @param hasMean \~english Whether localised mean is used \~chinese 是否使用局部平均值
+         * @param classWeights [out] \~english Sum of weights in each class \~chinese 各类别的权重和
+         *
+         * @return arma::rowvec \~english Discriminant scores without the prior term \~chinese 不包含先验概率项的判别值
+         */
+        arma::rowvec localDiscriminant(const ClassSamples &samples, const arma::vec &w, const arma::rowvec &xpr, bool isWqda, bool hasCov, bool hasMean, arma::rowvec &classWeights);
+
+        /**
+         * @brief \~english Add the prior term to discriminant scores and classify each focus point. \~chinese 向判别值中加入先验概率项，并对每个目标点分类。
+         *
+         * @param logPf \~english Discriminant scores without the prior term \~chinese 不包含先验概率项的判别值
+         * @param classWeights \~english Sum of weights in each class at each focus point \~chinese 每个目标点处各类别的权重和
+         * @param samples \~english Grouped samples \~chinese 分组后的样本
+         * @param hasPrior \~english Whether localised prior probability is used \~chinese 是否使用局部先验概率
+         *
+         * @return arma::mat \~english The result matrix of geographical weighted discriminant analysis. \~chinese 地理加权判别分析结果矩阵。
+         */
+        arma::mat classify(const arma::mat &logPf, const arma::mat &classWeights, const ClassSamples &samples, bool hasPrior);
+
         /**
          * @brief \~english GW discriminant analysis \~chinese 地理加权判别分析算法的单线程实现。
          */
@@ -402,11 +476,13 @@ namespace gwm
            
         arma::mat mX; //!< \~english Independent variable matrix for training \~chinese 自变量矩阵
         std::vector<std::string> mY; //!< \~english Dependent variable vector \~chinese 因变量矩阵
+        Categorical mYCategory; //!< \~english Encoded dependent variable \~chinese 编码后的因变量
         bool mHasPredict; //!< \~english Whether prediction data are provided \~chinese 是否提供了预测数据
         arma::mat mprX; //!< \~english Variable Prediction independent variable matrix \~chinese 预测自变量矩阵
         std::vector<std::string> mprY; //!< \~english Prediction dependent variable matrix \~chinese 预测因变量矩阵
         arma::mat mRes; // !< \~english the result matrix of geographical weighted discriminant analysis \~chinese 地理加权判别分析结果矩阵
         std::vector<std::string> mGroup; //!< \~english Classification results \~chinese 分类结果
+        arma::uvec mGroupCode; //!< \~english Codes of classification results \~chinese 分类结果的编码
         arma::mat mProbs; //!< \~english Location-wise probabilities \~chinese 位置概率
         arma::mat mPmax; //!< \~english max location-wise probabilities \~chinese 位置概率最大值
         arma::mat mEntropy; //!< \~english Associated entropy \~chinese 相关熵
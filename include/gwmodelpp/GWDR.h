@@ -35,8 +35,20 @@ public:
         AIC     //!< AIC
     };
 
+    /**
+     * @brief \~english Type of bandwidth optimizer. \~chinese 带宽优选器类型。
+     * 
+     */
+    enum BandwidthOptimizerType
+    {
+        NelderMead, //!< \~english Nelder-Mead simplex of GSL \~chinese GSL 的 Nelder-Mead 单纯形法
+        LBFGSB      //!< \~english Bounded limited-memory quasi-Newton method warm-started from a coarse grid \~chinese 从粗网格热启动的有界限制内存拟牛顿法
+    };
+
     typedef double (GWDR::*BandwidthCriterionCalculator)(const std::vector<BandwidthWeight*>&); //!< \~english Calculator to get criterion for bandwidth optimization \~chinese 带宽优选指标值计算函数
 
+    typedef arma::vec (GWDR::*BandwidthCriteriaCalculator)(const arma::mat&); //!< \~english Calculator to get criterions for many candidate bandwidths at once \~chinese 一次计算多组候选带宽指标值的函数
+
     typedef double (GWDR::*IndepVarCriterionCalculator)(const std::vector<std::size_t>&); //!< \~english Calculator to get criterion for variable optimization \~chinese 变量优选指标值计算函数
 
 public:
@@ -234,6 +246,20 @@ public:
      */
     void setBandwidthCriterionType(const BandwidthCriterionType& type);
 
+    /**
+     * @brief \~english Get the type of bandwidth optimizer. \~chinese 获取带宽优选器类型。
+     * 
+     * @return BandwidthOptimizerType \~english Type of bandwidth optimizer \~chinese 带宽优选器类型
+     */
+    BandwidthOptimizerType bandwidthOptimizerType() const { return mBandwidthOptimizerType; }
+
+    /**
+     * @brief \~english Set the type of bandwidth optimizer. \~chinese 设置带宽优选器类型。
+     * 
+     * @param type \~english Type of bandwidth optimizer \~chinese 带宽优选器类型
+     */
+    void setBandwidthOptimizerType(const BandwidthOptimizerType& type) { mBandwidthOptimizerType = type; }
+
     /**
      * @brief \~english Get whether independent variable selection is enabled. \~chinese 获取是否优选变量。
      * 
@@ -320,7 +346,16 @@ public: // IRegressionAnalysis
 
     virtual RegressionDiagnostic diagnostic() const override { return mDiagnostic; }
 
-    virtual arma::mat predict(const arma::mat& locations) override { return arma::mat(locations.n_rows, mX.n_cols, arma::fill::zeros); }
+    /**
+     * @brief \~english Predict coefficients on specified locations, which may differ from data points.
+     * Distances of each dimension are reset to be from these locations, so the model needs to be fitted again before other calculations.
+     * \~chinese 在指定位置处进行回归系数预测，这些位置可以与数据点不同。
+     * 各维度的距离将被重置为到这些位置的距离，因此进行其他计算前需要重新拟合模型。
+     * 
+     * @param locations \~english Locations to predict, one column for each dimension \~chinese 要预测的位置，每个维度一列
+     * @return arma::mat \~english Coefficient estimates \~chinese 回归系数估计值
+     */
+    virtual arma::mat predict(const arma::mat& locations) override;
 
     virtual arma::mat fit() override;
 
@@ -372,6 +407,20 @@ public:
         return (this->*mBandwidthCriterionFunction)(bandwidths);
     }
 
+    /**
+     * @brief \~english Calculate criterions for many candidate bandwidths in one pass over focus points.
+     * Distances of each focus point are calculated once and shared by all candidates.
+     * \~chinese 在对目标点的一次遍历中计算多组候选带宽的指标值。
+     * 每个目标点的距离只计算一次，由所有候选共享。
+     * 
+     * @param candidates \~english Candidate bandwidths, one row for each candidate and one column for each dimension \~chinese 候选带宽，每行一组候选，每列一个维度
+     * @return arma::vec \~english Criterion values, DBL_MAX for failed candidates \~chinese 指标值，失败的候选为 DBL_MAX
+     */
+    arma::vec bandwidthCriteria(const arma::mat& candidates)
+    {
+        return (this->*mBandwidthCriteriaFunction)(candidates);
+    }
+
 protected:
 
     /**
@@ -413,6 +462,14 @@ protected:
      */
     double bandwidthCriterionCVSerial(const std::vector<BandwidthWeight*>& bandwidths);
 
+    /**
+     * @brief \~english Non-parallel implementation of calculator to get criterions for many candidate bandwidths. \~chinese 获取多组候选带宽指标值的非并行实现。
+     * 
+     * @param candidates \~english Candidate bandwidths, one row for each candidate \~chinese 候选带宽，每行一组候选
+     * @return arma::vec \~english Criterion values \~chinese 指标值
+     */
+    arma::vec bandwidthCriteriaSerial(const arma::mat& candidates);
+
     /**
      * @brief \~english Non-parallel implementation of calculator to get AIC criterion for given variable combination. \~chinese 获取给定变量组合对应的AIC值的非并行实现。
      * 
@@ -460,6 +517,14 @@ protected:
      * @return double \~english Criterion value \~chinese 指标值
      */
     double bandwidthCriterionCVOmp(const std::vector<BandwidthWeight*>& bandwidths);
+
+    /**
+     * @brief \~english Multithreading implementation of calculator to get criterions for many candidate bandwidths. \~chinese 获取多组候选带宽指标值的多线程实现。
+     * 
+     * @param candidates \~english Candidate bandwidths, one row for each candidate \~chinese 候选带宽，每行一组候选
+     * @return arma::vec \~english Criterion values \~chinese 指标值
+     */
+    arma::vec bandwidthCriteriaOmp(const arma::mat& candidates);
     
     /**
      * @brief \~english Multithreading implementation of calculator to get AIC criterion for given variable combination. \~chinese 获取给定变量组合对应的AIC值的多线程实现。
@@ -483,11 +548,141 @@ private:
         return mHasHatMatrix && (mCoords.n_rows < 8192);
     }
 
+    /**
+     * @brief \~english Create bandwidth weights of every dimension for each candidate. \~chinese 为每组候选创建各维度的带宽权重。
+     * 
+     * @param candidates \~english Candidate bandwidths, one row for each candidate \~chinese 候选带宽，每行一组候选
+     * @return std::vector<std::vector<BandwidthWeight>> \~english Bandwidth weights, one vector for each candidate \~chinese 带宽权重，每组候选一个向量
+     */
+    std::vector<std::vector<BandwidthWeight>> candidateWeights(const arma::mat& candidates);
+
+    /**
+     * @brief \~english Accumulate contributions of a focus point to criterions of all candidates. \~chinese 累加一个目标点对所有候选指标值的贡献。
+     * 
+     * @param focus \~english Index of the focus point \~chinese 目标点索引
+     * @param dists \~english Distances to the focus point on each dimension \~chinese 各维度上到目标点的距离
+     * @param weights \~english Bandwidth weights of each candidate \~chinese 各组候选的带宽权重
+     * @param acc \~english [in,out] Sums of squared residuals and traces of \f$S\f$, one row for each candidate \~chinese [入参,出参] 残差平方和与 \f$S\f$ 的迹，每行一组候选
+     * @param failed \~english [in,out] Whether each candidate failed \~chinese [入参,出参] 每组候选是否失败
+     */
+    void bandwidthCriteriaFocus(arma::uword focus, const std::vector<arma::vec>& dists, std::vector<std::vector<BandwidthWeight>>& weights, arma::mat& acc, arma::uvec& failed);
+
+    /**
+     * @brief \~english Get criterion values from accumulated sums. \~chinese 根据累加和获取指标值。
+     * 
+     * @param candidates \~english Candidate bandwidths, one row for each candidate \~chinese 候选带宽，每行一组候选
+     * @param acc \~english Sums of squared residuals and traces of \f$S\f$ \~chinese 残差平方和与 \f$S\f$ 的迹
+     * @param failed \~english Whether each candidate failed \~chinese 每组候选是否失败
+     * @return arma::vec \~english Criterion values \~chinese 指标值
+     */
+    arma::vec bandwidthCriteriaValue(const arma::mat& candidates, const arma::mat& acc, const arma::uvec& failed);
+
+    /**
+     * @brief \~english Get whether a kernel function has compact support. \~chinese 获取核函数是否为紧支撑。
+     *
+     * @param kernel \~english Kernel function type \~chinese 核函数类型
+     * @return true \~english Weights are zero beyond the bandwidth \~chinese 超出带宽的权重为零
+     * @return false \~english Weights are positive everywhere \~chinese 权重处处为正
+     */
+    static bool isCompactKernel(BandwidthWeight::KernelFunctionType kernel)
+    {
+        return kernel == BandwidthWeight::Bisquare || kernel == BandwidthWeight::Tricube || kernel == BandwidthWeight::Boxcar;
+    }
+
+    /**
+     * @brief \~english Reset the weight cache and sort data points on each dimension. \~chinese 重置权重缓存并对每个维度上的数据点排序。
+     */
+    void prepareWeightCache();
+
+    /**
+     * @brief \~english Get whether weights of a dimension are cached for a bandwidth. \~chinese 获取一个维度在某带宽下的权重是否已缓存。
+     *
+     * @param m \~english Index of the dimension \~chinese 维度索引
+     * @param bandwidth \~english Bandwidth weight \~chinese 带宽权重
+     * @return true \~english Cached \~chinese 已缓存
+     * @return false \~english Not cached \~chinese 未缓存
+     */
+    bool isWeightCached(arma::uword m, const BandwidthWeight* bandwidth) const;
+
+    /**
+     * @brief \~english Recalculate cached weights of dimensions whose bandwidth has changed. \~chinese 重新计算带宽发生变化的维度的缓存权重。
+     *
+     * @param bandwidths \~english Bandwidth weights of each dimension \~chinese 各维度的带宽权重
+     */
+    void updateWeightCache(const std::vector<BandwidthWeight*>& bandwidths);
+
+    /**
+     * @brief \~english Update the weight cache to the most frequent bandwidth of each dimension among candidates. \~chinese 将权重缓存更新为各维度候选中出现最多的带宽。
+     *
+     * Candidates of forward differences differ from the base point in only one dimension, so most of their weights are shared.
+     *
+     * @param candidates \~english Candidate bandwidths, one row for each candidate \~chinese 候选带宽，每行一组候选
+     */
+    void prepareCandidateWeightCache(const arma::mat& candidates);
+
+    /**
+     * @brief \~english Get the product weights of all dimensions for a focus point. \~chinese 获取一个目标点在所有维度上的乘积权重。
+     *
+     * Cached weights are used for dimensions whose bandwidth matches the cache, and the others are calculated from distances.
+     *
+     * @param focus \~english Index of the focus point \~chinese 目标点索引
+     * @param bandwidths \~english Bandwidth weights of each dimension \~chinese 各维度的带宽权重
+     * @param dists \~english Distances to the focus point on each dimension, calculated when null \~chinese 各维度上到目标点的距离，为空时重新计算
+     * @return arma::vec \~english Weights of all data points \~chinese 所有数据点的权重
+     */
+    arma::vec focusWeight(arma::uword focus, const std::vector<BandwidthWeight*>& bandwidths, const std::vector<arma::vec>* dists = nullptr);
+
+    /**
+     * @brief \~english Get the product weights of all dimensions for a prediction location. \~chinese 获取一个预测位置在所有维度上的乘积权重。
+     *
+     * The weight cache holds weights between data points and is keyed only on bandwidths, so it is never read here.
+     *
+     * @param focus \~english Index of the prediction location \~chinese 预测位置索引
+     * @param bandwidths \~english Bandwidth weights of each dimension \~chinese 各维度的带宽权重
+     * @return arma::vec \~english Weights of all data points \~chinese 所有数据点的权重
+     */
+    arma::vec predictWeight(arma::uword focus, const std::vector<BandwidthWeight*>& bandwidths);
+
+    /**
+     * @brief \~english Get data points with non-zero weights for a focus point and their weights. \~chinese 获取一个目标点的非零权重数据点及其权重。
+     *
+     * When all kernels are compact and cached, neighbours are found by intersecting the ranges of non-zero weights on each dimension,
+     * starting from the narrowest one, without touching other data points.
+     * Otherwise all data points are returned.
+     *
+     * @param focus \~english Index of the focus point \~chinese 目标点索引
+     * @param bandwidths \~english Bandwidth weights of each dimension \~chinese 各维度的带宽权重
+     * @param w \~english [out] Weights of returned data points \~chinese [出参] 返回的数据点的权重
+     * @param dists \~english Distances to the focus point on each dimension, calculated when null \~chinese 各维度上到目标点的距离，为空时重新计算
+     * @return arma::uvec \~english Indices of data points in ascending order \~chinese 升序排列的数据点索引
+     */
+    arma::uvec focusNeighbours(arma::uword focus, const std::vector<BandwidthWeight*>& bandwidths, arma::vec& w, const std::vector<arma::vec>* dists = nullptr);
+
+private:
+
+    /**
+     * @brief \~english Cached weights of one dimension. \~chinese 一个维度的缓存权重。
+     */
+    struct WeightCache
+    {
+        bool valid = false;     //!< \~english Whether weights are calculated \~chinese 权重是否已计算
+        double bandwidth = 0.0; //!< \~english Bandwidth of cached weights \~chinese 缓存权重的带宽
+        bool adaptive = false;  //!< \~english Whether the bandwidth is adaptive \~chinese 带宽是否为自适应
+        BandwidthWeight::KernelFunctionType kernel = BandwidthWeight::Gaussian; //!< \~english Kernel function \~chinese 核函数
+        arma::mat weights;      //!< \~english Weights, one column for each focus point \~chinese 权重，每个目标点一列
+        arma::uvec order;       //!< \~english Indices of data points sorted by coordinate \~chinese 按坐标排序的数据点索引
+        arma::uvec rank;        //!< \~english Position of each data point in the sorted order \~chinese 各数据点在排序中的位置
+        arma::umat range;       //!< \~english Sorted positions \f$[begin, end)\f$ of non-zero weights for compact kernels, one column for each focus point \~chinese 紧支撑核函数下非零权重的排序位置 \f$[begin, end)\f$，每个目标点一列
+    };
+
+    static const arma::uword MaxWeightCacheSize = arma::uword(1) << 24; //!< \~english Maximum number of cached weights of all dimensions \~chinese 所有维度缓存权重的最大数量
+
 private:
 
     arma::mat mX;                       //!< \~english Dependent variables \~chinese 因变量
     arma::vec mY;                       //!< \~english Independent variables \~chinese 自变量
     std::vector<SpatialWeight> mSpatialWeights; //!< \~english Spatial weighting scheme \~chinese 空间权重配置
+    std::vector<WeightCache> mWeightCache;  //!< \~english Cached weights of each dimension, empty when too large \~chinese 各维度的缓存权重，过大时为空
     arma::mat mBetas;                   //!< \~english Coefficient estimates \~chinese 回归系数估计值
     bool mHasHatMatrix = true;          //!< \~english Whether has hat matrix \~chinese 是否有帽子矩阵 
     bool mHasIntercept = true;          //!< \~english Whether has intercept \~chinese 是否包含截距 
@@ -499,6 +694,8 @@ private:
     bool mEnableBandwidthOptimize = false;  //!< \~english Whether bandwidth optimization is enabled \~chinese 是否进行带宽优选
     BandwidthCriterionType mBandwidthCriterionType = BandwidthCriterionType::CV;    //!< \~english Type of criterion for bandwidth optimization \~chinese 带宽优选指标类型
     BandwidthCriterionCalculator mBandwidthCriterionFunction = &GWDR::bandwidthCriterionCVSerial;   //!< \~english Calculator to get criterion for given bandwidth value \~chinese 用于根据给定带宽值计算指标值的函数
+    BandwidthCriteriaCalculator mBandwidthCriteriaFunction = &GWDR::bandwidthCriteriaSerial;   //!< \~english Calculator to get criterions for many candidate bandwidths \~chinese 用于计算多组候选带宽指标值的函数
+    BandwidthOptimizerType mBandwidthOptimizerType = BandwidthOptimizerType::NelderMead;   //!< \~english Type of bandwidth optimizer \~chinese 带宽优选器类型
     double mBandwidthOptimizeEps = 1e-6;    //!< \~english Threshold for bandwidth optimization \~chinese 带宽优选阈值
     std::size_t mBandwidthOptimizeMaxIter = 100000; //!< \~english Maximum iteration for bandwidth optimization \~chinese 带宽优选最大迭代次数
     double mBandwidthOptimizeStep = 0.01;   //!< \~english Step size for bandwidth optimization \~chinese 带宽优选步长
@@ -603,6 +800,28 @@ public:
      */
     const int optimize(GWDR* instance, arma::uword featureCount, std::size_t maxIter, double eps, double step);
 
+    /**
+     * @brief \~english Optimize bandwidth for a GWDR model by a bounded limited-memory quasi-Newton method.
+     * Bandwidths are scaled to \f$[0,1]\f$ by their bounds.
+     * The start point is the best one in a coarse grid, whose criterions are calculated in one pass by GWDR::bandwidthCriteria().
+     * Each iteration takes a two-loop L-BFGS direction restricted to free variables,
+     * and a projected backtracking line search whose trial steps are also evaluated in one pass.
+     * The gradient is approximated by forward differences, whose \f$d\f$ model fits are evaluated in one pass.
+     * \~chinese 使用有界限制内存拟牛顿法为 GWDR 模型优选带宽。
+     * 带宽按其上下界缩放到 \f$[0,1]\f$ 。
+     * 起点为粗网格中的最优点，网格的指标值通过 GWDR::bandwidthCriteria() 一次计算。
+     * 每次迭代在自由变量上采用双循环 L-BFGS 方向，并进行投影回溯线搜索，各试探步长同样一次计算。
+     * 梯度由前向差分近似，其 \f$d\f$ 次模型拟合一次计算。
+     * 
+     * @param instance \~english A GWDR instance \~chinese 一个 GWDR 实例
+     * @param lower \~english Lower bounds of bandwidths \~chinese 带宽下界
+     * @param upper \~english Upper bounds of bandwidths \~chinese 带宽上界
+     * @param maxIter \~english Maximum of iteration \~chinese 最大迭代次数
+     * @param eps \~english Threshold of convergence for the projected gradient and the relative decrease of criterion \~chinese 投影梯度与指标值相对下降量的收敛阈值
+     * @return const int \~english Optimizer status, 0 if succeeded \~chinese 优化器退出状态，成功时为 0
+     */
+    const int optimizeLbfgsb(GWDR* instance, const arma::vec& lower, const arma::vec& upper, std::size_t maxIter, double eps);
+
 private:
     std::vector<BandwidthWeight*> mBandwidths;  //!< \~english Bandwidths \~chinese 带宽
 };
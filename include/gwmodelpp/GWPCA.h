@@ -16,11 +16,13 @@ namespace gwm
  * @brief \~english Geographically weighted principle component analysis. \~chinese 地理加权主成分分析。
  * 
  */
-class GWPCA: public SpatialMonoscaleAlgorithm, public IMultivariableAnalysis
+class GWPCA: public SpatialMonoscaleAlgorithm, public IMultivariableAnalysis, public IParallelizable, public IParallelOpenmpEnabled
 {
 private:
     typedef arma::mat (GWPCA::*Solver)(const arma::mat&, arma::cube&, arma::mat&);  //!< \~english Calculator to solve \~chinese 模型求解函数
 
+    typedef arma::mat (GWPCA::*MonteCarloCalculator)(const arma::umat&, double);  //!< \~english Calculator for Monte Carlo replicates \~chinese 蒙特卡洛重复计算函数
+
 public: // Constructors and Deconstructors
 
     /**
@@ -86,10 +88,106 @@ public: // Constructors and Deconstructors
     /**
      * @brief \~english Get the Scores matrix. \~chinese 获取得分矩阵。
      * 
+     * \~english
+     * Slice \f$i\f$ holds scores of all samples on the leading components at sample \f$i\f$,
+     * whose shape is \f$n \times k\f$.
+     * It is empty unless setHasScores() is called with true before run().
+     * 
+     * \~chinese
+     * 第 \f$i\f$ 个切片为所有样本在第 \f$i\f$ 个样本处前几个主成分上的得分，其形状为 \f$n \times k\f$。
+     * 除非在 run() 之前调用 setHasScores() 并传入 true，否则为空。
+     * 
      * @return arma::mat \~english Scores matrix \~chinese 得分矩阵
      */
     const arma::cube& scores() { return mScores; }
 
+    /**
+     * @brief \~english Get whether to calculate local scores. \~chinese 获取是否计算局部得分。
+     * 
+     * @return true \~english if local scores are calculated \~chinese 如果计算局部得分
+     * @return false \~english if local scores are not calculated \~chinese 如果不计算局部得分
+     */
+    bool hasScores() { return mHasScores; }
+
+    /**
+     * @brief \~english Set whether to calculate local scores. \~chinese 设置是否计算局部得分。
+     * 
+     * @param flag \~english Whether to calculate local scores, which takes \f$O(n^2 k)\f$ memory \~chinese 是否计算局部得分，需要 \f$O(n^2 k)\f$ 的内存
+     */
+    void setHasScores(bool flag) { mHasScores = flag; }
+
+    /**
+     * @brief \~english Get the number of Monte Carlo replicates. \~chinese 获取蒙特卡洛重复次数。
+     * 
+     * @return int \~english Number of Monte Carlo replicates \~chinese 蒙特卡洛重复次数
+     */
+    int monteCarloTimes() { return mMonteCarloTimes; }
+
+    /**
+     * @brief \~english Set the number of Monte Carlo replicates. \~chinese 设置蒙特卡洛重复次数。
+     * 
+     * \~english
+     * When it is positive, a Monte Carlo test of the non-stationarity of local eigenvalues is carried out in run().
+     * In each replicate, coordinates are randomly permuted among samples,
+     * and the test statistic is the standard deviation of local variances of the first component.
+     * 
+     * \~chinese
+     * 当其为正数时，在 run() 中对局部特征值的非平稳性进行蒙特卡洛检验。
+     * 每次重复中，坐标在样本之间随机置换，检验统计量为第一主成分局部方差的标准差。
+     * 
+     * @param times \~english Number of Monte Carlo replicates, 0 to disable the test \~chinese 蒙特卡洛重复次数，0 表示不进行检验
+     */
+    void setMonteCarloTimes(int times) { mMonteCarloTimes = times; }
+
+    /**
+     * @brief \~english Get the seed of random permutations. \~chinese 获取随机置换的种子。
+     * 
+     * @return unsigned long long \~english Seed of random permutations \~chinese 随机置换的种子
+     */
+    unsigned long long monteCarloSeed() { return mMonteCarloSeed; }
+
+    /**
+     * @brief \~english Set the seed of random permutations. \~chinese 设置随机置换的种子。
+     * 
+     * @param seed \~english Seed of random permutations. Each replicate draws from its own stream derived from the seed,
+     * so results do not depend on the parallel type or the number of threads.
+     * \~chinese 随机置换的种子。每次重复使用由该种子派生的独立随机数流，因此结果与并行方法和线程数无关。
+     */
+    void setMonteCarloSeed(unsigned long long seed) { mMonteCarloSeed = seed; }
+
+    /**
+     * @brief \~english Get the test statistic of the data. \~chinese 获取数据的检验统计量。
+     * 
+     * @return double \~english Standard deviation of local variances of the first component \~chinese 第一主成分局部方差的标准差
+     */
+    double monteCarloStatistic() { return mMonteCarloStatistic; }
+
+    /**
+     * @brief \~english Get test statistics of all replicates. \~chinese 获取所有重复的检验统计量。
+     * 
+     * @return const arma::vec& \~english Test statistics of all replicates \~chinese 所有重复的检验统计量
+     */
+    const arma::vec& monteCarloReplicates() { return mMonteCarloReplicates; }
+
+    /**
+     * @brief \~english Get the p-value of the Monte Carlo test. \~chinese 获取蒙特卡洛检验的 p 值。
+     * 
+     * @return double \~english Proportion of replicates, including the data itself, whose statistics are not less than the statistic of the data \~chinese 统计量不小于数据统计量的重复（包括数据本身）所占比例
+     */
+    double monteCarloPValue() { return mMonteCarloPValue; }
+
+    /**
+     * @brief \~english Generate a random permutation from an independent stream.
+     * The \f$r\f$-th replicate of the Monte Carlo test places the \f$t\f$-th sample at the \f$perm(t)\f$-th coordinate with `stream` \f$= r\f$.
+     * \~chinese 从独立的随机数流生成一个随机置换。
+     * 蒙特卡洛检验的第 \f$r\f$ 次重复使用 `stream` \f$= r\f$ 的置换，将第 \f$t\f$ 个样本放在第 \f$perm(t)\f$ 个坐标处。
+     * 
+     * @param n \~english Number of elements \~chinese 元素数量
+     * @param stream \~english Index of the stream \~chinese 随机数流的索引
+     * @return arma::uvec \~english Permutation \~chinese 置换
+     */
+    arma::uvec permutation(arma::uword n, arma::uword stream) const;
+
 public: // IMultivariableAnalysis
     virtual const arma::mat& variables() const override { return mX; }
     virtual void setVariables(const arma::mat& x) override { mX = x; }
@@ -98,6 +196,21 @@ public: // IMultivariableAnalysis
 public: // Algorithm
     virtual bool isValid() override;
 
+public:     // IParallelizable
+    int parallelAbility() const override
+    {
+        return ParallelType::SerialOnly
+#ifdef ENABLE_OPENMP
+            | ParallelType::OpenMP
+#endif        
+            ;
+    }
+    ParallelType parallelType() const override { return mParallelType; }
+    void setParallelType(const ParallelType& type) override;
+
+public:     // IParallelOpenmpEnabled
+    void setOmpThreadNum(const int threadNum) override { mOmpThreadNum = threadNum; }
+
 private:
 
     /**
@@ -123,18 +236,93 @@ private:
      */
     arma::mat solveSerial(const arma::mat& x, arma::cube& loadings, arma::mat& sdev);
 
+#ifdef ENABLE_OPENMP
+    /**
+     * @brief \~english Multithreading version of PCA funtion. \~chinese 多线程 PCA 函数。
+     * 
+     * @param x \~english Symmetric data matrix \~chinese 对称数据矩阵
+     * @param loadings [out] \~english Out reference to loadings matrix \~chinese 载荷矩阵
+     * @param sdev [out] \~english Out reference to standard deviation matrix \~chinese 标准差
+     * @return arma::mat \~english Principle values matrix \~chinese 主成分值矩阵
+     */
+    arma::mat solveOmp(const arma::mat& x, arma::cube& loadings, arma::mat& sdev);
+#endif
+
     /**
      * @brief \~english Function to carry out weighted PCA. \~chinese 执行加权PCA的函数。
      * 
+     * \~english
+     * The eigen decomposition of the \f$p \times p\f$ weighted covariance matrix is used instead of the SVD of the \f$n \times p\f$ weighted data matrix,
+     * and only samples with non-zero weights are involved.
+     * Values in \f$d\f$ are the same as singular values of the weighted data matrix.
+     * 
+     * \~chinese
+     * 使用 \f$p \times p\f$ 加权协方差矩阵的特征分解代替 \f$n \times p\f$ 加权数据矩阵的奇异值分解，并且只使用权重非零的样本。
+     * \f$d\f$ 中的值与加权数据矩阵的奇异值相同。
+     * 
      * @param x \~english Symmetric data matrix \~chinese 对称数据矩阵
      * @param w \~english Weight vector \~chinese 权重向量
-     * @param V [out] \~english Right orthogonal matrix \~chinese 右边的正交矩阵
-     * @param d [out] \~english Rectangular diagonal matri \~chinese 矩形对角阵
+     * @param V [out] \~english Leading \f$k\f$ right singular vectors \~chinese 前 \f$k\f$ 个右奇异向量
+     * @param d [out] \~english Singular values in descending order \~chinese 降序排列的奇异值
      */
     void wpca(const arma::mat& x, const arma::vec& w, arma::mat& V, arma::vec & d);
 
+    /**
+     * @brief \~english Carry out the Monte Carlo test. \~chinese 执行蒙特卡洛检验。
+     */
+    void monteCarloTest();
+
+    /**
+     * @brief \~english Serial version of Monte Carlo replicates. \~chinese 单线程蒙特卡洛重复计算函数。
+     * 
+     * \~english
+     * Permuting coordinates is equivalent to permuting weights among samples at a relabelled focus,
+     * so the weight vector of each sample is calculated once and shared by all replicates.
+     * 
+     * \~chinese
+     * 置换坐标等价于在重新标记的样本处将权重在样本间置换，因此每个样本的权重向量只计算一次并由所有重复共享。
+     * 
+     * @param perms \~english Permutations, one column for each replicate \~chinese 置换，每列对应一次重复
+     * @param sumw \~english Sum of weights used to scale variances \~chinese 用于缩放方差的权重之和
+     * @return arma::mat \~english Local variances of the first component, one column for each replicate \~chinese 第一主成分的局部方差，每列对应一次重复
+     */
+    arma::mat monteCarloSerial(const arma::umat& perms, double sumw);
+
+#ifdef ENABLE_OPENMP
+    /**
+     * @brief \~english Multithreading version of Monte Carlo replicates. \~chinese 多线程蒙特卡洛重复计算函数。
+     * 
+     * @param perms \~english Permutations, one column for each replicate \~chinese 置换，每列对应一次重复
+     * @param sumw \~english Sum of weights used to scale variances \~chinese 用于缩放方差的权重之和
+     * @return arma::mat \~english Local variances of the first component, one column for each replicate \~chinese 第一主成分的局部方差，每列对应一次重复
+     */
+    arma::mat monteCarloOmp(const arma::umat& perms, double sumw);
+#endif
+
+    /**
+     * @brief \~english Calculate the weighted covariance matrix of samples with non-zero weights. \~chinese 计算权重非零样本的加权协方差矩阵。
+     * 
+     * @param x \~english Symmetric data matrix \~chinese 对称数据矩阵
+     * @param w \~english Weight vector \~chinese 权重向量
+     * @return arma::mat \~english Weighted covariance matrix, not divided by the sum of weights \~chinese 未除以权重之和的加权协方差矩阵
+     */
+    arma::mat wcov(const arma::mat& x, const arma::vec& w);
+
+    /**
+     * @brief \~english Calculate standard deviations and percentages of variance from singular values. \~chinese 根据奇异值计算标准差和方差百分比。
+     * 
+     * @param d_all \~english Singular values, one column for each sample \~chinese 奇异值，每列对应一个样本
+     * @param sumw \~english Sum of weights \~chinese 权重之和
+     * @param sdev [out] \~english Out reference to standard deviation matrix \~chinese 标准差
+     * @return arma::mat \~english Principle values matrix \~chinese 主成分值矩阵
+     */
+    arma::mat summarize(const arma::mat& d_all, double sumw, arma::mat& sdev);
+
 private:    // Algorithm Parameters
     int mK = 2;  //!< \~english Number of components to be kept \~chinese 要保留的主成分数量
+    bool mHasScores = false;    //!< \~english Whether to calculate local scores \~chinese 是否计算局部得分
+    int mMonteCarloTimes = 0;   //!< \~english Number of Monte Carlo replicates \~chinese 蒙特卡洛重复次数
+    unsigned long long mMonteCarloSeed = 0; //!< \~english Seed of random permutations \~chinese 随机置换的种子
     // bool mRobust = false;
 
 private:    // Algorithm Results
@@ -143,12 +331,19 @@ private:    // Algorithm Results
     arma::mat mSDev;                  //!< \~english Standard Deviation \~chinese 标准差矩阵
     arma::cube mScores;               //!< \~english Scores for each variable \~chinese 得分矩阵
     arma::uvec mWinner;               //!< \~english Winner variable at each sample \~chinese 优胜变量索引值
+    double mMonteCarloStatistic = 0.0;  //!< \~english Test statistic of the data \~chinese 数据的检验统计量
+    arma::vec mMonteCarloReplicates;    //!< \~english Test statistics of replicates \~chinese 各次重复的检验统计量
+    double mMonteCarloPValue = 1.0;     //!< \~english p-value of the Monte Carlo test \~chinese 蒙特卡洛检验的 p 值
 
 private:    // Algorithm Runtime Variables
     arma::mat mX;           //!< \~english Variable matrix \~chinese 变量矩阵
     arma::vec mLatestWt;    //!< \~english Latest weigths \~chinese 最新的权重
 
     Solver mSolver = &GWPCA::solveSerial;   //!< \~english Calculator to solve \~chinese 模型求解函数
+    MonteCarloCalculator mMonteCarloCalculator = &GWPCA::monteCarloSerial;  //!< \~english Calculator for Monte Carlo replicates \~chinese 蒙特卡洛重复计算函数
+
+    ParallelType mParallelType = ParallelType::SerialOnly;  //!< \~english Parallel type \~chinese 并行方法
+    int mOmpThreadNum = 8;                                  //!< \~english Numbers of threads to be created while paralleling \~chinese 多线程所使用的线程数
 };
 
 }
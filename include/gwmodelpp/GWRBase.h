@@ -3,6 +3,7 @@
 
 #include "SpatialMonoscaleAlgorithm.h"
 #include "IRegressionAnalysis.h"
+#include "ModelArchive.h"
 
 namespace gwm
 {
@@ -90,7 +91,30 @@ public:
     static double AICc(const arma::mat& x, const arma::mat& y, const arma::mat& betas, const arma::vec& shat)
     {
         double ss = RSS(x, y, betas), n = (double)x.n_rows;
-        return n * log(ss / n) + n * log(2 * arma::datum::pi) + n * ((n + shat(0)) / (n - 2 - shat(0)));
+        return AICc(ss, n, shat(0));
+    }
+
+    /**
+     * \~english
+     * @brief Calculate AICc value according to given RSS, number of samples and \f$tr(S)\f$.
+     * 
+     * @param rss Residual sum of squares.
+     * @param n Number of samples.
+     * @param trS Trace of hat matrix \f$tr(S)\f$.
+     * @return double AICc value.
+     * 
+     * \~chinese
+     * @brief 根据给定的残差平方和、样本数量和 \f$tr(S)\f$ 计算 AICc 值。
+     * 
+     * @param rss 残差平方和。
+     * @param n 样本数量。
+     * @param trS 帽子矩阵的迹 \f$tr(S)\f$。
+     * @return double AICc 值。
+     * 
+     */
+    static double AICc(double rss, double n, double trS)
+    {
+        return n * log(rss / n) + n * log(2 * arma::datum::pi) + n * ((n + trS) / (n - 2 - trS));
     }
 
 public:
@@ -170,6 +194,127 @@ public:     // Implement IRegressionAnalysis
 public:
     virtual bool isValid() override;
 
+public:
+
+    /**
+     * \~english
+     * @brief Store the fitted state into an archive.
+     * Derived classes store their own results after calling this function.
+     * 
+     * @param archive Archive to store the state in.
+     * 
+     * \~chinese
+     * @brief 将拟合后的状态保存到存档中。
+     * 派生类在调用该函数后保存各自的结果。
+     * 
+     * @param archive 用于保存状态的存档。
+     * 
+     */
+    virtual void saveModel(ModelArchive& archive) const;
+
+    /**
+     * \~english
+     * @brief Restore the fitted state from an archive, after which the model can predict without fitting.
+     * 
+     * @param archive Archive storing the state.
+     * 
+     * \~chinese
+     * @brief 从存档中恢复拟合后的状态，之后无需拟合即可预测。
+     * 
+     * @param archive 保存状态的存档。
+     * 
+     */
+    virtual void loadModel(const ModelArchive& archive);
+
+    /**
+     * \~english
+     * @brief Store the fitted state into a file.
+     * 
+     * @param path Path to the file.
+     * 
+     * \~chinese
+     * @brief 将拟合后的状态保存到文件中。
+     * 
+     * @param path 文件路径。
+     * 
+     */
+    void save(const std::string& path) const;
+
+    /**
+     * \~english
+     * @brief Restore the fitted state from a file.
+     * 
+     * @param path Path to the file.
+     * 
+     * \~chinese
+     * @brief 从文件中恢复拟合后的状态。
+     * 
+     * @param path 文件路径。
+     * 
+     */
+    void load(const std::string& path);
+
+protected:
+
+    /**
+     * \~english
+     * @brief Order locations along a Z-order curve, so that consecutive locations are spatially close.
+     * 
+     * @param locations Coordinates of locations.
+     * @return arma::uvec Row indices of locations in order.
+     * 
+     * \~chinese
+     * @brief 按 Z 序曲线对位置排序，使相邻的位置在空间上接近。
+     * 
+     * @param locations 位置坐标。
+     * @return arma::uvec 排序后的位置行索引。
+     * 
+     */
+    static arma::uvec SpatialOrder(const arma::mat& locations);
+
+    /**
+     * \~english
+     * @brief Calculate products of variables at each data point, 
+     * i.e. \f$x_a x_c\f$ for \f$a \leq c\f$ followed by \f$x_a y\f$.
+     * Then \f$X^TWX\f$ and \f$X^TWy\f$ at a block of locations are given by one matrix product with the weight matrix.
+     * 
+     * @param x Independent variables \f$X\f$.
+     * @param y Dependent variable \f$y\f$.
+     * @return arma::mat Products, one row for each data point.
+     * 
+     * \~chinese
+     * @brief 计算每个数据点处变量的乘积，即 \f$a \leq c\f$ 时的 \f$x_a x_c\f$ ，其后为 \f$x_a y\f$ 。
+     * 于是一个分块中各位置处的 \f$X^TWX\f$ 和 \f$X^TWy\f$ 可以通过与权重矩阵的一次矩阵乘法得到。
+     * 
+     * @param x 自变量矩阵 \f$X\f$。
+     * @param y 因变量 \f$y\f$。
+     * @return arma::mat 乘积，每行对应一个数据点。
+     * 
+     */
+    static arma::mat CrossProducts(const arma::mat& x, const arma::vec& y);
+
+    /**
+     * \~english
+     * @brief Calculate coefficient estimates at a block of locations.
+     * Data points whose weights are zero at all locations in the block are skipped.
+     * 
+     * @param products Products given by CrossProducts().
+     * @param weights Weights, one column for each location.
+     * @param nVar Number of independent variables.
+     * @return arma::mat Coefficient estimates, one column for each location.
+     * 
+     * \~chinese
+     * @brief 计算一个分块中各位置处的回归系数估计值。
+     * 在分块中所有位置处权重均为零的数据点会被跳过。
+     * 
+     * @param products 由 CrossProducts() 得到的乘积。
+     * @param weights 权重，每列对应一个位置。
+     * @param nVar 自变量数量。
+     * @return arma::mat 回归系数估计值，每列对应一个位置。
+     * 
+     */
+    static arma::mat BlockBetas(const arma::mat& products, const arma::mat& weights, arma::uword nVar);
+
 protected:
 
     arma::mat mX;   //!< \~english Independent variables \f$X\f$ \~chinese 自变量 \f$X\f$
@@ -365,6 +365,10 @@ public:
 public:     // Implement Algorithm
     bool isValid() override;
 
+public:     // Implement GWRBase
+    void saveModel(ModelArchive& archive) const override;
+    void loadModel(const ModelArchive& archive) override;
+
 public:     // Implement IRegressionAnalysis
     arma::mat predict(const arma::mat& locations) override;
 
@@ -382,6 +386,11 @@ public:     // Implement IVariableSelectable
         return mSelectedIndepVars;
     }
 
+    bool isCriterionConcurrent() override
+    {
+        return true;
+    }
+
 public:     // Implement IBandwidthSelectable
     Status getCriterion(BandwidthWeight* weight, double& criterion) override
     {
@@ -395,6 +404,8 @@ private:
     /**
      * \~english 
      * @brief Predict coefficients on specified locations (serial implementation).
+     * Locations are processed in spatially coherent blocks, whose weights come from one distance tile
+     * and whose \f$X^TWX\f$ and \f$X^TWy\f$ are given by one matrix product.
      * 
      * @param locations Locations where to predict coefficients.
      * @param x Independent variables.
@@ -403,6 +414,7 @@ private:
      * 
      * \~chinese 
      * @brief 在指定位置处进行回归系数预测（单线程实现）。
+     * 位置按空间上连续的分块处理，每个分块的权重由一个距离块得到， \f$X^TWX\f$ 和 \f$X^TWy\f$ 由一次矩阵乘法得到。
      * 
      * @param locations 指定位置。
      * @param x 自变量矩阵。
@@ -414,6 +426,7 @@ private:
     /**
      * \~english
      * @brief Fit coefficients (serial implementation).
+     * Weights are calculated for blocks of data points from distance tiles.
      * 
      * @param x Independent variables.
      * @param y Dependent variable.
@@ -425,6 +438,7 @@ private:
      * 
      * \~chinese
      * @brief 回归系数估计值（串行实现）。
+     * 按数据点分块，由距离块计算权重。
      * 
      * @param x 自变量矩阵。
      * @param y 因变量。
@@ -468,24 +482,77 @@ private:
     
     /**
      * \~english
-     * @brief Get AIC value with given variables for variable optimization (serial implementation).
+     * @brief Get AIC value with given variables for variable optimization.
+     * The criterion is that of a global model, so it is calculated once per candidate rather than at every sample,
+     * and this implementation is shared by all parallel types.
      * 
      * @param indepVars Given variables
      * @return double Criterion value
      * 
      * \~chinese
-     * @brief 根据指定的变量计算变量优选的AIC值（串行实现）。
+     * @brief 根据指定的变量计算变量优选的AIC值。
+     * 该指标基于全局模型，因此每个候选变量组合只计算一次，而不是在每个样本处计算，所有并行类型共用该实现。
      * 
      * @param indepVars 指定的变量。
      * @return double 变量优选的指标值。
      */
-    double indepVarsSelectionCriterionSerial(const std::vector<size_t>& indepVars);
+    double indepVarsSelectionCriterionGlobal(const std::vector<size_t>& indepVars);
+
+    /**
+     * \~english
+     * @brief Orthogonalise a column against an orthonormal basis by Gram-Schmidt with reorthogonalisation.
+     * 
+     * @param q Orthonormal basis, one column for each vector.
+     * @param x Column to orthogonalise.
+     * @param qx [out] Normalised component of x orthogonal to q.
+     * @return true if x is not (numerically) a linear combination of q.
+     * @return false otherwise.
+     * 
+     * \~chinese
+     * @brief 使用带重正交化的 Gram-Schmidt 方法将一列对一组标准正交基正交化。
+     * 
+     * @param q 标准正交基，每列一个向量。
+     * @param x 要正交化的列。
+     * @param qx [out] x 中与 q 正交的部分的单位向量。
+     * @return true 如果 x 在数值上不是 q 的线性组合。
+     * @return false 否则。
+     */
+    static bool OrthogonalizeColumn(const arma::mat& q, const arma::vec& x, arma::vec& qx);
+
+    /**
+     * \~english
+     * @brief Clear the cached orthonormal basis for variable selection.
+     * 
+     * \~chinese
+     * @brief 清除变量优选中缓存的标准正交基。
+     */
+    void resetSelectionBasis();
+
+    /**
+     * \~english
+     * @brief Update the cached orthonormal basis to span given columns.
+     * If cached columns are a prefix of given ones, only the remaining columns are appended.
+     * 
+     * @param cols Indices of columns of \f$X\f$.
+     * @return true if the basis is updated.
+     * @return false if the columns are collinear.
+     * 
+     * \~chinese
+     * @brief 更新缓存的标准正交基，使其张成给定的列。
+     * 如果缓存的列是给定列的前缀，则只追加其余的列。
+     * 
+     * @param cols \f$X\f$ 的列索引。
+     * @return true 如果基被更新。
+     * @return false 如果这些列共线。
+     */
+    bool updateSelectionBasis(const arma::uvec& cols);
 
 #ifdef ENABLE_OPENMP
 
     /**
      * \~english 
      * @brief Predict coefficients on specified locations (OpenMP implementation).
+     * Blocks of locations are distributed to threads.
      * 
      * @param locations Locations where to predict coefficients.
      * @param x Independent variables.
@@ -494,6 +561,7 @@ private:
      * 
      * \~chinese 
      * @brief 在指定位置处进行回归系数预测（OpenMP 实现）。
+     * 位置分块被分配给各线程。
      * 
      * @param locations 指定位置。
      * @param x 自变量矩阵。
@@ -505,6 +573,7 @@ private:
     /**
      * \~english
      * @brief Fit coefficients (OpenMP implementation).
+     * Weights are calculated for blocks of data points from distance tiles.
      * 
      * @param x Independent variables.
      * @param y Dependent variable.
@@ -516,6 +585,7 @@ private:
      * 
      * \~chinese
      * @brief 回归系数估计值（OpenMP 实现）。
+     * 按数据点分块，由距离块计算权重。
      * 
      * @param x 自变量矩阵。
      * @param y 因变量。
@@ -557,21 +627,6 @@ private:
      */
     double bandwidthSizeCriterionAICOmp(BandwidthWeight* bandwidthWeight);
 
-    /**
-     * \~english
-     * @brief Get AIC value with given variables for variable optimization (OpenMP implementation).
-     * 
-     * @param indepVars Given bandwidth
-     * @return double Criterion value
-     * 
-     * \~chinese
-     * @brief 根据指定的变量计算变量优选的AIC值（OpenMP 实现）。
-     * 
-     * @param indepVars 指定的变量。
-     * @return double 变量优选的指标值。
-     */
-    double indepVarsSelectionCriterionOmp(const std::vector<size_t>& indepVars);
-
 #endif
 
 #ifdef ENABLE_CUDA
@@ -650,21 +705,6 @@ private:
      */
     double bandwidthSizeCriterionAICCuda(BandwidthWeight* bandwidthWeight);
 
-    /**
-     * \~english
-     * @brief Get AIC value with given variables for variable optimization (CUDA implementation).
-     * 
-     * @param indepVars Given variables
-     * @return double Criterion value
-     * 
-     * \~chinese
-     * @brief 根据指定的变量计算变量优选的AIC值（CUDA实现）。
-     * 
-     * @param indepVars 指定的变量。
-     * @return double 变量优选的指标值。
-     */
-    double indepVarsSelectionCriterionCuda(const std::vector<size_t>& indepVars);
-
 #endif
 
 public:     // Implement IParallelizable
@@ -728,11 +768,14 @@ protected:
     
     bool mIsAutoselectIndepVars = false;    //!< \~english Whether to auto select variables. \~chinese 是否自动优选变量。
     double mIndepVarSelectionThreshold = 3.0;   //!< \~english The threshold for variable selection. \~chinese 变量优选的阈值。
-    IndepVarsSelectCriterionCalculator mIndepVarsSelectionCriterionFunction = &GWRBasic::indepVarsSelectionCriterionSerial; //!< \~english Criterion calculator for variable selection. \~chinese 变量优选的指标计算函数。
+    IndepVarsSelectCriterionCalculator mIndepVarsSelectionCriterionFunction = &GWRBasic::indepVarsSelectionCriterionGlobal; //!< \~english Criterion calculator for variable selection. \~chinese 变量优选的指标计算函数。
     VariablesCriterionList mIndepVarsSelectionCriterionList;    //!< \~english Criterion list of each variable combination. \~chinese 每种变量组合对应的指标值。
     std::vector<std::size_t> mSelectedIndepVars;    //!< \~english Selected variables. \~chinese 优选得到的变量。
     std::size_t mIndepVarSelectionProgressTotal = 0; //!< \~english Total number of independent variable combination. \~chinese 自变量所有组合总数。
     std::size_t mIndepVarSelectionProgressCurrent = 0; //!< \~english Current progress of independent variable selection. \~chinese 当前自变量优选的进度。
+    arma::uvec mSelectionCols;  //!< \~english Columns spanned by the cached basis for variable selection. \~chinese 变量优选中缓存的基所张成的列。
+    arma::mat mSelectionQ;  //!< \~english Cached orthonormal basis for variable selection. \~chinese 变量优选中缓存的标准正交基。
+    arma::vec mSelectionResidual;  //!< \~english Residuals of \f$y\f$ projected onto the cached basis. \~chinese \f$y\f$ 在缓存的基上投影后的残差。
 
     bool mIsAutoselectBandwidth = false;    //!< \~english Whether to auto select bandwidth. \~chinese 是否自动优选带宽。
     BandwidthSelectionCriterionType mBandwidthSelectionCriterion = BandwidthSelectionCriterionType::AIC;    //!< \~english Type criterion for bandwidth selection. \~chinese 带宽优选的指标值类型。
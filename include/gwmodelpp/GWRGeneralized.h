@@ -132,6 +132,10 @@ public: // IBandwidthSizeSelectable interface
         return mStatus;
     }
 
+public: // GWRBase interface
+    void saveModel(ModelArchive& archive) const override;
+    void loadModel(const ModelArchive& archive) override;
+
 public: // IRegressionAnalysis interface
     arma::mat predict(const arma::mat& locations) override;
     arma::mat fit() override;
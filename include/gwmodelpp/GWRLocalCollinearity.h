@@ -279,24 +279,86 @@ protected:
     /**
      * @brief \~english Get the CV. \~chinese 返回cv的函数
      * 
-     * @param bw \~english  \~chinese 
-     * @param kernel \~english  \~chinese 
-     * @param adaptive \~english  \~chinese 
-     * @param lambda \~english  \~chinese 
-     * @param lambdaAdjust \~english  \~chinese 
-     * @param cnThresh \~english  \~chinese 
-     * @return double \~english  \~chinese 
+     * @param bw \~english Bandwidth size \~chinese 带宽大小
+     * @param kernel \~english Kernel function type \~chinese 核函数类型
+     * @param adaptive \~english Whether the bandwidth is adaptive \~chinese 是否为可变带宽
+     * @param lambda \~english Ridge parameter \~chinese 岭参数
+     * @param lambdaAdjust \~english Whether to adjust the ridge parameter by local condition numbers \~chinese 是否根据局部条件数调整岭参数
+     * @param cnThresh \~english Threshold of condition numbers \~chinese 条件数阈值
+     * @return double \~english CV value \~chinese CV值
      */
     double LcrCV(double bw,arma::uword kernel, bool adaptive,double lambda,bool lambdaAdjust,double cnThresh);
     
     /**
      * @brief \~english Ridge linear regression. \~chinese 岭回归。
      * 
-     * @param w \~english  \~chinese 
-     * @param lambda \~english  \~chinese 
-     * @return arma::vec \~english  \~chinese 
+     * \~english
+     * Independent variables except the intercept are scaled by their global standard deviations,
+     * so the penalty applies to \f$X^T W X\f$ divided by products of these standard deviations.
+     * 
+     * \~chinese
+     * 除截距外的自变量均按其全局标准差缩放，因此惩罚项作用于除以这些标准差乘积后的 \f$X^T W X\f$ 。
+     * 
+     * @param xtwx \~english Weighted Gram matrix \f$X^T W X\f$ \~chinese 加权 Gram 矩阵 \f$X^T W X\f$
+     * @param xtwy \~english Weighted cross product \f$X^T W y\f$ \~chinese 加权叉积 \f$X^T W y\f$
+     * @param lambda \~english Ridge parameter \~chinese 岭参数
+     * @return arma::vec \~english Coefficient estimates \~chinese 回归系数估计值
+     */
+    arma::vec ridgelm(const arma::mat& xtwx, const arma::vec& xtwy, double lambda);
+
+    /**
+     * @brief \~english Fit local ridge regression at a sample from weighted Gram matrices. \~chinese 基于加权 Gram 矩阵在一个样本处拟合局部岭回归。
+     * 
+     * \~english
+     * Both \f$X^T W X\f$ and \f$X^T W^2 X\f$ are calculated from one weighted copy of \f$X\f$.
+     * The local condition number is obtained from eigenvalues of \f$X^T W^2 X\f$ scaled to unit diagonal,
+     * which are squares of singular values of \f$WX\f$ with normalised columns.
+     * 
+     * \~chinese
+     * \f$X^T W X\f$ 和 \f$X^T W^2 X\f$ 均由 \f$X\f$ 的同一个加权副本计算。
+     * 局部条件数由缩放为单位对角的 \f$X^T W^2 X\f$ 的特征值得到，这些特征值是列归一化后 \f$WX\f$ 奇异值的平方。
+     * 
+     * @param x \~english Independent variables \~chinese 自变量
+     * @param y \~english Dependent variables \~chinese 因变量
+     * @param w \~english Weight vector \~chinese 权重向量
+     * @param xtwx [out] \~english Weighted Gram matrix \f$X^T W X\f$ \~chinese 加权 Gram 矩阵 \f$X^T W X\f$
+     * @param xtw2x [out] \~english Weighted Gram matrix \f$X^T W^2 X\f$ \~chinese 加权 Gram 矩阵 \f$X^T W^2 X\f$
+     * @return arma::vec \~english Coefficient estimates \~chinese 回归系数估计值
+     */
+    arma::vec ridgeSolve(const arma::mat& x, const arma::vec& y, const arma::vec& w, arma::mat& xtwx, arma::mat& xtw2x);
+
+    /**
+     * @brief \~english Calculate the ridge parameter at a sample. \~chinese 计算一个样本处的岭参数。
+     * 
+     * @param xtw2x \~english Weighted Gram matrix \f$X^T W^2 X\f$, whose columns can be scaled arbitrarily \~chinese 加权 Gram 矩阵 \f$X^T W^2 X\f$，其列可以任意缩放
+     * @return double \~english Ridge parameter, adjusted by the local condition number if required \~chinese 岭参数，如果需要则根据局部条件数调整
+     */
+    double localLambda(const arma::mat& xtw2x);
+
+    /**
+     * @brief \~english Calculate the leave-one-out residual at a sample. \~chinese 计算一个样本处的留一残差。
+     * 
+     * \~english
+     * Only samples with non-zero weights are involved.
+     * The weighted Gram matrix of globally standardised variables is decomposed once,
+     * and the ridge solution is obtained by shifting its eigenvalues by the local ridge parameter.
+     * \f$X^T W^2 X\f$ is formed only when the ridge parameter is adjusted.
+     * 
+     * \~chinese
+     * 只使用权重非零的样本。
+     * 全局标准化变量的加权 Gram 矩阵只分解一次，岭回归解通过将其特征值平移局部岭参数得到。
+     * 只有在调整岭参数时才计算 \f$X^T W^2 X\f$ 。
+     * 
+     * @param i \~english Index of the sample \~chinese 样本索引
+     * @param w \~english Weight vector whose element at the sample is 0 \~chinese 该样本处元素为 0 的权重向量
+     * @return double \~english Leave-one-out residual \~chinese 留一残差
+     */
+    double looResidual(arma::uword i, const arma::vec& w);
+
+    /**
+     * @brief \~english Calculate global standard deviations of independent variables and standardise them. \~chinese 计算自变量的全局标准差并将其标准化。
      */
-    arma::vec ridgelm(const arma::vec& w,double lambda);
+    void updateScales();
 
 private:
 
@@ -328,6 +390,8 @@ private:
     double mTrS = 0;
     double mTrStS = 0;
     arma::vec mSHat;
+    arma::rowvec mXsd;  //!< \~english Global standard deviations of independent variables, 1 for the intercept \~chinese 自变量的全局标准差，截距为 1
+    arma::mat mXs;      //!< \~english Independent variables divided by their global standard deviations \~chinese 除以全局标准差后的自变量
 
     FitCalculator mFitFunction = &GWRLocalCollinearity::fitSerial;
     PredictCalculator mPredictFunction = &GWRLocalCollinearity::predictSerial;
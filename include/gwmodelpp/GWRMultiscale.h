@@ -8,6 +8,7 @@
 #include "SpatialMultiscaleAlgorithm.h"
 #include "spatialweight/SpatialWeight.h"
 #include "IRegressionAnalysis.h"
+#include "ModelArchive.h"
 #include "IBandwidthSelectable.h"
 #include "BandwidthSelector.h"
 #include "IParallelizable.h"
@@ -397,6 +398,64 @@ public:
      */
     void setHasHatMatrix(bool hasHatMatrix) { mHasHatMatrix = hasHatMatrix; }
 
+    /**
+     * \~english
+     * @brief Get number of probe vectors used to estimate traces of hat matrix \f$S\f$.
+     * 
+     * @return arma::uword Number of probe vectors, 0 for the exact hat matrix.
+     * 
+     * \~chinese
+     * @brief 获取用于估计帽子矩阵 \f$S\f$ 迹的探针向量个数。
+     * 
+     * @return arma::uword 探针向量个数，为 0 时计算精确的帽子矩阵。
+     */
+    arma::uword hatMatrixProbes() const { return mHatMatrixProbes; }
+
+    /**
+     * \~english
+     * @brief Set number of probe vectors used to estimate traces of hat matrix \f$S\f$.
+     * When it is positive, backfitting propagates \f$S P\f$ instead of \f$S\f$ for a random \f$n \times m\f$ Rademacher matrix \f$P\f$,
+     * and \f$tr(S)\f$ and \f$tr(S^TS)\f$ are estimated by Hutchinson's estimator.
+     * This reduces the cost of each update from \f$O(n^3)\f$ to \f$O(n^2 m)\f$, and memory from \f$O(n^2)\f$ to \f$O(nm)\f$.
+     * 
+     * @param probes Number of probe vectors, 0 for the exact hat matrix.
+     * 
+     * \~chinese
+     * @brief 设置用于估计帽子矩阵 \f$S\f$ 迹的探针向量个数。
+     * 当其为正数时，后向迭代中对一个随机的 \f$n \times m\f$ Rademacher 矩阵 \f$P\f$ 更新 \f$S P\f$ 而非 \f$S\f$，
+     * 并用 Hutchinson 估计量估计 \f$tr(S)\f$ 和 \f$tr(S^TS)\f$。
+     * 每次更新的开销从 \f$O(n^3)\f$ 降低到 \f$O(n^2 m)\f$，内存从 \f$O(n^2)\f$ 降低到 \f$O(nm)\f$。
+     * 
+     * @param probes 探针向量个数，为 0 时计算精确的帽子矩阵。
+     */
+    void setHatMatrixProbes(arma::uword probes) { mHatMatrixProbes = probes; }
+
+    /**
+     * \~english
+     * @brief Get seed of random probe vectors.
+     * 
+     * @return unsigned long long Seed of random probe vectors.
+     * 
+     * \~chinese
+     * @brief 获取随机探针向量的种子。
+     * 
+     * @return unsigned long long 随机探针向量的种子。
+     */
+    unsigned long long hatMatrixProbeSeed() const { return mHatMatrixProbeSeed; }
+
+    /**
+     * \~english
+     * @brief Set seed of random probe vectors.
+     * 
+     * @param seed Seed of random probe vectors.
+     * 
+     * \~chinese
+     * @brief 设置随机探针向量的种子。
+     * 
+     * @param seed 随机探针向量的种子。
+     */
+    void setHatMatrixProbeSeed(unsigned long long seed) { mHatMatrixProbeSeed = seed; }
+
     /**
      * \~english
      * @brief Get maximum retry times when select bandwidths.
@@ -578,6 +637,65 @@ public:     // SpatialMultiscaleAlgorithm interface
     virtual void setSpatialWeights(const std::vector<SpatialWeight> &spatialWeights) override;
 
 
+public:
+
+    /**
+     * \~english
+     * @brief Store the fitted state, including the spatial weight of each variable, into an archive.
+     * 
+     * @param archive Archive to store the state in.
+     * 
+     * \~chinese
+     * @brief 将拟合后的状态（包括每个变量的空间权重）保存到存档中。
+     * 
+     * @param archive 用于保存状态的存档。
+     * 
+     */
+    void saveModel(ModelArchive& archive) const;
+
+    /**
+     * \~english
+     * @brief Restore the fitted state from an archive.
+     * 
+     * @param archive Archive storing the state.
+     * 
+     * \~chinese
+     * @brief 从存档中恢复拟合后的状态。
+     * 
+     * @param archive 保存状态的存档。
+     * 
+     */
+    void loadModel(const ModelArchive& archive);
+
+    /**
+     * \~english
+     * @brief Store the fitted state into a file.
+     * 
+     * @param path Path to the file.
+     * 
+     * \~chinese
+     * @brief 将拟合后的状态保存到文件中。
+     * 
+     * @param path 文件路径。
+     * 
+     */
+    void save(const std::string& path) const;
+
+    /**
+     * \~english
+     * @brief Restore the fitted state from a file.
+     * 
+     * @param path Path to the file.
+     * 
+     * \~chinese
+     * @brief 从文件中恢复拟合后的状态。
+     * 
+     * @param path 文件路径。
+     * 
+     */
+    void load(const std::string& path);
+
+
 public:     // IBandwidthSizeSelectable interface
     Status getCriterion(BandwidthWeight* weight, double& criterion) override
     {
@@ -664,6 +782,38 @@ protected:
      */
     arma::mat backfitting(const arma::mat &x, const arma::vec &y);
 
+    /**
+     * \~english
+     * @brief Multiply the hat matrix of one variable with a matrix,
+     * using a sparse product when most elements of the hat matrix are zero (e.g. compact kernels).
+     * 
+     * @param S Hat matrix of one variable.
+     * @param A Matrix to be multiplied.
+     * @return arma::mat Product \f$SA\f$.
+     * 
+     * \~chinese
+     * @brief 计算单一变量的帽子矩阵与一个矩阵的乘积，
+     * 当帽子矩阵大部分元素为零时（如紧支撑核函数）使用稀疏乘法。
+     * 
+     * @param S 单一变量的帽子矩阵。
+     * @param A 被乘矩阵。
+     * @return arma::mat 乘积 \f$SA\f$。
+     */
+    static arma::mat hatMatrixProduct(const arma::mat& S, const arma::mat& A);
+
+    /**
+     * \~english
+     * @brief Calculate \f$tr(S)\f$ and \f$tr(S^TS)\f$ of the hat matrix, estimated by probe vectors if they are used.
+     * 
+     * @return arma::vec A vector of 2 elements: \f$tr(S)\f$ and \f$tr(S^TS)\f$.
+     * 
+     * \~chinese
+     * @brief 计算帽子矩阵的 \f$tr(S)\f$ 和 \f$tr(S^TS)\f$，若使用探针向量则为估计值。
+     * 
+     * @return arma::vec 一个包含两个元素的向量，分别是 \f$tr(S)\f$ 和 \f$tr(S^TS)\f$。
+     */
+    arma::vec hatMatrixTraces() const;
+
     /**
      * \~english
      * @brief The serial implementation of fit function for all variables.
@@ -996,6 +1146,9 @@ private:
     int mAdaptiveLower = 10;    //!< \~english The lower bound for optimizing adaptive bandwidth. \~chinese 优选可变带宽优选下限值。
 
     bool mHasHatMatrix = true;  //!< \~english  \~chinese
+    arma::uword mHatMatrixProbes = 0;   //!< \~english Number of probe vectors for traces of hat matrix, 0 for the exact one. \~chinese 估计帽子矩阵迹的探针向量个数，为 0 时计算精确值。
+    unsigned long long mHatMatrixProbeSeed = 0; //!< \~english Seed of random probe vectors. \~chinese 随机探针向量的种子。
+    arma::mat mHatProbes;   //!< \~english Probe vectors, one column for each. \~chinese 探针向量，每列一个。
 
     arma::mat mX;   //!< \~english Independent variables \f$X\f$. \~chinese 自变量矩阵 \f$X\f$。
     arma::vec mY;   //!< \~english endent variable \f$y\f$. \~chinese 因变量 \f$y\f$。
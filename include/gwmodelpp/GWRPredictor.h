@@ -0,0 +1,128 @@
+#ifndef GWRPREDICTOR_H
+#define GWRPREDICTOR_H
+
+#include <armadillo>
+#include "GWRBasic.h"
+#include "spatialweight/BallTree.h"
+#include "spatialweight/BandwidthWeight.h"
+
+namespace gwm
+{
+
+/**
+ * \~english
+ * @brief Immutable predictor of coefficient estimates at new locations for a fitted basic GWR model.
+ * It copies the data and the bandwidth of the model, and indexes data points with a ball tree.
+ * For compact kernels (Bisquare, Tricube and Boxcar), only data points with non-zero weights are found and used,
+ * so that the cost of a query depends on the number of neighbours rather than the number of data points.
+ * All prediction functions are const and use per-thread workspaces, so that one predictor can serve queries from many threads.
+ * Only CRSDistance is supported.
+ *
+ * \~chinese
+ * @brief 已拟合的基础地理加权回归模型在新位置上的回归系数不可变预测器。
+ * 该类复制模型的数据和带宽，并用球树索引数据点。
+ * 对于有界核函数（Bisquare、Tricube 和 Boxcar），只查找和使用权重非零的数据点，
+ * 因此一次查询的开销取决于近邻数量而非数据点数量。
+ * 所有预测函数均为 const 并使用线程私有的工作空间，因此一个预测器可以同时响应多个线程的查询。
+ * 仅支持 CRSDistance 。
+ */
+class GWRPredictor
+{
+public:
+
+    /**
+     * \~english
+     * @brief Construct a new GWRPredictor object from a fitted or loaded model.
+     *
+     * @param model Basic GWR model.
+     *
+     * \~chinese
+     * @brief 根据已拟合或已加载的模型构造一个新的 GWRPredictor 对象。
+     *
+     * @param model 基础地理加权回归模型。
+     */
+    explicit GWRPredictor(const GWRBasic& model);
+
+public:
+
+    /**
+     * \~english
+     * @brief Predict coefficients at a location.
+     *
+     * @param location Coordinate of the location.
+     * @return arma::rowvec Coefficient estimates.
+     *
+     * \~chinese
+     * @brief 预测一个位置上的回归系数。
+     *
+     * @param location 位置坐标。
+     * @return arma::rowvec 回归系数估计值。
+     */
+    arma::rowvec predict(const arma::rowvec& location) const;
+
+    /**
+     * \~english
+     * @brief Predict coefficients at locations.
+     *
+     * @param locations Coordinates of locations, one row for each.
+     * @return arma::mat Coefficient estimates, one row for each location.
+     *
+     * \~chinese
+     * @brief 预测多个位置上的回归系数。
+     *
+     * @param locations 位置坐标，每行一个。
+     * @return arma::mat 回归系数估计值，每行对应一个位置。
+     */
+    arma::mat predict(const arma::mat& locations) const;
+
+private:
+
+    /**
+     * @brief \~english Construct a new GWRPredictor object from a model and its validated bandwidth weight. \~chinese 根据模型及其已校验的带宽权重构造一个新的 GWRPredictor 对象。
+     *
+     * @param model \~english Basic GWR model \~chinese 基础地理加权回归模型
+     * @param weight \~english Bandwidth weight of the model \~chinese 模型的带宽权重
+     */
+    GWRPredictor(const GWRBasic& model, const BandwidthWeight& weight);
+
+    /**
+     * @brief \~english Buffers reused by queries in the same thread. \~chinese 同一线程中的查询重复使用的缓冲区。
+     */
+    struct Workspace
+    {
+        arma::uvec index;   //!< \~english Row indices of neighbours \~chinese 近邻的行索引
+        arma::vec weights;  //!< \~english Distances to neighbours, overwritten by weights \~chinese 到近邻的距离，被权重覆盖
+        arma::mat x;        //!< \~english Independent variables of neighbours \~chinese 近邻的自变量
+        arma::mat xtw;      //!< \~english Transposed weighted independent variables of neighbours \~chinese 近邻的加权自变量的转置
+    };
+
+    /**
+     * @brief \~english Get the workspace of the calling thread. \~chinese 获取调用线程的工作空间。
+     *
+     * @return Workspace& \~english Workspace \~chinese 工作空间
+     */
+    static Workspace& workspace();
+
+    /**
+     * @brief \~english Find neighbours of a location and their weights. \~chinese 查找一个位置的近邻及其权重。
+     *
+     * @param location \~english Coordinate of the location \~chinese 位置坐标
+     * @param index \~english [out] Row indices of neighbours \~chinese [out] 近邻的行索引
+     * @param weights \~english [out] Weights of neighbours \~chinese [out] 近邻的权重
+     */
+    void neighbours(const arma::rowvec& location, arma::uvec& index, arma::vec& weights) const;
+
+private:
+    arma::mat mCoords;  //!< \~english Coordinates of data points \~chinese 数据点坐标
+    arma::mat mX;       //!< \~english Independent variables \~chinese 自变量
+    arma::vec mY;       //!< \~english Dependent variable \~chinese 因变量
+    double mBandwidth;  //!< \~english Bandwidth size \~chinese 带宽大小
+    bool mAdaptive;     //!< \~english Whether the bandwidth is adaptive \~chinese 是否为可变带宽
+    BandwidthWeight::KernelFunctionType mKernel;    //!< \~english Kernel function \~chinese 核函数
+    bool mGeographic;   //!< \~english Whether the coordinate reference system is geographical \~chinese 坐标参考系是否是地理坐标系
+    BallTree mTree;     //!< \~english Index of data points \~chinese 数据点索引
+};
+
+}
+
+#endif  // GWRPREDICTOR_H
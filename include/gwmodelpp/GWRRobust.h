@@ -23,6 +23,8 @@ class GWRRobust : public GWRBasic
 private:
     typedef arma::mat (GWRRobust::*RegressionHatmatrix)(const arma::mat &, const arma::vec &, arma::mat &, arma::vec &, arma::vec &, arma::mat &); //!< \~english Calculator for fitting \~chinese 拟合函数
 
+    typedef arma::mat (GWRRobust::*LocalBetasCalculator)(const arma::mat &, const arma::vec &); //!< \~english Calculator for coefficient estimates from cached local products \~chinese 根据缓存局部乘积计算回归系数的函数
+
     /**
      * @brief \~english Calculate diagnostic information. \~chinese 计算诊断信息。
      * 
@@ -65,6 +67,13 @@ public:
      */
     void setFiltered(bool value) { mFiltered = value; }
 
+    /**
+     * @brief \~english Get second-level weights of the last calibration. \~chinese 获取最后一次拟合的二次权重。
+     * 
+     * @return const arma::vec& \~english Second-level weights under which coefficient estimates, their standard errors and the hat matrix are calculated \~chinese 计算回归系数估计值及其标准误差和帽子矩阵所用的二次权重
+     */
+    const arma::vec& weightMask() const { return mLocalMask; }
+
 public: // Implement IRegressionAnalysis
     arma::mat predict(const arma::mat& locations) override;
     arma::mat fit() override;
@@ -78,6 +87,60 @@ private:
     arma::mat fitOmp(const arma::mat& x, const arma::vec& y, arma::mat& betasSE, arma::vec& shat, arma::vec& qDiag, arma::mat& S);
 #endif
 
+    /**
+     * @brief \~english Non-parallel implementation of calculating coefficient estimates only from cached local products. \~chinese 仅根据缓存的局部乘积计算回归系数估计值的非并行实现。
+     * 
+     * Local products \f$X^TWX\f$ and \f$X^TWy\f$ are built on the first call, 
+     * and then updated by only observations whose second-level weights changed and which are inside the bandwidth of each focus point.
+     * 
+     * @param x \~english Independent variables \~chinese 自变量
+     * @param y \~english Dependent variables \~chinese 因变量
+     * @return arma::mat \~english Coefficient estimates \~chinese 回归系数估计值
+     */
+    arma::mat localBetasSerial(const arma::mat& x, const arma::vec& y);
+
+#ifdef ENABLE_OPENMP
+    /**
+     * @brief \~english Multithreading implementation of calculating coefficient estimates only from cached local products. \~chinese 仅根据缓存的局部乘积计算回归系数估计值的多线程实现。
+     * 
+     * @param x \~english Independent variables \~chinese 自变量
+     * @param y \~english Dependent variables \~chinese 因变量
+     * @return arma::mat \~english Coefficient estimates \~chinese 回归系数估计值
+     */
+    arma::mat localBetasOmp(const arma::mat& x, const arma::vec& y);
+#endif
+
+    /**
+     * @brief \~english Get whether local products are cached for the independent variables. \~chinese 获取是否已为自变量缓存局部乘积。
+     * 
+     * @param x \~english Independent variables \~chinese 自变量
+     * @return true \~english Yes \~chinese 是
+     * @return false \~english No \~chinese 否
+     */
+    bool isLocalProductsCached(const arma::mat& x) const;
+
+    /**
+     * @brief \~english Find observations whose second-level weights changed, or allocate the cache when nothing is cached. \~chinese 查找二次权重发生变化的观测，或在未缓存时分配缓存。
+     * 
+     * @param x \~english Independent variables \~chinese 自变量
+     * @param cached \~english Whether local products are cached \~chinese 是否已缓存局部乘积
+     * @param changed \~english [out] Indices of changed observations \~chinese [出参] 发生变化的观测索引
+     * @param delta \~english [out] Changes of their second-level weights \~chinese [出参] 其二次权重的变化量
+     */
+    void prepareLocalProducts(const arma::mat& x, bool cached, arma::uvec& changed, arma::vec& delta);
+
+    /**
+     * @brief \~english Update cached local products of a focus point by a rank-k correction of changed observations. \~chinese 通过变化观测的秩 k 修正更新一个目标点的缓存局部乘积。
+     * 
+     * @param i \~english Index of the focus point \~chinese 目标点索引
+     * @param x \~english Independent variables \~chinese 自变量
+     * @param y \~english Dependent variables \~chinese 因变量
+     * @param w \~english Spatial weights of the focus point without second-level weights \~chinese 不含二次权重的目标点空间权重
+     * @param changed \~english Indices of changed observations \~chinese 发生变化的观测索引
+     * @param delta \~english Changes of their second-level weights \~chinese 其二次权重的变化量
+     */
+    void updateLocalProducts(arma::uword i, const arma::mat& x, const arma::vec& y, const arma::vec& w, const arma::uvec& changed, const arma::vec& delta);
+
 protected:
 
     /**
@@ -132,8 +195,12 @@ private:
 
     arma::mat mS;           //!< \~english Hat matrix \f$S\f$ \~chinese 帽子矩阵 \f$S\f$
     arma::vec mWeightMask;  //!< \~english Second-level weights \~chinese 二次加权权重
+    arma::cube mLocalXtWX;  //!< \~english Cached \f$X^TWX\f$ of each focus point under mLocalMask \~chinese mLocalMask 下各目标点缓存的 \f$X^TWX\f$
+    arma::mat mLocalXtWy;   //!< \~english Cached \f$X^TWy\f$ of each focus point under mLocalMask \~chinese mLocalMask 下各目标点缓存的 \f$X^TWy\f$
+    arma::vec mLocalMask;   //!< \~english Second-level weights of cached local products \~chinese 缓存局部乘积对应的二次权重
     
     RegressionHatmatrix mfitFunction = &GWRRobust::fitSerial;   //!< \~english Calculator for fitting \~chinese 拟合函数
+    LocalBetasCalculator mLocalBetasFunction = &GWRRobust::localBetasSerial;   //!< \~english Calculator for coefficient estimates from cached local products \~chinese 根据缓存局部乘积计算回归系数的函数
 };
 
 }
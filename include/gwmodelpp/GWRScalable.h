@@ -169,6 +169,10 @@ public:
 public:     // SpatialAlgorithm interface
     bool isValid() override;
 
+public:     // GWRBase interface
+    void saveModel(ModelArchive& archive) const override;
+    void loadModel(const ModelArchive& archive) override;
+
 
 public:     // IRegressionAnalysis interface
     arma::mat fit() override;
@@ -235,6 +239,7 @@ private:
     double mPenalty = 0.01; //!< \~english Penalty \~chinese Penalty
 
     bool mHasHatMatrix = true;  //!< \~english Whether has hat matrix. \~chinese 是否有帽子矩阵。 
+    bool mIsModelLoaded = false;    //!< \~english Whether the parameters are loaded from an archive, so that prediction uses them without optimization. \~chinese 参数是否从存档中加载，若是则预测时直接使用而不再优化。
 
     SpatialWeight mDpSpatialWeight; //!< \~english Spatial weighting scheme for data points \~chinese 数据点空间权重配置
 
@@ -15,6 +15,7 @@
 #include "SpatialMonoscaleAlgorithm.h"
 #include "IMultivariableAnalysis.h"
 #include "IParallelizable.h"
+#include "WeightedQuantile.h"
 
 namespace gwm
 {
@@ -39,6 +40,7 @@ namespace gwm
  * - local medians <- GWSS::localMedian()
  * - local interquartile ranges <- GWSS::iqr()
  * - local quantile imbalances and coordinates <- GWSS::qi()
+ * - local quantiles at user-specified probabilities <- GWSS::localQuantile()
  * 
  * \~chinese
  * @brief 地理加权汇总统计分析算法类。
@@ -59,6 +61,7 @@ namespace gwm
  * - local medians <- GWSS::localMedian()
  * - local interquartile ranges <- GWSS::iqr()
  * - local quantile imbalances and coordinates <- GWSS::qi()
+ * - local quantiles at user-specified probabilities <- GWSS::localQuantile()
  */
 class GWSS : public SpatialMonoscaleAlgorithm, public IMultivariableAnalysis, public IParallelizable, public IParallelOpenmpEnabled
 {
@@ -153,6 +156,28 @@ public:
      */
     void setQuantile(bool quantile) { mQuantile = quantile; }
 
+    /**
+     * @brief \~english Get probabilities of additional local quantiles. \~chinese 获取额外计算的局部分位数的概率。
+     * 
+     * @return arma::vec \~english Probabilities of additional local quantiles \~chinese 额外计算的局部分位数的概率
+     */
+    const arma::vec& quantileProbs() const { return mQuantileProbs; }
+
+    /**
+     * @brief \~english Set probabilities of additional local quantiles.
+     * They are calculated together with local medians when quantile algorithms are used.
+     * \~chinese 设置额外计算的局部分位数的概率。
+     * 当使用基于排序的算法时，它们与局部中位数一起计算。
+     * 
+     * @param probs \~english Probabilities in \f$[0,1]\f$ \~chinese 取值在 \f$[0,1]\f$ 之间的概率
+     */
+    void setQuantileProbs(const arma::vec& probs)
+    {
+        if (probs.n_elem > 0 && (probs.min() < 0.0 || probs.max() > 1.0))
+            throw std::runtime_error("Probabilities of quantiles must be in [0,1].");
+        mQuantileProbs = probs;
+    }
+
     /**
      * @brief \~english Get whether calculate correlation between the first variable and others. \~chinese 获取是否仅为第一个变量计算与其他变量的相关系数
      * 
@@ -225,6 +250,13 @@ public:
      */
     const arma::mat& qi() const { return mQI; }
 
+    /**
+     * @brief \~english Get local quantiles at probabilities set by GWSS::setQuantileProbs(). \~chinese 获取在 GWSS::setQuantileProbs() 设置的概率处的局部分位数。
+     * 
+     * @return \~english Local quantiles, whose slice \f$k\f$ is for the \f$k\f$-th probability \~chinese 局部分位数，其第 \f$k\f$ 层对应第 \f$k\f$ 个概率
+     */
+    const arma::cube& localQuantile() const { return mLocalQuantile; }
+
     
     /**
      * @brief \~english Get local coefficients of variation on each sample. \~chinese 获取局部协方差。
@@ -335,6 +367,72 @@ public:     // IParallelOpenmpEnabled
     void updateCalculator();
 
 private:
+    /**
+     * @brief \~english Prepare data shared by all focus points in GWAverage.
+     * Variables are shifted by their means and stacked with their squares and cubes,
+     * so that the first three local moments come from one product with the weight vector.
+     * If quantiles are required, the quantile engine sorts each variable once here.
+     * \~chinese 准备 GWAverage 中所有目标点共用的数据。
+     * 变量减去其均值后与其平方和立方拼接，使前三阶局部矩可以由与权重向量的一次乘积得到。
+     * 如果需要计算分位数，分位数引擎也在这里对每个变量排序一次。
+     * 
+     * @param shift [out] \~english Means by which variables are shifted \~chinese 变量平移所用的均值
+     * @param powers [out] \~english Shifted variables, their squares and cubes \~chinese 平移后的变量及其平方和立方
+     * @param quantile [out] \~english Quantile engine for quartiles and additional probabilities \~chinese 用于四分位数和额外概率的分位数引擎
+     */
+    void prepareAverage(arma::rowvec& shift, arma::mat& powers, WeightedQuantile& quantile);
+
+    /**
+     * @brief \~english Store quantiles found at a focus point. \~chinese 保存在一个目标点处得到的分位数。
+     * 
+     * @param i \~english Index of the focus point \~chinese 目标点索引
+     * @param quant \~english Quartiles followed by additional quantiles \~chinese 四分位数及其后的额外分位数
+     */
+    void storeQuantile(arma::uword i, const arma::mat& quant);
+
+    /**
+     * @brief \~english Calculate local summary statistics at a block of consecutive focus points.
+     * Weights come from one distance tile, and local moments of the whole block come from one product with the weight matrix.
+     * Where these moments about the global means cancel, i.e. the local variance is tiny compared with them,
+     * the variance and the third moment are calculated again about the local mean.
+     * \~chinese 计算一组连续目标点处的局部统计量。
+     * 权重由一个距离块得到，整个分块的局部矩由与权重矩阵的一次乘积得到。
+     * 当这些关于全局均值的矩发生相消，即局部方差相对于它们很小时，关于局部均值重新计算方差和三阶矩。
+     *
+     * @param begin \~english Index of the first focus point \~chinese 第一个目标点的索引
+     * @param end \~english Index after the last focus point \~chinese 最后一个目标点之后的索引
+     * @param shift \~english Means by which variables are shifted \~chinese 变量平移所用的均值
+     * @param powers \~english Shifted variables, their squares and cubes \~chinese 平移后的变量及其平方和立方
+     * @param quantile \~english Quantile engine \~chinese 分位数引擎
+     */
+    void localAverage(arma::uword begin, arma::uword end, const arma::rowvec& shift, const arma::mat& powers, const WeightedQuantile& quantile);
+
+    /**
+     * @brief \~english Prepare data shared by all focus points in GWCorrelation.
+     * Both variables and their ranks are shifted by their means once here.
+     * \~chinese 准备 GWCorrelation 中所有目标点共用的数据。
+     * 变量及其秩在这里一次性减去各自的均值。
+     * 
+     * @param shift [out] \~english Means by which variables are shifted \~chinese 变量平移所用的均值
+     * @param xs [out] \~english Shifted variables \~chinese 平移后的变量
+     * @param rs [out] \~english Shifted ranks of variables \~chinese 平移后的变量的秩
+     */
+    void prepareCorrelation(arma::rowvec& shift, arma::mat& xs, arma::mat& rs);
+
+    /**
+     * @brief \~english Calculate local covariances and correlations at a focus point.
+     * The weighted cross products of all required pairs come from one matrix product \f$X^T W X\f$ for variables and another for their ranks.
+     * \~chinese 计算一个目标点处的局部协方差和相关系数。
+     * 所有所需变量对的加权叉积由变量的一次矩阵乘积 \f$X^T W X\f$ 和其秩的一次矩阵乘积得到。
+     * 
+     * @param i \~english Index of the focus point \~chinese 目标点索引
+     * @param Wi \~english Normalised weight vector \~chinese 归一化权重向量
+     * @param shift \~english Means by which variables are shifted \~chinese 变量平移所用的均值
+     * @param xs \~english Shifted variables \~chinese 平移后的变量
+     * @param rs \~english Shifted ranks of variables \~chinese 平移后的变量的秩
+     */
+    void localCorrelation(arma::uword i, const arma::vec& Wi, const arma::rowvec& shift, const arma::mat& xs, const arma::mat& rs);
+
     /**
      * @brief \~english GWAverage algorithm implemented with no parallel methods. \~chinese GWAverage算法的单线程实现。
      */
@@ -370,6 +468,8 @@ private:
     arma::mat mLocalMedian;   //!< \~english Local medians \~chinese 局部中位数
     arma::mat mIQR;           //!< \~english Local interquartile ranges \~chinese 局部分位距
     arma::mat mQI;            //!< \~english Local quantile imbalances and coordinates \~chinese 局部分位数不平衡度
+    arma::vec mQuantileProbs; //!< \~english Probabilities of additional local quantiles \~chinese 额外计算的局部分位数的概率
+    arma::cube mLocalQuantile;//!< \~english Local quantiles at additional probabilities \~chinese 额外概率处的局部分位数
     arma::mat mCovmat;        //!< \~english Local covariances \~chinese 局部协方差
     arma::mat mCorrmat;       //!< \~english Local correlations (Pearson's) \~chinese 局部皮尔逊相关系数
     arma::mat mSCorrmat;      //!< \~english Local correlations (Spearman's) \~chinese 局部斯皮尔曼相关系数
@@ -64,6 +64,21 @@ struct IVarialbeSelectable
      */
     virtual Status getCriterion(const std::vector<std::size_t>& variables, double& criterion) = 0;
 
+    /**
+     * \~english
+     * @brief Whether getCriterion() with variables can be called from several threads at the same time.
+     * 
+     * @return true if candidates can be evaluated concurrently.
+     * @return false otherwise.
+     * 
+     * \~chinese
+     * @brief 是否可以在多个线程中同时调用根据变量计算指标值的 getCriterion() 。
+     * 
+     * @return true 如果候选变量组合可以并发计算。
+     * @return false 否则。
+     */
+    virtual bool isCriterionConcurrent() { return false; }
+
     /**
      * \~english
      * @brief Get selected variables.
@@ -0,0 +1,223 @@
+#ifndef MODELARCHIVE_H
+#define MODELARCHIVE_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <armadillo>
+#include "spatialweight/SpatialWeight.h"
+#include "RegressionDiagnostic.h"
+
+namespace gwm
+{
+
+/**
+ * \~english
+ * @brief Versioned binary archive of the state of a fitted model.
+ * An archive holds the name of the model and a set of named matrices.
+ * On disk it starts with a fixed header and a table of entries, followed by the column-major data of each matrix aligned to 64 bytes.
+ * Hence a file mapped into memory can be opened by ModelArchive::fromBuffer() without copying any matrix,
+ * and ModelArchive::load() reads a file into one buffer that grows in doubling chunks, so a corrupt header cannot cause a huge allocation.
+ * Scalars and configurations (e.g. kernels and distances) are stored as small matrices.
+ *
+ * \~chinese
+ * @brief 已拟合模型状态的带版本二进制存档。
+ * 存档包含模型名称和一组具名矩阵。
+ * 在磁盘上，存档以固定的文件头和条目表开始，其后为按 64 字节对齐、按列存储的各矩阵数据。
+ * 因此映射到内存中的文件可以通过 ModelArchive::fromBuffer() 打开而无需复制任何矩阵，
+ * ModelArchive::load() 读取文件时将数据读入一个按倍增分块增长的缓冲区，因此损坏的文件头不会导致巨大的内存分配。
+ * 标量和配置（如核函数和距离）以小矩阵的形式保存。
+ */
+class ModelArchive
+{
+public:
+    static const std::uint32_t Version = 1;     //!< \~english Version of the format \~chinese 格式版本
+    static const std::size_t Alignment = 64;    //!< \~english Alignment of data of each matrix in bytes \~chinese 各矩阵数据的字节对齐
+    static const std::size_t NameLength = 40;   //!< \~english Maximum length of names including the terminating zero \~chinese 名称的最大长度（含结尾零字符）
+
+public:
+
+    /**
+     * @brief \~english Construct a new empty ModelArchive object. \~chinese 构造一个新的空 ModelArchive 对象。
+     */
+    ModelArchive() {}
+
+    /**
+     * @brief \~english Construct a new empty ModelArchive object for a model. \~chinese 为一个模型构造一个新的空 ModelArchive 对象。
+     *
+     * @param model \~english Name of the model \~chinese 模型名称
+     */
+    explicit ModelArchive(const std::string& model) : mModel(model) {}
+
+public:
+
+    /**
+     * @brief \~english Get the name of the model. \~chinese 获取模型名称。
+     *
+     * @return const std::string& \~english Name of the model \~chinese 模型名称
+     */
+    const std::string& model() const { return mModel; }
+
+    /**
+     * @brief \~english Set the name of the model. \~chinese 设置模型名称。
+     *
+     * @param model \~english Name of the model \~chinese 模型名称
+     */
+    void setModel(const std::string& model) { mModel = model; }
+
+    /**
+     * @brief \~english Get whether an entry exists. \~chinese 获取条目是否存在。
+     *
+     * @param name \~english Name of the entry \~chinese 条目名称
+     * @return true \~english Exists \~chinese 存在
+     * @return false \~english Not exists \~chinese 不存在
+     */
+    bool contains(const std::string& name) const { return mEntries.find(name) != mEntries.end(); }
+
+    /**
+     * @brief \~english Get a matrix. \~chinese 获取一个矩阵。
+     *
+     * @param name \~english Name of the entry \~chinese 条目名称
+     * @return const arma::mat& \~english Matrix, which may refer to the buffer of the archive \~chinese 矩阵，可能引用存档的缓冲区
+     */
+    const arma::mat& get(const std::string& name) const;
+
+    /**
+     * @brief \~english Get a scalar. \~chinese 获取一个标量。
+     *
+     * @param name \~english Name of the entry \~chinese 条目名称
+     * @return double \~english Scalar \~chinese 标量
+     */
+    double scalar(const std::string& name) const;
+
+    /**
+     * @brief \~english Set a matrix. \~chinese 设置一个矩阵。
+     *
+     * @param name \~english Name of the entry \~chinese 条目名称
+     * @param value \~english Matrix \~chinese 矩阵
+     */
+    void set(const std::string& name, const arma::mat& value);
+
+    /**
+     * @brief \~english Set a scalar. \~chinese 设置一个标量。
+     *
+     * @param name \~english Name of the entry \~chinese 条目名称
+     * @param value \~english Scalar \~chinese 标量
+     */
+    void set(const std::string& name, double value);
+
+    /**
+     * @brief \~english Set a spatial weighting scheme with a bandwidth weight. \~chinese 设置一个使用带宽权重的空间权重配置。
+     *
+     * Distances of type DMatDistance are not supported, as they refer to external files.
+     *
+     * @param name \~english Name of the entries \~chinese 条目名称
+     * @param spatialWeight \~english Spatial weighting scheme \~chinese 空间权重配置
+     */
+    void setSpatialWeight(const std::string& name, const SpatialWeight& spatialWeight);
+
+    /**
+     * @brief \~english Get a spatial weighting scheme. \~chinese 获取一个空间权重配置。
+     *
+     * @param name \~english Name of the entries \~chinese 条目名称
+     * @return SpatialWeight \~english Spatial weighting scheme without distance parameters \~chinese 不含距离参数的空间权重配置
+     */
+    SpatialWeight spatialWeight(const std::string& name) const;
+
+    /**
+     * @brief \~english Set the entries shared by regression models: coords, x, y, betas, hasIntercept and diagnostic. \~chinese 设置回归模型共有的条目：coords、x、y、betas、hasIntercept 和 diagnostic。
+     *
+     * @param coords \~english Coordinates of data points \~chinese 数据点坐标
+     * @param x \~english Independent variables \~chinese 自变量
+     * @param y \~english Dependent variable \~chinese 因变量
+     * @param betas \~english Coefficient estimates \~chinese 回归系数估计值
+     * @param hasIntercept \~english Whether the model has an intercept \~chinese 模型是否有截距
+     * @param diagnostic \~english Diagnostic information \~chinese 诊断信息
+     */
+    void setRegression(const arma::mat& coords, const arma::mat& x, const arma::vec& y, const arma::mat& betas, bool hasIntercept, const RegressionDiagnostic& diagnostic);
+
+    /**
+     * @brief \~english Get the entries shared by regression models. \~chinese 获取回归模型共有的条目。
+     *
+     * @param coords \~english [out] Coordinates of data points \~chinese [出参] 数据点坐标
+     * @param x \~english [out] Independent variables \~chinese [出参] 自变量
+     * @param y \~english [out] Dependent variable \~chinese [出参] 因变量
+     * @param betas \~english [out] Coefficient estimates \~chinese [出参] 回归系数估计值
+     * @param hasIntercept \~english [out] Whether the model has an intercept \~chinese [出参] 模型是否有截距
+     * @param diagnostic \~english [out] Diagnostic information \~chinese [出参] 诊断信息
+     */
+    void regression(arma::mat& coords, arma::mat& x, arma::vec& y, arma::mat& betas, bool& hasIntercept, RegressionDiagnostic& diagnostic) const;
+
+    /**
+     * @brief \~english Save the archive to a file. \~chinese 将存档保存到文件。
+     *
+     * @param path \~english Path to the file \~chinese 文件路径
+     */
+    void save(const std::string& path) const;
+
+    /**
+     * @brief \~english Save the archive to a stream. \~chinese 将存档保存到流。
+     *
+     * @param stream \~english Binary output stream \~chinese 二进制输出流
+     */
+    void save(std::ostream& stream) const;
+
+    /**
+     * @brief \~english Load an archive from a file. \~chinese 从文件加载存档。
+     *
+     * @param path \~english Path to the file \~chinese 文件路径
+     * @return ModelArchive \~english Archive \~chinese 存档
+     */
+    static ModelArchive load(const std::string& path);
+
+    /**
+     * @brief \~english Load an archive from a stream. \~chinese 从流加载存档。
+     *
+     * @param stream \~english Binary input stream \~chinese 二进制输入流
+     * @return ModelArchive \~english Archive \~chinese 存档
+     */
+    static ModelArchive load(std::istream& stream);
+
+    /**
+     * @brief \~english Open an archive in memory, e.g. a mapped file, without copying matrices. \~chinese 打开内存中的存档（如映射的文件），不复制矩阵。
+     *
+     * The memory must be aligned to double and outlive the archive, and must not be changed.
+     * Archives with broken, duplicated or overlapping entries are rejected.
+     *
+     * @param data \~english Pointer to the archive \~chinese 指向存档的指针
+     * @param size \~english Size of the memory in bytes \~chinese 内存的字节大小
+     * @return ModelArchive \~english Archive whose matrices refer to the memory \~chinese 矩阵引用该内存的存档
+     */
+    static ModelArchive fromBuffer(const void* data, std::size_t size);
+
+private:
+
+    /**
+     * @brief \~english Set a distance configuration. \~chinese 设置一个距离配置。
+     *
+     * @param name \~english Name of the entries \~chinese 条目名称
+     * @param distance \~english Distance \~chinese 距离
+     */
+    void setDistance(const std::string& name, const Distance* distance);
+
+    /**
+     * @brief \~english Create a distance from its configuration. \~chinese 根据配置创建一个距离。
+     *
+     * @param name \~english Name of the entries \~chinese 条目名称
+     * @return std::unique_ptr<Distance> \~english Distance \~chinese 距离
+     */
+    std::unique_ptr<Distance> distance(const std::string& name) const;
+
+private:
+    std::string mModel;                         //!< \~english Name of the model \~chinese 模型名称
+    std::map<std::string, arma::mat> mEntries;  //!< \~english Named matrices \~chinese 具名矩阵
+    std::shared_ptr<std::vector<double>> mBuffer;   //!< \~english Buffer read from a stream, referred by matrices \~chinese 从流读取的缓冲区，被矩阵引用
+};
+
+}
+
+#endif  // MODELARCHIVE_H
@@ -83,6 +83,26 @@ public:
      */
     void setThreshold(double threshold) { mThreshold = threshold; }
 
+    /**
+     * @brief \~english Get the number of threads evaluating candidates concurrently. \~chinese 获取并发计算候选变量组合的线程数。
+     * 
+     * @return int \~english Number of threads \~chinese 线程数
+     */
+    int ompThreadNum() const { return mOmpThreadNum; }
+
+    /**
+     * @brief \~english Set the number of threads evaluating candidates concurrently.
+     * If it is greater than 1 and the instance supports concurrent criterion evaluation,
+     * all candidates of a step are scored as OpenMP tasks, which idle threads steal from each other.
+     * Parallel regions inside each criterion then run on a single thread, so threads are never oversubscribed.
+     * \~chinese 设置并发计算候选变量组合的线程数。
+     * 如果大于 1 且实例支持并发计算指标值，每一步的所有候选变量组合作为 OpenMP 任务计算，空闲线程会相互窃取任务。
+     * 此时每个指标值计算内部的并行区域只使用一个线程，因此不会产生线程过量。
+     * 
+     * @param threadNum \~english Number of threads \~chinese 线程数
+     */
+    void setOmpThreadNum(int threadNum) { mOmpThreadNum = threadNum; }
+
 public:
 
     /**
@@ -107,6 +127,17 @@ private:
      */
     std::vector<std::size_t> convertIndexToVariables(std::vector<std::size_t> index);
 
+    /**
+     * @brief \~english Evaluate all candidates of a step. \~chinese 计算一步中的所有候选变量组合。
+     * 
+     * @param instance \~english A pointer to a instance of type inherited from gwm::IVarialbeSelectable \~chinese 指向派生自 gwm::IVarialbeSelectable 类型对象的指针
+     * @param curIndex \~english Indices of variables already selected \~chinese 已选择的变量索引
+     * @param restIndex \~english Indices of candidate variables \~chinese 候选变量索引
+     * @param criterions [out] \~english Criterion value of each candidate \~chinese 每个候选变量组合的指标值
+     * @return Status \~english Algorithm status \~chinese 算法运行状态
+     */
+    Status evaluateCandidates(IVarialbeSelectable* instance, const std::vector<std::size_t>& curIndex, const std::vector<std::size_t>& restIndex, arma::vec& criterions);
+
     /**
      * @brief \~english Sort variable combinations. \~chinese 对变量组合进行排序。
      * 
@@ -126,6 +157,7 @@ private:
 private:
     std::vector<std::size_t> mVariables;    //!< \~english Variables to be selected \~chinese 要优选的变量
     double mThreshold;                      //!< \~english Threshold \~chinese 阈值
+    int mOmpThreadNum = 1;                  //!< \~english Number of threads evaluating candidates concurrently \~chinese 并发计算候选变量组合的线程数
 
     std::vector<std::pair<std::vector<std::size_t>, double> > mVarsCriterion;   //!< \~english List of criterion values for each variable combination in independent variable selection \~chinese 变量优选过程中每种变量组合对应的指标值列表
 };
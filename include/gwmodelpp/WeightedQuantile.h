@@ -0,0 +1,89 @@
+#ifndef WEIGHTEDQUANTILE_H
+#define WEIGHTEDQUANTILE_H
+
+#include <armadillo>
+
+namespace gwm
+{
+
+/**
+ * \~english
+ * @brief Engine for weighted quantiles of fixed variables under many weight vectors.
+ * Each column of the variables is sorted only once on construction.
+ * For every weight vector, the quantiles are then found either by one pass over the cumulative weights in sorted order,
+ * or, when most weights are zero (e.g. compact kernels), by binary search on the prefix sum of the non-zero weights only.
+ * The weighted \f$p\f$-quantile is the value right before the first sorted value whose cumulative weight exceeds \f$p\f$.
+ *
+ * \~chinese
+ * @brief 在多个权重向量下计算固定变量加权分位数的引擎。
+ * 变量的每一列只在构造时排序一次。
+ * 对于每个权重向量，分位数或者通过按排序顺序对累积权重的一次遍历得到，
+ * 或者在大部分权重为零时（如紧支撑核函数），仅在非零权重的前缀和上二分查找得到。
+ * 加权 \f$p\f$ 分位数为累积权重首次超过 \f$p\f$ 的排序值的前一个值。
+ */
+class WeightedQuantile
+{
+public:
+
+    /**
+     * @brief \~english Construct a new empty WeightedQuantile object. \~chinese 构造一个新的空 WeightedQuantile 对象。
+     */
+    WeightedQuantile() {}
+
+    /**
+     * @brief \~english Construct a new WeightedQuantile object and sort each variable. \~chinese 构造一个新的 WeightedQuantile 对象并对各变量排序。
+     *
+     * @param x \~english Variables, one column for each \~chinese 变量，每列一个
+     * @param probs \~english Probabilities of quantiles, in any order \~chinese 分位数的概率，可以为任意顺序
+     */
+    WeightedQuantile(const arma::mat& x, const arma::vec& probs);
+
+public:
+
+    /**
+     * @brief \~english Get probabilities of quantiles. \~chinese 获取分位数的概率。
+     *
+     * @return arma::vec \~english Probabilities in the order given on construction \~chinese 按构造时顺序排列的概率
+     */
+    arma::vec probs() const;
+
+    /**
+     * @brief \~english Calculate weighted quantiles of all variables. \~chinese 计算所有变量的加权分位数。
+     *
+     * @param w \~english Normalised weight vector whose sum is 1 \~chinese 和为 1 的归一化权重向量
+     * @return arma::mat \~english Quantiles, one row for each probability and one column for each variable \~chinese 分位数，每行对应一个概率，每列对应一个变量
+     */
+    arma::mat quantile(const arma::vec& w) const;
+
+private:
+
+    /**
+     * @brief \~english Find quantiles of one variable by one pass over all sorted values. \~chinese 通过对所有排序值的一次遍历查找一个变量的分位数。
+     *
+     * @param j \~english Index of the variable \~chinese 变量的索引
+     * @param w \~english Normalised weight vector \~chinese 归一化权重向量
+     * @return arma::vec \~english Quantiles in ascending order of probabilities \~chinese 按概率升序排列的分位数
+     */
+    arma::vec quantileDense(arma::uword j, const arma::vec& w) const;
+
+    /**
+     * @brief \~english Find quantiles of one variable by binary search on the prefix sum of non-zero weights. \~chinese 通过在非零权重的前缀和上二分查找得到一个变量的分位数。
+     *
+     * @param j \~english Index of the variable \~chinese 变量的索引
+     * @param w \~english Normalised weight vector \~chinese 归一化权重向量
+     * @param nz \~english Indices of non-zero weights \~chinese 非零权重的索引
+     * @return arma::vec \~english Quantiles in ascending order of probabilities \~chinese 按概率升序排列的分位数
+     */
+    arma::vec quantileCompact(arma::uword j, const arma::vec& w, const arma::uvec& nz) const;
+
+private:
+    arma::vec mProbs;       //!< \~english Probabilities in ascending order \~chinese 升序排列的概率
+    arma::uvec mProbOrder;  //!< \~english Position of each sorted probability in the order given by users \~chinese 排序后的各概率在用户给定顺序中的位置
+    arma::mat mSorted;      //!< \~english Each variable sorted in ascending order \~chinese 升序排列的各变量
+    arma::umat mOrder;      //!< \~english Row index of each sorted value \~chinese 各排序值的行索引
+    arma::umat mRank;       //!< \~english Position of each value in the sorted variable \~chinese 各值在排序后变量中的位置
+};
+
+}
+
+#endif  // WEIGHTEDQUANTILE_H
@@ -0,0 +1,138 @@
+#ifndef BALLTREE_H
+#define BALLTREE_H
+
+#include <vector>
+#include <armadillo>
+
+namespace gwm
+{
+
+/**
+ * \~english
+ * @brief Ball tree over data points, used to find extreme distances and neighbours without calculating every pair.
+ * Each node bounds its points by a ball: a circle for projected coordinates,
+ * or a spherical cap on the unit sphere for geographical coordinates.
+ * Nodes whose bounds cannot improve the current result are skipped,
+ * and distances at leaves are calculated by the same formula as CRSDistance.
+ *
+ * \~chinese
+ * @brief 数据点上的球树，用于在不计算所有点对的情况下查找极值距离和近邻。
+ * 每个节点用一个球包围其中的点：投影坐标下为圆，地理坐标下为单位球面上的球冠。
+ * 边界无法改进当前结果的节点会被跳过，叶节点处的距离使用与 CRSDistance 相同的公式计算。
+ */
+class BallTree
+{
+public:
+
+    /**
+     * @brief \~english Construct a new BallTree object. \~chinese 构造一个新的 BallTree 对象。
+     *
+     * @param points \~english Coordinates of data points, whose shape must be \f$n \times 2\f$ \~chinese 数据点坐标，其形状必须是 \f$n \times 2\f$
+     * @param geographic \~english Whether the coordinate reference system is geographical \~chinese 坐标参考系是否是地理坐标系
+     */
+    BallTree(const arma::mat& points, bool geographic);
+
+public:
+
+    /**
+     * @brief \~english Find the nearest distance from a location to data points. \~chinese 查找一个位置到数据点的最近距离。
+     *
+     * @param loc \~english Coordinate of the location \~chinese 位置坐标
+     * @param bound \~english Known upper bound of the result, nodes not closer than it are skipped \~chinese 结果的已知上界，不比它更近的节点会被跳过
+     * @return double \~english The smaller one of bound and the nearest distance \~chinese bound 与最近距离中的较小值
+     */
+    double nearest(const arma::rowvec& loc, double bound) const;
+
+    /**
+     * @brief \~english Find the farthest distance from a location to data points. \~chinese 查找一个位置到数据点的最远距离。
+     *
+     * @param loc \~english Coordinate of the location \~chinese 位置坐标
+     * @param bound \~english Known lower bound of the result, nodes not farther than it are skipped \~chinese 结果的已知下界，不比它更远的节点会被跳过
+     * @return double \~english The larger one of bound and the farthest distance \~chinese bound 与最远距离中的较大值
+     */
+    double farthest(const arma::rowvec& loc, double bound) const;
+
+    /**
+     * @brief \~english Find data points closer to a location than a radius. \~chinese 查找到一个位置的距离小于半径的数据点。
+     *
+     * @param loc \~english Coordinate of the location \~chinese 位置坐标
+     * @param radius \~english Radius, points at exactly this distance are excluded \~chinese 半径，距离恰好等于它的点不包括在内
+     * @param index \~english [out] Row indices of found points \~chinese [out] 找到的点的行索引
+     * @param dists \~english [out] Distances to found points \~chinese [out] 到找到的点的距离
+     */
+    void within(const arma::rowvec& loc, double radius, arma::uvec& index, arma::vec& dists) const;
+
+    /**
+     * @brief \~english Find the k nearest data points to a location. \~chinese 查找距离一个位置最近的 k 个数据点。
+     *
+     * @param loc \~english Coordinate of the location \~chinese 位置坐标
+     * @param k \~english Number of points, no more than the number of data points \~chinese 点的数量，不超过数据点数量
+     * @param index \~english [out] Row indices of found points, ordered by distance \~chinese [out] 找到的点的行索引，按距离排序
+     * @param dists \~english [out] Ascending distances to found points \~chinese [out] 到找到的点的升序距离
+     */
+    void nearest(const arma::rowvec& loc, arma::uword k, arma::uvec& index, arma::vec& dists) const;
+
+private:
+
+    /**
+     * @brief \~english Node of the tree. \~chinese 树的节点。
+     */
+    struct Node
+    {
+        arma::uword begin;  //!< \~english First position of points in this node \~chinese 节点中点的起始位置
+        arma::uword end;    //!< \~english One past the last position of points in this node \~chinese 节点中点的结束位置（不含）
+        arma::vec3 center;  //!< \~english Center of the ball \~chinese 球心
+        double radius;      //!< \~english Radius of the ball, an angle for geographical coordinates \~chinese 球半径，地理坐标下为角度
+        int left;           //!< \~english Index of the left child, -1 for leaves \~chinese 左子节点索引，叶节点为 -1
+        int right;          //!< \~english Index of the right child, -1 for leaves \~chinese 右子节点索引，叶节点为 -1
+    };
+
+    /**
+     * @brief \~english Build nodes for points in a range recursively. \~chinese 为一段范围内的点递归构建节点。
+     *
+     * @param begin \~english First position \~chinese 起始位置
+     * @param end \~english One past the last position \~chinese 结束位置（不含）
+     * @return int \~english Index of the created node \~chinese 创建的节点索引
+     */
+    int build(arma::uword begin, arma::uword end);
+
+    /**
+     * @brief \~english Map a coordinate to the space where balls are defined. \~chinese 将坐标映射到定义球的空间中。
+     *
+     * @param loc \~english Coordinate \~chinese 坐标
+     * @return arma::vec3 \~english Point on the plane or on the unit sphere \~chinese 平面或单位球面上的点
+     */
+    arma::vec3 embed(const arma::rowvec& loc) const;
+
+    /**
+     * @brief \~english Calculate lower and upper bounds of distances from a location to points in a node. \~chinese 计算一个位置到节点中各点距离的下界和上界。
+     *
+     * @param node \~english Node \~chinese 节点
+     * @param e \~english Embedded location \~chinese 映射后的位置
+     * @param lower [out] \~english Lower bound \~chinese 下界
+     * @param upper [out] \~english Upper bound \~chinese 上界
+     */
+    void bounds(const Node& node, const arma::vec3& e, double& lower, double& upper) const;
+
+    /**
+     * @brief \~english Calculate the distance from a location to a data point. \~chinese 计算一个位置到一个数据点的距离。
+     *
+     * @param loc \~english Coordinate of the location \~chinese 位置坐标
+     * @param i \~english Row index of the data point \~chinese 数据点的行索引
+     * @return double \~english Distance \~chinese 距离
+     */
+    double distance(const arma::rowvec& loc, arma::uword i) const;
+
+private:
+    static const arma::uword LeafSize = 16;     //!< \~english Maximum number of points in a leaf \~chinese 叶节点中点的最大数量
+
+    bool mGeographic;           //!< \~english Whether the coordinate reference system is geographical \~chinese 坐标参考系是否是地理坐标系
+    arma::mat mPoints;          //!< \~english Coordinates of data points \~chinese 数据点坐标
+    arma::mat mEmbedded;        //!< \~english Embedded data points, one column for each \~chinese 映射后的数据点，每列一个
+    arma::uvec mIndex;          //!< \~english Row indices of data points ordered by nodes \~chinese 按节点排列的数据点行索引
+    std::vector<Node> mNodes;   //!< \~english Nodes, the first of which is the root \~chinese 节点，第一个为根节点
+};
+
+}
+
+#endif  // BALLTREE_H
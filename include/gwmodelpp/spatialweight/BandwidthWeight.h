@@ -3,6 +3,7 @@
 
 #include <unordered_map>
 #include <string>
+#include <cmath>
 #include "Weight.h"
 
 #ifdef ENABLE_CUDA
@@ -58,6 +59,90 @@ public:
 
     static KernelFunction Kernel[];
 
+    typedef void (*KernelInPlaceFunction)(double*, arma::uword, double); //!< \~english Kernel functions overwriting a buffer of distances with weights \~chinese 用权重覆盖距离缓冲区的核函数
+
+    static KernelInPlaceFunction KernelInPlace[];
+
+    /**
+     * @brief \~english Gaussian kernel function applied in place. \~chinese 原地计算的 Gaussian 核函数。
+     * 
+     * @param dist \~english [in,out] Buffer of distances, overwritten by weights \~chinese [in,out] 距离缓冲区，被权重覆盖
+     * @param n \~english Number of elements in the buffer \~chinese 缓冲区中的元素数量
+     * @param bw \~english Bandwidth size (its unit is equal to that of distance vector) \~chinese 带宽大小（和距离向量的单位相同）
+     */
+    static void GaussianKernelInPlace(double* dist, arma::uword n, double bw)
+    {
+        const double scale = (-2.0) * (bw * bw);
+        for (arma::uword i = 0; i < n; i++)
+        {
+            dist[i] = std::exp((dist[i] * dist[i]) / scale);
+        }
+    }
+
+    /**
+     * @brief \~english Exponential kernel function applied in place. \~chinese 原地计算的 Exponential 核函数。
+     * 
+     * @param dist \~english [in,out] Buffer of distances, overwritten by weights \~chinese [in,out] 距离缓冲区，被权重覆盖
+     * @param n \~english Number of elements in the buffer \~chinese 缓冲区中的元素数量
+     * @param bw \~english Bandwidth size (its unit is equal to that of distance vector) \~chinese 带宽大小（和距离向量的单位相同）
+     */
+    static void ExponentialKernelInPlace(double* dist, arma::uword n, double bw)
+    {
+        for (arma::uword i = 0; i < n; i++)
+        {
+            dist[i] = std::exp(-dist[i] / bw);
+        }
+    }
+
+    /**
+     * @brief \~english Bisquare kernel function applied in place. \~chinese 原地计算的 Bisquare 核函数。
+     * 
+     * @param dist \~english [in,out] Buffer of distances, overwritten by weights \~chinese [in,out] 距离缓冲区，被权重覆盖
+     * @param n \~english Number of elements in the buffer \~chinese 缓冲区中的元素数量
+     * @param bw \~english Bandwidth size (its unit is equal to that of distance vector) \~chinese 带宽大小（和距离向量的单位相同）
+     */
+    static void BisquareKernelInPlace(double* dist, arma::uword n, double bw)
+    {
+        const double bw2 = bw * bw;
+        for (arma::uword i = 0; i < n; i++)
+        {
+            double d = dist[i], t = 1.0 - (d * d) / bw2;
+            dist[i] = d < bw ? t * t : 0.0;
+        }
+    }
+
+    /**
+     * @brief \~english Tricube kernel function applied in place. \~chinese 原地计算的 Tricube 核函数。
+     * 
+     * @param dist \~english [in,out] Buffer of distances, overwritten by weights \~chinese [in,out] 距离缓冲区，被权重覆盖
+     * @param n \~english Number of elements in the buffer \~chinese 缓冲区中的元素数量
+     * @param bw \~english Bandwidth size (its unit is equal to that of distance vector) \~chinese 带宽大小（和距离向量的单位相同）
+     */
+    static void TricubeKernelInPlace(double* dist, arma::uword n, double bw)
+    {
+        const double bw3 = bw * bw * bw;
+        for (arma::uword i = 0; i < n; i++)
+        {
+            double d = dist[i], t = 1.0 - (d * d * d) / bw3;
+            dist[i] = d < bw ? t * t * t : 0.0;
+        }
+    }
+
+    /**
+     * @brief \~english Boxcar kernel function applied in place. \~chinese 原地计算的 Boxcar 核函数。
+     * 
+     * @param dist \~english [in,out] Buffer of distances, overwritten by weights \~chinese [in,out] 距离缓冲区，被权重覆盖
+     * @param n \~english Number of elements in the buffer \~chinese 缓冲区中的元素数量
+     * @param bw \~english Bandwidth size (its unit is equal to that of distance vector) \~chinese 带宽大小（和距离向量的单位相同）
+     */
+    static void BoxcarKernelInPlace(double* dist, arma::uword n, double bw)
+    {
+        for (arma::uword i = 0; i < n; i++)
+        {
+            dist[i] = dist[i] < bw ? 1.0 : 0.0;
+        }
+    }
+
     /**
      * @brief \~english Gaussian kernel function. \~chinese Gaussian 核函数。
      * 
@@ -67,9 +152,10 @@ public:
      */
     static arma::vec GaussianKernelFunction(arma::vec dist, double bw)
     {
-        return exp((dist % dist) / ((-2.0) * (bw * bw)));
+        GaussianKernelInPlace(dist.memptr(), dist.n_elem, bw);
+        return dist;
     }
-    
+
     /**
      * @brief \~english Exponential kernel function. \~chinese Exponential 核函数。
      * 
@@ -79,9 +165,10 @@ public:
      */
     static arma::vec ExponentialKernelFunction(arma::vec dist, double bw)
     {
-        return exp(-dist / bw);
+        ExponentialKernelInPlace(dist.memptr(), dist.n_elem, bw);
+        return dist;
     }
-    
+
     /**
      * @brief \~english Bisquare kernel function. \~chinese Bisquare 核函数。
      * 
@@ -91,10 +178,10 @@ public:
      */
     static arma::vec BisquareKernelFunction(arma::vec dist, double bw)
     {
-        arma::vec d2_d_b2 = 1.0 - (dist % dist) / (bw * bw);
-        return (dist < bw) % (d2_d_b2 % d2_d_b2);
+        BisquareKernelInPlace(dist.memptr(), dist.n_elem, bw);
+        return dist;
     }
-    
+
     /**
      * @brief \~english Tricube kernel function. \~chinese Tricube 核函数。
      * 
@@ -104,10 +191,10 @@ public:
      */
     static arma::vec TricubeKernelFunction(arma::vec dist, double bw)
     {
-        arma::vec d3_d_b3 = 1.0 - (dist % dist % dist) / (bw * bw * bw);
-        return (dist < bw) % (d3_d_b3 % d3_d_b3 % d3_d_b3);
+        TricubeKernelInPlace(dist.memptr(), dist.n_elem, bw);
+        return dist;
     }
-    
+
     /**
      * @brief \~english Boxcar kernel function. \~chinese Boxcar 核函数。
      * 
@@ -117,7 +204,8 @@ public:
      */
     static arma::vec BoxcarKernelFunction(arma::vec dist, double bw)
     {
-        return (dist < bw) % arma::vec(arma::size(dist), arma::fill::ones);
+        BoxcarKernelInPlace(dist.memptr(), dist.n_elem, bw);
+        return dist;
     }
 
 public:
@@ -180,6 +268,24 @@ public:
 public:
     virtual arma::vec weight(arma::vec dist) override;
 
+    /**
+     * @brief \~english Calculate weights in place, without allocating any vector for fixed bandwidths.
+     * \~chinese 原地计算权重，对于固定带宽不分配任何向量。
+     * 
+     * @param dist \~english [in,out] Distance vector, overwritten by weights \~chinese [in,out] 距离向量，被权重覆盖
+     */
+    virtual void weightInPlace(arma::vec& dist) override;
+
+    /**
+     * @brief \~english Get the bandwidth in the unit of distances.
+     * For adaptive bandwidths, it is found by partial selection instead of sorting all distances.
+     * \~chinese 获取以距离为单位的带宽。对于可变带宽，通过部分选择而不是对所有距离排序得到。
+     * 
+     * @param dist \~english Distance vector \~chinese 距离向量
+     * @return double \~english Bandwidth in the unit of distances \~chinese 以距离为单位的带宽
+     */
+    double distanceBandwidth(const arma::vec& dist) const;
+
 #ifdef ENABLE_CUDA
     virtual cudaError_t weight(double* d_dists, double* d_weights, size_t elems) override;
 #endif // ENABLE_CUDA
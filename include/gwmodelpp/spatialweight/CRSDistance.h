@@ -44,6 +44,10 @@ public:
          */
         arma::mat dataPoints;
 
+        arma::rowvec center;        //!< \~english Mean of data points' coordinates \~chinese 数据点坐标的均值
+        arma::mat centeredPoints;   //!< \~english Data points' coordinates minus their mean \~chinese 减去均值后的数据点坐标
+        arma::vec centeredNorms;    //!< \~english Squared norms of centered data points \~chinese 中心化数据点的平方范数
+
         /**
          * @brief \~english Construct a new CRSDistanceParameter object. \~chinese 构造一个新的 CRSDistanceParameter 对象。
          * 
@@ -55,6 +59,9 @@ public:
             , dataPoints(dp)
         {
             total = fp.n_rows;
+            center = dp.n_rows > 0 ? arma::rowvec(arma::mean(dp, 0)) : arma::rowvec(dp.n_cols, arma::fill::zeros);
+            centeredPoints = dp.each_row() - center;
+            centeredNorms = arma::sum(arma::square(centeredPoints), 1);
         }
     };
 
@@ -181,6 +188,8 @@ public:
     void setGeographic(bool geographic)
     {
         mGeographic = geographic;
+        mMaxDistance.reset();
+        mMinDistance.reset();
         mCalculator = mGeographic ? &SpatialDistance : &EuclideanDistance;
 #ifdef ENABLE_CUDA
         mCalculatorCuda = mGeographic ? &sp_dist_cuda : eu_dist_cuda;
@@ -205,9 +214,68 @@ public:
     virtual void makeParameter(std::initializer_list<DistParamVariant> plist) override;
 
     virtual arma::vec distance(arma::uword focus) override;
+
+    /**
+     * @brief \~english Calculate distance vector for a focus point into a buffer.
+     * No memory is allocated if the buffer already has the size of data points.
+     * \~chinese 为一个目标点计算距离向量并写入缓冲区。如果缓冲区大小已经等于数据点数量，则不分配内存。
+     * 
+     * @param focus \~english Focused point's index. Require focus < total \~chinese 目标点索引，要求 focus 小于参数中的 total
+     * @param dist [out] \~english Distance vector for the focused point \~chinese 目标点到所有数据点的距离向量
+     */
+    void distance(arma::uword focus, arma::vec& dist);
+
+    /**
+     * @brief \~english Calculate distances for a block of focus points as a tile.
+     * For projected coordinates, squared distances are expanded as \f$\|a\|^2 + \|b\|^2 - 2ab^T\f$ about the mean of data points,
+     * so that the cross terms of the whole tile are one matrix product.
+     * Where cancellation makes the expansion inaccurate, i.e. the distance is small relative to the norms,
+     * the entry is recalculated directly. Hence coincident points always get zero distances.
+     * For geographical coordinates, distances are calculated for each focus point.
+     * \~chinese 为一组目标点计算距离块。
+     * 对于投影坐标，以数据点均值为中心将距离平方展开为 \f$\|a\|^2 + \|b\|^2 - 2ab^T\f$ ，因此整个距离块的交叉项仅需一次矩阵乘法。
+     * 当距离相对于范数很小而导致展开式因相消不精确时，直接重新计算该元素，因此重合点的距离总为零。
+     * 对于地理坐标，逐个目标点计算距离。
+     *
+     * @param focuses \~english Focused points' indices. Require each focus < total \~chinese 目标点索引，要求每个均小于参数中的 total
+     * @return arma::mat \~english Distances from all data points (rows) to the focused points (columns) \~chinese 所有数据点（行）到目标点（列）的距离矩阵
+     */
+    virtual arma::mat distanceBlock(const arma::uvec& focuses) override;
+
+    /**
+     * @brief \~english Get maximum distance between focus points and data points.
+     * For projected coordinates, only vertices of convex hulls of both point sets are checked.
+     * For geographical coordinates, a ball tree of spherical caps skips data points that cannot be farther.
+     * The result is cached until parameters change.
+     * \~chinese 获取目标点与数据点之间的最大距离。
+     * 对于投影坐标，只检查两个点集凸包的顶点。
+     * 对于地理坐标，使用球冠构成的球树跳过不可能更远的数据点。
+     * 结果在参数改变前会被缓存。
+     * 
+     * @return double \~english Maximum distance \~chinese 最大距离
+     */
     virtual double maxDistance() override;
+
+    /**
+     * @brief \~english Get minimum distance between focus points and data points.
+     * Nearest data points are searched in a ball tree. The result is cached until parameters change.
+     * \~chinese 获取目标点与数据点之间的最小距离。
+     * 在球树中搜索最近的数据点。结果在参数改变前会被缓存。
+     * 
+     * @return double \~english Minimum distance \~chinese 最小距离
+     */
     virtual double minDistance() override;
 
+    /**
+     * @brief \~english Find vertices of the convex hull of points with Andrew's monotone chain algorithm.
+     * Points lying on edges are kept.
+     * \~chinese 使用 Andrew 单调链算法查找点集凸包的顶点。位于边上的点会被保留。
+     * 
+     * @param points \~english Coordinates of points, whose shape must be \f$n \times 2\f$ \~chinese 点坐标，其形状必须是 \f$n \times 2\f$
+     * @return arma::uvec \~english Row indices of hull vertices \~chinese 凸包顶点的行索引
+     */
+    static arma::uvec ConvexHull(const arma::mat& points);
+
 #ifdef ENABLE_CUDA
     virtual cudaError_t prepareCuda(size_t gpuId) override;
 
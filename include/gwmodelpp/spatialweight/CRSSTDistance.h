@@ -4,12 +4,20 @@
 #include "CRSDistance.h"
 #include "OneDimDistance.h"
 #include <math.h>
+#include <memory>
 
 namespace gwm
 {
 
 /**
  * @brief \~english Class for calculating spatial temporal distance. \~chinese 计算时空距离的类，由空间距离和时间距离组成
+ * 
+ * \~english By default, spatial distances to all focus points are cached when parameters are made (see setComponentCache()).
+ * The cache holds one double for each pair of focus and data points, up to CRSSTDistance::MaxCacheSize elements (128 MiB).
+ * It is never modified once made, so copies of the distance share it instead of copying it.
+ * \~chinese 默认在生成参数时缓存到所有目标点的空间距离（见 setComponentCache()）。
+ * 缓存为每一对目标点和数据点保存一个双精度数，最多 CRSSTDistance::MaxCacheSize 个元素（128 MiB）。
+ * 缓存生成后不再修改，因此距离对象的副本共享缓存而不复制。
  */
 class CRSSTDistance : public Distance
 {
@@ -57,6 +65,32 @@ public:
      */
     static arma::vec ObliqueSTDistance(Distance* spatial, gwm::OneDimDistance* temporal, arma::uword focus, double lambda, double angle);
 
+    /**
+     * @brief \~english Combine spatial distances and signed temporal distances into spatial temporal distances.
+     * Data points later than the focus point get CRSSTDistance::LaterDistance unless \f$\lambda = 1\f$.
+     * \~chinese 将空间距离和带符号的时间距离组合为时空距离。
+     * 除非 \f$\lambda = 1\f$ ，晚于目标点的数据点的距离为 CRSSTDistance::LaterDistance 。
+     * 
+     * @param sdist \~english Spatial distances \~chinese 空间距离
+     * @param tdist \~english Signed temporal distances, negative for later data points \~chinese 带符号的时间距离，晚于目标点的数据点为负
+     * @param lambda \~english lambda \~chinese 时空距离的相对权重值
+     * @param cosine \~english Coefficient of the cross term, 1 for OrthogonalSTDistance and \f$\cos\theta\f$ for ObliqueSTDistance
+     * \~chinese 交叉项的系数，OrthogonalSTDistance 为 1， ObliqueSTDistance 为 \f$\cos\theta\f$
+     * @return arma::vec \~english Distance vector \~chinese 计算得到的距离向量
+     */
+    static arma::vec CombineSTDistance(const arma::vec& sdist, const arma::vec& tdist, double lambda, double cosine);
+
+    /**
+     * @brief \~english Get the coefficient of the cross term for an angle. \~chinese 获取一个角度对应的交叉项系数。
+     * 
+     * @param angle \~english angle \~chinese 斜交时空距离的角度
+     * @return double \~english 1 if the angle is \f$\pi/2\f$ (OrthogonalSTDistance), otherwise \f$\cos\theta\f$ \~chinese 角度为 \f$\pi/2\f$ 时（ OrthogonalSTDistance ）为 1，否则为 \f$\cos\theta\f$
+     */
+    static double CrossCoefficient(double angle)
+    {
+        return (std::abs(angle - arma::datum::pi / 2.0) < 1e-15) ? 1.0 : cos(angle);
+    }
+
 public:
 
     /**
@@ -84,31 +118,116 @@ public:
 
     /**
      * \~english @brief make the input data, initialize mParameter.
+     * Focus points may differ from data points, e.g. for prediction.
+     * If the component cache is enabled and not too large, spatial distances to all focus points are calculated and cached here.
      * \~chinese @brief 将输入的数据初始化到mSpatialDistance, mTemporalDistance中，并初始化mParameter
+     * 目标点可以与数据点不同，例如用于预测时。
+     * 如果启用了分量缓存且缓存不会过大，在此计算并缓存到所有目标点的空间距离。
      * @param plist \~english need to contain 4 items, mat, mat, vec, vec
      * \~chinese 需要是4个数据组成：mat：目标空间点，mat：数据空间点，vec：目标时间戳，vec：数据时间戳
      */
     void makeParameter(std::initializer_list<DistParamVariant> plist) override;
 
     /**
-     * @brief \~english calculate distance
-     * \~chinese 利用mCalculator计算距离
-     * @param focus \~english focus     * \~chinese 第几个数据
-     * @return mCalculator \~english already initialized OrthogonalSTDistance or ObliqueSTDistance 
-     * \~chinese 距离计算器，二选一，是已被初始化的
+     * @brief \~english Calculate distance in the same way as OrthogonalSTDistance or ObliqueSTDistance.
+     * Unless \f$\lambda = 1\f$, only data points not later than the focus point (see admissible()) are evaluated,
+     * and the others get CRSSTDistance::LaterDistance directly.
+     * \~chinese 以与 OrthogonalSTDistance 或 ObliqueSTDistance 相同的方式计算距离。
+     * 除非 \f$\lambda = 1\f$ ，只计算不晚于目标点的数据点（见 admissible() ），其余数据点的距离直接为 CRSSTDistance::LaterDistance 。
+     * @param focus \~english focus \~chinese 第几个数据
+     * @return arma::vec \~english Distance vector \~chinese 计算得到的距离向量
      */
-    arma::vec distance(arma::uword focus) override
-    {
-        return mCalculator(mSpatialDistance, mTemporalDistance, focus, mLambda, mAngle);
-    }
+    arma::vec distance(arma::uword focus) override;
 
     /**
-     * @brief \~english bandwidth calculation. \~chinese 用于计算带宽
+     * @brief \~english Get data points not later than a focus point, found by binary search in data points sorted by time.
+     * \~chinese 获取不晚于目标点的数据点，通过在按时间排序的数据点中二分查找得到。
+     * 
+     * @param focus \~english focus \~chinese 第几个数据
+     * @return arma::uvec \~english Indices of data points in ascending order of time \~chinese 按时间升序排列的数据点索引
+     */
+    arma::uvec admissible(arma::uword focus) const;
+
+    /**
+     * @brief \~english Get minimum distance for bandwidth calculation.
+     * When \f$\lambda = 1\f$ it is the minimum spatial distance; otherwise the search stops once a zero distance is found.
+     * The result is cached until parameters change.
+     * \~chinese 获取用于计算带宽的最小距离。
+     * 当 \f$\lambda = 1\f$ 时即为最小空间距离；否则在找到零距离后停止搜索。
+     * 结果在参数改变前会被缓存。
      */
     double minDistance() override;
 
+    /**
+     * @brief \~english Get maximum distance for bandwidth calculation.
+     * When \f$\lambda = 1\f$ it is the maximum spatial distance; otherwise the search stops once a data point later than the focus point is found,
+     * whose distance is always CRSSTDistance::LaterDistance.
+     * The result is cached until parameters change.
+     * \~chinese 获取用于计算带宽的最大距离。
+     * 当 \f$\lambda = 1\f$ 时即为最大空间距离；否则在找到晚于目标点的数据点后停止搜索，其距离恒为 CRSSTDistance::LaterDistance 。
+     * 结果在参数改变前会被缓存。
+     */
     double maxDistance() override;
 
+    /**
+     * @brief \~english Calculate spatial distances and signed temporal distances to a focus point, which do not depend on \f$\lambda\f$ or the angle.
+     * \~chinese 计算到目标点的空间距离和带符号的时间距离，二者与 \f$\lambda\f$ 和角度无关。
+     * 
+     * @param focus \~english focus \~chinese 第几个数据
+     * @param sdist [out] \~english Spatial distances \~chinese 空间距离
+     * @param tdist [out] \~english Signed temporal distances \~chinese 带符号的时间距离
+     */
+    void componentDistance(arma::uword focus, arma::vec& sdist, arma::vec& tdist);
+
+    /**
+     * @brief \~english Get whether spatial distances are cached when parameters are made.
+     * As they do not depend on \f$\lambda\f$ or the angle, the combined distance is then only a cheap blend while these change.
+     * Temporal distances are a single subtraction and never cached.
+     * \~chinese 获取是否在生成参数时缓存空间距离。
+     * 由于空间距离与 \f$\lambda\f$ 和角度无关，在二者变化时组合距离只需进行廉价的混合计算。
+     * 时间距离只需一次减法，不做缓存。
+     * 
+     * @return true \~english if spatial distances are cached \~chinese 如果缓存空间距离
+     * @return false \~english if spatial distances are not cached \~chinese 如果不缓存空间距离
+     */
+    bool componentCache() const { return mComponentCache; }
+
+    /**
+     * @brief \~english Set whether spatial distances are cached when parameters are made.
+     * The cache costs 8 bytes for each pair of focus and data points, i.e. up to 128 MiB,
+     * and is skipped if it has more than CRSSTDistance::MaxCacheSize elements.
+     * Copies share one cache until either of them makes parameters again.
+     * Turn it off when memory matters more than repeated distance calculations.
+     * \~chinese 设置是否在生成参数时缓存空间距离。
+     * 缓存对每一对目标点和数据点占用 8 字节，即最多 128 MiB，
+     * 缓存元素数超过 CRSSTDistance::MaxCacheSize 时不缓存。
+     * 副本共享同一个缓存，直到其中之一重新生成参数。
+     * 当内存比重复计算距离更重要时应关闭缓存。
+     * 
+     * @param cache \~english Whether spatial distances are cached \~chinese 是否缓存空间距离
+     */
+    void setComponentCache(bool cache)
+    {
+        mComponentCache = cache;
+        if (!cache) mSpatialCache.reset();
+    }
+
+    /**
+     * @brief \~english Get an upper bound of distances to data points not later than focus points, for any \f$\lambda\f$ and angle.
+     * \~chinese 获取对任意 \f$\lambda\f$ 和角度均成立的、到不晚于目标点的数据点的距离上界。
+     * 
+     * @return double \~english \f$(\sqrt{S} + \sqrt{T})^2\f$ where \f$S\f$ and \f$T\f$ are maximum spatial and temporal distances
+     * \~chinese \f$(\sqrt{S} + \sqrt{T})^2\f$ ，其中 \f$S\f$ 和 \f$T\f$ 为最大空间距离和最大时间距离
+     */
+    double boundDistance()
+    {
+        double sbound = sqrt(mSpatialDistance->maxDistance()), tbound = sqrt(mTemporalDistance->maxDistance());
+        return (sbound + tbound) * (sbound + tbound);
+    }
+
+    static constexpr double LaterDistance = 1e13;  //!< \~english Distance to data points later than the focus point \~chinese 晚于目标点的数据点的距离
+    static constexpr arma::uword MaxCacheSize = arma::uword(1) << 24;   //!< \~english Maximum number of cached spatial distances \~chinese 缓存空间距离的最大个数
+
 public:
 
     //const gwm::CRSDistance* spatialDistance() const { return mSpatialDistance; }
@@ -118,16 +237,37 @@ public:
     const gwm::OneDimDistance* temporalDistance() const { return mTemporalDistance; }
 
     // unused code to set lambda
-    // double lambda() const { return mLambda; }
+    double lambda() const { return mLambda; }
     void setLambda(const double lambda)    {
         if (lambda >= 0 && lambda <= 1)
         {
             mLambda = lambda;
+            mMaxDistance.reset();
+            mMinDistance.reset();
         }
         else
             throw std::runtime_error("The lambda must be in [0,1].");
     }
 
+    /**
+     * @brief \~english Get the angle. \~chinese 获取斜交时空距离的角度。
+     * 
+     * @return double \~english Angle \~chinese 角度
+     */
+    double angle() const { return mAngle; }
+
+    /**
+     * @brief \~english Set the angle. \~chinese 设置斜交时空距离的角度。
+     * 
+     * @param angle \~english Angle \~chinese 角度
+     */
+    void setAngle(const double angle)
+    {
+        mAngle = atan(tan(angle));
+        mMaxDistance.reset();
+        mMinDistance.reset();
+    }
+
 protected:
     Distance* mSpatialDistance = nullptr;  //!< \~english Pointer to instance for spatial distance \~chinese 指向空间距离的指针
     gwm::OneDimDistance* mTemporalDistance = nullptr;  //!< \~english Pointer to instance for temporal distance \~chinese 指向时间距离的指针
@@ -135,9 +275,27 @@ protected:
     double mLambda = 0.0;  //!< \~english Weight of temporal distance \~chinese 时间距离的权重
     double mAngle = arma::datum::pi / 2;  //!< \~english Angle of spatial distance and temporal distance \~chinese 斜交时空距离的角度
 
+private:
+
+    /**
+     * @brief \~english Calculate spatial distances from a focus point to some data points, taken from the cache if possible. \~chinese 计算目标点到部分数据点的空间距离，尽可能从缓存中获取。
+     * 
+     * @param focus \~english focus \~chinese 第几个数据
+     * @param idx \~english Indices of data points \~chinese 数据点索引
+     * @return arma::vec \~english Spatial distances \~chinese 空间距离
+     */
+    arma::vec spatialDistance(arma::uword focus, const arma::uvec& idx);
+
 private:
     std::unique_ptr<Parameter> mParameter;  //!< \~english Parameters \~chinese 参数
-    CalculatorType mCalculator = &OrthogonalSTDistance;  //!< \~english Calculator \~chinese 计算器
+    arma::mat mFocusCoords;     //!< \~english Spatial coordinates of focus points \~chinese 目标点空间坐标
+    arma::mat mDataCoords;      //!< \~english Spatial coordinates of data points \~chinese 数据点空间坐标
+    arma::vec mFocusTimes;      //!< \~english Timestamps of focus points \~chinese 目标点时间戳
+    arma::vec mDataTimes;       //!< \~english Timestamps of data points \~chinese 数据点时间戳
+    arma::uvec mTimeOrder;      //!< \~english Indices of data points in ascending order of time \~chinese 按时间升序排列的数据点索引
+    arma::vec mSortedTimes;     //!< \~english Timestamps of data points in ascending order \~chinese 升序排列的数据点时间戳
+    bool mComponentCache = true;    //!< \~english Whether spatial distances are cached \~chinese 是否缓存空间距离
+    std::shared_ptr<const arma::mat> mSpatialCache;    //!< \~english Cached spatial distances, one column for each focus point, shared by copies \~chinese 缓存的空间距离，每个目标点一列，由副本共享
 };
 
 }
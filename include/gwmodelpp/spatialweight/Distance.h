@@ -7,6 +7,7 @@
 #endif // ENABLE_CUDA
 
 #include <memory>
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <armadillo>
@@ -105,6 +106,16 @@ public:
      */
     virtual arma::vec distance(arma::uword focus) = 0;
 
+    /**
+     * @brief \~english Calculate distances for a block of focus points as a tile.
+     * The default implementation calls distance() for each focus point.
+     * \~chinese 为一组目标点计算距离块。默认实现对每个目标点调用 distance() 。
+     *
+     * @param focuses \~english Focused points' indices. Require each focus < total \~chinese 目标点索引，要求每个均小于参数中的 total
+     * @return arma::mat \~english Distances from all data points (rows) to the focused points (columns) \~chinese 所有数据点（行）到目标点（列）的距离矩阵
+     */
+    virtual arma::mat distanceBlock(const arma::uvec& focuses);
+
 #ifdef ENABLE_CUDA
 
     virtual bool useCuda() override { return mUseCuda; }
@@ -142,6 +153,10 @@ public:
      */
     virtual double minDistance() = 0;
 
+protected:
+    std::optional<double> mMaxDistance;  //!< \~english Cached maximum distance, reset when parameters change \~chinese 缓存的最大距离，参数改变时重置
+    std::optional<double> mMinDistance;  //!< \~english Cached minimum distance, reset when parameters change \~chinese 缓存的最小距离，参数改变时重置
+
 #ifdef ENABLE_CUDA
 protected:
     bool mUseCuda = false;  //<! \~english Whether to use CUDA \~chinese 是否使用 CUDA
@@ -108,6 +108,18 @@ public:
 public:
     virtual arma::vec distance(arma::uword focus) override;
 
+    /**
+     * @brief \~english Calculate distances for a block of focus points as a tile.
+     * Euclidean distances (p = 2) and geographical distances are calculated as CRSDistance::distanceBlock(),
+     * others are calculated for each focus point.
+     * \~chinese 为一组目标点计算距离块。
+     * 欧氏距离（ p = 2 ）和地理距离按 CRSDistance::distanceBlock() 计算，其他距离逐个目标点计算。
+     *
+     * @param focuses \~english Focused points' indices. Require each focus < total \~chinese 目标点索引，要求每个均小于参数中的 total
+     * @return arma::mat \~english Distances from all data points (rows) to the focused points (columns) \~chinese 所有数据点（行）到目标点（列）的距离矩阵
+     */
+    virtual arma::mat distanceBlock(const arma::uvec& focuses) override;
+
 private:
     double mPoly = 2.0;
     double mTheta = 0.0;
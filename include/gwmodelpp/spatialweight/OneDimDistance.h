@@ -104,7 +104,18 @@ public:
      */
     arma::vec noAbsdistance(arma::uword focus);
 
+    /**
+     * @brief Get maximum distance, which is found from the two ends of data points and cached until parameters change.
+     * 
+     * @return double Maximum distance.
+     */
     virtual double maxDistance() override;
+
+    /**
+     * @brief Get minimum distance, which is found by binary search in sorted data points and cached until parameters change.
+     * 
+     * @return double Minimum distance.
+     */
     virtual double minDistance() override;
 
 protected:
@@ -379,7 +379,91 @@ public:
      */
     virtual arma::vec weightVector(arma::uword focus)
     {
-        return mWeight->weight(mDistance->distance(focus));
+        arma::vec w;
+        weightVector(focus, w);
+        return w;
+    }
+
+    /**
+     * \~english
+     * @brief Calculate the spatial weight vector from focused sample to other samples into a buffer.
+     * Weights are calculated in place over distances.
+     * For CRSDistance, distances are written directly into the buffer,
+     * so no memory is allocated if the buffer already has the size of samples and the bandwidth is fixed.
+     * 
+     * @param focus Index of current sample.
+     * @param w [out] The spatial weight vector from focused sample to other samples.
+     * 
+     * \~chinese
+     * @brief 计算当前样本到其他样本的空间权重向量并写入缓冲区。
+     * 权重在距离上原地计算。
+     * 对于 CRSDistance ，距离直接写入缓冲区，因此当缓冲区大小已经等于样本数量且带宽固定时不分配内存。
+     * 
+     * @param focus 当前样本的索引值。
+     * @param w [out] 当前样本到其他所有样本的空间权重向量。
+     */
+    void weightVector(arma::uword focus, arma::vec& w)
+    {
+        if (mDistance->type() == Distance::DistanceType::CRSDistance)
+        {
+            static_cast<CRSDistance*>(mDistance)->distance(focus, w);
+        }
+        else w = mDistance->distance(focus);
+        mWeight->weightInPlace(w);
+    }
+
+    /**
+     * \~english
+     * @brief Calculate spatial weights from a block of focused samples to all samples.
+     * Distances are calculated as a tile by Distance::distanceBlock(), and weights are calculated in place column by column.
+     *
+     * @param focuses Indices of focused samples.
+     * @return mat Spatial weights from all samples (rows) to the focused samples (columns).
+     *
+     * \~chinese
+     * @brief 计算一组当前样本到所有样本的空间权重。
+     * 距离由 Distance::distanceBlock() 按块计算，权重逐列原地计算。
+     *
+     * @param focuses 当前样本的索引值。
+     * @return mat 所有样本（行）到当前样本（列）的空间权重矩阵。
+     */
+    arma::mat weightMatrix(const arma::uvec& focuses)
+    {
+        arma::mat w = mDistance->distanceBlock(focuses);
+        for (arma::uword j = 0; j < w.n_cols; j++)
+        {
+            arma::vec wj(w.colptr(j), w.n_rows, false, true);
+            mWeight->weightInPlace(wj);
+        }
+        return w;
+    }
+
+    static constexpr arma::uword MaxBlockSize = 64;             //!< \~english Maximum number of focused samples in a block for weightMatrix() \~chinese weightMatrix() 分块中当前样本的最大数量
+    static constexpr arma::uword MaxBlockElements = 1 << 20;    //!< \~english Maximum number of elements of a weight matrix given by weightMatrix() \~chinese weightMatrix() 给出的权重矩阵的最大元素数量
+
+    /**
+     * \~english
+     * @brief Get the number of focused samples in each block for weightMatrix().
+     * When focused samples are divided among threads, blocks are small enough to give every thread at least one block.
+     *
+     * @param nDp Number of samples, which are also the focused samples divided among threads.
+     * @param nThreads Number of threads, or 0 if focused samples are not divided among threads.
+     * @return arma::uword Number of focused samples in each block.
+     *
+     * \~chinese
+     * @brief 获取用于 weightMatrix() 的每个分块中当前样本的数量。
+     * 当前样本在线程间划分时，分块足够小，使每个线程至少分到一个分块。
+     *
+     * @param nDp 样本数量，也是在线程间划分的当前样本数量。
+     * @param nThreads 线程数，当前样本不在线程间划分时为 0 。
+     * @return arma::uword 每个分块中当前样本的数量。
+     */
+    static arma::uword BlockSize(arma::uword nDp, arma::uword nThreads = 0)
+    {
+        arma::uword size = MaxBlockSize;
+        if (nDp > 0 && MaxBlockElements / nDp < size) size = MaxBlockElements / nDp;
+        if (nThreads > 0 && nDp / nThreads < size) size = nDp / nThreads;
+        return size > 0 ? size : 1;
     }
 
 #ifdef ENABLE_CUDA
@@ -64,6 +64,16 @@ public:
      */
     virtual arma::vec weight(arma::vec dist) = 0;
 
+    /**
+     * @brief \~english Calculate weights in place, overwriting a distance vector. \~chinese 原地计算权重，覆盖距离向量。
+     * 
+     * @param dist \~english [in,out] Distance vector, overwritten by weights \~chinese [in,out] 距离向量，被权重覆盖
+     */
+    virtual void weightInPlace(arma::vec& dist)
+    {
+        dist = weight(dist);
+    }
+
 #ifdef ENABLE_CUDA
     bool useCuda() { return mUseCuda; }
 
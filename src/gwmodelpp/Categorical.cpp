@@ -0,0 +1,47 @@
+#include "Categorical.h"
+#include <unordered_map>
+
+using namespace std;
+using namespace arma;
+using namespace gwm;
+
+Categorical::Categorical(const vector<string> &values)
+{
+    uword n = values.size();
+    unordered_map<string, uword> lookup;
+    mCodes = uvec(n, fill::zeros);
+    for (uword i = 0; i < n; i++)
+    {
+        auto d = lookup.find(values[i]);
+        if (d == lookup.end())
+        {
+            d = lookup.insert(make_pair(values[i], mLevels.size())).first;
+            mLevels.push_back(values[i]);
+        }
+        mCodes(i) = d->second;
+    }
+    for (uword l = 0; l < mLevels.size(); l++)
+    {
+        mIndices.push_back(find(mCodes == l));
+    }
+}
+
+vec Categorical::counts() const
+{
+    vec n(mLevels.size(), fill::zeros);
+    for (uword l = 0; l < mLevels.size(); l++)
+    {
+        n(l) = double(mIndices[l].n_elem);
+    }
+    return n;
+}
+
+vector<string> Categorical::decode(const uvec &codes) const
+{
+    vector<string> values(codes.n_elem);
+    for (uword i = 0; i < codes.n_elem; i++)
+    {
+        values[i] = mLevels[codes(i)];
+    }
+    return values;
+}
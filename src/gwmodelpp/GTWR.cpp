@@ -11,6 +11,37 @@ using namespace std;
 using namespace arma;
 using namespace gwm;
 
+namespace
+{
+/// Number of values of each parameter in the coarse grid of joint selection.
+const uword JointGridSize = 5;
+/// Maximum number of compass search iterations of joint selection.
+const uword JointMaxIteration = 100;
+
+/// Cartesian product of candidate bandwidths, lambdas and angles, one row for each combination.
+mat jointGrid(const vec& bws, const vec& lambdas, const vec& angles)
+{
+    mat grid(bws.n_elem * lambdas.n_elem * angles.n_elem, 3);
+    uword r = 0;
+    for (uword i = 0; i < bws.n_elem; i++)
+        for (uword j = 0; j < lambdas.n_elem; j++)
+            for (uword k = 0; k < angles.n_elem; k++, r++)
+            {
+                grid(r, 0) = bws(i);
+                grid(r, 1) = lambdas(j);
+                grid(r, 2) = angles(k);
+            }
+    return grid;
+}
+
+/// Values at a center and one step on both sides, clipped to a range.
+vec jointNeighbours(double center, double step, double lower, double upper)
+{
+    if (step <= 0.0) return vec({ center });
+    return unique(clamp(vec({ center - step, center, center + step }), lower, upper));
+}
+}
+
 RegressionDiagnostic GTWR::CalcDiagnostic(const mat& x, const vec& y, const mat& betas, const vec& shat)
 {
     vec r = y - sum(betas % x, 1);
@@ -33,7 +64,16 @@ mat GTWR::fit()
     uword nDp = mCoords.n_rows, nVars = mX.n_cols;
     GWM_LOG_STOP_RETURN(mStatus, mat(nDp, nVars, arma::fill::zeros));
 
-    if (mIsAutoselectBandwidth)
+    if (mIsJointAutoselect)
+    {
+        GWM_LOG_STAGE("Bandwidth and lambda optimization")
+        BandwidthWeight *bw = mSpatialWeight.weight<BandwidthWeight>();
+        mStdistance = mSpatialWeight.distance<CRSSTDistance>();
+        JointAutoSelection(bw);
+        GWM_LOG_STOP_RETURN(mStatus, mat(nDp, nVars, arma::fill::zeros));
+    }
+
+    if (mIsAutoselectBandwidth && !mIsJointAutoselect)
     {
         GWM_LOG_STAGE("Bandwidth optimization")
         BandwidthWeight *bw0 = mSpatialWeight.weight<BandwidthWeight>();
@@ -51,7 +91,7 @@ mat GTWR::fit()
         GWM_LOG_STOP_RETURN(mStatus, mat(nDp, nVars, arma::fill::zeros));
     }
 
-    if (mIsAutoselectLambda)
+    if (mIsAutoselectLambda && !mIsJointAutoselect)
     {
         GWM_LOG_STAGE("Lambda optimization")
         BandwidthWeight *bw = mSpatialWeight.weight<BandwidthWeight>();
@@ -96,6 +136,21 @@ mat GTWR::predict(const mat& locations)
     return mBetas;
 }
 
+mat GTWR::predict(const mat& locations, const vec& times)
+{
+    if (locations.n_rows != times.n_rows)
+    {
+        throw std::runtime_error("Rows of locations and times are not equal.");
+    }
+    if (mSpatialWeight.distance()->type() != Distance::DistanceType::CRSSTDistance)
+    {
+        throw std::runtime_error("[GTWR::predict] Timestamps can only be used with CRSSTDistance.");
+    }
+    mSpatialWeight.distance()->makeParameter({ locations, mCoords, times, vTimes });
+    mBetas = (this->*mPredictFunction)(locations, mX, mY);
+    return mBetas;
+}
+
 void GTWR::createPredictionDistanceParameter(const arma::mat& locations)
 {
     if (mSpatialWeight.distance()->type() == Distance::DistanceType::CRSSTDistance)
@@ -115,26 +170,26 @@ void GTWR::createDistanceParameter()
 
 mat GTWR::predictSerial(const mat& locations, const mat& x, const vec& y)
 {
-    uword nRp = locations.n_rows, nVar = x.n_cols;
+    uword nRp = locations.n_rows, nDp = x.n_rows, nVar = x.n_cols;
+    uword nBlock = SpatialWeight::BlockSize(nDp);
+    uvec order = SpatialOrder(locations);
+    mat products = CrossProducts(x, y);
     mat betas(nVar, nRp, fill::zeros);
-    for (uword i = 0; i < nRp; i++)
+    for (uword begin = 0; begin < nRp; begin += nBlock)
     {
         GWM_LOG_STOP_BREAK(mStatus);
-        vec w = mSpatialWeight.weightVector(i);
-        mat xtw = trans(x.each_col() % w);
-        mat xtwx = xtw * x;
-        mat xtwy = xtw * y;
+        uvec block = order.subvec(begin, std::min(begin + nBlock, nRp) - 1);
+        mat weights = mSpatialWeight.weightMatrix(block);
         try
         {
-            mat xtwx_inv = inv_sympd(xtwx);
-            betas.col(i) = xtwx_inv * xtwy;
+            betas.cols(block) = BlockBetas(products, weights, nVar);
         }
         catch (const exception& e)
         {
             GWM_LOG_ERROR(e.what());
             throw e;
         }
-        GWM_LOG_PROGRESS(i + 1, nRp);
+        GWM_LOG_PROGRESS(begin + block.n_elem, nRp);
     }
     return betas.t();
 }
@@ -264,6 +319,37 @@ void GTWR::setBandwidthSelectionCriterion(const BandwidthSelectionCriterionType&
     mBandwidthSelectionCriterionFunction = mapper[mBandwidthSelectionCriterion];
 }
 
+void GTWR::saveModel(ModelArchive& archive) const
+{
+    GWRBase::saveModel(archive);
+    archive.setModel("GTWR");
+    archive.set("times", vTimes);
+    archive.set("betasSE", mBetasSE);
+    archive.set("sHat", mSHat);
+    archive.set("qDiag", mQDiag);
+    archive.set("hasHatMatrix", mHasHatMatrix ? 1.0 : 0.0);
+    if (!mS.is_empty())
+    {
+        archive.set("s", mS);
+    }
+}
+
+void GTWR::loadModel(const ModelArchive& archive)
+{
+    if (archive.model() != "GTWR")
+    {
+        throw std::runtime_error("[GTWR::loadModel] The archive is saved from model " + archive.model() + ".");
+    }
+    GWRBase::loadModel(archive);
+    vTimes = archive.get("times");
+    mBetasSE = archive.get("betasSE");
+    mSHat = archive.get("sHat");
+    mQDiag = archive.get("qDiag");
+    mHasHatMatrix = archive.scalar("hasHatMatrix") != 0.0;
+    mS = archive.contains("s") ? archive.get("s") : mat();
+    mStdistance = mSpatialWeight.distance<CRSSTDistance>();
+}
+
 bool GTWR::isValid()
 {
     if (GWRBase::isValid())
@@ -282,24 +368,25 @@ bool GTWR::isValid()
 #ifdef ENABLE_OPENMP
 mat GTWR::predictOmp(const mat& locations, const mat& x, const vec& y)
 {
-    uword nRp = locations.n_rows, nVar = x.n_cols;
+    uword nRp = locations.n_rows, nDp = x.n_rows, nVar = x.n_cols;
+    uword nBlock = SpatialWeight::BlockSize(nDp), nBlocks = (nRp + nBlock - 1) / nBlock;
+    uvec order = SpatialOrder(locations);
+    mat products = CrossProducts(x, y);
     mat betas(nVar, nRp, arma::fill::zeros);
     bool success = true;
     std::exception except;
 #pragma omp parallel for num_threads(mOmpThreadNum)
-    for (int i = 0; (uword)i < nRp; i++)
+    for (int b = 0; (uword)b < nBlocks; b++)
     {
         GWM_LOG_STOP_CONTINUE(mStatus);
+        uword begin = b * nBlock;
+        uvec block = order.subvec(begin, std::min(begin + nBlock, nRp) - 1);
         if (success)
         {
-            vec w = mSpatialWeight.weightVector(i);
-            mat xtw = trans(x.each_col() % w);
-            mat xtwx = xtw * x;
-            mat xtwy = xtw * y;
+            mat weights = mSpatialWeight.weightMatrix(block);
             try
             {
-                mat xtwx_inv = inv_sympd(xtwx);
-                betas.col(i) = xtwx_inv * xtwy;
+                betas.cols(block) = BlockBetas(products, weights, nVar);
             }
             catch (const exception& e)
             {
@@ -308,7 +395,7 @@ mat GTWR::predictOmp(const mat& locations, const mat& x, const vec& y)
                 success = false;
             }
         }
-        GWM_LOG_PROGRESS(i + 1, nRp);
+        GWM_LOG_PROGRESS(begin + block.n_elem, nRp);
     }
     if (!success)
     {
@@ -477,16 +564,19 @@ void GTWR::setParallelType(const ParallelType& type)
         case ParallelType::SerialOnly:
             mPredictFunction = &GTWR::predictSerial;
             mFitFunction = &GTWR::fitSerial;
+            mJointCriterionFunction = &GTWR::jointCriterionSerial;
             break;
 #ifdef ENABLE_OPENMP
         case ParallelType::OpenMP:
             mPredictFunction = &GTWR::predictOmp;
             mFitFunction = &GTWR::fitOmp;
+            mJointCriterionFunction = &GTWR::jointCriterionOmp;
             break;
 #endif
         default:
             mPredictFunction = &GTWR::predictSerial;
             mFitFunction = &GTWR::fitSerial;
+            mJointCriterionFunction = &GTWR::jointCriterionSerial;
             break;
         }
         setBandwidthSelectionCriterion(mBandwidthSelectionCriterion);
@@ -500,7 +590,6 @@ Status GTWR::RsquareByLambda(BandwidthWeight* bandwidthWeight, double lambda, do
     uword nDp = mCoords.n_rows, nVar = mX.n_cols;
     mat betas(nVar, nDp, fill::zeros);
     mStdistance->setLambda(lambda);
-    mStdistance->makeParameter({ mCoords, mCoords, vTimes, vTimes });
     for (uword i = 0; i < nDp; i++)
     {
         GWM_LOG_STOP_BREAK(mStatus);
@@ -605,6 +694,168 @@ double GTWR::LambdaAutoSelection(BandwidthWeight* bw)
     else return 0.0;
 }
 
+void GTWR::JointAutoSelection(BandwidthWeight* bw)
+{
+    uword nDp = mCoords.n_rows;
+    bool adaptive = bw->adaptive();
+    double bwLower = adaptive ? 20 : 0.0;
+    double bwUpper = adaptive ? nDp : mStdistance->boundDistance();
+    double angleUpper = mIsAutoselectAngle ? datum::pi / 2.0 - 1e-6 : mStdistance->angle();
+    double angleLower = mIsAutoselectAngle ? 0.0 : mStdistance->angle();
+    vec lower = { bwLower, 0.0, angleLower }, upper = { bwUpper, 1.0, angleUpper };
+    vec tol = { adaptive ? 1.0 : 1e-4 * (bwUpper - bwLower), 1e-3, 1e-3 };
+
+    // Coarse grid
+    vec bws = linspace(bwLower, bwUpper, JointGridSize);
+    if (adaptive) bws = round(bws);
+    vec angles = mIsAutoselectAngle ? linspace(angleLower, angleUpper, JointGridSize) : vec({ angleLower });
+    mat candidates = jointGrid(bws, linspace(0.0, 1.0, JointGridSize), angles);
+    vec criterion = (this->*mJointCriterionFunction)(candidates, bw);
+    GWM_LOG_STOP_RETURN(mStatus, void());
+    uword best = index_min(criterion);
+    rowvec opt = candidates.row(best);
+    double optCriterion = criterion(best);
+    GWM_LOG_INFO(infoLambdaCriterion(opt(1), optCriterion));
+
+    // Compass search around the best candidate
+    vec step = (upper - lower) / double(JointGridSize - 1);
+    if (adaptive) step(0) = floor(step(0));
+    for (uword iter = 0; iter < JointMaxIteration && any(step >= tol); iter++)
+    {
+        mat neighbours = jointGrid(
+            jointNeighbours(opt(0), step(0) >= tol(0) ? step(0) : 0.0, lower(0), upper(0)),
+            jointNeighbours(opt(1), step(1) >= tol(1) ? step(1) : 0.0, lower(1), upper(1)),
+            jointNeighbours(opt(2), step(2) >= tol(2) ? step(2) : 0.0, lower(2), upper(2))
+        );
+        uvec others = find(sum(abs(neighbours.each_row() - opt), 1) > 0.0);
+        if (others.n_elem > 0)
+        {
+            neighbours = neighbours.rows(others);
+            criterion = (this->*mJointCriterionFunction)(neighbours, bw);
+            GWM_LOG_STOP_RETURN(mStatus, void());
+            best = index_min(criterion);
+        }
+        if (others.n_elem > 0 && criterion(best) < optCriterion)
+        {
+            opt = neighbours.row(best);
+            optCriterion = criterion(best);
+            GWM_LOG_INFO(infoLambdaCriterion(opt(1), optCriterion));
+        }
+        else
+        {
+            step /= 2.0;
+            if (adaptive) step(0) = floor(step(0));
+        }
+    }
+
+    if (optCriterion < DBL_MAX)
+    {
+        bw->setBandwidth(opt(0));
+        mStdistance->setLambda(opt(1));
+        if (mIsAutoselectAngle) mStdistance->setAngle(opt(2));
+    }
+}
+
+arma::vec GTWR::jointCriterionValue(const mat& acc, const uvec& failed)
+{
+    uword nCand = acc.n_rows;
+    double n = double(mCoords.n_rows);
+    vec criterion(nCand);
+    for (uword c = 0; c < nCand; c++)
+    {
+        double value = mBandwidthSelectionCriterion == BandwidthSelectionCriterionType::CV ? acc(c, 0) : GWRBase::AICc(acc(c, 0), n, acc(c, 1));
+        criterion(c) = (failed(c) == 0 && isfinite(value)) ? value : DBL_MAX;
+    }
+    return criterion;
+}
+
+void GTWR::jointCriterionFocus(uword focus, const vec& sdist, const vec& tdist, const mat& candidates, vector<BandwidthWeight>& weights, mat& acc, uvec& failed)
+{
+    bool cv = mBandwidthSelectionCriterion == BandwidthSelectionCriterionType::CV;
+    for (uword c = 0; c < candidates.n_rows; c++)
+    {
+        if (failed(c)) continue;
+        vec w = CRSSTDistance::CombineSTDistance(sdist, tdist, candidates(c, 1), CRSSTDistance::CrossCoefficient(candidates(c, 2)));
+        weights[c].weightInPlace(w);
+        if (cv) w(focus) = 0.0;
+        mat xtw = trans(mX.each_col() % w);
+        mat xtwx = xtw * mX;
+        vec xtwy = xtw * mY;
+        mat xtwx_inv;
+        if (!inv_sympd(xtwx_inv, xtwx))
+        {
+            failed(c) = 1;
+            continue;
+        }
+        vec beta = xtwx_inv * xtwy;
+        double res = mY(focus) - as_scalar(mX.row(focus) * beta);
+        acc(c, 0) += res * res;
+        if (!cv)
+        {
+            rowvec si = mX.row(focus) * xtwx_inv * xtw;
+            acc(c, 1) += si(focus);
+            acc(c, 2) += dot(si, si);
+        }
+    }
+}
+
+arma::vec GTWR::jointCriterionSerial(const mat& candidates, const BandwidthWeight* bandwidthWeight)
+{
+    uword nDp = mCoords.n_rows, nCand = candidates.n_rows;
+    vector<BandwidthWeight> weights;
+    for (uword c = 0; c < nCand; c++)
+    {
+        weights.emplace_back(candidates(c, 0), bandwidthWeight->adaptive(), bandwidthWeight->kernel());
+    }
+    mat acc(nCand, 3, fill::zeros);
+    uvec failed(nCand, fill::zeros);
+    vec sdist, tdist;
+    for (uword i = 0; i < nDp; i++)
+    {
+        GWM_LOG_STOP_BREAK(mStatus);
+        mStdistance->componentDistance(i, sdist, tdist);
+        jointCriterionFocus(i, sdist, tdist, candidates, weights, acc, failed);
+    }
+    return jointCriterionValue(acc, failed);
+}
+
+#ifdef ENABLE_OPENMP
+arma::vec GTWR::jointCriterionOmp(const mat& candidates, const BandwidthWeight* bandwidthWeight)
+{
+    uword nDp = mCoords.n_rows, nCand = candidates.n_rows;
+    cube acc_all(nCand, 3, mOmpThreadNum, fill::zeros);
+    umat failed_all(nCand, mOmpThreadNum, fill::zeros);
+#pragma omp parallel num_threads(mOmpThreadNum)
+    {
+        int thread = omp_get_thread_num();
+        vector<BandwidthWeight> weights;
+        for (uword c = 0; c < nCand; c++)
+        {
+            weights.emplace_back(candidates(c, 0), bandwidthWeight->adaptive(), bandwidthWeight->kernel());
+        }
+        mat acc(nCand, 3, fill::zeros);
+        uvec failed(nCand, fill::zeros);
+        vec sdist, tdist;
+#pragma omp for
+        for (int i = 0; (uword)i < nDp; i++)
+        {
+            GWM_LOG_STOP_CONTINUE(mStatus);
+            mStdistance->componentDistance(i, sdist, tdist);
+            jointCriterionFocus(i, sdist, tdist, candidates, weights, acc, failed);
+        }
+        acc_all.slice(thread) = acc;
+        failed_all.col(thread) = failed;
+    }
+    mat acc(nCand, 3, fill::zeros);
+    for (int t = 0; t < mOmpThreadNum; t++)
+    {
+        acc += acc_all.slice(t);
+    }
+    uvec failed = max(failed_all, 1);
+    return jointCriterionValue(acc, failed);
+}
+#endif
+
 // void GTWR::LambdaBwAutoSelection()
 // {
 
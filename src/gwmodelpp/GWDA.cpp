@@ -45,15 +45,7 @@ void GWDA::run()
     }
     (this->*mDiscriminantAnalysisFunction)();
     uword NV = mRes.n_cols;
-    vec correct(mY.size(), fill::zeros);
-    for (uword i = 0; i < mGroup.size(); i++)
-    {
-        if (mGroup[i] == mY[i])
-        {
-            correct[i] = 1;
-        }
-    }
-    uvec correctCount = find(correct == 1);
+    uvec correctCount = find(mGroupCode == mYCategory.codes());
     mCorrectRate = (double)correctCount.n_rows / nRp;
     mat tmp = mRes.cols(0, NV - 1);
     for (uword i = 0; i < NV - 1; i++)
@@ -94,23 +86,18 @@ double GWDA::shannonEntropy(arma::vec &p)
 void GWDA::discriminantAnalysisSerial()
 {
     uword nRp = mCoords.n_rows;
-    // uword nVar = mX.n_cols;//nPr = mprX.n_rows;
-    vector<string> lev = levels(mY);
-    mat wt(nRp, nRp, fill::zeros);
+    ClassSamples samples = groupSamples(mX, mYCategory);
+    uword m = samples.category.nLevels();
+    mat logPf(nRp, m, fill::zeros), classWeights(nRp, m, fill::zeros);
     for (uword i = 0; i < nRp; i++)
     {
-        // vec w=mSpatialWeight.weightVector(i);
-        wt.col(i) = mSpatialWeight.weightVector(i);
-    }
-    if (!mHasPredict) wt.diag().zeros();
-    if (mIsWqda)
-    {
-        mRes = wqda(mX, mY, wt, mprX, mHascov, mHasmean, mHasprior);
-    }
-    else
-    {
-        mRes = wlda(mX, mY, wt, mprX, mHascov, mHasmean, mHasprior);
+        vec w = mSpatialWeight.weightVector(i);
+        if (!mHasPredict) w(i) = 0.0;
+        rowvec wsum;
+        logPf.row(i) = localDiscriminant(samples, w, mprX.row(i), mIsWqda, mHascov, mHasmean, wsum);
+        classWeights.row(i) = wsum;
     }
+    mRes = classify(logPf, classWeights, samples, mHasprior);
 }
 
 #ifdef ENABLE_OPENMP
@@ -118,24 +105,112 @@ void GWDA::discriminantAnalysisSerial()
 void GWDA::discriminantAnalysisOmp()
 {
     uword nRp = mCoords.n_rows;
-    // uword nVar = mX.n_cols;//nPr = mprX.n_rows;
-    vector<string> lev = levels(mY);
-    mat wt(nRp, nRp, fill::zeros);
+    ClassSamples samples = groupSamples(mX, mYCategory);
+    uword m = samples.category.nLevels();
+    mat logPf(nRp, m, fill::zeros), classWeights(nRp, m, fill::zeros);
 #pragma omp parallel for num_threads(mOmpThreadNum)
     for (int i = 0; (uword)i < nRp; i++)
     {
-        wt.col(i) = mSpatialWeight.weightVector(i);
+        vec w = mSpatialWeight.weightVector(i);
+        if (!mHasPredict) w(i) = 0.0;
+        rowvec wsum;
+        logPf.row(i) = localDiscriminant(samples, w, mprX.row(i), mIsWqda, mHascov, mHasmean, wsum);
+        classWeights.row(i) = wsum;
     }
-    if (mIsWqda)
+    mRes = classify(logPf, classWeights, samples, mHasprior);
+}
+#endif
+
+GWDA::ClassSamples GWDA::groupSamples(const arma::mat &x, const Categorical &y)
+{
+    ClassSamples samples;
+    samples.category = y;
+    uword m = y.nLevels(), nVar = x.n_cols;
+    samples.center = mat(m, nVar, fill::zeros);
+    samples.cov = cube(nVar, nVar, m, fill::zeros);
+    samples.count = y.counts();
+    for (uword i = 0; i < m; i++)
     {
-        mRes = wqda(mX, mY, wt, mprX, mHascov, mHasmean, mHasprior);
+        mat xi = x.rows(y.indices(i));
+        samples.center.row(i) = mean(xi, 0);
+        samples.cov.slice(i) = arma::cov(xi);
+        samples.shifted.push_back(xi.each_row() - samples.center.row(i));
+    }
+    return samples;
+}
+
+arma::rowvec GWDA::mahalanobis(const arma::mat &sigma, const arma::mat &dx)
+{
+    mat L;
+    if (chol(L, sigma, "lower"))
+    {
+        mat z = solve(trimatl(L), dx);
+        return sum(z % z, 0);
     }
     else
     {
-        mRes = wlda(mX, mY, wt, mprX, mHascov, mHasmean, mHasprior);
+        return sum(dx % solve(sigma, dx), 0);
     }
 }
-#endif
+
+arma::rowvec GWDA::localDiscriminant(const ClassSamples &samples, const arma::vec &w, const arma::rowvec &xpr, bool isWqda, bool hasCov, bool hasMean, arma::rowvec &classWeights)
+{
+    uword m = samples.category.nLevels(), nVar = samples.center.n_cols;
+    classWeights = rowvec(m, fill::zeros);
+    mat dx(nVar, m, fill::zeros);
+    cube localCov(nVar, nVar, m, fill::zeros);
+    for (uword i = 0; i < m; i++)
+    {
+        // Moments are taken on samples shifted by the class mean, so that the one-pass formula keeps its precision.
+        const mat &xs = samples.shifted[i];
+        vec wi = w.elem(samples.category.indices(i));
+        double sumw = sum(wi);
+        vec wn = wi / sumw;
+        rowvec d = wn.t() * xs;
+        rowvec meani = hasMean ? rowvec(samples.center.row(i) + d) : rowvec(samples.center.row(i));
+        classWeights(i) = sumw;
+        dx.col(i) = (xpr - meani).t();
+        localCov.slice(i) = hasCov ? mat((xs.t() * (xs.each_col() % wn) - d.t() * d) / (1 - sum(wn % wn))) : mat(samples.cov.slice(i));
+    }
+    rowvec logPf(m, fill::zeros);
+    if (isWqda)
+    {
+        for (uword i = 0; i < m; i++)
+        {
+            const mat &covmat = localCov.slice(i);
+            logPf(i) = (m / 2) * log(norm(covmat)) + 0.5 * as_scalar(mahalanobis(covmat, dx.col(i)));
+        }
+    }
+    else
+    {
+        mat sigma = mat(nVar, nVar, fill::zeros);
+        for (uword i = 0; i < m; i++)
+        {
+            sigma += samples.count(i) * localCov.slice(i);
+        }
+        sigma /= sum(samples.count);
+        logPf = (m / 2) * log(norm(sigma)) + 0.5 * mahalanobis(sigma, dx);
+    }
+    return logPf;
+}
+
+arma::mat GWDA::classify(const arma::mat &logPf, const arma::mat &classWeights, const ClassSamples &samples, bool hasPrior)
+{
+    uword nPr = logPf.n_rows;
+    mat prior;
+    if (hasPrior)
+    {
+        prior = classWeights / accu(classWeights);
+    }
+    else
+    {
+        prior = repmat(samples.count.t(), nPr, 1) / (sum(samples.count) * nPr);
+    }
+    mat res = logPf - log(prior);
+    mGroupCode = index_min(res, 1);
+    mGroup = samples.category.decode(mGroupCode);
+    return res;
+}
 
 uvec GWDA::findSameString(std::vector<std::string> &y, std::string s)
 {
@@ -161,7 +236,7 @@ vector<mat> GWDA::splitX(arma::mat &x, std::vector<std::string> &y)
 }
 
 // template<class T>
-vector<string> GWDA::levels(vector<std::string> &y)
+vector<string> GWDA::levels(const vector<std::string> &y)
 {
     uword n = y.size();
     vector<string> lev;
@@ -219,180 +294,31 @@ mat GWDA::covwtmat(const arma::mat &x, const arma::vec &wt)
 // template<class T>
 mat GWDA::wqda(arma::mat &x, std::vector<std::string> &y, arma::mat &wt, arma::mat &xpr, bool hasCOv, bool hasMean, bool hasPrior)
 {
-    vector<string> lev = levels(y);
-    uword m = lev.size();
-    // uword nDp = x.n_rows;
-    uword nPr = xpr.n_rows;
-    mat wtOnes;
-    // wtOnes.ones(nDp, nPr);
-    vector<mat> xg = splitX(x, y);
-    vector<vec> prior;
-    mat wti; //(nDp, nPr, fill::zeros);
-    vector<mat> localMean;
-    vector<cube> sigmagw;
-    double sumW;
-    for (uword i = 0; i < m; i++)
-    {
-        mat xi = xg[i];
-        /*vector<uword> idx;
-        // uword index = 0;
-        for (uword j = 0; j < y.size(); j++)
-        {
-            if (y[j] == lev[i])
-            {
-                idx.push_back(j);
-            }
-        }*/
-        if (hasMean)
-        {
-            /*for (uword j = 0; j < idx.size(); j++)
-            {
-                wti.row(idx[j]) = mSpatialWeight.weightVector(j);
-            }*/
-            wti = wt.rows(findSameString(y, lev[i]));
-        }
-        else
-        {
-            wti = wtOnes.rows(findSameString(y, lev[i]));
-        }
-        localMean.push_back(wMean(xi, wti));
-        if (hasCOv)
-        {
-            wti = wt.rows(findSameString(y, lev[i]));
-        }
-        else
-        {
-            wti = wtOnes.rows(findSameString(y, lev[i]));
-        }
-        sigmagw.push_back(wVarCov(xi, wti));
-        if (hasPrior)
-        {
-            wti = wt.rows(findSameString(y, lev[i]));
-            sumW = accu(wt);
-        }
-        else
-        {
-            wti = wtOnes.rows(findSameString(y, lev[i]));
-            sumW = accu(wtOnes);
-        }
-        prior.push_back(wPrior(wti, sumW));
-    }
-    mat logPf = mat(nPr, m, fill::zeros);
-    for (uword i = 0; i < m; i++)
+    ClassSamples samples = groupSamples(x, Categorical(y));
+    uword m = samples.category.nLevels(), nPr = xpr.n_rows;
+    mat logPf(nPr, m, fill::zeros), classWeights(nPr, m, fill::zeros);
+    for (uword j = 0; j < nPr; j++)
     {
-        for (uword j = 0; j < nPr; j++)
-        {
-            vec xprj = xpr.row(j).t();
-            vec meani = localMean[i].row(j).t();
-            mat covmatj = sigmagw[i].row(j);
-            vec x1 = 0.5 * (xprj - meani).t() * solve(covmatj, (xprj - meani)); // inv(covmatj) * (xprj - meani);
-            logPf(j, i) = (m / 2) * log(norm(covmatj)) + x1(0) - log(prior[i].at(j));
-        }
-    }
-    vector<string> groupPr;
-    for (uword i = 0; i < nPr; i++)
-    {
-        uword index = index_min(logPf.row(i));
-        groupPr.push_back((lev[index]));
+        rowvec wsum;
+        logPf.row(j) = localDiscriminant(samples, wt.col(j), xpr.row(j), true, hasCOv, hasMean, wsum);
+        classWeights.row(j) = wsum;
     }
-    mGroup = groupPr;
-    return logPf;
+    return classify(logPf, classWeights, samples, hasPrior);
 }
 
 // template<class T>
 mat GWDA::wlda(arma::mat &x, std::vector<std::string> &y, arma::mat &wt, arma::mat &xpr, bool hasCOv, bool hasMean, bool hasPrior)
 {
-    vector<string> lev = levels(y);
-    uword m = lev.size();
-    uword nDp = x.n_rows;
-    uword nPr = xpr.n_rows;
-    uword nVar = x.n_cols;
-    mat wtOnes;
-    wtOnes.ones(nDp, nPr);
-    vector<mat> xg = splitX(x, y);
-    vector<vec> prior;
-    mat wti(nDp, nPr, fill::zeros);
-    vector<mat> localMean;
-    vector<cube> sigmagw;
-    double sumW;
-    for (uword i = 0; i < m; i++)
+    ClassSamples samples = groupSamples(x, Categorical(y));
+    uword m = samples.category.nLevels(), nPr = xpr.n_rows;
+    mat logPf(nPr, m, fill::zeros), classWeights(nPr, m, fill::zeros);
+    for (uword j = 0; j < nPr; j++)
     {
-        mat xi = xg[i];
-        /*vector<uword> idx;
-        // uword index = 0;
-        for (uword j = 0; j < y.size(); j++)
-        {
-            if (y[j] == lev[i])
-            {
-                idx.push_back(j);
-            }
-        }*/
-        if (hasMean)
-        {
-            wti = wt.rows(findSameString(y, lev[i]));
-        }
-        else
-        {
-            wti = wtOnes.rows(findSameString(y, lev[i]));
-        }
-        localMean.push_back(wMean(xi, wti));
-        if (hasCOv)
-        {
-            wti = wt.rows(findSameString(y, lev[i]));
-        }
-        else
-        {
-            wti = wtOnes.rows(findSameString(y, lev[i]));
-        }
-        sigmagw.push_back(wVarCov(xi, wti));
-        if (hasPrior)
-        {
-            wti = wt.rows(findSameString(y, lev[i]));
-            sumW = accu(wt);
-        }
-        else
-        {
-            wti = wtOnes.rows(findSameString(y, lev[i]));
-            sumW = accu(wtOnes);
-        }
-        prior.push_back(wPrior(wti, sumW));
-    }
-    cube sigma1gw(nPr, nVar, nVar, fill::zeros);
-    unordered_map<string, uword> counts = ytable(y);
-    for (uword i = 0; i < nPr; i++)
-    {
-        mat sigmai(nVar, nVar, fill::zeros);
-        double yisum = 0;
-        for (uword j = 0; j < m; j++)
-        {
-            double yi = counts[lev[j]];
-            mat x1 = sigmagw[j].row(i);
-            sigmai = sigmai + yi * x1;
-            yisum += yi;
-        }
-        sigma1gw.row(i) = sigmai / yisum;
+        rowvec wsum;
+        logPf.row(j) = localDiscriminant(samples, wt.col(j), xpr.row(j), false, hasCOv, hasMean, wsum);
+        classWeights.row(j) = wsum;
     }
-
-    mat logPf = mat(nPr, m, fill::zeros);
-    for (uword i = 0; i < m; i++)
-    {
-        for (uword j = 0; j < nPr; j++)
-        {
-            vec xprj = xpr.row(j).t();
-            vec meani = localMean[i].row(j).t();
-            mat covmatj = sigma1gw.row(j);
-            vec x1 = 0.5 * (xprj - meani).t() * solve(covmatj, (xprj - meani));
-            logPf(j, i) = (m / 2) * log(norm(covmatj)) + x1(0) - log(prior[i].at(j));
-        }
-    }
-    vector<string> groupPr;
-    for (uword i = 0; i < nPr; i++)
-    {
-        uword index = index_min(logPf.row(i));
-        groupPr.push_back((lev[index]));
-    }
-    mGroup = groupPr;
-    return logPf;
+    return classify(logPf, classWeights, samples, hasPrior);
 }
 
 // template<class T>
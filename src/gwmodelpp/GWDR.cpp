@@ -1,4 +1,5 @@
 #include "GWDR.h"
+#include "GWRBase.h"
 #include <assert.h>
 #include <exception>
 #include <gsl/gsl_vector.h>
@@ -14,6 +15,44 @@ using namespace std;
 using namespace arma;
 using namespace gwm;
 
+namespace
+{
+/// Maximum number of points in the coarse grid of LBFGSB optimizer.
+const uword LbfgsbGridSize = 64;
+/// Number of corrections kept by LBFGSB optimizer.
+const size_t LbfgsbMemory = 5;
+/// Number of trial steps evaluated together in each pass of line search.
+const uword LbfgsbLineSearchTrials = 4;
+/// Maximum number of passes of line search.
+const uword LbfgsbLineSearchPasses = 3;
+/// Relative step of forward differences.
+const double LbfgsbDiffStep = 1e-3;
+/// Sufficient decrease coefficient of line search.
+const double LbfgsbArmijo = 1e-4;
+
+/// Get the most frequent value of each column, which shares cached weights with the most candidates.
+rowvec mostFrequentRow(const mat& candidates)
+{
+    rowvec row(candidates.n_cols);
+    for (uword m = 0; m < candidates.n_cols; m++)
+    {
+        vec values = unique(candidates.col(m));
+        uword best = 0, count = 0;
+        for (uword k = 0; k < values.n_elem; k++)
+        {
+            uword n = accu(candidates.col(m) == values(k));
+            if (n > count)
+            {
+                best = k;
+                count = n;
+            }
+        }
+        row(m) = values(best);
+    }
+    return row;
+}
+}
+
 RegressionDiagnostic GWDR::CalcDiagnostic(const mat& x, const vec& y, const mat& betas, const vec& shat)
 {
     vec r = y - sum(betas % x, 1);
@@ -40,6 +79,7 @@ mat GWDR::fit()
     {
         mSpatialWeights[m].distance()->makeParameter({ vec(mCoords.col(m)), vec(mCoords.col(m)) });
     }
+    prepareWeightCache();
 
     // Select Independent Variable
     if (mEnableIndepVarSelect)
@@ -67,8 +107,10 @@ mat GWDR::fit()
     if (mEnableBandwidthOptimize)
     {
         GWM_LOG_STAGE("Bandwidth selection");
-        for (auto&& sw : mSpatialWeights)
+        vec lowers(nDims), uppers(nDims);
+        for (size_t m = 0; m < nDims; m++)
         {
+            SpatialWeight& sw = mSpatialWeights[m];
             BandwidthWeight* bw = sw.weight<BandwidthWeight>();
             // Set Initial value
             double lower = bw->adaptive() ? nVars + 1 : sw.distance()->minDistance();
@@ -77,6 +119,8 @@ mat GWDR::fit()
             {
                 bw->setBandwidth(upper * 0.618);
             }
+            lowers(m) = lower;
+            uppers(m) = upper;
         }
         vector<BandwidthWeight*> bws;
         for (auto&& iter : mSpatialWeights)
@@ -86,7 +130,9 @@ mat GWDR::fit()
         
         GWM_LOG_INFO(GWDRBandwidthOptimizer::infoBandwidthCriterion(bws));
         GWDRBandwidthOptimizer optimizer(bws);
-        int resultCode = optimizer.optimize(this, mCoords.n_rows, mBandwidthOptimizeMaxIter, mBandwidthOptimizeEps, mBandwidthOptimizeStep);
+        int resultCode = mBandwidthOptimizerType == BandwidthOptimizerType::LBFGSB ?
+            optimizer.optimizeLbfgsb(this, lowers, uppers, mBandwidthOptimizeMaxIter, mBandwidthOptimizeEps) :
+            optimizer.optimize(this, mCoords.n_rows, mBandwidthOptimizeMaxIter, mBandwidthOptimizeEps, mBandwidthOptimizeStep);
         GWM_LOG_STOP_RETURN(mStatus, mat(nDp, nVars, arma::fill::zeros));
         
         if (resultCode)
@@ -127,19 +173,49 @@ mat GWDR::fit()
     return mBetas;
 }
 
+mat GWDR::predict(const mat& locations)
+{
+    GWM_LOG_STAGE("Initialization");
+    uword nDims = mCoords.n_cols, nRp = locations.n_rows, nVars = mX.n_cols;
+    if (locations.n_cols != nDims)
+    {
+        throw std::runtime_error("[GWDR::predict] Locations and coordinates have different dimensions.");
+    }
+    for (size_t m = 0; m < nDims; m++)
+    {
+        mSpatialWeights[m].distance()->makeParameter({ vec(locations.col(m)), vec(mCoords.col(m)) });
+    }
+    GWM_LOG_STOP_RETURN(mStatus, mat(nRp, nVars, arma::fill::zeros));
+
+    GWM_LOG_STAGE("Prediction");
+    mBetas = (this->*mPredictFunction)(locations, mX, mY);
+    GWM_LOG_STOP_RETURN(mStatus, mat(nRp, nVars, arma::fill::zeros));
+    return mBetas;
+}
+
+vec GWDR::predictWeight(uword focus, const vector<BandwidthWeight*>& bandwidths)
+{
+    vec w(mCoords.n_rows, arma::fill::ones);
+    for (uword m = 0; m < bandwidths.size(); m++)
+    {
+        w = w % bandwidths[m]->weight(mSpatialWeights[m].distance()->distance(focus));
+    }
+    return w;
+}
+
 mat GWDR::predictSerial(const mat& locations, const mat& x, const vec& y)
 {
     uword nDp = locations.n_rows, nVar = mX.n_cols;
     mat betas(nVar, nDp, arma::fill::zeros);
+    vector<BandwidthWeight*> bandwidths;
+    for (auto&& sw : mSpatialWeights)
+    {
+        bandwidths.push_back(sw.weight<BandwidthWeight>());
+    }
     for (size_t i = 0; i < nDp; i++)
     {
         GWM_LOG_STOP_BREAK(mStatus);
-        vec w(nDp, arma::fill::ones);
-        for (auto&& sw : mSpatialWeights)
-        {
-            vec w_m = sw.weightVector(i);
-            w = w % w_m;
-        }
+        vec w = predictWeight(i, bandwidths);
         mat ws(1, nVar, arma::fill::ones);
         mat xtw = (x %(w * ws)).t();
         mat xtwx = xtw * x;
@@ -164,6 +240,11 @@ mat GWDR::predictOmp(const mat& locations, const mat& x, const vec& y)
 {
     uword nDp = locations.n_rows, nVar = mX.n_cols;
     mat betas(nVar, nDp, arma::fill::zeros);
+    vector<BandwidthWeight*> bandwidths;
+    for (auto&& sw : mSpatialWeights)
+    {
+        bandwidths.push_back(sw.weight<BandwidthWeight>());
+    }
     bool success = true;
     std::exception except;
 #pragma omp parallel for num_threads(mOmpThreadNum)
@@ -172,12 +253,7 @@ mat GWDR::predictOmp(const mat& locations, const mat& x, const vec& y)
         GWM_LOG_STOP_CONTINUE(mStatus);
         if (success)
         {
-            vec w(nDp, arma::fill::ones);
-            for (auto&& sw : mSpatialWeights)
-            {
-                vec w_m = sw.weightVector(i);
-                w = w % w_m;
-            }
+            vec w = predictWeight(i, bandwidths);
             mat ws(1, nVar, arma::fill::ones);
             mat xtw = (x %(w * ws)).t();
             mat xtwx = xtw * x;
@@ -212,16 +288,16 @@ mat GWDR::fitSerial(const mat& x, const vec& y, mat& betasSE, vec& shat, vec& qd
     qdiag = vec(nDp, arma::fill::zeros);
     S = mat(isStoreS() ? nDp : 1, nDp, arma::fill::zeros);
     mat rowsumSE(nDp, 1, arma::fill::ones);
+    vector<BandwidthWeight*> bandwidths;
+    for (auto&& sw : mSpatialWeights)
+    {
+        bandwidths.push_back(sw.weight<BandwidthWeight>());
+    }
     vec s_hat1(nDp, arma::fill::zeros), s_hat2(nDp, arma::fill::zeros);
     for (size_t i = 0; i < nDp; i++)
     {
         GWM_LOG_STOP_BREAK(mStatus);
-        vec w(nDp, arma::fill::ones);
-        for (auto&& sw : mSpatialWeights)
-        {
-            vec w_m = sw.weightVector(i);
-            w = w % w_m;
-        }
+        vec w = focusWeight(i, bandwidths);
         mat ws(1, nVar, arma::fill::ones);
         mat xtw = trans(x %(w * ws));
         mat xtwx = xtw * x;
@@ -263,6 +339,11 @@ mat GWDR::fitOmp(const mat& x, const vec& y, mat& betasSE, vec& shat, vec& qdiag
     qdiag = vec(nDp, arma::fill::zeros);
     S = mat(isStoreS() ? nDp : 1, nDp, arma::fill::zeros);
     mat rowsumSE(nDp, 1, arma::fill::ones);
+    vector<BandwidthWeight*> bandwidths;
+    for (auto&& sw : mSpatialWeights)
+    {
+        bandwidths.push_back(sw.weight<BandwidthWeight>());
+    }
     mat s_hat_all(2, mOmpThreadNum, arma::fill::zeros);
     mat qdiag_all(nDp, mOmpThreadNum, arma::fill::zeros);
     bool success = true;
@@ -274,12 +355,7 @@ mat GWDR::fitOmp(const mat& x, const vec& y, mat& betasSE, vec& shat, vec& qdiag
         int thread = omp_get_thread_num();
         if (success)
         {
-            vec w(nDp, arma::fill::ones);
-            for (auto&& sw : mSpatialWeights)
-            {
-                vec w_m = sw.weightVector(i);
-                w = w % w_m;
-            }
+            vec w = focusWeight(i, bandwidths);
             mat ws(1, nVar, arma::fill::ones);
             mat xtw = trans(x %(w * ws));
             mat xtwx = xtw * x;
@@ -319,9 +395,144 @@ mat GWDR::fitOmp(const mat& x, const vec& y, mat& betasSE, vec& shat, vec& qdiag
 }
 #endif
 
-double GWDR::bandwidthCriterionCVSerial(const vector<BandwidthWeight*>& bandwidths)
+void GWDR::prepareWeightCache()
 {
     uword nDp = mCoords.n_rows, nDim = mCoords.n_cols;
+    mWeightCache.clear();
+    if (nDim * nDp * nDp > MaxWeightCacheSize) return;
+    mWeightCache.resize(nDim);
+    for (uword m = 0; m < nDim; m++)
+    {
+        WeightCache& cache = mWeightCache[m];
+        cache.order = stable_sort_index(mCoords.col(m));
+        cache.rank = uvec(nDp);
+        cache.rank(cache.order) = regspace<uvec>(0, nDp - 1);
+    }
+}
+
+bool GWDR::isWeightCached(uword m, const BandwidthWeight* bandwidth) const
+{
+    if (m >= mWeightCache.size()) return false;
+    const WeightCache& cache = mWeightCache[m];
+    return cache.valid && cache.bandwidth == bandwidth->bandwidth() && cache.adaptive == bandwidth->adaptive() && cache.kernel == bandwidth->kernel();
+}
+
+void GWDR::updateWeightCache(const vector<BandwidthWeight*>& bandwidths)
+{
+    uword nDp = mCoords.n_rows;
+    for (uword m = 0; m < mWeightCache.size(); m++)
+    {
+        BandwidthWeight* bw = bandwidths[m];
+        if (isWeightCached(m, bw)) continue;
+        WeightCache& cache = mWeightCache[m];
+        bool compact = isCompactKernel(bw->kernel());
+        cache.weights.set_size(nDp, nDp);
+        cache.range.set_size(compact ? 2 : 0, nDp);
+        Distance* distance = mSpatialWeights[m].distance();
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for num_threads(mParallelType == ParallelType::OpenMP ? mOmpThreadNum : 1)
+#endif
+        for (int i = 0; (uword)i < nDp; i++)
+        {
+            cache.weights.col(i) = bw->weight(distance->distance(i));
+            if (compact)
+            {
+                // Non-zero weights of a compact kernel are contiguous in the sorted order and contain the focus point.
+                const double* w = cache.weights.colptr(i);
+                uword pos = cache.rank(i), lo = pos, hi = pos;
+                if (w[i] > 0.0)
+                {
+                    uword a = 0, b = pos;
+                    while (a < b)
+                    {
+                        uword mid = (a + b) / 2;
+                        if (w[cache.order(mid)] > 0.0) b = mid; else a = mid + 1;
+                    }
+                    lo = a;
+                    a = pos + 1, b = nDp;
+                    while (a < b)
+                    {
+                        uword mid = (a + b) / 2;
+                        if (w[cache.order(mid)] > 0.0) a = mid + 1; else b = mid;
+                    }
+                    hi = a;
+                }
+                cache.range(0, i) = lo;
+                cache.range(1, i) = hi;
+            }
+        }
+        cache.bandwidth = bw->bandwidth();
+        cache.adaptive = bw->adaptive();
+        cache.kernel = bw->kernel();
+        cache.valid = true;
+    }
+}
+
+vec GWDR::focusWeight(uword focus, const vector<BandwidthWeight*>& bandwidths, const vector<vec>* dists)
+{
+    uword nDp = mCoords.n_rows;
+    vec w(nDp, arma::fill::ones);
+    for (uword m = 0; m < bandwidths.size(); m++)
+    {
+        if (isWeightCached(m, bandwidths[m]))
+        {
+            w = w % mWeightCache[m].weights.col(focus);
+        }
+        else
+        {
+            vec w_m = bandwidths[m]->weight(dists ? (*dists)[m] : mSpatialWeights[m].distance()->distance(focus));
+            w = w % w_m;
+        }
+    }
+    return w;
+}
+
+uvec GWDR::focusNeighbours(uword focus, const vector<BandwidthWeight*>& bandwidths, vec& w, const vector<vec>* dists)
+{
+    uword nDim = bandwidths.size();
+    bool intersect = nDim > 0;
+    for (uword m = 0; m < nDim && intersect; m++)
+    {
+        intersect = isCompactKernel(bandwidths[m]->kernel()) && isWeightCached(m, bandwidths[m]);
+    }
+    if (!intersect)
+    {
+        w = focusWeight(focus, bandwidths, dists);
+        return regspace<uvec>(0, mCoords.n_rows - 1);
+    }
+    uword narrowest = 0;
+    for (uword m = 1; m < nDim; m++)
+    {
+        const umat& range = mWeightCache[m].range;
+        const umat& best = mWeightCache[narrowest].range;
+        if (range(1, focus) - range(0, focus) < best(1, focus) - best(0, focus)) narrowest = m;
+    }
+    const WeightCache& base = mWeightCache[narrowest];
+    uword lo = base.range(0, focus), hi = base.range(1, focus);
+    if (hi <= lo)
+    {
+        w.reset();
+        return uvec();
+    }
+    uvec idx = sort(base.order.subvec(lo, hi - 1));
+    w = vec(idx.n_elem, arma::fill::ones);
+    for (uword m = 0; m < nDim; m++)
+    {
+        const mat& weights = mWeightCache[m].weights;
+        for (uword k = 0; k < idx.n_elem; k++)
+        {
+            w(k) *= weights(idx(k), focus);
+        }
+    }
+    uvec nz = find(w > 0.0);
+    w = w(nz);
+    return idx(nz);
+}
+
+double GWDR::bandwidthCriterionCVSerial(const vector<BandwidthWeight*>& bandwidths)
+{
+    uword nDp = mCoords.n_rows;
+    updateWeightCache(bandwidths);
     double cv = 0.0;
     bool success = true;
     for (size_t i = 0; i < nDp; i++)
@@ -329,17 +540,13 @@ double GWDR::bandwidthCriterionCVSerial(const vector<BandwidthWeight*>& bandwidt
         GWM_LOG_STOP_BREAK(mStatus);
         if (success)
         {
-            vec w(nDp, arma::fill::ones);
-            for (size_t m = 0; m < nDim; m++)
-            {
-                vec d_m = mSpatialWeights[m].distance()->distance(i);
-                vec w_m = bandwidths[m]->weight(d_m);
-                w = w % w_m;
-            }
-            w(i) = 0.0;
-            mat xtw = (mX.each_col() % w).t();
-            mat xtwx = xtw * mX;
-            mat xtwy = xtw * mY;
+            vec w;
+            uvec nb = focusNeighbours(i, bandwidths, w);
+            w(find(nb == i)).zeros();
+            mat x = mX.rows(nb);
+            mat xtw = (x.each_col() % w).t();
+            mat xtwx = xtw * x;
+            mat xtwy = xtw * mY(nb);
             try
             {
                 mat xtwx_inv = xtwx.i();
@@ -368,27 +575,25 @@ double GWDR::bandwidthCriterionCVSerial(const vector<BandwidthWeight*>& bandwidt
 #ifdef ENABLE_OPENMP
 double GWDR::bandwidthCriterionCVOmp(const vector<BandwidthWeight*>& bandwidths)
 {
-    uword nDp = mCoords.n_rows, nDim = mCoords.n_cols;
+    uword nDp = mCoords.n_rows;
+    updateWeightCache(bandwidths);
     vec cv_all(mOmpThreadNum, arma::fill::zeros);
     bool success = true;
     std::exception except;
-    for (size_t i = 0; i < nDp; i++)
+#pragma omp parallel for num_threads(mOmpThreadNum)
+    for (int i = 0; (uword)i < nDp; i++)
     {
         GWM_LOG_STOP_CONTINUE(mStatus);
         int thread = omp_get_thread_num();
         if (success)
         {
-            vec w(nDp, arma::fill::ones);
-            for (size_t m = 0; m < nDim; m++)
-            {
-                vec d_m = mSpatialWeights[m].distance()->distance(i);
-                vec w_m = bandwidths[m]->weight(d_m);
-                w = w % w_m;
-            }
-            w(i) = 0.0;
-            mat xtw = (mX.each_col() % w).t();
-            mat xtwx = xtw * mX;
-            mat xtwy = mX.t() * (w % mY);
+            vec w;
+            uvec nb = focusNeighbours(i, bandwidths, w);
+            w(find(nb == (uword)i)).zeros();
+            mat x = mX.rows(nb);
+            mat xtw = (x.each_col() % w).t();
+            mat xtwx = xtw * x;
+            mat xtwy = x.t() * (w % mY(nb));
             try
             {
                 mat xtwx_inv = xtwx.i();
@@ -419,7 +624,8 @@ double GWDR::bandwidthCriterionCVOmp(const vector<BandwidthWeight*>& bandwidths)
 
 double GWDR::bandwidthCriterionAICSerial(const vector<BandwidthWeight*>& bandwidths)
 {
-    uword nDp = mCoords.n_rows, nDim = mCoords.n_cols, nVar = mX.n_cols;
+    uword nDp = mCoords.n_rows, nVar = mX.n_cols;
+    updateWeightCache(bandwidths);
     mat betas(nVar, nDp, fill::zeros);
     double trS = 0.0;
     bool flag = true;
@@ -428,23 +634,21 @@ double GWDR::bandwidthCriterionAICSerial(const vector<BandwidthWeight*>& bandwid
         GWM_LOG_STOP_BREAK(mStatus);
         if (flag)
         {
-            vec w(nDp, arma::fill::ones);
-            for (size_t m = 0; m < nDim; m++)
-            {
-                vec d_m = mSpatialWeights[m].distance()->distance(i);
-                vec w_m = bandwidths[m]->weight(d_m);
-                w = w % w_m;
-            }
-            mat xtw = (mX.each_col() % w).t();
-            mat xtwx = xtw * mX;
-            mat xtwy = mX.t() * (w % mY);
+            vec w;
+            uvec nb = focusNeighbours(i, bandwidths, w);
+            mat x = mX.rows(nb);
+            mat xtw = (x.each_col() % w).t();
+            mat xtwx = xtw * x;
+            mat xtwy = x.t() * (w % mY(nb));
             try
             {
                 mat xtwx_inv = xtwx.i();
                 betas.col(i) = xtwx_inv * xtwy;
-                mat ci = xtwx_inv * xtw;
-                mat si = mX.row(i) * ci;
-                trS += si(0, i);
+                uvec self = find(nb == i, 1);
+                if (self.n_elem > 0)
+                {
+                    trS += as_scalar(mX.row(i) * xtwx_inv * xtw.col(self(0)));
+                }
             }
             catch(const std::exception& e)
             {
@@ -468,7 +672,8 @@ double GWDR::bandwidthCriterionAICSerial(const vector<BandwidthWeight*>& bandwid
 #ifdef ENABLE_OPENMP
 double GWDR::bandwidthCriterionAICOmp(const vector<BandwidthWeight*>& bandwidths)
 {
-    uword nDp = mCoords.n_rows, nDim = mCoords.n_cols, nVar = mX.n_cols;
+    uword nDp = mCoords.n_rows, nVar = mX.n_cols;
+    updateWeightCache(bandwidths);
     mat betas(nVar, nDp, arma::fill::zeros);
     vec trS_all(mOmpThreadNum, arma::fill::zeros);
     bool success = true;
@@ -480,23 +685,21 @@ double GWDR::bandwidthCriterionAICOmp(const vector<BandwidthWeight*>& bandwidths
         int thread = omp_get_thread_num();
         if (success)
         {
-            vec w(nDp, arma::fill::ones);
-            for (size_t m = 0; m < nDim; m++)
-            {
-                vec d_m = mSpatialWeights[m].distance()->distance(i);
-                vec w_m = bandwidths[m]->weight(d_m);
-                w = w % w_m;
-            }
-            mat xtw = (mX.each_col() % w).t();
-            mat xtwx = xtw * mX;
-            mat xtwy = mX.t() * (w % mY);
+            vec w;
+            uvec nb = focusNeighbours(i, bandwidths, w);
+            mat x = mX.rows(nb);
+            mat xtw = (x.each_col() % w).t();
+            mat xtwx = xtw * x;
+            mat xtwy = x.t() * (w % mY(nb));
             try
             {
                 mat xtwx_inv = xtwx.i();
                 betas.col(i) = xtwx_inv * xtwy;
-                mat ci = xtwx_inv * xtw;
-                mat si = mX.row(i) * ci;
-                trS_all(thread) += si(0, i);
+                uvec self = find(nb == (uword)i, 1);
+                if (self.n_elem > 0)
+                {
+                    trS_all(thread) += as_scalar(mX.row(i) * xtwx_inv * xtw.col(self(0)));
+                }
             }
             catch(const std::exception& e)
             {
@@ -520,6 +723,147 @@ double GWDR::bandwidthCriterionAICOmp(const vector<BandwidthWeight*>& bandwidths
 }
 #endif
 
+vector<vector<BandwidthWeight>> GWDR::candidateWeights(const mat& candidates)
+{
+    vector<vector<BandwidthWeight>> weights(candidates.n_rows);
+    for (uword c = 0; c < candidates.n_rows; c++)
+    {
+        for (uword m = 0; m < candidates.n_cols; m++)
+        {
+            const BandwidthWeight* bw = mSpatialWeights[m].weight<BandwidthWeight>();
+            weights[c].emplace_back(candidates(c, m), bw->adaptive(), bw->kernel());
+        }
+    }
+    return weights;
+}
+
+void GWDR::bandwidthCriteriaFocus(uword focus, const vector<vec>& dists, vector<vector<BandwidthWeight>>& weights, mat& acc, uvec& failed)
+{
+    bool cv = mBandwidthCriterionType == BandwidthCriterionType::CV;
+    vector<BandwidthWeight*> bandwidths(dists.size());
+    for (uword c = 0; c < weights.size(); c++)
+    {
+        if (failed(c)) continue;
+        for (size_t m = 0; m < dists.size(); m++)
+        {
+            bandwidths[m] = &weights[c][m];
+        }
+        vec w;
+        uvec nb = focusNeighbours(focus, bandwidths, w, &dists);
+        uvec self = find(nb == focus, 1);
+        if (cv) w(self).zeros();
+        mat x = mX.rows(nb);
+        mat xtw = (x.each_col() % w).t();
+        mat xtwx = xtw * x;
+        vec xtwy = xtw * mY(nb);
+        mat xtwx_inv;
+        if (!inv(xtwx_inv, xtwx))
+        {
+            failed(c) = 1;
+            continue;
+        }
+        vec beta = xtwx_inv * xtwy;
+        double res = mY(focus) - as_scalar(mX.row(focus) * beta);
+        acc(c, 0) += res * res;
+        if (!cv && self.n_elem > 0)
+        {
+            acc(c, 1) += as_scalar(mX.row(focus) * xtwx_inv * xtw.col(self(0)));
+        }
+    }
+}
+
+void GWDR::prepareCandidateWeightCache(const mat& candidates)
+{
+    if (mWeightCache.empty() || candidates.n_rows == 0) return;
+    vector<BandwidthWeight> weights = candidateWeights(mostFrequentRow(candidates)).front();
+    vector<BandwidthWeight*> bandwidths;
+    for (auto&& weight : weights)
+    {
+        bandwidths.push_back(&weight);
+    }
+    updateWeightCache(bandwidths);
+}
+
+vec GWDR::bandwidthCriteriaValue(const mat& candidates, const mat& acc, const uvec& failed)
+{
+    uword nCand = candidates.n_rows;
+    double n = double(mCoords.n_rows);
+    vec criterion(nCand);
+    for (uword c = 0; c < nCand; c++)
+    {
+        double rss = acc(c, 0), trS = acc(c, 1);
+        double value = mBandwidthCriterionType == BandwidthCriterionType::CV ? rss : GWRBase::AICc(rss, n, trS);
+        criterion(c) = (failed(c) == 0 && isfinite(value)) ? value : DBL_MAX;
+        if (criterion(c) < DBL_MAX)
+        {
+            vector<string> labels(candidates.n_cols);
+            for (uword m = 0; m < candidates.n_cols; m++)
+            {
+                labels[m] = to_string(candidates(c, m));
+            }
+            GWM_LOG_INFO(string(GWM_LOG_TAG_BANDWIDTH_CIRTERION) + strjoin(",", labels) + "," + to_string(criterion(c)));
+        }
+    }
+    return criterion;
+}
+
+vec GWDR::bandwidthCriteriaSerial(const mat& candidates)
+{
+    uword nDp = mCoords.n_rows, nDim = mCoords.n_cols, nCand = candidates.n_rows;
+    vector<vector<BandwidthWeight>> weights = candidateWeights(candidates);
+    prepareCandidateWeightCache(candidates);
+    mat acc(nCand, 2, arma::fill::zeros);
+    uvec failed(nCand, arma::fill::zeros);
+    vector<vec> dists(nDim);
+    for (uword i = 0; i < nDp; i++)
+    {
+        GWM_LOG_STOP_BREAK(mStatus);
+        for (uword m = 0; m < nDim; m++)
+        {
+            dists[m] = mSpatialWeights[m].distance()->distance(i);
+        }
+        bandwidthCriteriaFocus(i, dists, weights, acc, failed);
+    }
+    return bandwidthCriteriaValue(candidates, acc, failed);
+}
+
+#ifdef ENABLE_OPENMP
+vec GWDR::bandwidthCriteriaOmp(const mat& candidates)
+{
+    uword nDp = mCoords.n_rows, nDim = mCoords.n_cols, nCand = candidates.n_rows;
+    cube acc_all(nCand, 2, mOmpThreadNum, arma::fill::zeros);
+    umat failed_all(nCand, mOmpThreadNum, arma::fill::zeros);
+    prepareCandidateWeightCache(candidates);
+#pragma omp parallel num_threads(mOmpThreadNum)
+    {
+        int thread = omp_get_thread_num();
+        vector<vector<BandwidthWeight>> weights = candidateWeights(candidates);
+        mat acc(nCand, 2, arma::fill::zeros);
+        uvec failed(nCand, arma::fill::zeros);
+        vector<vec> dists(nDim);
+#pragma omp for
+        for (int i = 0; (uword)i < nDp; i++)
+        {
+            GWM_LOG_STOP_CONTINUE(mStatus);
+            for (uword m = 0; m < nDim; m++)
+            {
+                dists[m] = mSpatialWeights[m].distance()->distance(i);
+            }
+            bandwidthCriteriaFocus(i, dists, weights, acc, failed);
+        }
+        acc_all.slice(thread) = acc;
+        failed_all.col(thread) = failed;
+    }
+    mat acc(nCand, 2, arma::fill::zeros);
+    for (int t = 0; t < mOmpThreadNum; t++)
+    {
+        acc += acc_all.slice(t);
+    }
+    uvec failed = max(failed_all, 1);
+    return bandwidthCriteriaValue(candidates, acc, failed);
+}
+#endif
+
 double GWDR::indepVarCriterionSerial(const vector<size_t>& indepVars)
 {
     mat x = mX.cols(VariableForwardSelector::index2uvec(indepVars, mHasIntercept));
@@ -730,18 +1074,21 @@ void GWDR::setParallelType(const ParallelType& type)
             mPredictFunction = &GWDR::predictSerial;
             mFitFunction = &GWDR::fitSerial;
             mIndepVarCriterionFunction = &GWDR::indepVarCriterionSerial;
+            mBandwidthCriteriaFunction = &GWDR::bandwidthCriteriaSerial;
             break;
 #ifdef ENABLE_OPENMP
         case ParallelType::OpenMP:
             mPredictFunction = &GWDR::predictOmp;
             mFitFunction = &GWDR::fitOmp;
             mIndepVarCriterionFunction= &GWDR::indepVarCriterionOmp;
+            mBandwidthCriteriaFunction = &GWDR::bandwidthCriteriaOmp;
             break;
 #endif
         default:
             mPredictFunction = &GWDR::predictSerial;
             mFitFunction = &GWDR::fitSerial;
             mIndepVarCriterionFunction = &GWDR::indepVarCriterionSerial;
+            mBandwidthCriteriaFunction = &GWDR::bandwidthCriteriaSerial;
             break;
         }
     }
@@ -837,3 +1184,159 @@ const int GWDRBandwidthOptimizer::optimize(GWDR* instance, uword featureCount, s
     gsl_vector_free(steps);
     return status;
 }
+
+const int GWDRBandwidthOptimizer::optimizeLbfgsb(GWDR* instance, const vec& lower, const vec& upper, size_t maxIter, double eps)
+{
+    uword nDim = mBandwidths.size();
+    vec range = upper - lower;
+    uvec adaptive(nDim);
+    vec h(nDim);
+    for (uword m = 0; m < nDim; m++)
+    {
+        adaptive(m) = mBandwidths[m]->adaptive() ? 1 : 0;
+        // Adaptive bandwidths are piecewise constant between integers, so differences must cross at least one.
+        h(m) = adaptive(m) ? std::max(LbfgsbDiffStep, 1.0 / range(m)) : LbfgsbDiffStep;
+    }
+    auto evaluate = [&](const mat& xs) -> vec
+    {
+        mat bws = xs.each_row() % range.t();
+        bws.each_row() += lower.t();
+        // Evaluate adaptive bandwidths where they will be set, so the returned optimum keeps its criterion.
+        for (uword m = 0; m < nDim; m++)
+        {
+            if (adaptive(m)) bws.col(m) = round(bws.col(m));
+        }
+        return instance->bandwidthCriteria(bws);
+    };
+    auto gradient = [&](const vec& x, double f) -> vec
+    {
+        mat probes = repmat(x.t(), nDim, 1);
+        vec steps = h;
+        for (uword m = 0; m < nDim; m++)
+        {
+            if (x(m) + h(m) > 1.0) steps(m) = -h(m);
+            probes(m, m) += steps(m);
+        }
+        vec fp = evaluate(probes);
+        vec g(nDim, arma::fill::zeros);
+        for (uword m = 0; m < nDim; m++)
+        {
+            if (fp(m) < DBL_MAX) g(m) = (fp(m) - f) / steps(m);
+        }
+        return g;
+    };
+
+    // Warm start from a coarse grid together with the initial bandwidths.
+    uword gridSize = std::max<uword>(2, uword(floor(pow(double(LbfgsbGridSize), 1.0 / double(nDim)))));
+    uword nGrid = 1;
+    for (uword m = 0; m < nDim; m++) nGrid *= gridSize;
+    mat grid(nGrid + 1, nDim);
+    for (uword r = 0; r < nGrid; r++)
+    {
+        for (uword m = 0, k = r; m < nDim; m++, k /= gridSize)
+        {
+            grid(r, m) = (double(k % gridSize) + 0.5) / double(gridSize);
+        }
+    }
+    for (uword m = 0; m < nDim; m++)
+    {
+        grid(nGrid, m) = std::min(1.0, std::max(0.0, (mBandwidths[m]->bandwidth() - lower(m)) / range(m)));
+    }
+    vec gridCriterion = evaluate(grid);
+    if (instance->status() != Status::Success) return 1;
+    uword best = index_min(gridCriterion);
+    vec x = grid.row(best).t();
+    double f = gridCriterion(best);
+    if (f >= DBL_MAX) return 1;
+    vec g = gradient(x, f);
+
+    vector<vec> S, Y;
+    for (size_t iter = 0; iter < maxIter && instance->status() == Status::Success; iter++)
+    {
+        vec pg = clamp(x - g, 0.0, 1.0) - x;
+        if (norm(pg, "inf") < eps) break;
+        // Variables at bounds whose gradients point outwards are fixed in this iteration.
+        uvec fixed = find(abs(pg) <= 0.0);
+
+        // Two-loop recursion
+        vec q = g;
+        vec alpha(S.size());
+        for (size_t k = S.size(); k-- > 0;)
+        {
+            alpha(k) = dot(S[k], q) / dot(Y[k], S[k]);
+            q -= alpha(k) * Y[k];
+        }
+        if (!S.empty()) q *= dot(S.back(), Y.back()) / dot(Y.back(), Y.back());
+        for (size_t k = 0; k < S.size(); k++)
+        {
+            double beta = dot(Y[k], q) / dot(Y[k], S[k]);
+            q += (alpha(k) - beta) * S[k];
+        }
+        vec p = -q;
+        p(fixed).zeros();
+        if (dot(p, g) >= 0.0)
+        {
+            p = -g;
+            p(fixed).zeros();
+            S.clear();
+            Y.clear();
+        }
+
+        // Projected backtracking line search, several trial steps in each pass.
+        bool accepted = false;
+        vec xn;
+        double fn = DBL_MAX, t = 1.0;
+        for (uword pass = 0; pass < LbfgsbLineSearchPasses && !accepted; pass++)
+        {
+            mat trials(LbfgsbLineSearchTrials, nDim);
+            for (uword k = 0; k < LbfgsbLineSearchTrials; k++, t /= 2.0)
+            {
+                trials.row(k) = clamp(x + t * p, 0.0, 1.0).t();
+            }
+            vec ft = evaluate(trials);
+            if (instance->status() != Status::Success) return 1;
+            for (uword k = 0; k < LbfgsbLineSearchTrials && !accepted; k++)
+            {
+                vec xk = trials.row(k).t();
+                if (ft(k) < DBL_MAX && ft(k) <= f + LbfgsbArmijo * std::min(0.0, dot(g, xk - x)))
+                {
+                    accepted = true;
+                    xn = xk;
+                    fn = ft(k);
+                }
+            }
+        }
+        if (!accepted)
+        {
+            if (S.empty()) break;
+            S.clear();
+            Y.clear();
+            continue;
+        }
+
+        vec gn = gradient(xn, fn);
+        vec s = xn - x, y = gn - g;
+        if (dot(s, y) > 1e-12)
+        {
+            if (S.size() == LbfgsbMemory)
+            {
+                S.erase(S.begin());
+                Y.erase(Y.begin());
+            }
+            S.push_back(s);
+            Y.push_back(y);
+        }
+        bool converged = (f - fn) <= eps * std::max(1.0, abs(f));
+        x = xn;
+        f = fn;
+        g = gn;
+        if (converged) break;
+    }
+
+    for (uword m = 0; m < nDim; m++)
+    {
+        double bw = lower(m) + x(m) * range(m);
+        mBandwidths[m]->setBandwidth(adaptive(m) ? round(bw) : bw);
+    }
+    return instance->status() == Status::Success ? 0 : 1;
+}
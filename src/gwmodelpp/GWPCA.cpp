@@ -1,5 +1,9 @@
 #include "GWPCA.h"
+#include <cstdint>
+#include <random>
+#include <algorithm>
 
+using namespace std;
 using namespace arma;
 using namespace gwm;
 
@@ -14,20 +18,28 @@ void GWPCA::run()
     GWM_LOG_STOP_RETURN(mStatus, void());
     
     mWinner = index_max(mLoadings.slice(0), 1);
+
+    if (mMonteCarloTimes > 0)
+    {
+        GWM_LOG_STAGE("Monte Carlo test");
+        monteCarloTest();
+        GWM_LOG_STOP_RETURN(mStatus, void());
+    }
 }
 
 mat GWPCA::solveSerial(const mat& x, cube& loadings, mat& sdev)
 {
     uword nDp = mCoords.n_rows, nVar = mX.n_cols;
     mat d_all(nVar, nDp, arma::fill::zeros);
-    vec w0;
+    vec w, w0;
+    mat V;
+    vec d;
     loadings = cube(nDp, nVar, mK, arma::fill::zeros);
+    mScores = mHasScores ? cube(nDp, mK, nDp, arma::fill::zeros) : cube();
     for (uword i = 0; i < nDp; i++)
     {
         GWM_LOG_STOP_BREAK(mStatus);
-        vec w = mSpatialWeight.weightVector(i);
-        mat V;
-        vec d;
+        mSpatialWeight.weightVector(i, w);
         wpca(x, w, V, d);
         w0 = w;
         d_all.col(i) = d;
@@ -35,20 +47,170 @@ mat GWPCA::solveSerial(const mat& x, cube& loadings, mat& sdev)
         {
             loadings.slice(j).row(i) = arma::trans(V.col(j));
         }
+        if (mHasScores)
+        {
+            mScores.slice(i) = x * V;
+        }
         GWM_LOG_PROGRESS(i + 1, nDp);
     }
-    d_all = trans(d_all);
-    mat variance = (d_all / sqrt(sum(w0))) % (d_all / sqrt(sum(w0)));
+    return summarize(d_all, sum(w0), sdev);
+}
+
+#ifdef ENABLE_OPENMP
+mat GWPCA::solveOmp(const mat& x, cube& loadings, mat& sdev)
+{
+    uword nDp = mCoords.n_rows, nVar = mX.n_cols;
+    mat d_all(nVar, nDp, arma::fill::zeros);
+    loadings = cube(nDp, nVar, mK, arma::fill::zeros);
+    mScores = mHasScores ? cube(nDp, mK, nDp, arma::fill::zeros) : cube();
+#pragma omp parallel num_threads(mOmpThreadNum)
+    {
+        vec w, d;
+        mat V;
+#pragma omp for
+        for (int i = 0; (uword) i < nDp; i++)
+        {
+            GWM_LOG_STOP_CONTINUE(mStatus);
+            mSpatialWeight.weightVector(i, w);
+            wpca(x, w, V, d);
+            d_all.col(i) = d;
+            for (int j = 0; j < mK; j++)
+            {
+                loadings.slice(j).row(i) = arma::trans(V.col(j));
+            }
+            if (mHasScores)
+            {
+                mScores.slice(i) = x * V;
+            }
+            GWM_LOG_PROGRESS(i + 1, nDp);
+        }
+    }
+    vec w0 = mSpatialWeight.weightVector(nDp - 1);
+    return summarize(d_all, sum(w0), sdev);
+}
+#endif
+
+mat GWPCA::summarize(const mat& d_all, double sumw, mat& sdev)
+{
+    mat ds = trans(d_all) / sqrt(sumw);
+    mat variance = ds % ds;
     sdev = sqrt(variance);
     mat pv = variance.cols(0, mK - 1).each_col() % (1.0 / sum(variance, 1)) * 100.0;
     return pv;
 }
 
+void GWPCA::monteCarloTest()
+{
+    uword nDp = mCoords.n_rows, nRep = mMonteCarloTimes;
+    umat perms(nDp, nRep);
+    for (uword r = 0; r < nRep; r++)
+    {
+        perms.col(r) = permutation(nDp, r);
+    }
+    double sumw = sum(mSpatialWeight.weightVector(nDp - 1));
+    mat lambda1 = (this->*mMonteCarloCalculator)(perms, sumw);
+    GWM_LOG_STOP_RETURN(mStatus, void());
+    mMonteCarloStatistic = stddev(vec(square(mSDev.col(0))));
+    mMonteCarloReplicates = trans(stddev(lambda1, 0, 0));
+    uvec extreme = find(mMonteCarloReplicates >= mMonteCarloStatistic);
+    mMonteCarloPValue = double(extreme.n_elem + 1) / double(nRep + 1);
+}
+
+mat GWPCA::monteCarloSerial(const umat& perms, double sumw)
+{
+    uword nDp = mCoords.n_rows, nRep = perms.n_cols;
+    mat lambda1(nDp, nRep, arma::fill::zeros);
+    vec w, lambda;
+    for (uword i = 0; i < nDp; i++)
+    {
+        GWM_LOG_STOP_BREAK(mStatus);
+        mSpatialWeight.weightVector(i, w);
+        for (uword r = 0; r < nRep; r++)
+        {
+            eig_sym(lambda, wcov(mX, w.elem(perms.col(r))));
+            lambda1(i, r) = lambda.max() / sumw;
+        }
+        GWM_LOG_PROGRESS(i + 1, nDp);
+    }
+    return lambda1;
+}
+
+#ifdef ENABLE_OPENMP
+mat GWPCA::monteCarloOmp(const umat& perms, double sumw)
+{
+    uword nDp = mCoords.n_rows, nRep = perms.n_cols;
+    mat lambda1(nDp, nRep, arma::fill::zeros);
+#pragma omp parallel num_threads(mOmpThreadNum)
+    {
+        vec w, lambda;
+#pragma omp for
+        for (int i = 0; (uword) i < nDp; i++)
+        {
+            GWM_LOG_STOP_CONTINUE(mStatus);
+            mSpatialWeight.weightVector(i, w);
+            for (uword r = 0; r < nRep; r++)
+            {
+                eig_sym(lambda, wcov(mX, w.elem(perms.col(r))));
+                lambda1(i, r) = lambda.max() / sumw;
+            }
+            GWM_LOG_PROGRESS(i + 1, nDp);
+        }
+    }
+    return lambda1;
+}
+#endif
+
+uvec GWPCA::permutation(uword n, uword stream) const
+{
+    seed_seq seq { uint32_t(mMonteCarloSeed), uint32_t(mMonteCarloSeed >> 32), uint32_t(stream), uint32_t(uint64_t(stream) >> 32) };
+    mt19937_64 engine(seq);
+    uvec perm = regspace<uvec>(0, n).head(n);
+    shuffle(perm.begin(), perm.end(), engine);
+    return perm;
+}
+
+mat GWPCA::wcov(const mat& x, const vec& w)
+{
+    uvec nz = find(w != 0.0);
+    bool compact = nz.n_elem < w.n_elem;
+    mat xc = compact ? mat(x.rows(nz)) : x;
+    vec wc = compact ? vec(w(nz)) : w;
+    xc.each_row() -= trans(wc) * xc / sum(wc);
+    return symmatu(trans(xc) * (xc.each_col() % wc));
+}
+
 void GWPCA::wpca(const mat& x, const vec& w, mat& V, vec & d)
 {
-    mat xw = x.each_col() % w, U;
-    mat centerized = (x.each_row() - sum(xw) / sum(w)).each_col() % sqrt(w);
-    svd(U, d, V, centerized);
+    vec lambda;
+    mat E;
+    eig_sym(lambda, E, wcov(x, w));
+    d = sqrt(clamp(flipud(lambda), 0.0, datum::inf));
+    V = fliplr(E.tail_cols(mK));
+}
+
+void GWPCA::setParallelType(const ParallelType& type)
+{
+    if (type & parallelAbility())
+    {
+        mParallelType = type;
+        switch (type)
+        {
+        case ParallelType::SerialOnly:
+            mSolver = &GWPCA::solveSerial;
+            mMonteCarloCalculator = &GWPCA::monteCarloSerial;
+            break;
+#ifdef ENABLE_OPENMP
+        case ParallelType::OpenMP:
+            mSolver = &GWPCA::solveOmp;
+            mMonteCarloCalculator = &GWPCA::monteCarloOmp;
+            break;
+#endif
+        default:
+            mSolver = &GWPCA::solveSerial;
+            mMonteCarloCalculator = &GWPCA::monteCarloSerial;
+            break;
+        }
+    }
 }
 
 bool GWPCA::isValid()
@@ -1,8 +1,29 @@
 #include "GWRBase.h"
 #include <assert.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
 
+using namespace std;
+using namespace arma;
 using namespace gwm;
 
+namespace
+{
+/// Number of bits of each quantized coordinate in the Z-order curve.
+const int SpatialOrderBits = 16;
+
+uint64_t interleave(uint64_t v)
+{
+    v &= 0xFFFF;
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+}
+
 bool GWRBase::isValid()
 {
     if (SpatialMonoscaleAlgorithm::isValid())
@@ -16,4 +37,96 @@ bool GWRBase::isValid()
         return true;
     }
     else return false;
-}
\ No newline at end of file
+}
+
+void GWRBase::saveModel(ModelArchive& archive) const
+{
+    archive.setRegression(mCoords, mX, mY, mBetas, mHasIntercept, mDiagnostic);
+    archive.setSpatialWeight("spatialWeight", mSpatialWeight);
+}
+
+void GWRBase::loadModel(const ModelArchive& archive)
+{
+    archive.regression(mCoords, mX, mY, mBetas, mHasIntercept, mDiagnostic);
+    mSpatialWeight = archive.spatialWeight("spatialWeight");
+}
+
+void GWRBase::save(const string& path) const
+{
+    ModelArchive archive;
+    saveModel(archive);
+    archive.save(path);
+}
+
+void GWRBase::load(const string& path)
+{
+    loadModel(ModelArchive::load(path));
+}
+
+uvec GWRBase::SpatialOrder(const mat& locations)
+{
+    uword n = locations.n_rows;
+    uvec order(n);
+    for (uword i = 0; i < n; i++)
+    {
+        order(i) = i;
+    }
+    if (n == 0 || locations.n_cols < 2) return order;
+    rowvec lower = min(locations.cols(0, 1), 0);
+    rowvec range = max(locations.cols(0, 1), 0) - lower;
+    const double cells = double((1 << SpatialOrderBits) - 1);
+    vector<uint64_t> keys(n);
+    for (uword i = 0; i < n; i++)
+    {
+        uint64_t q[2];
+        for (uword k = 0; k < 2; k++)
+        {
+            q[k] = range(k) > 0.0 ? uint64_t((locations(i, k) - lower(k)) / range(k) * cells) : 0;
+        }
+        keys[i] = interleave(q[0]) | (interleave(q[1]) << 1);
+    }
+    stable_sort(order.begin(), order.end(), [&keys](uword a, uword b) { return keys[a] < keys[b]; });
+    return order;
+}
+
+mat GWRBase::CrossProducts(const mat& x, const vec& y)
+{
+    uword nVar = x.n_cols;
+    mat products(x.n_rows, nVar * (nVar + 1) / 2 + nVar);
+    uword k = 0;
+    for (uword a = 0; a < nVar; a++)
+    {
+        for (uword c = a; c < nVar; c++)
+        {
+            products.col(k++) = x.col(a) % x.col(c);
+        }
+    }
+    for (uword a = 0; a < nVar; a++)
+    {
+        products.col(k++) = x.col(a) % y;
+    }
+    return products;
+}
+
+mat GWRBase::BlockBetas(const mat& products, const mat& weights, uword nVar)
+{
+    uvec active = find(any(weights, 1));
+    mat sums = active.n_elem < weights.n_rows ? mat(products.rows(active).t() * weights.rows(active)) : mat(products.t() * weights);
+    uword nBlock = weights.n_cols, nPair = nVar * (nVar + 1) / 2;
+    mat betas(nVar, nBlock);
+    mat xtwx(nVar, nVar);
+    for (uword j = 0; j < nBlock; j++)
+    {
+        uword k = 0;
+        for (uword a = 0; a < nVar; a++)
+        {
+            for (uword c = a; c < nVar; c++, k++)
+            {
+                xtwx(a, c) = xtwx(c, a) = sums(k, j);
+            }
+        }
+        vec xtwy = sums.col(j).subvec(nPair, nPair + nVar - 1);
+        betas.col(j) = inv_sympd(xtwx) * xtwy;
+    }
+    return betas;
+}
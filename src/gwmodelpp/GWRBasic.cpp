@@ -60,7 +60,14 @@ mat GWRBasic::fit()
         mIndepVarSelectionProgressCurrent = 0;
 
         GWM_LOG_INFO(IVarialbeSelectable::infoVariableCriterion());
+        resetSelectionBasis();
         VariableForwardSelector selector(indep_vars, mIndepVarSelectionThreshold);
+#ifdef ENABLE_OPENMP
+        if (mParallelType == ParallelType::OpenMP)
+        {
+            selector.setOmpThreadNum(mOmpThreadNum);
+        }
+#endif // ENABLE_OPENMP
         mSelectedIndepVars = selector.optimize(this);
         if (mSelectedIndepVars.size() > 0)
         {
@@ -166,26 +173,26 @@ void GWRBasic::createPredictionDistanceParameter(const arma::mat& locations)
 
 mat GWRBasic::predictSerial(const mat& locations, const mat& x, const vec& y)
 {
-    uword nRp = locations.n_rows, nVar = x.n_cols;
+    uword nRp = locations.n_rows, nDp = x.n_rows, nVar = x.n_cols;
+    uword nBlock = SpatialWeight::BlockSize(nDp);
+    uvec order = SpatialOrder(locations);
+    mat products = CrossProducts(x, y);
     mat betas(nVar, nRp, fill::zeros);
-    for (uword i = 0; i < nRp; i++)
+    for (uword begin = 0; begin < nRp; begin += nBlock)
     {
         GWM_LOG_STOP_BREAK(mStatus);
-        vec w = mSpatialWeight.weightVector(i);
-        mat xtw = trans(x.each_col() % w);
-        mat xtwx = xtw * x;
-        mat xtwy = xtw * y;
+        uvec block = order.subvec(begin, std::min(begin + nBlock, nRp) - 1);
+        mat weights = mSpatialWeight.weightMatrix(block);
         try
         {
-            mat xtwx_inv = inv_sympd(xtwx);
-            betas.col(i) = xtwx_inv * xtwy;
+            betas.cols(block) = BlockBetas(products, weights, nVar);
         }
         catch (const exception& e)
         {
             GWM_LOG_ERROR(e.what());
             throw e;
         }
-        GWM_LOG_PROGRESS(i + 1, nRp);
+        GWM_LOG_PROGRESS(begin + block.n_elem, nRp);
     }
     return betas.t();
 }
@@ -198,33 +205,39 @@ mat GWRBasic::fitSerial(const mat& x, const vec& y, mat& betasSE, vec& shat, vec
     shat = vec(2, fill::zeros);
     qDiag = vec(nDp, fill::zeros);
     S = mat(isStoreS() ? nDp : 1, nDp, fill::zeros);
-    for (uword i = 0; i < nDp; i++)
+    uword nBlock = SpatialWeight::BlockSize(nDp);
+    for (uword begin = 0; begin < nDp; begin += nBlock)
     {
         GWM_LOG_STOP_BREAK(mStatus);
-        vec w = mSpatialWeight.weightVector(i);
-        mat xtw = trans(x.each_col() % w);
-        mat xtwx = xtw * x;
-        mat xtwy = xtw * y;
-        try
+        uword end = std::min(begin + nBlock, nDp);
+        mat weights = mSpatialWeight.weightMatrix(regspace<uvec>(begin, end - 1));
+        for (uword i = begin; i < end; i++)
         {
-            mat xtwx_inv = inv_sympd(xtwx);
-            betas.col(i) = xtwx_inv * xtwy;
-            mat ci = xtwx_inv * xtw;
-            betasSE.col(i) = sum(ci % ci, 1);
-            mat si = x.row(i) * ci;
-            shat(0) += si(0, i);
-            shat(1) += det(si * si.t());
-            vec p = - si.t();
-            p(i) += 1.0;
-            qDiag += p % p;
-            S.row(isStoreS() ? i : 0) = si;
-        }
-        catch (const exception& e)
-        {
-            GWM_LOG_ERROR(e.what());
-            throw e;
+            vec w(weights.colptr(i - begin), nDp, false, true);
+            mat xtw = trans(x.each_col() % w);
+            mat xtwx = xtw * x;
+            mat xtwy = xtw * y;
+            try
+            {
+                mat xtwx_inv = inv_sympd(xtwx);
+                betas.col(i) = xtwx_inv * xtwy;
+                mat ci = xtwx_inv * xtw;
+                betasSE.col(i) = sum(ci % ci, 1);
+                mat si = x.row(i) * ci;
+                shat(0) += si(0, i);
+                shat(1) += det(si * si.t());
+                vec p = - si.t();
+                p(i) += 1.0;
+                qDiag += p % p;
+                S.row(isStoreS() ? i : 0) = si;
+            }
+            catch (const exception& e)
+            {
+                GWM_LOG_ERROR(e.what());
+                throw e;
+            }
         }
-        GWM_LOG_PROGRESS(i + 1, nDp);
+        GWM_LOG_PROGRESS(end, nDp);
     }
     betasSE = betasSE.t();
     return betas.t();
@@ -306,39 +319,82 @@ double GWRBasic::bandwidthSizeCriterionAICSerial(BandwidthWeight* bandwidthWeigh
     else return DBL_MAX;
 }
 
-double GWRBasic::indepVarsSelectionCriterionSerial(const vector<size_t>& indepVars)
+bool GWRBasic::OrthogonalizeColumn(const mat& q, const vec& x, vec& qx)
 {
-    mat x = mX.cols(VariableForwardSelector::index2uvec(indepVars, mHasIntercept));
-    vec y = mY;
-    uword nDp = mCoords.n_rows, nVar = x.n_cols;
-    mat betas(nVar, nDp, fill::zeros);
-    vec shat(2, fill::zeros);
-    for (uword i = 0; i < nDp; i++)
+    vec v = x;
+    // Orthogonalise twice so that the basis stays orthonormal in floating point.
+    for (int pass = 0; pass < 2 && q.n_cols > 0; pass++)
     {
-        GWM_LOG_STOP_BREAK(mStatus);
-        vec w(nDp, fill::ones);
-        mat xtw = trans(x.each_col() % w);
-        mat xtwx = xtw * x;
-        mat xtwy = xtw * y;
-        try
-        {
-            mat xtwx_inv = inv_sympd(xtwx);
-            betas.col(i) = xtwx_inv * xtwy;
-            mat ci = xtwx_inv * xtw;
-            mat si = x.row(i) * ci;
-            shat(0) += si(0, i);
-            shat(1) += det(si * si.t());
-        }
-        catch (const exception& e)
-        {
-            GWM_LOG_ERROR(e.what());
-            return DBL_MAX;
-        }
+        v -= q * (q.t() * v);
+    }
+    double r = norm(v);
+    if (!(r > 1e-8 * norm(x))) return false;
+    qx = v / r;
+    return true;
+}
+
+void GWRBasic::resetSelectionBasis()
+{
+    mSelectionCols.reset();
+    mSelectionQ = mat(mY.n_elem, 0);
+    mSelectionResidual = mY;
+}
+
+bool GWRBasic::updateSelectionBasis(const uvec& cols)
+{
+    bool prefix = mSelectionResidual.n_elem == mY.n_elem && mSelectionCols.n_elem <= cols.n_elem;
+    for (uword j = 0; prefix && j < mSelectionCols.n_elem; j++)
+    {
+        prefix = mSelectionCols(j) == cols(j);
+    }
+    if (!prefix) resetSelectionBasis();
+    for (uword j = mSelectionCols.n_elem; j < cols.n_elem; j++)
+    {
+        vec q;
+        if (!OrthogonalizeColumn(mSelectionQ, mX.col(cols(j)), q)) return false;
+        mSelectionQ.insert_cols(j, q);
+        mSelectionResidual -= dot(q, mSelectionResidual) * q;
+        mSelectionCols.resize(j + 1);
+        mSelectionCols(j) = cols(j);
+    }
+    return true;
+}
+
+double GWRBasic::indepVarsSelectionCriterionGlobal(const vector<size_t>& indepVars)
+{
+    uvec cols = VariableForwardSelector::index2uvec(indepVars, mHasIntercept);
+    uword nDp = mCoords.n_rows, nVar = cols.n_elem;
+    // Candidates share all but the last column with the current selection, whose basis is kept.
+    // The candidate column is then appended in O(np) instead of refitting the model.
+    // Candidates may be evaluated concurrently, so the shared basis is only touched in a critical section.
+    bool updated = false;
+    mat basis;
+    vec residual;
+#ifdef ENABLE_OPENMP
+#pragma omp critical(gwrbasic_selection_basis)
+#endif // ENABLE_OPENMP
+    {
+        updated = updateSelectionBasis(cols.head(nVar - 1));
+        basis = mSelectionQ;
+        residual = mSelectionResidual;
     }
-    GWM_LOG_PROGRESS(++mIndepVarSelectionProgressCurrent, mIndepVarSelectionProgressTotal);
+    vec q;
+    if (!updated || !OrthogonalizeColumn(basis, mX.col(cols(nVar - 1)), q))
+    {
+        GWM_LOG_ERROR("Independent variables are collinear.");
+        return DBL_MAX;
+    }
+    residual -= dot(q, residual) * q;
+    size_t progress = 0;
+#ifdef ENABLE_OPENMP
+#pragma omp atomic capture
+#endif // ENABLE_OPENMP
+    progress = ++mIndepVarSelectionProgressCurrent;
+    GWM_LOG_PROGRESS(progress, mIndepVarSelectionProgressTotal);
     if (mStatus == Status::Success)
     {
-        double value = GWRBase::AICc(x, y, betas.t(), shat);
+        // All weights are 1, so the hat matrix is the projection onto the columns and tr(S) = tr(S'S) = nVar.
+        double value = GWRBase::AICc(sum(residual % residual), double(nDp), double(nVar));
         GWM_LOG_INFO(IVarialbeSelectable::infoVariableCriterion(indepVars, value));
         return value;
     }
@@ -348,24 +404,25 @@ double GWRBasic::indepVarsSelectionCriterionSerial(const vector<size_t>& indepVa
 #ifdef ENABLE_OPENMP
 mat GWRBasic::predictOmp(const mat& locations, const mat& x, const vec& y)
 {
-    uword nRp = locations.n_rows, nVar = x.n_cols;
+    uword nRp = locations.n_rows, nDp = x.n_rows, nVar = x.n_cols;
+    uword nBlock = SpatialWeight::BlockSize(nDp), nBlocks = (nRp + nBlock - 1) / nBlock;
+    uvec order = SpatialOrder(locations);
+    mat products = CrossProducts(x, y);
     mat betas(nVar, nRp, arma::fill::zeros);
     bool success = true;
     std::exception except;
 #pragma omp parallel for num_threads(mOmpThreadNum)
-    for (int i = 0; (uword)i < nRp; i++)
+    for (int b = 0; (uword)b < nBlocks; b++)
     {
         GWM_LOG_STOP_CONTINUE(mStatus);
+        uword begin = b * nBlock;
+        uvec block = order.subvec(begin, std::min(begin + nBlock, nRp) - 1);
         if (success)
         {
-            vec w = mSpatialWeight.weightVector(i);
-            mat xtw = trans(x.each_col() % w);
-            mat xtwx = xtw * x;
-            mat xtwy = xtw * y;
+            mat weights = mSpatialWeight.weightMatrix(block);
             try
             {
-                mat xtwx_inv = inv_sympd(xtwx);
-                betas.col(i) = xtwx_inv * xtwy;
+                betas.cols(block) = BlockBetas(products, weights, nVar);
             }
             catch (const exception& e)
             {
@@ -374,7 +431,7 @@ mat GWRBasic::predictOmp(const mat& locations, const mat& x, const vec& y)
                 success = false;
             }
         }
-        GWM_LOG_PROGRESS(i + 1, nRp);
+        GWM_LOG_PROGRESS(begin + block.n_elem, nRp);
     }
     if (!success)
     {
@@ -391,41 +448,48 @@ mat GWRBasic::fitOmp(const mat& x, const vec& y, mat& betasSE, vec& shat, vec& q
     S = mat(isStoreS() ? nDp : 1, nDp, fill::zeros);
     mat shat_all(2, mOmpThreadNum, fill::zeros);
     mat qDiag_all(nDp, mOmpThreadNum, fill::zeros);
+    // Blocks are made small enough to give every thread some work.
+    uword nBlock = SpatialWeight::BlockSize(nDp, mOmpThreadNum), nBlocks = (nDp + nBlock - 1) / nBlock;
     bool success = true;
     std::exception except;
 #pragma omp parallel for num_threads(mOmpThreadNum)
-    for (int i = 0; (uword)i < nDp; i++)
+    for (int b = 0; (uword)b < nBlocks; b++)
     {
         GWM_LOG_STOP_CONTINUE(mStatus);
+        uword begin = b * nBlock, end = std::min(begin + nBlock, nDp);
         if (success)
         {
             int thread = omp_get_thread_num();
-            vec w = mSpatialWeight.weightVector(i);
-            mat xtw = trans(x.each_col() % w);
-            mat xtwx = xtw * x;
-            mat xtwy = xtw * y;
-            try
+            mat weights = mSpatialWeight.weightMatrix(regspace<uvec>(begin, end - 1));
+            for (uword i = begin; i < end && success; i++)
             {
-                mat xtwx_inv = inv_sympd(xtwx);
-                betas.col(i) = xtwx_inv * xtwy;
-                mat ci = xtwx_inv * xtw;
-                betasSE.col(i) = sum(ci % ci, 1);
-                mat si = x.row(i) * ci;
-                shat_all(0, thread) += si(0, i);
-                shat_all(1, thread) += det(si * si.t());
-                vec p = - si.t();
-                p(i) += 1.0;
-                qDiag_all.col(thread) += p % p;
-                S.row(isStoreS() ? i : 0) = si;
-            }
-            catch (const exception& e)
-            {
-                GWM_LOG_ERROR(e.what());
-                except = e;
-                success = false;
+                vec w(weights.colptr(i - begin), nDp, false, true);
+                mat xtw = trans(x.each_col() % w);
+                mat xtwx = xtw * x;
+                mat xtwy = xtw * y;
+                try
+                {
+                    mat xtwx_inv = inv_sympd(xtwx);
+                    betas.col(i) = xtwx_inv * xtwy;
+                    mat ci = xtwx_inv * xtw;
+                    betasSE.col(i) = sum(ci % ci, 1);
+                    mat si = x.row(i) * ci;
+                    shat_all(0, thread) += si(0, i);
+                    shat_all(1, thread) += det(si * si.t());
+                    vec p = - si.t();
+                    p(i) += 1.0;
+                    qDiag_all.col(thread) += p % p;
+                    S.row(isStoreS() ? i : 0) = si;
+                }
+                catch (const exception& e)
+                {
+                    GWM_LOG_ERROR(e.what());
+                    except = e;
+                    success = false;
+                }
             }
         }
-        GWM_LOG_PROGRESS(i + 1, nDp);
+        GWM_LOG_PROGRESS(end, nDp);
     }
     if (!success)
     {
@@ -534,50 +598,6 @@ double GWRBasic::bandwidthSizeCriterionAICOmp(BandwidthWeight* bandwidthWeight)
     else return DBL_MAX;
 }
 
-double GWRBasic::indepVarsSelectionCriterionOmp(const vector<size_t>& indepVars)
-{
-    mat x = mX.cols(VariableForwardSelector::index2uvec(indepVars, mHasIntercept));
-    vec y = mY;
-    uword nDp = mCoords.n_rows, nVar = x.n_cols;
-    mat betas(nVar, nDp, fill::zeros);
-    mat shat(2, mOmpThreadNum, fill::zeros);
-    int flag = true;
-#pragma omp parallel for num_threads(mOmpThreadNum)
-    for (int i = 0; (uword)i < nDp; i++)
-    {
-        GWM_LOG_STOP_CONTINUE(mStatus);
-        if (flag)
-        {
-            int thread = omp_get_thread_num();
-            vec w(nDp, fill::ones);
-            mat xtw = trans(x.each_col() % w);
-            mat xtwx = xtw * x;
-            mat xtwy = xtw * y;
-            try
-            {
-                mat xtwx_inv = inv_sympd(xtwx);
-                betas.col(i) = xtwx_inv * xtwy;
-                mat ci = xtwx_inv * xtw;
-                mat si = x.row(i) * ci;
-                shat(0, thread) += si(0, i);
-                shat(1, thread) += det(si * si.t());
-            }
-            catch (const exception& e)
-            {
-                GWM_LOG_ERROR(e.what());
-                flag = false;
-            }
-        }
-    }
-    GWM_LOG_PROGRESS(++mIndepVarSelectionProgressCurrent, mIndepVarSelectionProgressTotal);
-    if (mStatus == Status::Success && flag)
-    {
-        double value = GWRBase::AICc(x, y, betas.t(), sum(shat, 1));
-        GWM_LOG_INFO(IVarialbeSelectable::infoVariableCriterion(indepVars, value));
-        return value;
-    }
-    else return DBL_MAX;
-}
 #endif
 
 #ifdef ENABLE_CUDA
@@ -835,70 +855,6 @@ double GWRBasic::bandwidthSizeCriterionAICCuda(BandwidthWeight* bandwidthWeight)
     else return DBL_MAX;
 }
 
-double GWRBasic::indepVarsSelectionCriterionCuda(const std::vector<size_t>& indepVars)
-{
-    mat x = mX.cols(VariableForwardSelector::index2uvec(indepVars, mHasIntercept));
-    mat y = mY;
-    uword nDp = mCoords.n_rows, nVar = x.n_cols;
-    cumat u_xt(x.t()), u_y(y), u_betas(nVar, nDp);
-    cumat u_weights(vec(nDp, fill::ones));
-    custride u_xtw(nVar, nDp, mGroupLength);
-    mat betas(nVar, nDp);
-    vec shat(2), sst(mGroupLength);
-    mat sg(nDp, mGroupLength);
-    int *d_info, *p_info;
-    p_info = new int[mGroupLength];
-    checkCudaErrors(cudaMalloc(&d_info, sizeof(int) * mGroupLength));
-    bool success = true;
-    size_t groups = nDp / mGroupLength + (nDp % mGroupLength == 0 ? 0 : 1);
-    for (size_t i = 0; i < groups && success; i++)
-    {
-        GWM_LOG_STOP_BREAK(mStatus);
-        size_t begin = i * mGroupLength, length = (begin + mGroupLength > nDp) ? (nDp - begin) : mGroupLength;
-        for (size_t j = 0, e = begin + j; j < length; j++, e++)
-        {
-            u_xtw.strides(j) = u_xt.diagmul(u_weights);
-        }
-        custride u_xtwx = u_xtw * u_xt.t();
-        custride u_xtwy = u_xtw * u_y;
-        custride u_xtwxI = u_xtwx.inv(d_info);
-        checkCudaErrors(cudaMemcpy(p_info, d_info, sizeof(int) * mGroupLength, cudaMemcpyDeviceToHost));
-        for (size_t j = 0; j < mGroupLength; j++)
-        {
-            if (p_info[j] != 0)
-            {
-                GWM_LOG_ERROR("Cuda failed to get the inverse of matrix");
-                success = false;
-                break;
-            }
-        }
-        if (success)
-        {
-            u_betas.as_stride().strides(begin, begin + length) = u_xtwxI * u_xtwy;
-            custride u_c = u_xtwxI * u_xtw;
-            custride u_s = u_xt.as_stride().strides(begin, begin + length).t() * u_c;
-            custride u_sst = u_s * u_s.t();
-            u_s.get(sg.memptr());
-            u_sst.get(sst.memptr());
-            shat(0) += trace(sg.submat(begin, 0, arma::SizeMat(length, length)));
-            shat(1) += sum(sst);
-        }
-    }
-    checkCudaErrors(cudaFree(d_info));
-    delete[] p_info;
-    if (!success) return DBL_MAX;
-    u_betas.get(betas.memptr());
-    GWM_LOG_PROGRESS(++mIndepVarSelectionProgressCurrent, mIndepVarSelectionProgressTotal);
-    double aic = GWRBasic::AICc(x, y, betas.t(), shat);
-    if (isfinite(aic))
-    {
-        GWM_LOG_INFO(IVarialbeSelectable::infoVariableCriterion(indepVars, aic));
-        mBandwidthLastCriterion = aic;
-        return aic;
-    }
-    else return DBL_MAX;
-}
-
 #endif
 
 void GWRBasic::setBandwidthSelectionCriterion(const BandwidthSelectionCriterionType& criterion)
@@ -948,32 +904,60 @@ void GWRBasic::setParallelType(const ParallelType& type)
         case ParallelType::SerialOnly:
             mPredictFunction = &GWRBasic::predictSerial;
             mFitFunction = &GWRBasic::fitSerial;
-            mIndepVarsSelectionCriterionFunction = &GWRBasic::indepVarsSelectionCriterionSerial;
+            mIndepVarsSelectionCriterionFunction = &GWRBasic::indepVarsSelectionCriterionGlobal;
             break;
 #ifdef ENABLE_OPENMP
         case ParallelType::OpenMP:
             mPredictFunction = &GWRBasic::predictOmp;
             mFitFunction = &GWRBasic::fitOmp;
-            mIndepVarsSelectionCriterionFunction = &GWRBasic::indepVarsSelectionCriterionOmp;
+            mIndepVarsSelectionCriterionFunction = &GWRBasic::indepVarsSelectionCriterionGlobal;
             break;
 #endif // ENABLE_OPENMP
 #ifdef ENABLE_CUDA
         case ParallelType::CUDA:
             mPredictFunction = &GWRBasic::predictCuda;
             mFitFunction = &GWRBasic::fitCuda;
-            mIndepVarsSelectionCriterionFunction = &GWRBasic::indepVarsSelectionCriterionCuda;
+            mIndepVarsSelectionCriterionFunction = &GWRBasic::indepVarsSelectionCriterionGlobal;
             break;
 #endif // ENABLE_CUDA
         default:
             mPredictFunction = &GWRBasic::predictSerial;
             mFitFunction = &GWRBasic::fitSerial;
-            mIndepVarsSelectionCriterionFunction = &GWRBasic::indepVarsSelectionCriterionSerial;
+            mIndepVarsSelectionCriterionFunction = &GWRBasic::indepVarsSelectionCriterionGlobal;
             break;
         }
         setBandwidthSelectionCriterion(mBandwidthSelectionCriterion);
     }
 }
 
+void GWRBasic::saveModel(ModelArchive& archive) const
+{
+    GWRBase::saveModel(archive);
+    archive.setModel("GWRBasic");
+    archive.set("betasSE", mBetasSE);
+    archive.set("sHat", mSHat);
+    archive.set("qDiag", mQDiag);
+    archive.set("hasHatMatrix", mHasHatMatrix ? 1.0 : 0.0);
+    if (!mS.is_empty())
+    {
+        archive.set("s", mS);
+    }
+}
+
+void GWRBasic::loadModel(const ModelArchive& archive)
+{
+    if (archive.model() != "GWRBasic")
+    {
+        throw std::runtime_error("[GWRBasic::loadModel] The archive is saved from model " + archive.model() + ".");
+    }
+    GWRBase::loadModel(archive);
+    mBetasSE = archive.get("betasSE");
+    mSHat = archive.get("sHat");
+    mQDiag = archive.get("qDiag");
+    mHasHatMatrix = archive.scalar("hasHatMatrix") != 0.0;
+    mS = archive.contains("s") ? archive.get("s") : mat();
+}
+
 bool GWRBasic::isValid()
 {
     if (GWRBase::isValid())
@@ -1053,6 +1053,39 @@ mat GWRGeneralized::CiMat(const mat &x, const vec &w)
     return inv(trans(x) * diagmat(w) * x) * trans(x) * diagmat(w);
 }
 
+void GWRGeneralized::saveModel(ModelArchive& archive) const
+{
+    GWRBase::saveModel(archive);
+    archive.setModel("GWRGeneralized");
+    archive.set("family", double(mFamily));
+    archive.set("betasSE", mBetasSE);
+    archive.set("sHat", mShat);
+    archive.set("hasHatMatrix", mHasHatMatrix ? 1.0 : 0.0);
+    archive.set("generalizedDiagnostic", mat({ mDiagnostic.AIC, mDiagnostic.AICc, mDiagnostic.RSS, mDiagnostic.RSquare }));
+    archive.set("glmDiagnostic", mat({ mGLMDiagnostic.AIC, mGLMDiagnostic.AICc, mGLMDiagnostic.NullDev, mGLMDiagnostic.Dev, mGLMDiagnostic.RSquare }));
+}
+
+void GWRGeneralized::loadModel(const ModelArchive& archive)
+{
+    if (archive.model() != "GWRGeneralized")
+    {
+        throw std::runtime_error("[GWRGeneralized::loadModel] The archive is saved from model " + archive.model() + ".");
+    }
+    GWRBase::loadModel(archive);
+    setFamily(Family(int(archive.scalar("family"))));
+    mBetasSE = archive.get("betasSE");
+    mShat = archive.get("sHat");
+    mHasHatMatrix = archive.scalar("hasHatMatrix") != 0.0;
+    const mat& diagnostic = archive.get("generalizedDiagnostic");
+    const mat& glmDiagnostic = archive.get("glmDiagnostic");
+    if (diagnostic.n_elem != 4 || glmDiagnostic.n_elem != 5)
+    {
+        throw std::runtime_error("[GWRGeneralized::loadModel] Entries of diagnostic are broken.");
+    }
+    mDiagnostic = GWRGeneralizedDiagnostic(vec(vectorise(diagnostic)));
+    mGLMDiagnostic = GLMDiagnostic(vec(vectorise(glmDiagnostic)));
+}
+
 bool GWRGeneralized::setFamily(Family family)
 {
     mFamily = family;
@@ -42,6 +42,7 @@ mat GWRLocalCollinearity::fit()
     uword nDp = mCoords.n_rows, nVar = mX.n_cols;
     createDistanceParameter();
     GWM_LOG_STOP_RETURN(mStatus, mat(nDp, nVar, arma::fill::zeros));
+    updateScales();
 
     //setXY(mX, mY, mSourceLayer, mDepVar, mIndepVars);
     //选带宽
@@ -102,6 +103,7 @@ mat GWRLocalCollinearity::predict(const mat& locations)
     uword nDp = mCoords.n_rows, nVar = mX.n_cols;
     createPredictionDistanceParameter(locations);
     GWM_LOG_STOP_RETURN(mStatus, mat(nDp, nVar, arma::fill::zeros));
+    updateScales();
 
     mBetas = (this->*mPredictFunction)(locations, mX, mY);
     GWM_LOG_STOP_RETURN(mStatus, mat(nDp, nVar, arma::fill::zeros));
@@ -137,37 +139,78 @@ void GWRLocalCollinearity::setBandwidthSelectionCriterion(const BandwidthSelecti
     mBandwidthSelectionCriterionFunction = mapper[mBandwidthSelectionCriterion];
 }
 
-vec GWRLocalCollinearity::ridgelm(const vec& w,double lambda)
+void GWRLocalCollinearity::updateScales()
+{
+    mXsd = rowvec(mX.n_cols, fill::ones);
+    mXsd.cols(1, mX.n_cols - 1) = stddev(mX.cols(1, mX.n_cols - 1), 0);
+    mXs = mX.each_row() / mXsd;
+}
+
+double GWRLocalCollinearity::localLambda(const mat& xtw2x)
+{
+    double lambda = mLambda;
+    if (mLambdaAdjust)
+    {
+        //svd.x的奇异值为单位化后xtw2x特征值的平方根
+        vec s = sqrt(xtw2x.diag());
+        vec e = eig_sym(symmatu(xtw2x / (s * trans(s))));
+        double smax = sqrt(std::max(e.max(), 0.0)), smin = sqrt(std::max(e.min(), 0.0));
+        if (smax > mCnThresh * smin)
+        {
+            lambda = (smax - mCnThresh * smin) / (mCnThresh - 1);
+        }
+    }
+    return lambda;
+}
+
+double GWRLocalCollinearity::looResidual(uword i, const vec& w)
+{
+    uvec nz = find(w != 0.0);
+    mat xs = mXs.rows(nz);
+    mat xsw = xs.each_col() % w(nz);
+    vec c = trans(xsw) * mY(nz);
+    vec e;
+    mat q;
+    eig_sym(e, q, symmatu(trans(xs) * xsw));
+    double lambda = mLambdaAdjust ? localLambda(trans(xsw) * xsw) : mLambda;
+    vec bs = q * ((trans(q) * c) / (e + lambda));
+    return mY(i) - as_scalar(mXs.row(i) * bs);
+}
+
+vec GWRLocalCollinearity::ridgelm(const mat& xtwx, const vec& xtwy, double lambda)
 {
-    //to be done
-    //ridgelm
     //X默认加了1
     //默认add.int为False
-    mat wspan(1, mX.n_cols, fill::ones);
-    mat Xw = mX % (sqrt(w) * wspan);
-    mat yw = mY % (sqrt(w));
-    //求标准差
-    //取mX不含第一列的部分
-    mat mXnot1 = mX.cols(1, mX.n_cols - 1);
-    //标准差结果矩阵
-    mat Xsd(1, mX.n_cols, fill::ones);
-    Xsd.cols(1, mX.n_cols - 1) = stddev(mX.cols(1, mX.n_cols - 1),0);
-    //Xsd = trans(Xsd);
-    //计算Xws
-    mat Xws = Xw.each_row() / Xsd;
-    double ysd = stddev(yw.col(0));
-    mat yws = yw / ysd;
-    //计算b值
-    //计算crossprod(Xws)
-    mat tmpCrossprodXws = trans(Xws)*Xws;
-    //生成diag矩阵
-    mat tmpdiag = eye(Xws.n_cols,Xws.n_cols);
-    //方程求解
-    mat tmpXX = tmpCrossprodXws+lambda*tmpdiag;
-    mat tmpYY = trans(Xws)*yws;
-    vec resultb = inv(tmpXX)*(tmpYY)*ysd/trans(Xsd);
-    //如何返回？？
-    return resultb;
+    //按全局标准差缩放后求解，因变量的缩放在结果中相互抵消
+    vec xsd = trans(mXsd);
+    mat xtwxs = xtwx / (xsd * mXsd);
+    xtwxs.diag() += lambda;
+    return solve(xtwxs, xtwy / xsd) / xsd;
+}
+
+vec GWRLocalCollinearity::ridgeSolve(const mat& x, const vec& y, const vec& w, mat& xtwx, mat& xtw2x)
+{
+    mat xw = x.each_col() % w;
+    xtwx = trans(x) * xw;
+    xtw2x = trans(xw) * xw;
+    vec xtwy = trans(xw) * y;
+    return ridgelm(xtwx, xtwy, localLambda(xtw2x));
+}
+
+double GWRLocalCollinearity::LcrCV(double bw, uword kernel, bool adaptive, double lambda, bool lambdaAdjust, double cnThresh)
+{
+    double lambda0 = mLambda, cnThresh0 = mCnThresh;
+    bool lambdaAdjust0 = mLambdaAdjust;
+    mLambda = lambda;
+    mLambdaAdjust = lambdaAdjust;
+    mCnThresh = cnThresh;
+    updateScales();
+    BandwidthWeight bandwidthWeight(bw, adaptive, BandwidthWeight::KernelFunctionType(kernel));
+    double cv = (this->*mBandwidthSelectionCriterionFunction)(&bandwidthWeight);
+    mLambda = lambda0;
+    mLambdaAdjust = lambdaAdjust0;
+    mCnThresh = cnThresh0;
+    return cv;
 }
 
 void GWRLocalCollinearity::setParallelType(const ParallelType& type)
@@ -197,59 +240,18 @@ void GWRLocalCollinearity::setParallelType(const ParallelType& type)
 
 double GWRLocalCollinearity::bandwidthSizeCriterionCVSerial(BandwidthWeight* bandwidthWeight)
 {
-    //行数
     uword n = mX.n_rows;
-    //列数
-    uword m = mX.n_cols;
-    //初始化矩阵
-    mat betas = mat(n,m,fill::zeros);
-    vec localcn(n,fill::zeros);
-    vec locallambda(n,fill::zeros);
-    //取mX不含第一列的部分
-    mat mXnot1 = mat(mX.n_rows,mX.n_cols-1,fill::zeros);
-    for(uword i=0;i<mX.n_cols-1;i++)
-    {
-        mXnot1.col(i) = mX.col(i+1);
-    }
+    vec residual(n, fill::zeros);
     //主循环
     for (uword i = 0; i < n ; i++)
     {
         GWM_LOG_STOP_BREAK(mStatus);
-        vec distvi = mSpatialWeight.distance()->distance(i);
-        vec wgt = bandwidthWeight->weight(distvi);
-        //vec wgt = mSpatialWeight.spatialWeight(mDataPoints.row(i),mDataPoints);
+        vec wgt = mSpatialWeight.distance()->distance(i);
+        bandwidthWeight->weightInPlace(wgt);
         wgt(i) = 0;
-        mat wgtspan(1,mXnot1.n_cols,fill::ones);
-        mat wgtspan1(1,mX.n_cols,fill::ones);
-        //计算xw
-        mat xw = mXnot1 % (wgt * wgtspan);
-        //计算x1w
-        mat x1w = mX % (wgt * wgtspan1);
-        //计算用于SVD分解的矩阵
-        //计算svd.x
-        //mat U,V均为正交矩阵，S为奇异值构成的列向量
-        mat U,V;
-        colvec S;
-        svd(U,S,V,x1w.each_row() / sqrt(sum(x1w % x1w, 0)));
-        //赋值操作
-        //S.print();
-        //qDebug() << S(m);
-        localcn(i)=S(0)/S(m-1);
-        locallambda(i) = mLambda;
-        if(mLambdaAdjust){
-            if(localcn(i)>mCnThresh){
-                locallambda(i) = (S(0) - mCnThresh*S(m-1)) / (mCnThresh - 1);
-            }
-        }
-        betas.row(i) = trans( ridgelm(wgt,locallambda(i)) );
+        residual(i) = looResidual(i, wgt);
     }
-    //yhat赋值
-    //vec mYHat = fitted(mX,betas);
-    vec yhat = sum(betas % mX,1);
-    //计算residual
-    vec residual = mY - yhat;
     //计算cv
-
     double cv = sum(residual % residual);
     if (mStatus == Status::Success && isfinite(cv))
     {
@@ -264,57 +266,18 @@ double GWRLocalCollinearity::bandwidthSizeCriterionCVSerial(BandwidthWeight* ban
 #ifdef ENABLE_OPENMP
 double GWRLocalCollinearity::bandwidthSizeCriterionCVOmp(BandwidthWeight* bandwidthWeight)
 {
-    //行数
     uword n = mX.n_rows;
-    //列数
-    uword m = mX.n_cols;
-    //初始化矩阵
-    mat betas = mat(n,m,fill::zeros);
-    vec localcn(n,fill::zeros);
-    vec locallambda(n,fill::zeros);
-    //取mX不含第一列的部分
-    mat mXnot1 = mX.cols(1, mX.n_cols - 1);
+    vec residual(n, fill::zeros);
     //主循环
-    uword current = 0;
 #pragma omp parallel for num_threads(mOmpThreadNum)
     for (int i = 0; i <(int) n; i++)
     {
         GWM_LOG_STOP_CONTINUE(mStatus);
-        //int thread = omp_get_thread_num();
-        vec distvi = mSpatialWeight.distance()->distance(i);
-        vec wgt = bandwidthWeight->weight(distvi);
-        //vec wgt = mSpatialWeight.spatialWeight(mDataPoints.row(i),mDataPoints);
+        vec wgt = mSpatialWeight.distance()->distance(i);
+        bandwidthWeight->weightInPlace(wgt);
         wgt(i) = 0;
-        mat wgtspan(1,mXnot1.n_cols,fill::ones);
-        mat wgtspan1(1,mX.n_cols,fill::ones);
-        //计算xw
-        mat xw = mXnot1 % (wgt * wgtspan);
-        //计算x1w
-        mat x1w = mX % (wgt * wgtspan1);
-        //计算用于SVD分解的矩阵
-        //计算svd.x
-        //mat U,V均为正交矩阵，S为奇异值构成的列向量
-        mat U,V;
-        colvec S;
-        svd(U,S,V,x1w.each_row() / sqrt(sum(x1w % x1w, 0)));
-        //赋值操作
-        //S.print();
-        //qDebug() << S(m);
-        localcn(i)=S(0)/S(m-1);
-        locallambda(i) = mLambda;
-        if(mLambdaAdjust){
-            if(localcn(i)>mCnThresh){
-                locallambda(i) = (S(0) - mCnThresh*S(m-1)) / (mCnThresh - 1);
-            }
-        }
-        betas.row(i) = trans( ridgelm(wgt,locallambda(i)) );
-        current++;
+        residual(i) = looResidual(i, wgt);
     }
-    //yhat赋值
-    //vec mYHat = fitted(mX,betas);
-    vec yhat = sum(betas % mX,1);
-    //计算residual
-    vec residual = mY - yhat;
     //计算cv
     double cv = sum(residual % residual);
     if (mStatus == Status::Success && isfinite(cv))
@@ -331,85 +294,35 @@ mat GWRLocalCollinearity::fitSerial(const mat& x, const vec& y)
 {
     uword nDp = mCoords.n_rows, nVar = x.n_cols;
     mat betas(nDp, nVar, fill::zeros);
-    vec localcn(nDp, fill::zeros);
-    vec locallambda(nDp, fill::zeros);
-    vec hatrow(nDp, fill::zeros);
+    mat xtwx, xtw2x;
+    double trS = 0.0, trStS = 0.0;
     for(uword i=0;i<nDp ;i++)
     {
         GWM_LOG_STOP_BREAK(mStatus);
-        vec wi =mSpatialWeight.weightVector(i);
-        //计算xw
-        //取mX不含第一列的部分
-        mat mXnot1 = x.cols(1, x.n_cols - 1);
-        mat wispan(1,mXnot1.n_cols,fill::ones);
-        mat wispan1(1,x.n_cols,fill::ones);
-        //计算xw
-        mat xw = mXnot1 % (wi * wispan);
-        //计算x1w
-        mat x1w = x % (wi * wispan1);
-        //计算svd.x
-        //mat U,V均为正交矩阵，S为奇异值构成的列向量
-        mat U,V;
-        colvec S;
-        svd(U,S,V,x1w.each_row() / sqrt(sum(x1w % x1w, 0)));
-        //qDebug() << mX.n_cols;
-        //赋值操作
-        localcn(i)=S(0)/S(x.n_cols-1);
-        locallambda(i) = mLambda;
-        if(mLambdaAdjust){
-            if(localcn(i)>mCnThresh){
-                locallambda(i) = (S(0) - mCnThresh*S(x.n_cols-1)) / (mCnThresh - 1);
-            }
-        }
-        betas.row(i) = trans(ridgelm(wi,locallambda(i)) );
-        //如果没有给regressionpoint
-        mat xm = x;
-        mat xtw = trans(x % (wi * wispan1));
-        mat xtwx = xtw * x;
-        mat xtwxinv = inv(xtwx);
-        rowvec hatrow = x1w.row(i) * xtwxinv * trans(x1w);
-        this->mTrS += hatrow(i);
-        this->mTrStS += sum(hatrow % hatrow);
+        vec wi = mSpatialWeight.weightVector(i);
+        betas.row(i) = trans(ridgeSolve(x, y, wi, xtwx, xtw2x));
+        //hatrow = w_i x_i (X^T W X)^{-1} X^T W
+        vec v = solve(xtwx, trans(x.row(i)));
+        double wi2 = wi(i) * wi(i);
+        trS += wi2 * as_scalar(x.row(i) * v);
+        trStS += wi2 * as_scalar(trans(v) * xtw2x * v);
         GWM_LOG_PROGRESS(i + 1, nDp);
     }
+    mTrS = trS;
+    mTrStS = trStS;
     return betas;
 }
 
 mat GWRLocalCollinearity::predictSerial(const arma::mat &locations, const mat& x, const vec& y)
 {
-    uword nRp = locations.n_rows, nVar = mX.n_cols;
+    uword nRp = locations.n_rows, nVar = x.n_cols;
     mat betas(nRp, nVar, fill::zeros);
-    vec localcn(nRp, fill::zeros);
-    vec locallambda(nRp, fill::zeros);
-    vec hatrow(nRp, fill::zeros);
+    mat xtwx, xtw2x;
     for(uword i=0;i<nRp ;i++)
     {
         GWM_LOG_STOP_BREAK(mStatus);
-        vec wi =mSpatialWeight.weightVector(i);
-        //计算xw
-        //取mX不含第一列的部分
-        mat mXnot1 = x.cols(1, x.n_cols - 1);
-        mat wispan(1,mXnot1.n_cols,fill::ones);
-        mat wispan1(1,x.n_cols,fill::ones);
-        //计算xw
-        mat xw = mXnot1 % (wi * wispan);
-        //计算x1w
-        mat x1w = x % (wi * wispan1);
-        //计算svd.x
-        //mat U,V均为正交矩阵，S为奇异值构成的列向量
-        mat U,V;
-        colvec S;
-        svd(U,S,V,x1w.each_row() / sqrt(sum(x1w % x1w, 0)));
-        //qDebug() << mX.n_cols;
-        //赋值操作
-        localcn(i)=S(0)/S(x.n_cols-1);
-        locallambda(i) = mLambda;
-        if(mLambdaAdjust){
-            if(localcn(i)>mCnThresh){
-                locallambda(i) = (S(0) - mCnThresh*S(x.n_cols-1)) / (mCnThresh - 1);
-            }
-        }
-        betas.row(i) = trans(ridgelm(wi,locallambda(i)) );
+        vec wi = mSpatialWeight.weightVector(i);
+        betas.row(i) = trans(ridgeSolve(x, y, wi, xtwx, xtw2x));
         GWM_LOG_PROGRESS(i + 1, nRp);
     }
     return betas;
@@ -420,105 +333,47 @@ mat GWRLocalCollinearity::fitOmp(const mat& x, const vec& y)
 {
     uword nDp = mCoords.n_rows, nVar = x.n_cols;
     mat betas(nDp, nVar, fill::zeros);
-    vec localcn(nDp, fill::zeros);
-    vec locallambda(nDp, fill::zeros);
-    vec hatrow(nDp, fill::zeros);
     mat shat_all(2, mOmpThreadNum, fill::zeros);
-    //int current = 0;
-#pragma omp parallel for num_threads(mOmpThreadNum)
-    for(int i=0;i <(int)nDp;i++)
+#pragma omp parallel num_threads(mOmpThreadNum)
     {
-        GWM_LOG_STOP_CONTINUE(mStatus);
         int thread = omp_get_thread_num();
-        vec wi = mSpatialWeight.weightVector(i);
-        //计算xw
-        //取mX不含第一列的部分
-        mat mXnot1 = x.cols(1, x.n_cols - 1);
-        mat wispan(1,mXnot1.n_cols,fill::ones);
-        mat wispan1(1,x.n_cols,fill::ones);
-        //计算xw
-        mat xw = mXnot1 % (wi * wispan);
-        //计算x1w
-        mat x1w = x % (wi * wispan1);
-        //计算svd.x
-        //mat U,V均为正交矩阵，S为奇异值构成的列向量
-        mat U,V;
-        colvec S;
-        svd(U,S,V,x1w.each_row() / sqrt(sum(x1w % x1w, 0)));
-        //qDebug() << mX.n_cols;
-        //赋值操作
-        localcn(i)=S(0)/S(x.n_cols-1);
-        locallambda(i) = mLambda;
-        if(mLambdaAdjust){
-            if(localcn(i)>mCnThresh){
-                locallambda(i) = (S(0) - mCnThresh*S(x.n_cols-1)) / (mCnThresh - 1);
-            }
+        mat xtwx, xtw2x;
+#pragma omp for
+        for(int i=0;i <(int)nDp;i++)
+        {
+            GWM_LOG_STOP_CONTINUE(mStatus);
+            vec wi = mSpatialWeight.weightVector(i);
+            betas.row(i) = trans(ridgeSolve(x, y, wi, xtwx, xtw2x));
+            //hatrow = w_i x_i (X^T W X)^{-1} X^T W
+            vec v = solve(xtwx, trans(x.row(i)));
+            double wi2 = wi(i) * wi(i);
+            shat_all(0, thread) += wi2 * as_scalar(x.row(i) * v);
+            shat_all(1, thread) += wi2 * as_scalar(trans(v) * xtw2x * v);
+            GWM_LOG_PROGRESS(i + 1, nDp);
         }
-        betas.row(i) = trans( ridgelm(wi,locallambda(i)) );
-        //如果没有给regressionpoint
-        mat xm = x;
-        mat xtw = trans(x % (wi * wispan1));
-        mat xtwx = xtw * x;
-        mat xtwxinv = inv(xtwx);
-        rowvec hatrow = x1w.row(i) * xtwxinv * trans(x1w);
-        shat_all(0, thread) += hatrow(i);
-        shat_all(1, thread) += sum(hatrow % hatrow);
-        this->mTrS += hatrow(i);
-        this->mTrStS += sum(hatrow % hatrow);
-        GWM_LOG_PROGRESS(i + 1, nDp);
     }
     vec shat = sum(shat_all,1);
-    this->mTrS = sum(shat.row(0));
-    this->mTrStS = sum(shat.row(1));
+    this->mTrS = shat(0);
+    this->mTrStS = shat(1);
     return betas;
 }
 
 mat GWRLocalCollinearity::predictOmp(const arma::mat &locations, const mat& x, const vec& y)
 {
-    uword nRp = locations.n_rows, nVar = mX.size() + 1;
+    uword nRp = locations.n_rows, nVar = x.n_cols;
     mat betas(nRp, nVar, fill::zeros);
-    vec localcn(nRp, fill::zeros);
-    vec locallambda(nRp, fill::zeros);
-    vec hatrow(nRp, fill::zeros);
-
-    mat shat_all(2, mOmpThreadNum, fill::zeros);
-    //int current = 0;
-#pragma omp parallel for num_threads(mOmpThreadNum)
-    for(int i=0;i <(int)nRp;i++)
+#pragma omp parallel num_threads(mOmpThreadNum)
     {
-        GWM_LOG_STOP_CONTINUE(mStatus);
-        vec wi = mSpatialWeight.weightVector(i);
-        //计算xw
-        //取mX不含第一列的部分
-        mat mXnot1 = x.cols(1, x.n_cols - 1);
-        mat wispan(1,mXnot1.n_cols,fill::ones);
-        mat wispan1(1,x.n_cols,fill::ones);
-        //计算xw
-        mat xw = mXnot1 % (wi * wispan);
-        //计算x1w
-        mat x1w = x % (wi * wispan1);
-        //计算svd.x
-        //mat U,V均为正交矩阵，S为奇异值构成的列向量
-        mat U,V;
-        colvec S;
-        svd(U,S,V,x1w.each_row() / sqrt(sum(x1w % x1w, 0)));
-        //qDebug() << mX.n_cols;
-        //赋值操作
-        localcn(i)=S(0)/S(x.n_cols-1);
-        locallambda(i) = mLambda;
-        if(mLambdaAdjust){
-            if(localcn(i)>mCnThresh){
-                locallambda(i) = (S(0) - mCnThresh*S(x.n_cols-1)) / (mCnThresh - 1);
-            }
+        mat xtwx, xtw2x;
+#pragma omp for
+        for(int i=0;i <(int)nRp;i++)
+        {
+            GWM_LOG_STOP_CONTINUE(mStatus);
+            vec wi = mSpatialWeight.weightVector(i);
+            betas.row(i) = trans(ridgeSolve(x, y, wi, xtwx, xtw2x));
+            GWM_LOG_PROGRESS(i + 1, nRp);
         }
-        betas.row(i) = trans( ridgelm(wi,locallambda(i)) );
-        GWM_LOG_PROGRESS(i + 1, nRp);
     }
-    vec shat = sum(shat_all,1);
-    this->mTrS = sum(shat.row(0));
-    this->mTrStS = sum(shat.row(1));
     return betas;
 }
 #endif
-
-
@@ -5,6 +5,7 @@
 #include <exception>
 #include <vector>
 #include <string>
+#include <random>
 #include <spatialweight/CRSDistance.h>
 #include "BandwidthSelector.h"
 #include "VariableForwardSelector.h"
@@ -162,9 +163,18 @@ mat GWRMultiscale::fit()
     // 初始化诊断信息矩阵
     if (mHasHatMatrix)
     {
-        mS0 = mat(nDp, nDp, fill::zeros);
-        mSArray = cube(nDp, nDp, nVar, fill::zeros);
-        mC = cube(nVar, nDp, nDp, fill::zeros);
+        uword nCol = nDp;
+        if (mHatMatrixProbes > 0)
+        {
+            nCol = mHatMatrixProbes;
+            mHatProbes = mat(nDp, nCol);
+            std::mt19937_64 gen(mHatMatrixProbeSeed);
+            std::bernoulli_distribution sign(0.5);
+            mHatProbes.imbue([&]() { return sign(gen) ? 1.0 : -1.0; });
+        }
+        mS0 = mat(nDp, nCol, fill::zeros);
+        mSArray = cube(nDp, nCol, nVar, fill::zeros);
+        mC = cube(nVar, nCol, nDp, fill::zeros);
     }
 
     GWM_LOG_STAGE("Model fitting");
@@ -173,10 +183,7 @@ mat GWRMultiscale::fit()
 
     // Diagnostic
     GWM_LOG_STAGE("Model Diagnostic");
-    vec shat = { 
-        mHasHatMatrix ? trace(mS0) : 0,
-        mHasHatMatrix ? trace(mS0.t() * mS0) : 0
-    };
+    vec shat = mHasHatMatrix ? hatMatrixTraces() : vec(2, fill::zeros);
     mDiagnostic = CalcDiagnostic(mX, mY, shat, mRSS0);
     if (mHasHatMatrix)
     {
@@ -296,7 +303,7 @@ mat GWRMultiscale::backfitting(const mat &x, const vec &y)
             if (mHasHatMatrix)
             {
                 mat SArrayi = mSArray.slice(i) - mS0;
-                mSArray.slice(i) = S * SArrayi + S;
+                mSArray.slice(i) = mHatMatrixProbes > 0 ? hatMatrixProduct(S, SArrayi + mHatProbes) : mat(hatMatrixProduct(S, SArrayi) + S);
                 mS0 = mSArray.slice(i) - SArrayi;
             }
             resid = y - Fitted(x, betas);
@@ -316,6 +323,69 @@ mat GWRMultiscale::backfitting(const mat &x, const vec &y)
     return betas;
 }
 
+mat GWRMultiscale::hatMatrixProduct(const mat& S, const mat& A)
+{
+    uword nnz = accu(S != 0.0);
+    return (nnz * 4 < S.n_elem) ? mat(sp_mat(S) * A) : mat(S * A);
+}
+
+vec GWRMultiscale::hatMatrixTraces() const
+{
+    if (mHatMatrixProbes > 0)
+    {
+        double m = double(mHatMatrixProbes);
+        return { accu(mHatProbes % mS0) / m, accu(mS0 % mS0) / m };
+    }
+    return { trace(mS0), accu(mS0 % mS0) };
+}
+
+void GWRMultiscale::saveModel(ModelArchive& archive) const
+{
+    archive.setModel("GWRMultiscale");
+    archive.setRegression(mCoords, mX, mY, mBetas, mHasIntercept, mDiagnostic);
+    archive.set("betasSE", mBetasSE);
+    archive.set("betasTV", mBetasTV);
+    archive.set("spatialWeights", double(mSpatialWeights.size()));
+    for (size_t i = 0; i < mSpatialWeights.size(); i++)
+    {
+        archive.setSpatialWeight("spatialWeight" + to_string(i), mSpatialWeights[i]);
+    }
+}
+
+void GWRMultiscale::loadModel(const ModelArchive& archive)
+{
+    if (archive.model() != "GWRMultiscale")
+    {
+        throw std::runtime_error("[GWRMultiscale::loadModel] The archive is saved from model " + archive.model() + ".");
+    }
+    archive.regression(mCoords, mX, mY, mBetas, mHasIntercept, mDiagnostic);
+    mBetasSE = archive.get("betasSE");
+    mBetasTV = archive.get("betasTV");
+    double nWeights = archive.scalar("spatialWeights");
+    if (nWeights != double(mX.n_cols))
+    {
+        throw std::runtime_error("[GWRMultiscale::loadModel] Entry spatialWeights is broken.");
+    }
+    vector<SpatialWeight> spatialWeights;
+    for (size_t i = 0; i < mX.n_cols; i++)
+    {
+        spatialWeights.push_back(archive.spatialWeight("spatialWeight" + to_string(i)));
+    }
+    setSpatialWeights(spatialWeights);
+}
+
+void GWRMultiscale::save(const string& path) const
+{
+    ModelArchive archive;
+    saveModel(archive);
+    archive.save(path);
+}
+
+void GWRMultiscale::load(const string& path)
+{
+    loadModel(ModelArchive::load(path));
+}
+
 bool GWRMultiscale::isValid()
 {
     if (!(mX.n_cols > 0))
@@ -380,8 +450,16 @@ mat GWRMultiscale::fitAllSerial(const mat& x, const vec& y)
                 mat ci = xtwx_inv * xtw;
                 betasSE.col(i) = sum(ci % ci, 1);
                 mat si = x.row(i) * ci;
-                mS0.row(i) = si;
-                mC.slice(i) = ci;
+                if (mHatMatrixProbes > 0)
+                {
+                    mS0.row(i) = si * mHatProbes;
+                    mC.slice(i) = ci * mHatProbes;
+                }
+                else
+                {
+                    mS0.row(i) = si;
+                    mC.slice(i) = ci;
+                }
             }
             catch (const exception& e)
             {
@@ -662,8 +740,16 @@ mat GWRMultiscale::fitAllOmp(const mat &x, const vec &y)
                 mat ci = xtwx_inv * xtw;
                 betasSE.col(i) = sum(ci % ci, 1);
                 mat si = x.row(i) * ci;
-                mS0.row(i) = si;
-                mC.slice(i) = ci;
+                if (mHatMatrixProbes > 0)
+                {
+                    mS0.row(i) = si * mHatProbes;
+                    mC.slice(i) = ci * mHatProbes;
+                }
+                else
+                {
+                    mS0.row(i) = si;
+                    mC.slice(i) = ci;
+                }
             }
             catch (const exception& e)
             {
@@ -1012,9 +1098,20 @@ mat GWRMultiscale::fitAllCuda(const mat& x, const vec& y)
             custride u_s = u_xt.as_stride().strides(begin, begin + length).t() * u_c;
             custride u_cct = u_c * u_c.t();
             u_s.get(si.memptr());
-            mS0.rows(begin, begin + length - 1) = si.head_cols(length).t();
             u_c.get(ci.memptr());
-            mC.slices(begin, begin + length - 1) = ci.head_slices(length);
+            if (mHatMatrixProbes > 0)
+            {
+                mS0.rows(begin, begin + length - 1) = si.head_cols(length).t() * mHatProbes;
+                for (size_t j = 0; j < length; j++)
+                {
+                    mC.slice(begin + j) = ci.slice(j) * mHatProbes;
+                }
+            }
+            else
+            {
+                mS0.rows(begin, begin + length - 1) = si.head_cols(length).t();
+                mC.slices(begin, begin + length - 1) = ci.head_slices(length);
+            }
             u_cct.get(cct.memptr());
             for (size_t j = 0, e = i * mGroupLength + j; j < mGroupLength && e < nDp; j++, e++)
             {
@@ -0,0 +1,130 @@
+#include "GWRPredictor.h"
+#include <cmath>
+#include <stdexcept>
+#include "spatialweight/CRSDistance.h"
+#include "spatialweight/MinkwoskiDistance.h"
+
+using namespace std;
+using namespace arma;
+using namespace gwm;
+
+namespace
+{
+const BandwidthWeight& bandwidthOf(const GWRBasic& model)
+{
+    const BandwidthWeight* bw = dynamic_cast<const BandwidthWeight*>(model.spatialWeight().weight());
+    if (bw == nullptr)
+    {
+        throw runtime_error("[GWRPredictor] Only bandwidth weights are supported.");
+    }
+    if (bw->adaptive() ? bw->bandwidth() < 1.0 : !(bw->bandwidth() > 0.0))
+    {
+        throw runtime_error("[GWRPredictor] Bandwidth is invalid.");
+    }
+    return *bw;
+}
+
+bool geographicOf(const GWRBasic& model)
+{
+    const CRSDistance* distance = dynamic_cast<const CRSDistance*>(model.spatialWeight().distance());
+    if (distance == nullptr || dynamic_cast<const MinkwoskiDistance*>(distance) != nullptr)
+    {
+        throw runtime_error("[GWRPredictor] Only CRSDistance is supported.");
+    }
+    return distance->geographic();
+}
+
+bool isCompact(BandwidthWeight::KernelFunctionType kernel)
+{
+    return kernel == BandwidthWeight::Bisquare || kernel == BandwidthWeight::Tricube || kernel == BandwidthWeight::Boxcar;
+}
+}
+
+GWRPredictor::GWRPredictor(const GWRBasic& model) : GWRPredictor(model, bandwidthOf(model))
+{
+}
+
+GWRPredictor::GWRPredictor(const GWRBasic& model, const BandwidthWeight& weight) :
+    mCoords(model.coords()),
+    mX(model.independentVariables()),
+    mY(model.dependentVariable()),
+    mBandwidth(weight.bandwidth()),
+    mAdaptive(weight.adaptive()),
+    mKernel(weight.kernel()),
+    mGeographic(geographicOf(model)),
+    mTree(mCoords, mGeographic)
+{
+    if (mCoords.n_rows == 0 || mX.n_rows != mCoords.n_rows || mY.n_rows != mCoords.n_rows)
+    {
+        throw runtime_error("[GWRPredictor] The model has no valid data.");
+    }
+}
+
+GWRPredictor::Workspace& GWRPredictor::workspace()
+{
+    static thread_local Workspace ws;
+    return ws;
+}
+
+void GWRPredictor::neighbours(const rowvec& location, uvec& index, vec& weights) const
+{
+    uword nDp = mCoords.n_rows;
+    bool compact = isCompact(mKernel);
+    double bw = mBandwidth;
+    if (mAdaptive)
+    {
+        if (mBandwidth < nDp)
+        {
+            // The same interpolation as BandwidthWeight::distanceBandwidth(), which needs the k+1 nearest distances.
+            double b0 = floor(mBandwidth), bx = mBandwidth - b0;
+            uword k = uword(b0);
+            mTree.nearest(location, k + 1, index, weights);
+            bw = weights(k - 1) + (weights(k) - weights(k - 1)) * bx;
+            if (compact)
+            {
+                // Farther points have zero weights, and distances are ascending.
+                uword m = 0;
+                while (m < weights.n_elem && weights(m) < bw) m++;
+                index.resize(m);
+                weights.resize(m);
+                BandwidthWeight::KernelInPlace[mKernel](weights.memptr(), weights.n_elem, bw);
+                return;
+            }
+        }
+        else
+        {
+            bw = mBandwidth / nDp * mTree.farthest(location, 0.0);
+        }
+    }
+    if (compact)
+    {
+        mTree.within(location, bw, index, weights);
+    }
+    else
+    {
+        index = regspace<uvec>(0, nDp - 1);
+        weights = mGeographic ? CRSDistance::SpatialDistance(location, mCoords) : CRSDistance::EuclideanDistance(location, mCoords);
+    }
+    BandwidthWeight::KernelInPlace[mKernel](weights.memptr(), weights.n_elem, bw);
+}
+
+rowvec GWRPredictor::predict(const rowvec& location) const
+{
+    Workspace& ws = workspace();
+    neighbours(location, ws.index, ws.weights);
+    ws.x = mX.rows(ws.index);
+    ws.xtw = trans(ws.x.each_col() % ws.weights);
+    mat xtwx = ws.xtw * ws.x;
+    vec xtwy = ws.xtw * mY.elem(ws.index);
+    return trans(inv_sympd(xtwx) * xtwy);
+}
+
+mat GWRPredictor::predict(const mat& locations) const
+{
+    mat betas(locations.n_rows, mX.n_cols);
+    for (uword i = 0; i < locations.n_rows; i++)
+    {
+        betas.row(i) = predict(rowvec(locations.row(i)));
+    }
+    return betas;
+}
@@ -134,13 +134,27 @@ mat GWRRobust::fitSerial(const mat& x, const vec& y, mat& betasSE, vec& shat, ve
     shat = vec(2, fill::zeros);
     qDiag = vec(nDp, fill::zeros);
     S = mat(isStoreS() ? nDp : 1, nDp, fill::zeros);
+    bool cached = isLocalProductsCached(x);
+    uvec changed;
+    vec delta;
+    prepareLocalProducts(x, cached, changed, delta);
     for (uword i = 0; i < nDp; i++)
     {
         GWM_LOG_STOP_BREAK(mStatus);
-        vec w = mSpatialWeight.weightVector(i) % mWeightMask;
+        vec wi = mSpatialWeight.weightVector(i);
+        vec w = wi % mWeightMask;
         mat xtw = trans(x.each_col() % w);
-        mat xtwx = xtw * x;
-        mat xtwy = xtw * y;
+        if (cached)
+        {
+            updateLocalProducts(i, x, y, wi, changed, delta);
+        }
+        else
+        {
+            mLocalXtWX.slice(i) = xtw * x;
+            mLocalXtWy.col(i) = xtw * y;
+        }
+        const mat& xtwx = mLocalXtWX.slice(i);
+        mat xtwy = mLocalXtWy.col(i);
         try
         {
             mat xtwx_inv = inv_sympd(xtwx);
@@ -162,6 +176,7 @@ mat GWRRobust::fitSerial(const mat& x, const vec& y, mat& betasSE, vec& shat, ve
         }
         GWM_LOG_PROGRESS(i + 1, nDp);
     }
+    mLocalMask = mWeightMask;
     betasSE = betasSE.t();
     return betas.t();
 }
@@ -177,6 +192,10 @@ mat GWRRobust::fitOmp(const mat& x, const vec& y, mat& betasSE, vec& shat, vec&
     mat qDiag_all(nDp, mOmpThreadNum, fill::zeros);
     bool success = true;
     std::exception except;
+    bool cached = isLocalProductsCached(x);
+    uvec changed;
+    vec delta;
+    prepareLocalProducts(x, cached, changed, delta);
 #pragma omp parallel for num_threads(mOmpThreadNum)
     for (int i = 0; i < (int)nDp; i++)
     {
@@ -184,10 +203,20 @@ mat GWRRobust::fitOmp(const mat& x, const vec& y, mat& betasSE, vec& shat, vec&
         if (success)
         {
             int thread = omp_get_thread_num();
-            vec w = mSpatialWeight.weightVector(i) % mWeightMask;
+            vec wi = mSpatialWeight.weightVector(i);
+            vec w = wi % mWeightMask;
             mat xtw = trans(x.each_col() % w);
-            mat xtwx = xtw * x;
-            mat xtwy = xtw * y;
+            if (cached)
+            {
+                updateLocalProducts(i, x, y, wi, changed, delta);
+            }
+            else
+            {
+                mLocalXtWX.slice(i) = xtw * x;
+                mLocalXtWy.col(i) = xtw * y;
+            }
+            const mat& xtwx = mLocalXtWX.slice(i);
+            mat xtwy = mLocalXtWy.col(i);
             try
             {
                 mat xtwx_inv = inv_sympd(xtwx);
@@ -215,6 +244,7 @@ mat GWRRobust::fitOmp(const mat& x, const vec& y, mat& betasSE, vec& shat, vec&
     {
         throw except;
     }
+    mLocalMask = mWeightMask;
     shat = sum(shat_all, 1);
     qDiag = sum(qDiag_all, 1);
     betasSE = betasSE.t();
@@ -222,9 +252,132 @@ mat GWRRobust::fitOmp(const mat& x, const vec& y, mat& betasSE, vec& shat, vec&
 }
 #endif
 
+bool GWRRobust::isLocalProductsCached(const mat& x) const
+{
+    uword nDp = x.n_rows, nVar = x.n_cols;
+    return mLocalXtWX.n_slices == nDp && mLocalXtWX.n_rows == nVar && mLocalMask.n_elem == nDp;
+}
+
+void GWRRobust::prepareLocalProducts(const mat& x, bool cached, uvec& changed, vec& delta)
+{
+    if (cached)
+    {
+        changed = find(mWeightMask != mLocalMask);
+        delta = mWeightMask(changed) - mLocalMask(changed);
+    }
+    else
+    {
+        mLocalXtWX.set_size(x.n_cols, x.n_cols, x.n_rows);
+        mLocalXtWy.set_size(x.n_cols, x.n_rows);
+    }
+}
+
+void GWRRobust::updateLocalProducts(uword i, const mat& x, const vec& y, const vec& w, const uvec& changed, const vec& delta)
+{
+    if (changed.n_elem == 0) return;
+    vec d = w(changed) % delta;
+    uvec inside = find(d != 0.0);
+    if (inside.n_elem == 0) return;
+    uvec rows = changed(inside);
+    d = d(inside);
+    mat xc = x.rows(rows);
+    mLocalXtWX.slice(i) += xc.t() * (xc.each_col() % d);
+    mLocalXtWy.col(i) += xc.t() * (d % y(rows));
+}
+
+mat GWRRobust::localBetasSerial(const mat& x, const vec& y)
+{
+    uword nDp = x.n_rows, nVar = x.n_cols;
+    mat betas(nVar, nDp, fill::zeros);
+    bool cached = isLocalProductsCached(x);
+    uvec changed;
+    vec delta;
+    prepareLocalProducts(x, cached, changed, delta);
+    for (uword i = 0; i < nDp; i++)
+    {
+        GWM_LOG_STOP_BREAK(mStatus);
+        if (!cached)
+        {
+            vec w = mSpatialWeight.weightVector(i) % mWeightMask;
+            mat xtw = trans(x.each_col() % w);
+            mLocalXtWX.slice(i) = xtw * x;
+            mLocalXtWy.col(i) = xtw * y;
+        }
+        else if (changed.n_elem > 0)
+        {
+            updateLocalProducts(i, x, y, mSpatialWeight.weightVector(i), changed, delta);
+        }
+        try
+        {
+            mat xtwx_inv = inv_sympd(mLocalXtWX.slice(i));
+            betas.col(i) = xtwx_inv * mLocalXtWy.col(i);
+        }
+        catch (const exception& e)
+        {
+            GWM_LOG_ERROR(e.what());
+            throw e;
+        }
+    }
+    mLocalMask = mWeightMask;
+    return betas.t();
+}
+
+#ifdef ENABLE_OPENMP
+mat GWRRobust::localBetasOmp(const mat& x, const vec& y)
+{
+    uword nDp = x.n_rows, nVar = x.n_cols;
+    mat betas(nVar, nDp, fill::zeros);
+    bool cached = isLocalProductsCached(x);
+    uvec changed;
+    vec delta;
+    prepareLocalProducts(x, cached, changed, delta);
+    bool success = true;
+    std::exception except;
+#pragma omp parallel for num_threads(mOmpThreadNum)
+    for (int i = 0; i < (int)nDp; i++)
+    {
+        GWM_LOG_STOP_CONTINUE(mStatus);
+        if (success)
+        {
+            if (!cached)
+            {
+                vec w = mSpatialWeight.weightVector(i) % mWeightMask;
+                mat xtw = trans(x.each_col() % w);
+                mLocalXtWX.slice(i) = xtw * x;
+                mLocalXtWy.col(i) = xtw * y;
+            }
+            else if (changed.n_elem > 0)
+            {
+                updateLocalProducts(i, x, y, mSpatialWeight.weightVector(i), changed, delta);
+            }
+            try
+            {
+                mat xtwx_inv = inv_sympd(mLocalXtWX.slice(i));
+                betas.col(i) = xtwx_inv * mLocalXtWy.col(i);
+            }
+            catch (const exception& e)
+            {
+                GWM_LOG_ERROR(e.what());
+                except = e;
+                success = false;
+            }
+        }
+    }
+    if (!success)
+    {
+        throw except;
+    }
+    mLocalMask = mWeightMask;
+    return betas.t();
+}
+#endif
+
 
 mat GWRRobust::regressionHatmatrix(const mat &x, const vec &y, mat &betasSE, vec &shat, vec &qdiag, mat &S)
 {
+    mLocalXtWX.reset();
+    mLocalXtWy.reset();
+    mLocalMask.reset();
     if (mFiltered)
     {
         return robustGWRCaliFirst(x, y, betasSE, shat, qdiag, S);
@@ -281,7 +434,7 @@ mat GWRRobust::robustGWRCaliSecond(const mat &x, const vec &y, mat &betasSE, vec
     double diffmse = 1;
     double delta = 1.0e-5;
     double maxiter = 20;
-    mat betas = (this->*mfitFunction)(x, y, betasSE, shat, qDiag, S);
+    mat betas = (this->*mLocalBetasFunction)(x, y);
     GWM_LOG_STOP_RETURN(mStatus, betas);
 
     //计算residual
@@ -296,7 +449,7 @@ mat GWRRobust::robustGWRCaliSecond(const mat &x, const vec &y, mat &betasSE, vec
     while (diffmse > delta && iter < maxiter)
     {
         double oldmse = mse;
-        betas = (this->*mfitFunction)(x, y, betasSE, shat, qDiag, S);
+        betas = (this->*mLocalBetasFunction)(x, y);
         GWM_LOG_STOP_BREAK(mStatus);
         //计算residual
         // yHat = fitted(x, betas);
@@ -308,6 +461,12 @@ mat GWRRobust::robustGWRCaliSecond(const mat &x, const vec &y, mat &betasSE, vec
         iter = iter + 1;
     }
     GWM_LOG_STOP_RETURN(mStatus, mat(nDp, nVar, arma::fill::zeros));
+    // Hat matrix of the last calibration, whose local products are all cached.
+    vec nextMask = mWeightMask;
+    mWeightMask = mLocalMask;
+    betas = (this->*mfitFunction)(x, y, betasSE, shat, qDiag, S);
+    mWeightMask = nextMask;
+    GWM_LOG_STOP_RETURN(mStatus, mat(nDp, nVar, arma::fill::zeros));
     mSHat=shat;
     return betas;
 }
@@ -321,14 +480,17 @@ void GWRRobust::setParallelType(const ParallelType &type)
         {
         case ParallelType::SerialOnly:
             mfitFunction = &GWRRobust::fitSerial;
+            mLocalBetasFunction = &GWRRobust::localBetasSerial;
             break;
 #ifdef ENABLE_OPENMP
         case ParallelType::OpenMP:
             mfitFunction = &GWRRobust::fitOmp;
+            mLocalBetasFunction = &GWRRobust::localBetasOmp;
             break;
 #endif
         default:
             mfitFunction = &GWRRobust::fitSerial;
+            mLocalBetasFunction = &GWRRobust::localBetasSerial;
             break;
         }
     }
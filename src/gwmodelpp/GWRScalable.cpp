@@ -299,6 +299,11 @@ void GWRScalable::prepare()
 
 mat GWRScalable::predict(const mat& locations)
 {
+    if (mIsModelLoaded)
+    {
+        mBetas = predictSerial(locations, mX, mY);
+        return mBetas;
+    }
     createDistanceParameter();
     mDpSpatialWeight = mSpatialWeight;
     findDataPointNeighbours();
@@ -463,6 +468,7 @@ mat GWRScalable::predictSerial(const mat& locations, const arma::mat &x, const a
 mat GWRScalable::fit()
 {
     GWM_LOG_STAGE("Initializing");
+    mIsModelLoaded = false;
     createDistanceParameter();
     mDpSpatialWeight = mSpatialWeight;
     findDataPointNeighbours();
@@ -662,6 +668,34 @@ arma::mat GWRScalable::fitSerial(const arma::mat &x, const arma::vec &y)
     return betas.t();
 }
 
+void GWRScalable::saveModel(ModelArchive& archive) const
+{
+    GWRBase::saveModel(archive);
+    archive.setModel("GWRScalable");
+    archive.set("polynomial", double(mPolynomial));
+    archive.set("cv", mCV);
+    archive.set("scale", mScale);
+    archive.set("penalty", mPenalty);
+    archive.set("betasSE", mBetasSE);
+    archive.set("sHat", mShat);
+}
+
+void GWRScalable::loadModel(const ModelArchive& archive)
+{
+    if (archive.model() != "GWRScalable")
+    {
+        throw std::runtime_error("[GWRScalable::loadModel] The archive is saved from model " + archive.model() + ".");
+    }
+    GWRBase::loadModel(archive);
+    mPolynomial = uword(archive.scalar("polynomial"));
+    mCV = archive.scalar("cv");
+    mScale = archive.scalar("scale");
+    mPenalty = archive.scalar("penalty");
+    mBetasSE = archive.get("betasSE");
+    mShat = archive.get("sHat");
+    mIsModelLoaded = true;
+}
+
 bool GWRScalable::isValid()
 {
     if (GWRBase::isValid())
@@ -10,6 +10,13 @@ using namespace std;
 using namespace arma;
 using namespace gwm;
 
+namespace
+{
+/// Local variances below this ratio of the raw second moments lose more than about three digits by cancellation,
+/// so their moments are calculated again about the local means.
+const double CancellationRatio = 1e-3;
+}
+
 vec GWSS::del(vec x, uword rowcount){
     vec res;
     if (rowcount == 0)
@@ -23,29 +30,8 @@ vec GWSS::del(vec x, uword rowcount){
 
 vec GWSS::findq(const mat &x, const vec &w)
 {
-    uword lw = w.n_rows;
-    uword lp = 3;
-    vec q = vec(lp,fill::zeros);
-    vec xo = sort(x);
-    vec wo = w(sort_index(x));
-    vec Cum = cumsum(wo);
-    uword cond = lw - 1;
-    for(uword j = 0; j < lp ; j++){
-        double k = 0.25 * (j + 1);
-        for(uword i = 0; i < lw; i++){
-            if(Cum(i) > k){
-                cond = i - 1;
-                break;
-            }
-        }
-        if(cond < 0)
-        {
-            cond = 0;
-        }
-        q.row(j) = xo[cond];
-        cond = lw - 1;
-    }
-    return q;
+    WeightedQuantile quantile(x, { 0.25, 0.5, 0.75 });
+    return quantile.quantile(w);
 }
 
 bool GWSS::isValid()
@@ -91,6 +77,7 @@ void GWSS::run()
             mLocalMedian = mat(nRp, nVar, fill::zeros);
             mIQR = mat(nRp, nVar, fill::zeros);
             mQI = mat(nRp, nVar, fill::zeros);
+            mLocalQuantile = cube(nRp, nVar, mQuantileProbs.n_elem, fill::zeros);
         }
         break;
     }
@@ -99,71 +86,142 @@ void GWSS::run()
     (this->*mSummaryFunction)();
 }
 
-void GWSS::GWAverageSerial()
+void GWSS::prepareAverage(rowvec &shift, mat &powers, WeightedQuantile &quantile)
 {
-    mat rankX = mX;
-    rankX.each_col([&](vec &x) { x = rank(x); });
-    uword nVar = mX.n_cols, nRp = mCoords.n_rows;
-    for (uword i = 0; i < nRp; i++)
+    shift = mean(mX, 0);
+    mat xs = mX.each_row() - shift;
+    mat xs2 = xs % xs;
+    powers = join_rows(xs, join_rows(xs2, xs2 % xs));
+    if (mQuantile)
     {
-        GWM_LOG_STOP_BREAK(mStatus);
-        vec w = mSpatialWeight.weightVector(i);
-        double sumw = sum(w);
-        vec Wi = w / sumw;
-        mLocalMean.row(i) = trans(Wi) * mX;
-        if (mQuantile)
+        vec quartiles = { 0.25, 0.5, 0.75 };
+        quantile = WeightedQuantile(mX, join_cols(quartiles, mQuantileProbs));
+    }
+}
+
+void GWSS::storeQuantile(uword i, const mat &quant)
+{
+    mLocalMedian.row(i) = quant.row(1);
+    mIQR.row(i) = quant.row(2) - quant.row(0);
+    mQI.row(i) = (2 * quant.row(1) - quant.row(2) - quant.row(0)) / mIQR.row(i);
+    for (uword k = 0; k < mQuantileProbs.n_elem; k++)
+    {
+        mLocalQuantile.slice(k).row(i) = quant.row(3 + k);
+    }
+}
+
+void GWSS::localAverage(uword begin, uword end, const rowvec &shift, const mat &powers, const WeightedQuantile &quantile)
+{
+    uword nVar = mX.n_cols;
+    mat W = mSpatialWeight.weightMatrix(regspace<uvec>(begin, end - 1));
+    W.each_row() /= sum(W, 0);
+    // Moments of all focus points in the block are given by one matrix product.
+    mat moments = trans(W) * powers;
+    mat m1 = moments.cols(0, nVar - 1), m2 = moments.cols(nVar, 2 * nVar - 1), m3 = moments.cols(2 * nVar, 3 * nVar - 1);
+    mat var = m2 - m1 % m1, cm3 = m3 - 3.0 * m1 % m2 + 2.0 * m1 % m1 % m1;
+    // Moments about the global means cancel where the local mean is far from them compared with the local spread.
+    for (uword k = 0; k < nVar; k++)
+    {
+        for (uword j = 0; j < W.n_cols; j++)
         {
-            mat quant = mat(3, nVar);
-            for (uword j = 0; j < nVar; j++)
+            if (!(var(j, k) > CancellationRatio * m2(j, k)))
             {
-                quant.col(j) = findq(mX.col(j), Wi);
+                vec c = powers.col(k) - m1(j, k), c2 = c % c;
+                var(j, k) = dot(W.col(j), c2);
+                cm3(j, k) = dot(W.col(j), c2 % c);
             }
-            mLocalMedian.row(i) = quant.row(1);
-            mIQR.row(i) = quant.row(2) - quant.row(0);
-            mQI.row(i) = (2 * quant.row(1) - quant.row(2) - quant.row(0)) / mIQR.row(i);
         }
-        mat centerized = mX.each_row() - mLocalMean.row(i);
-        mLVar.row(i) = Wi.t() * (centerized % centerized);
-        mStandardDev.row(i) = sqrt(mLVar.row(i));
-        mLocalSkewness.row(i) = (Wi.t() * (centerized % centerized % centerized)) / (mLVar.row(i) % mStandardDev.row(i));
-        GWM_LOG_PROGRESS(i + 1, nRp);
     }
-    mLCV = mStandardDev / mLocalMean;
+    mat sd = sqrt(var);
+    mat localMean = m1.each_row() + shift;
+    mLocalMean.rows(begin, end - 1) = localMean;
+    mLVar.rows(begin, end - 1) = var;
+    mStandardDev.rows(begin, end - 1) = sd;
+    mLocalSkewness.rows(begin, end - 1) = cm3 / (var % sd);
+    mLCV.rows(begin, end - 1) = sd / localMean;
+    if (mQuantile)
+    {
+        for (uword i = begin; i < end; i++)
+        {
+            storeQuantile(i, quantile.quantile(W.col(i - begin)));
+        }
+    }
 }
 
-void GWSS::GWCorrelationSerial()
+void GWSS::GWAverageSerial()
 {
+    rowvec shift;
+    mat powers;
+    WeightedQuantile quantile;
+    prepareAverage(shift, powers, quantile);
+    uword nRp = mCoords.n_rows, nBlock = SpatialWeight::BlockSize(nRp);
+    for (uword begin = 0; begin < nRp; begin += nBlock)
+    {
+        GWM_LOG_STOP_BREAK(mStatus);
+        uword end = std::min(begin + nBlock, nRp);
+        localAverage(begin, end, shift, powers, quantile);
+        GWM_LOG_PROGRESS(end, nRp);
+    }
+}
+
+void GWSS::prepareCorrelation(rowvec &shift, mat &xs, mat &rs)
+{
+    shift = mean(mX, 0);
+    xs = mX.each_row() - shift;
     mat rankX = mX;
     rankX.each_col([&](vec &x) { x = rank(x); });
-    uword nVar = mX.n_cols, nRp = mCoords.n_rows;
+    rs = rankX.each_row() - mean(rankX, 0);
+}
+
+void GWSS::localCorrelation(uword i, const vec &Wi, const rowvec &shift, const mat &xs, const mat &rs)
+{
+    uword nVar = mX.n_cols;
     uword corrSize = mIsCorrWithFirstOnly ? 1 : nVar - 1;
+    double sumW2 = sum(Wi % Wi);
+    rowvec dx = trans(Wi) * xs, dr = trans(Wi) * rs;
+    // Weighted cross products about local means, only for rows of variables being correlated.
+    // Centring before the products avoids cancellation where local means are far from global means.
+    mat cx = xs.each_row() - dx, cr = rs.each_row() - dr;
+    mat wcx = cx.each_col() % Wi, wcr = cr.each_col() % Wi;
+    mat gx = trans(cx.head_cols(corrSize)) * wcx;
+    mat gr = trans(cr.head_cols(corrSize)) * wcr;
+    rowvec vx = sum(cx % wcx, 0);
+    rowvec vr = sum(cr % wcr, 0);
+    mLocalMean.row(i) = shift + dx;
+    mLVar.row(i) = vx;
+    uword tag = 0;
+    for (uword j = 0; j < corrSize; j++)
+    {
+        for (uword k = j + 1; k < nVar; k++)
+        {
+            mCovmat(i, tag) = gx(j, k) / (1.0 - sumW2);
+            mCorrmat(i, tag) = gx(j, k) / sqrt(vx(j) * vx(k));
+            mSCorrmat(i, tag) = gr(j, k) / sqrt(vr(j) * vr(k));
+            tag++;
+        }
+    }
+}
+
+void GWSS::GWCorrelationSerial()
+{
+    rowvec shift;
+    mat xs, rs;
+    prepareCorrelation(shift, xs, rs);
+    uword nVar = mX.n_cols, nRp = mCoords.n_rows;
     if (nVar >= 2)
     {
-        for (uword i = 0; i < nRp; i++)
+        uword nBlock = SpatialWeight::BlockSize(nRp);
+        for (uword begin = 0; begin < nRp; begin += nBlock)
         {
             GWM_LOG_STOP_BREAK(mStatus);
-            vec w = mSpatialWeight.weightVector(i);
-            double sumw = sum(w);
-            vec Wi = w / sumw;
-            mLocalMean.row(i) = trans(Wi) * mX;
-            mat centerized = mX.each_row() - mLocalMean.row(i);
-            mLVar.row(i) = Wi.t() * (centerized % centerized);
-            uword tag = 0;
-            for (uword j = 0; j < corrSize; j++)
+            uword end = std::min(begin + nBlock, nRp);
+            mat W = mSpatialWeight.weightMatrix(regspace<uvec>(begin, end - 1));
+            W.each_row() /= sum(W, 0);
+            for (uword i = begin; i < end; i++)
             {
-                for (uword k = j + 1; k < nVar; k++)
-                {
-                    double covjk = covwt(mX.col(j), mX.col(k), Wi);
-                    double sumW2 = sum(Wi % Wi);
-                    double covjj = mLVar(i, j) / (1.0 - sumW2);
-                    double covkk = mLVar(i, k) / (1.0 - sumW2);
-                    mCovmat(i, tag) = covjk;
-                    mCorrmat(i, tag) = covjk / sqrt(covjj * covkk);
-                    mSCorrmat(i, tag) = corwt(rankX.col(j), rankX.col(k), Wi);
-                    tag++;
-                }
+                localCorrelation(i, W.col(i - begin), shift, xs, rs);
             }
-            GWM_LOG_PROGRESS(i + 1, nRp);
+            GWM_LOG_PROGRESS(end, nRp);
         }
     }
     else{
@@ -175,75 +233,46 @@ void GWSS::GWCorrelationSerial()
 #ifdef ENABLE_OPENMP
 void GWSS::GWAverageOmp()
 {
-    mat rankX = mX;
-    rankX.each_col([&](vec &x) { x = rank(x); });
-    uword nVar = mX.n_cols;
+    rowvec shift;
+    mat powers;
+    WeightedQuantile quantile;
+    prepareAverage(shift, powers, quantile);
     uword nRp = mCoords.n_rows;
+    uword nBlock = SpatialWeight::BlockSize(nRp, mOmpThreadNum), nBlocks = (nRp + nBlock - 1) / nBlock;
 #pragma omp parallel for num_threads(mOmpThreadNum)
-    for (int i = 0; (uword) i < nRp; i++)
+    for (int b = 0; (uword) b < nBlocks; b++)
     {
         GWM_LOG_STOP_CONTINUE(mStatus);
-        vec w = mSpatialWeight.weightVector(i);
-        double sumw = sum(w);
-        vec Wi = w / sumw;
-        mLocalMean.row(i) = trans(Wi) * mX;
-        if (mQuantile)
-        {
-            mat quant = mat(3, nVar);
-            for (uword j = 0; j < nVar; j++)
-            {
-                quant.col(j) = findq(mX.col(j), Wi);
-            }
-            mLocalMedian.row(i) = quant.row(1);
-            mIQR.row(i) = quant.row(2) - quant.row(0);
-            mQI.row(i) = (2 * quant.row(1) - quant.row(2) - quant.row(0)) / mIQR.row(i);
-        }
-        mat centerized = mX.each_row() - mLocalMean.row(i);
-        mLVar.row(i) = Wi.t() * (centerized % centerized);
-        mStandardDev.row(i) = sqrt(mLVar.row(i));
-        mLocalSkewness.row(i) = (Wi.t() * (centerized % centerized % centerized)) / (mLVar.row(i) % mStandardDev.row(i));
-        GWM_LOG_PROGRESS(i + 1, nRp);
+        uword begin = b * nBlock, end = std::min(begin + nBlock, nRp);
+        localAverage(begin, end, shift, powers, quantile);
+        GWM_LOG_PROGRESS(end, nRp);
     }
-    mLCV = mStandardDev / mLocalMean;
 }
 #endif
 
 #ifdef ENABLE_OPENMP
 void GWSS::GWCorrelationOmp()
 {
-    mat rankX = mX;
-    rankX.each_col([&](vec &x) { x = rank(x); });
+    rowvec shift;
+    mat xs, rs;
+    prepareCorrelation(shift, xs, rs);
     uword nVar = mX.n_cols;
     uword nRp = mCoords.n_rows;
-    uword corrSize = mIsCorrWithFirstOnly ? 1 : nVar - 1;
     if (nVar >= 2)
     {
+        uword nBlock = SpatialWeight::BlockSize(nRp, mOmpThreadNum), nBlocks = (nRp + nBlock - 1) / nBlock;
 #pragma omp parallel for num_threads(mOmpThreadNum)
-        for (int i = 0; (uword) i < nRp; i++)
+        for (int b = 0; (uword) b < nBlocks; b++)
         {
             GWM_LOG_STOP_CONTINUE(mStatus);
-            vec w = mSpatialWeight.weightVector(i);
-            double sumw = sum(w);
-            vec Wi = w / sumw;
-            mLocalMean.row(i) = trans(Wi) * mX;
-            mat centerized = mX.each_row() - mLocalMean.row(i);
-            mLVar.row(i) = Wi.t() * (centerized % centerized);
-            uword tag = 0;
-            for (uword j = 0; j < corrSize; j++)
+            uword begin = b * nBlock, end = std::min(begin + nBlock, nRp);
+            mat W = mSpatialWeight.weightMatrix(regspace<uvec>(begin, end - 1));
+            W.each_row() /= sum(W, 0);
+            for (uword i = begin; i < end; i++)
             {
-                for (uword k = j + 1; k < nVar; k++)
-                {
-                    double covjk = covwt(mX.col(j), mX.col(k), Wi);
-                    double sumW2 = sum(Wi % Wi);
-                    double covjj = mLVar(i, j) / (1.0 - sumW2);
-                    double covkk = mLVar(i, k) / (1.0 - sumW2);
-                    mCovmat(i, tag) = covjk;
-                    mCorrmat(i, tag) = covjk / sqrt(covjj * covkk);
-                    mSCorrmat(i, tag) = corwt(rankX.col(j), rankX.col(k), Wi);
-                    tag++;
-                }
+                localCorrelation(i, W.col(i - begin), shift, xs, rs);
             }
-            GWM_LOG_PROGRESS(i + 1, nRp);
+            GWM_LOG_PROGRESS(end, nRp);
         }
     }
     else{
@@ -0,0 +1,363 @@
+#include "ModelArchive.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "spatialweight/BandwidthWeight.h"
+#include "spatialweight/CRSDistance.h"
+#include "spatialweight/MinkwoskiDistance.h"
+#include "spatialweight/OneDimDistance.h"
+#include "spatialweight/CRSSTDistance.h"
+
+using namespace std;
+using namespace arma;
+using namespace gwm;
+
+namespace
+{
+/// Magic number at the beginning of archives.
+const char Magic[8] = { 'G', 'W', 'M', 'A', 'R', 'C', 'H', '\0' };
+/// Byte order mark, which is read as a different value on machines with the other byte order.
+const uint32_t ByteOrderMark = 0x01020304;
+/// Size of the first chunk read from a stream, doubled for each later chunk.
+const uint64_t ReadChunkSize = uint64_t(1) << 20;
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t entries;
+    uint64_t size;
+    char model[32];
+};
+
+struct Entry
+{
+    char name[ModelArchive::NameLength];
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t offset;
+};
+
+static_assert(sizeof(Header) == ModelArchive::Alignment, "Header must fill one aligned block.");
+static_assert(sizeof(Entry) == ModelArchive::Alignment, "Entry must fill one aligned block.");
+
+uint64_t aligned(uint64_t bytes)
+{
+    return (bytes + ModelArchive::Alignment - 1) / ModelArchive::Alignment * ModelArchive::Alignment;
+}
+}
+
+const mat& ModelArchive::get(const string& name) const
+{
+    auto iter = mEntries.find(name);
+    if (iter == mEntries.end())
+    {
+        throw runtime_error("[ModelArchive::get] Entry " + name + " is not in the archive.");
+    }
+    return iter->second;
+}
+
+double ModelArchive::scalar(const string& name) const
+{
+    const mat& value = get(name);
+    if (value.n_elem != 1)
+    {
+        throw runtime_error("[ModelArchive::scalar] Entry " + name + " is not a scalar.");
+    }
+    return value(0);
+}
+
+void ModelArchive::set(const string& name, const mat& value)
+{
+    if (name.empty() || name.size() >= NameLength)
+    {
+        throw runtime_error("[ModelArchive::set] Length of entry names must be in [1, " + to_string(NameLength - 1) + "].");
+    }
+    mEntries[name] = value;
+}
+
+void ModelArchive::set(const string& name, double value)
+{
+    mat m(1, 1);
+    m(0, 0) = value;
+    set(name, m);
+}
+
+void ModelArchive::setSpatialWeight(const string& name, const SpatialWeight& spatialWeight)
+{
+    const BandwidthWeight* bw = dynamic_cast<const BandwidthWeight*>(spatialWeight.weight());
+    if (bw == nullptr)
+    {
+        throw runtime_error("[ModelArchive::setSpatialWeight] Only bandwidth weights can be archived.");
+    }
+    set(name + ".weight", mat({ bw->bandwidth(), bw->adaptive() ? 1.0 : 0.0, double(bw->kernel()) }));
+    setDistance(name + ".distance", spatialWeight.distance());
+}
+
+SpatialWeight ModelArchive::spatialWeight(const string& name) const
+{
+    const mat& w = get(name + ".weight");
+    if (w.n_elem != 3)
+    {
+        throw runtime_error("[ModelArchive::spatialWeight] Entry " + name + ".weight is broken.");
+    }
+    if (!(w(2) >= double(BandwidthWeight::Gaussian) && w(2) <= double(BandwidthWeight::Boxcar)))
+    {
+        throw runtime_error("[ModelArchive::spatialWeight] Entry " + name + ".weight is broken.");
+    }
+    BandwidthWeight bandwidth(w(0), w(1) != 0.0, BandwidthWeight::KernelFunctionType(int(w(2))));
+    unique_ptr<Distance> dist = distance(name + ".distance");
+    return SpatialWeight(&bandwidth, dist.get());
+}
+
+void ModelArchive::setRegression(const mat& coords, const mat& x, const vec& y, const mat& betas, bool hasIntercept, const RegressionDiagnostic& diagnostic)
+{
+    set("coords", coords);
+    set("x", x);
+    set("y", y);
+    set("betas", betas);
+    set("hasIntercept", hasIntercept ? 1.0 : 0.0);
+    set("diagnostic", mat({ diagnostic.RSS, diagnostic.AIC, diagnostic.AICc, diagnostic.ENP, diagnostic.EDF, diagnostic.RSquare, diagnostic.RSquareAdjust }));
+}
+
+void ModelArchive::regression(mat& coords, mat& x, vec& y, mat& betas, bool& hasIntercept, RegressionDiagnostic& diagnostic) const
+{
+    const mat& yEntry = get("y");
+    const mat& d = get("diagnostic");
+    if (yEntry.n_cols != 1 || d.n_elem != 7)
+    {
+        throw runtime_error("[ModelArchive::regression] Entry y or diagnostic is broken.");
+    }
+    coords = get("coords");
+    x = get("x");
+    y = yEntry;
+    betas = get("betas");
+    hasIntercept = scalar("hasIntercept") != 0.0;
+    diagnostic = { d(0), d(1), d(2), d(3), d(4), d(5), d(6) };
+}
+
+void ModelArchive::setDistance(const string& name, const Distance* distance)
+{
+    if (const MinkwoskiDistance* d = dynamic_cast<const MinkwoskiDistance*>(distance))
+    {
+        set(name, mat({ double(Distance::MinkwoskiDistance), d->poly(), d->theta() }));
+    }
+    else if (const CRSDistance* d = dynamic_cast<const CRSDistance*>(distance))
+    {
+        set(name, mat({ double(Distance::CRSDistance), d->geographic() ? 1.0 : 0.0 }));
+    }
+    else if (dynamic_cast<const OneDimDistance*>(distance))
+    {
+        set(name, double(Distance::OneDimDistance));
+    }
+    else if (const CRSSTDistance* d = dynamic_cast<const CRSSTDistance*>(distance))
+    {
+        set(name, mat({ double(Distance::CRSSTDistance), d->lambda(), d->angle() }));
+        setDistance(name + ".spatial", d->spatialDistance());
+    }
+    else
+    {
+        throw runtime_error("[ModelArchive::setDistance] This type of distance cannot be archived.");
+    }
+}
+
+unique_ptr<Distance> ModelArchive::distance(const string& name) const
+{
+    const mat& d = get(name);
+    int type = d.n_elem > 0 && d(0) >= 0.0 && d(0) <= double(Distance::CRSSTDistance) ? int(d(0)) : -1;
+    switch (type)
+    {
+    case Distance::CRSDistance:
+        if (d.n_elem != 2) break;
+        return unique_ptr<Distance>(new CRSDistance(d(1) != 0.0));
+    case Distance::MinkwoskiDistance:
+        if (d.n_elem != 3) break;
+        return unique_ptr<Distance>(new MinkwoskiDistance(d(1), d(2)));
+    case Distance::OneDimDistance:
+        if (d.n_elem != 1) break;
+        return unique_ptr<Distance>(new OneDimDistance());
+    case Distance::CRSSTDistance:
+    {
+        if (d.n_elem != 3 || !(d(1) >= 0.0 && d(1) <= 1.0)) break;
+        unique_ptr<Distance> spatial = distance(name + ".spatial");
+        OneDimDistance temporal;
+        return unique_ptr<Distance>(new CRSSTDistance(spatial.get(), &temporal, d(1), d(2)));
+    }
+    default:
+        break;
+    }
+    throw runtime_error("[ModelArchive::distance] Entry " + name + " is broken.");
+}
+
+void ModelArchive::save(const string& path) const
+{
+    ofstream stream(path, ios::binary);
+    if (!stream)
+    {
+        throw runtime_error("[ModelArchive::save] Cannot open " + path + ".");
+    }
+    save(stream);
+}
+
+void ModelArchive::save(ostream& stream) const
+{
+    if (mModel.size() >= sizeof(Header::model))
+    {
+        throw runtime_error("[ModelArchive::save] Name of the model is too long.");
+    }
+    Header header;
+    memset(&header, 0, sizeof(Header));
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.byteOrder = ByteOrderMark;
+    header.entries = mEntries.size();
+    strncpy(header.model, mModel.c_str(), sizeof(header.model) - 1);
+    vector<Entry> entries(mEntries.size());
+    uint64_t offset = sizeof(Header) + sizeof(Entry) * entries.size();
+    size_t e = 0;
+    for (auto&& iter : mEntries)
+    {
+        Entry& entry = entries[e++];
+        memset(&entry, 0, sizeof(Entry));
+        strncpy(entry.name, iter.first.c_str(), NameLength - 1);
+        entry.rows = iter.second.n_rows;
+        entry.cols = iter.second.n_cols;
+        entry.offset = offset;
+        offset = aligned(offset + sizeof(double) * iter.second.n_elem);
+    }
+    header.size = offset;
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    stream.write(reinterpret_cast<const char*>(entries.data()), sizeof(Entry) * entries.size());
+    const char padding[Alignment] = { 0 };
+    e = 0;
+    for (auto&& iter : mEntries)
+    {
+        uint64_t bytes = sizeof(double) * iter.second.n_elem;
+        stream.write(reinterpret_cast<const char*>(iter.second.memptr()), bytes);
+        stream.write(padding, aligned(entries[e].offset + bytes) - entries[e].offset - bytes);
+        e++;
+    }
+    if (!stream)
+    {
+        throw runtime_error("[ModelArchive::save] Failed to write the archive.");
+    }
+}
+
+ModelArchive ModelArchive::load(const string& path)
+{
+    ifstream stream(path, ios::binary);
+    if (!stream)
+    {
+        throw runtime_error("[ModelArchive::load] Cannot open " + path + ".");
+    }
+    return load(stream);
+}
+
+ModelArchive ModelArchive::load(istream& stream)
+{
+    Header header;
+    if (!stream.read(reinterpret_cast<char*>(&header), sizeof(Header)) || memcmp(header.magic, Magic, sizeof(Magic)) != 0)
+    {
+        throw runtime_error("[ModelArchive::load] Not a model archive.");
+    }
+    if (header.byteOrder != ByteOrderMark || header.size < sizeof(Header) || header.size % Alignment != 0)
+    {
+        throw runtime_error("[ModelArchive::load] The archive is broken or written with a different byte order.");
+    }
+    // The size comes from an untrusted header, so the buffer only grows as data actually arrive.
+    auto buffer = make_shared<vector<double>>(sizeof(Header) / sizeof(double));
+    memcpy(buffer->data(), &header, sizeof(Header));
+    uint64_t received = sizeof(Header);
+    while (received < header.size)
+    {
+        uint64_t chunk = std::min(header.size - received, std::max(received, ReadChunkSize));
+        buffer->resize((received + chunk) / sizeof(double));
+        if (!stream.read(reinterpret_cast<char*>(buffer->data()) + received, chunk))
+        {
+            throw runtime_error("[ModelArchive::load] The archive is truncated.");
+        }
+        received += chunk;
+    }
+    ModelArchive archive = fromBuffer(buffer->data(), header.size);
+    archive.mBuffer = buffer;
+    return archive;
+}
+
+ModelArchive ModelArchive::fromBuffer(const void* data, size_t size)
+{
+    if (reinterpret_cast<uintptr_t>(data) % alignof(double) != 0)
+    {
+        throw runtime_error("[ModelArchive::fromBuffer] The buffer is not aligned.");
+    }
+    const char* bytes = static_cast<const char*>(data);
+    Header header;
+    if (size < sizeof(Header))
+    {
+        throw runtime_error("[ModelArchive::fromBuffer] Not a model archive.");
+    }
+    memcpy(&header, bytes, sizeof(Header));
+    if (memcmp(header.magic, Magic, sizeof(Magic)) != 0)
+    {
+        throw runtime_error("[ModelArchive::fromBuffer] Not a model archive.");
+    }
+    if (header.byteOrder != ByteOrderMark)
+    {
+        throw runtime_error("[ModelArchive::fromBuffer] The archive is written with a different byte order.");
+    }
+    if (header.version > Version)
+    {
+        throw runtime_error("[ModelArchive::fromBuffer] The archive is written by a newer version.");
+    }
+    if (header.size < sizeof(Header) || header.size % Alignment != 0)
+    {
+        throw runtime_error("[ModelArchive::fromBuffer] The archive is broken.");
+    }
+    if (header.size > size)
+    {
+        throw runtime_error("[ModelArchive::fromBuffer] The archive is truncated.");
+    }
+    // Same as sizeof(Header) + entries * sizeof(Entry) <= size, without overflow.
+    if (header.entries > (header.size - sizeof(Header)) / sizeof(Entry))
+    {
+        throw runtime_error("[ModelArchive::fromBuffer] The table of entries exceeds the archive.");
+    }
+    uint64_t dataBegin = sizeof(Header) + header.entries * sizeof(Entry);
+    header.model[sizeof(header.model) - 1] = '\0';
+    ModelArchive archive(header.model);
+    vector<pair<uint64_t, uint64_t>> ranges;
+    for (uint64_t e = 0; e < header.entries; e++)
+    {
+        Entry entry;
+        memcpy(&entry, bytes + sizeof(Header) + e * sizeof(Entry), sizeof(Entry));
+        entry.name[NameLength - 1] = '\0';
+        uint64_t n = entry.rows * entry.cols;
+        if (entry.offset % sizeof(double) != 0 || entry.offset < dataBegin || entry.offset > header.size || (entry.rows != 0 && n / entry.rows != entry.cols) || n > (header.size - entry.offset) / sizeof(double))
+        {
+            throw runtime_error("[ModelArchive::fromBuffer] Entry " + string(entry.name) + " is broken.");
+        }
+        double* memory = const_cast<double*>(reinterpret_cast<const double*>(bytes + entry.offset));
+        if (!archive.mEntries.emplace(piecewise_construct, forward_as_tuple(entry.name), forward_as_tuple(memory, uword(entry.rows), uword(entry.cols), false, true)).second)
+        {
+            throw runtime_error("[ModelArchive::fromBuffer] Entry " + string(entry.name) + " is duplicated.");
+        }
+        if (n > 0)
+        {
+            ranges.emplace_back(entry.offset, entry.offset + n * sizeof(double));
+        }
+    }
+    // Matrices refer to the buffer without copying, so no two of them may share memory.
+    sort(ranges.begin(), ranges.end());
+    for (size_t r = 1; r < ranges.size(); r++)
+    {
+        if (ranges[r].first < ranges[r - 1].second)
+        {
+            throw runtime_error("[ModelArchive::fromBuffer] Entries overlap.");
+        }
+    }
+    return archive;
+}
@@ -2,6 +2,10 @@
 
 #include <armadillo>
 
+#ifdef ENABLE_OPENMP
+#include <omp.h>
+#endif
+
 using namespace arma;
 using namespace std;
 using namespace gwm;
@@ -17,18 +21,15 @@ vector<size_t> VariableForwardSelector::optimize(IVarialbeSelectable *instance)
     Status status = Status::Success;
     for (size_t i = 0; i < mVariables.size(); i++)
     {
-        if (status != Status::Success) break;
         vec criterions = vec(mVariables.size() - i);
+        status = evaluateCandidates(instance, curIndex, restIndex, criterions);
         for (size_t j = 0; j < restIndex.size(); j++)
         {
-            if (status != Status::Success) break;
             curIndex.push_back(restIndex[j]);
-            double aic = DBL_MAX;
-            status = instance->getCriterion(convertIndexToVariables(curIndex), aic);
-            criterions(j) = aic;
-            modelCriterions.push_back(make_pair(curIndex, aic));
+            modelCriterions.push_back(make_pair(curIndex, criterions(j)));
             curIndex.pop_back();
         }
+        if (status != Status::Success) break;
         uword iBestVar = criterions.index_min();
         curIndex.push_back(restIndex[iBestVar]);
         restIndex.erase(restIndex.begin() + iBestVar);
@@ -41,6 +42,54 @@ vector<size_t> VariableForwardSelector::optimize(IVarialbeSelectable *instance)
     else return mVariables;
 }
 
+Status VariableForwardSelector::evaluateCandidates(IVarialbeSelectable *instance, const vector<size_t>& curIndex, const vector<size_t>& restIndex, vec& criterions)
+{
+    size_t nCandidates = restIndex.size();
+    criterions.fill(DBL_MAX);
+#ifdef ENABLE_OPENMP
+    if (mOmpThreadNum > 1 && nCandidates > 1 && instance->isCriterionConcurrent())
+    {
+        vector<Status> statuses(nCandidates, Status::Success);
+        // Only the outer level is active, so parallel regions inside each criterion run on one thread.
+        int maxLevels = omp_get_max_active_levels();
+        omp_set_max_active_levels(1);
+#pragma omp parallel num_threads(mOmpThreadNum)
+#pragma omp single
+        {
+            for (size_t j = 0; j < nCandidates; j++)
+            {
+#pragma omp task firstprivate(j) shared(statuses, criterions)
+                {
+                    vector<size_t> candidate = curIndex;
+                    candidate.push_back(restIndex[j]);
+                    double aic = DBL_MAX;
+                    statuses[j] = instance->getCriterion(convertIndexToVariables(candidate), aic);
+                    criterions(j) = aic;
+                }
+            }
+#pragma omp taskwait
+        }
+        omp_set_max_active_levels(maxLevels);
+        for (Status s : statuses)
+        {
+            if (s != Status::Success) return s;
+        }
+        return Status::Success;
+    }
+#endif // ENABLE_OPENMP
+    Status status = Status::Success;
+    vector<size_t> candidate = curIndex;
+    for (size_t j = 0; j < nCandidates && status == Status::Success; j++)
+    {
+        candidate.push_back(restIndex[j]);
+        double aic = DBL_MAX;
+        status = instance->getCriterion(convertIndexToVariables(candidate), aic);
+        criterions(j) = aic;
+        candidate.pop_back();
+    }
+    return status;
+}
+
 std::vector<std::size_t> VariableForwardSelector::convertIndexToVariables(std::vector<std::size_t> index)
 {
     vector<size_t> variables;
@@ -0,0 +1,102 @@
+#include "WeightedQuantile.h"
+#include <algorithm>
+
+using namespace std;
+using namespace arma;
+using namespace gwm;
+
+WeightedQuantile::WeightedQuantile(const mat &x, const vec &probs)
+{
+    uword n = x.n_rows, p = x.n_cols;
+    mProbOrder = sort_index(probs);
+    mProbs = probs(mProbOrder);
+    mSorted = mat(n, p);
+    mOrder = umat(n, p);
+    mRank = umat(n, p);
+    for (uword j = 0; j < p; j++)
+    {
+        mOrder.col(j) = sort_index(x.col(j));
+        for (uword t = 0; t < n; t++)
+        {
+            mSorted(t, j) = x(mOrder(t, j), j);
+            mRank(mOrder(t, j), j) = t;
+        }
+    }
+}
+
+vec WeightedQuantile::probs() const
+{
+    vec p(mProbs.n_elem);
+    p(mProbOrder) = mProbs;
+    return p;
+}
+
+mat WeightedQuantile::quantile(const vec &w) const
+{
+    uword n = mSorted.n_rows, p = mSorted.n_cols, nq = mProbs.n_elem;
+    mat q(nq, p, fill::zeros);
+    uvec nz = find(w != 0.0);
+    bool compact = nz.n_elem * 4 < n;
+    for (uword j = 0; j < p; j++)
+    {
+        vec qj = compact ? quantileCompact(j, w, nz) : quantileDense(j, w);
+        for (uword k = 0; k < nq; k++)
+        {
+            q(mProbOrder(k), j) = qj(k);
+        }
+    }
+    return q;
+}
+
+vec WeightedQuantile::quantileDense(uword j, const vec &w) const
+{
+    uword n = mSorted.n_rows, nq = mProbs.n_elem, k = 0;
+    vec q(nq, fill::zeros);
+    double cum = 0.0;
+    for (uword t = 0; t < n && k < nq; t++)
+    {
+        cum += w(mOrder(t, j));
+        while (k < nq && cum > mProbs(k))
+        {
+            q(k++) = mSorted(t > 0 ? t - 1 : 0, j);
+        }
+    }
+    for (; k < nq; k++)
+    {
+        q(k) = mSorted(n - 1, j);
+    }
+    return q;
+}
+
+vec WeightedQuantile::quantileCompact(uword j, const vec &w, const uvec &nz) const
+{
+    uword n = mSorted.n_rows, nq = mProbs.n_elem, m = nz.n_elem;
+    vec q(nq, fill::zeros);
+    uvec pos(m);
+    for (uword t = 0; t < m; t++)
+    {
+        pos(t) = mRank(nz(t), j);
+    }
+    pos = sort(pos);
+    vec cum(m);
+    double s = 0.0;
+    for (uword t = 0; t < m; t++)
+    {
+        s += w(mOrder(pos(t), j));
+        cum(t) = s;
+    }
+    for (uword k = 0; k < nq; k++)
+    {
+        const double* first = std::upper_bound(cum.begin(), cum.end(), mProbs(k));
+        if (first == cum.end())
+        {
+            q(k) = mSorted(n - 1, j);
+        }
+        else
+        {
+            uword t = pos(first - cum.begin());
+            q(k) = mSorted(t > 0 ? t - 1 : 0, j);
+        }
+    }
+    return q;
+}
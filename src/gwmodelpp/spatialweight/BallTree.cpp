@@ -0,0 +1,309 @@
+#include "gwmodelpp/spatialweight/BallTree.h"
+#include "gwmodelpp/spatialweight/CRSDistance.h"
+#include <algorithm>
+#include <queue>
+#include <utility>
+
+using namespace std;
+using namespace arma;
+using namespace gwm;
+
+namespace
+{
+/// Equatorial radius (km) used by CRSDistance::SpGcdist.
+const double EarthRadius = 6378.137;
+/// Relative margin covering the ellipsoidal correction of CRSDistance::SpGcdist against spherical distances.
+const double EllipsoidMargin = 0.01;
+/// Relative margin covering rounding errors of bounds.
+const double RoundingMargin = 1e-10;
+
+double angleBetween(const vec3& a, const vec3& b)
+{
+    return atan2(norm(cross(a, b)), dot(a, b));
+}
+}
+
+BallTree::BallTree(const mat &points, bool geographic) : mGeographic(geographic), mPoints(points)
+{
+    uword n = points.n_rows;
+    mEmbedded = mat(3, n);
+    for (uword i = 0; i < n; i++)
+    {
+        mEmbedded.col(i) = embed(points.row(i));
+    }
+    if (n > 0)
+    {
+        mIndex = regspace<uvec>(0, n - 1);
+        mNodes.reserve(2 * (n / LeafSize + 1));
+        build(0, n);
+    }
+}
+
+vec3 BallTree::embed(const rowvec &loc) const
+{
+    vec3 e(fill::zeros);
+    if (mGeographic)
+    {
+        double lon = loc(0) * datum::pi / 180.0, lat = loc(1) * datum::pi / 180.0;
+        e(0) = cos(lat) * cos(lon);
+        e(1) = cos(lat) * sin(lon);
+        e(2) = sin(lat);
+    }
+    else
+    {
+        e(0) = loc(0);
+        e(1) = loc(1);
+    }
+    return e;
+}
+
+int BallTree::build(uword begin, uword end)
+{
+    uvec idx = mIndex.subvec(begin, end - 1);
+    mat pts = mEmbedded.cols(idx);
+    Node node;
+    node.begin = begin;
+    node.end = end;
+    node.left = node.right = -1;
+    node.center = mean(pts, 1);
+    if (mGeographic)
+    {
+        double c = norm(node.center);
+        node.center = c > 0.0 ? vec3(node.center / c) : vec3(pts.col(0));
+        node.radius = 0.0;
+        for (uword i = 0; i < pts.n_cols; i++)
+        {
+            node.radius = std::max(node.radius, angleBetween(node.center, vec3(pts.col(i))));
+        }
+    }
+    else
+    {
+        node.radius = sqrt(max(sum(square(pts.each_col() - node.center), 0)));
+    }
+    int id = int(mNodes.size());
+    mNodes.push_back(node);
+    if (end - begin > LeafSize)
+    {
+        uword dim = index_max(max(pts, 1) - min(pts, 1));
+        uword mid = begin + (end - begin) / 2;
+        std::nth_element(mIndex.begin() + begin, mIndex.begin() + mid, mIndex.begin() + end, [&](uword a, uword b)
+        {
+            return mEmbedded(dim, a) < mEmbedded(dim, b);
+        });
+        int left = build(begin, mid);
+        int right = build(mid, end);
+        mNodes[id].left = left;
+        mNodes[id].right = right;
+    }
+    return id;
+}
+
+void BallTree::bounds(const Node &node, const vec3 &e, double &lower, double &upper) const
+{
+    if (mGeographic)
+    {
+        double theta = angleBetween(e, node.center);
+        lower = std::max(0.0, theta - node.radius) * EarthRadius * (1.0 - EllipsoidMargin);
+        upper = std::min(datum::pi, theta + node.radius) * EarthRadius * (1.0 + EllipsoidMargin);
+    }
+    else
+    {
+        double d = norm(e - node.center);
+        lower = std::max(0.0, d - node.radius) * (1.0 - RoundingMargin);
+        upper = (d + node.radius) * (1.0 + RoundingMargin);
+    }
+}
+
+double BallTree::distance(const rowvec &loc, uword i) const
+{
+    if (mGeographic)
+    {
+        return CRSDistance::SpGcdist(mPoints(i, 0), loc(0), mPoints(i, 1), loc(1));
+    }
+    else
+    {
+        double dx = mPoints(i, 0) - loc(0), dy = mPoints(i, 1) - loc(1);
+        return sqrt(dx * dx + dy * dy);
+    }
+}
+
+double BallTree::nearest(const rowvec &loc, double bound) const
+{
+    if (mNodes.empty()) return bound;
+    vec3 e = embed(loc);
+    double best = bound;
+    vector<int> stack = { 0 };
+    while (!stack.empty())
+    {
+        const Node& node = mNodes[stack.back()];
+        stack.pop_back();
+        double lower, upper;
+        bounds(node, e, lower, upper);
+        if (lower >= best) continue;
+        if (node.left < 0)
+        {
+            for (uword t = node.begin; t < node.end; t++)
+            {
+                best = std::min(best, distance(loc, mIndex(t)));
+            }
+        }
+        else
+        {
+            double ll, lu, rl, ru;
+            bounds(mNodes[node.left], e, ll, lu);
+            bounds(mNodes[node.right], e, rl, ru);
+            // Push the closer child last so that it is visited first.
+            if (ll < rl)
+            {
+                stack.push_back(node.right);
+                stack.push_back(node.left);
+            }
+            else
+            {
+                stack.push_back(node.left);
+                stack.push_back(node.right);
+            }
+        }
+    }
+    return best;
+}
+
+double BallTree::farthest(const rowvec &loc, double bound) const
+{
+    if (mNodes.empty()) return bound;
+    vec3 e = embed(loc);
+    double best = bound;
+    vector<int> stack = { 0 };
+    while (!stack.empty())
+    {
+        const Node& node = mNodes[stack.back()];
+        stack.pop_back();
+        double lower, upper;
+        bounds(node, e, lower, upper);
+        if (upper <= best) continue;
+        if (node.left < 0)
+        {
+            for (uword t = node.begin; t < node.end; t++)
+            {
+                best = std::max(best, distance(loc, mIndex(t)));
+            }
+        }
+        else
+        {
+            double ll, lu, rl, ru;
+            bounds(mNodes[node.left], e, ll, lu);
+            bounds(mNodes[node.right], e, rl, ru);
+            // Push the farther child last so that it is visited first.
+            if (lu > ru)
+            {
+                stack.push_back(node.right);
+                stack.push_back(node.left);
+            }
+            else
+            {
+                stack.push_back(node.left);
+                stack.push_back(node.right);
+            }
+        }
+    }
+    return best;
+}
+
+void BallTree::within(const rowvec &loc, double radius, uvec &index, vec &dists) const
+{
+    vector<uword> found;
+    vector<double> foundDists;
+    if (!mNodes.empty())
+    {
+        vec3 e = embed(loc);
+        vector<int> stack = { 0 };
+        while (!stack.empty())
+        {
+            const Node& node = mNodes[stack.back()];
+            stack.pop_back();
+            double lower, upper;
+            bounds(node, e, lower, upper);
+            if (lower >= radius) continue;
+            if (node.left < 0)
+            {
+                for (uword t = node.begin; t < node.end; t++)
+                {
+                    double d = distance(loc, mIndex(t));
+                    if (d < radius)
+                    {
+                        found.push_back(mIndex(t));
+                        foundDists.push_back(d);
+                    }
+                }
+            }
+            else
+            {
+                stack.push_back(node.left);
+                stack.push_back(node.right);
+            }
+        }
+    }
+    index = uvec(found);
+    dists = vec(foundDists);
+}
+
+void BallTree::nearest(const rowvec &loc, uword k, uvec &index, vec &dists) const
+{
+    // Max-heap of the k nearest points found so far, whose top is the current bound.
+    priority_queue<pair<double, uword>> heap;
+    if (!mNodes.empty() && k > 0)
+    {
+        vec3 e = embed(loc);
+        vector<int> stack = { 0 };
+        while (!stack.empty())
+        {
+            const Node& node = mNodes[stack.back()];
+            stack.pop_back();
+            double lower, upper;
+            bounds(node, e, lower, upper);
+            if (heap.size() == k && lower >= heap.top().first) continue;
+            if (node.left < 0)
+            {
+                for (uword t = node.begin; t < node.end; t++)
+                {
+                    double d = distance(loc, mIndex(t));
+                    if (heap.size() < k)
+                    {
+                        heap.emplace(d, mIndex(t));
+                    }
+                    else if (d < heap.top().first)
+                    {
+                        heap.pop();
+                        heap.emplace(d, mIndex(t));
+                    }
+                }
+            }
+            else
+            {
+                double ll, lu, rl, ru;
+                bounds(mNodes[node.left], e, ll, lu);
+                bounds(mNodes[node.right], e, rl, ru);
+                // Push the closer child last so that it is visited first.
+                if (ll < rl)
+                {
+                    stack.push_back(node.right);
+                    stack.push_back(node.left);
+                }
+                else
+                {
+                    stack.push_back(node.left);
+                    stack.push_back(node.right);
+                }
+            }
+        }
+    }
+    uword n = heap.size();
+    index.set_size(n);
+    dists.set_size(n);
+    for (uword i = n; i > 0; i--)
+    {
+        dists(i - 1) = heap.top().first;
+        index(i - 1) = heap.top().second;
+        heap.pop();
+    }
+}
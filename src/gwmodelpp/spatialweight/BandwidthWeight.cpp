@@ -1,5 +1,6 @@
 #include "gwmodelpp/spatialweight/BandwidthWeight.h"
 #include "gwmodelpp/spatialweight/Weight.h"
+#include <algorithm>
 
 #ifdef ENABLE_CUDA
 #include "CudaUtils.h"
@@ -32,32 +33,47 @@ BandwidthWeight::KernelFunction BandwidthWeight::Kernel[] =
     &BandwidthWeight::BoxcarKernelFunction
 };
 
-vec BandwidthWeight::weight(vec dist)
+BandwidthWeight::KernelInPlaceFunction BandwidthWeight::KernelInPlace[] =
+{
+    &BandwidthWeight::GaussianKernelInPlace,
+    &BandwidthWeight::ExponentialKernelInPlace,
+    &BandwidthWeight::BisquareKernelInPlace,
+    &BandwidthWeight::TricubeKernelInPlace,
+    &BandwidthWeight::BoxcarKernelInPlace
+};
+
+double BandwidthWeight::distanceBandwidth(const vec &dist) const
 {
-    const KernelFunction *kerf = Kernel + mKernel;
+    if (!mAdaptive) return mBandwidth;
     uword nr = dist.n_elem;
-    vec w(nr, fill::zeros);
-    if (mAdaptive)
+    double dn = mBandwidth / nr, fixbw = 0;
+    if (dn < 1)
     {
-        double dn = mBandwidth / nr, fixbw = 0;
-        if (dn < 1)
-        {
-            vec vdist = sort(dist);
-            double b0 = floor(mBandwidth), bx = mBandwidth - b0;
-            double d0 = vdist(int(b0) - 1), d1 = vdist(int(b0));
-            fixbw = d0 + (d1 - d0) * bx;
-        }
-        else
-        {
-            fixbw = dn * max(dist);
-        }
-        w = (*kerf)(dist, fixbw);
+        // Only the b0-th and (b0+1)-th smallest distances are needed.
+        double b0 = floor(mBandwidth), bx = mBandwidth - b0;
+        uword k = uword(b0);
+        vec vdist = dist;
+        std::nth_element(vdist.begin(), vdist.begin() + k, vdist.end());
+        double d0 = max(vdist.head(k)), d1 = vdist(k);
+        fixbw = d0 + (d1 - d0) * bx;
     }
     else
     {
-        w = (*kerf)(dist, mBandwidth);
+        fixbw = dn * max(dist);
     }
-    return w;
+    return fixbw;
+}
+
+void BandwidthWeight::weightInPlace(vec &dist)
+{
+    double bw = distanceBandwidth(dist);
+    (*(KernelInPlace + mKernel))(dist.memptr(), dist.n_elem, bw);
+}
+
+vec BandwidthWeight::weight(vec dist)
+{
+    weightInPlace(dist);
+    return dist;
 }
 
 #ifdef ENABLE_CUDA
@@ -1,6 +1,8 @@
 #include "gwmodelpp/spatialweight/CRSDistance.h"
+#include "gwmodelpp/spatialweight/BallTree.h"
 #include <assert.h>
 #include <exception>
+#include <algorithm>
 
 #ifdef ENABLE_CUDA
 #include "CudaUtils.h"
@@ -12,6 +14,13 @@ using namespace gwm;
 
 #define POWDI(x, i) pow(x, i)
 
+namespace
+{
+/// Squared distances below this ratio of the sum of squared norms are recalculated directly in distance tiles.
+/// Cancellation in the expansion loses about log10(1 / ratio) digits, so the expanded entries keep about 15 significant digits.
+const double RecomputeRatio = 0.1;
+}
+
 double CRSDistance::SpGcdist(double lon1, double lon2, double lat1, double lat2)
 {
 
@@ -100,6 +109,8 @@ CRSDistance::CRSDistance(const CRSDistance &distance) : Distance(distance)
 
 void CRSDistance::makeParameter(initializer_list<DistParamVariant> plist)
 {
+    mMaxDistance.reset();
+    mMinDistance.reset();
     if (plist.size() == 2)
     {
         const mat& fp = get<mat>(*(plist.begin()));
@@ -130,27 +141,148 @@ vec CRSDistance::distance(uword focus)
     else throw std::runtime_error("Target is out of bounds of data points.");
 }
 
+void CRSDistance::distance(uword focus, vec &dist)
+{
+    if(mParameter == nullptr) throw std::runtime_error("Parameter is nullptr.");
+    if (focus >= mParameter->total) throw std::runtime_error("Target is out of bounds of data points.");
+    const mat& dp = mParameter->dataPoints;
+    uword n = dp.n_rows;
+    dist.set_size(n);
+    double uout = mParameter->focusPoints(focus, 0), vout = mParameter->focusPoints(focus, 1);
+    const double *u = dp.colptr(0), *v = dp.colptr(1);
+    double* d = dist.memptr();
+    if (mGeographic)
+    {
+        for (uword j = 0; j < n; j++)
+        {
+            d[j] = SpGcdist(u[j], uout, v[j], vout);
+        }
+    }
+    else
+    {
+        for (uword j = 0; j < n; j++)
+        {
+            double du = u[j] - uout, dv = v[j] - vout;
+            d[j] = sqrt(du * du + dv * dv);
+        }
+    }
+}
+
+mat CRSDistance::distanceBlock(const uvec& focuses)
+{
+    if(mParameter == nullptr) throw std::runtime_error("Parameter is nullptr.");
+    if (any(focuses >= mParameter->total)) throw std::runtime_error("Target is out of bounds of data points.");
+    const mat& dp = mParameter->dataPoints;
+    uword n = dp.n_rows, nFocus = focuses.n_elem;
+    mat dists(n, nFocus);
+    if (mGeographic)
+    {
+        for (uword j = 0; j < nFocus; j++)
+        {
+            vec d(dists.colptr(j), n, false, true);
+            distance(focuses(j), d);
+        }
+        return dists;
+    }
+    // Both sides are centered by the mean of data points to keep the norms, and hence the cancellation, small.
+    mat fc = mParameter->focusPoints.rows(focuses);
+    fc.each_row() -= mParameter->center;
+    vec fn = sum(fc % fc, 1);
+    mat cross = mParameter->centeredPoints * fc.t();
+    const double *dn = mParameter->centeredNorms.memptr(), *u = dp.colptr(0), *v = dp.colptr(1);
+    for (uword j = 0; j < nFocus; j++)
+    {
+        const double* c = cross.colptr(j);
+        double* d = dists.colptr(j);
+        double uout = mParameter->focusPoints(focuses(j), 0), vout = mParameter->focusPoints(focuses(j), 1);
+        for (uword i = 0; i < n; i++)
+        {
+            double norms = dn[i] + fn(j);
+            double d2 = norms - 2.0 * c[i];
+            if (d2 > RecomputeRatio * norms)
+            {
+                d[i] = sqrt(d2);
+            }
+            else
+            {
+                double du = u[i] - uout, dv = v[i] - vout;
+                d[i] = sqrt(du * du + dv * dv);
+            }
+        }
+    }
+    return dists;
+}
+
+uvec CRSDistance::ConvexHull(const mat &points)
+{
+    uword n = points.n_rows;
+    if (n < 3) return regspace<uvec>(0, n).head(n);
+    uvec order = regspace<uvec>(0, n - 1);
+    std::sort(order.begin(), order.end(), [&](uword a, uword b)
+    {
+        return points(a, 0) < points(b, 0) || (points(a, 0) == points(b, 0) && points(a, 1) < points(b, 1));
+    });
+    auto cross = [&](uword o, uword a, uword b)
+    {
+        return (points(a, 0) - points(o, 0)) * (points(b, 1) - points(o, 1)) - (points(a, 1) - points(o, 1)) * (points(b, 0) - points(o, 0));
+    };
+    vector<uword> hull;
+    // Lower hull from left to right, then upper hull from right to left.
+    for (uword t = 0; t < n; t++)
+    {
+        while (hull.size() >= 2 && cross(hull[hull.size() - 2], hull.back(), order(t)) < 0) hull.pop_back();
+        hull.push_back(order(t));
+    }
+    size_t lower = hull.size() + 1;
+    for (uword t = n - 1; t-- > 0; )
+    {
+        while (hull.size() >= lower && cross(hull[hull.size() - 2], hull.back(), order(t)) < 0) hull.pop_back();
+        hull.push_back(order(t));
+    }
+    return unique(uvec(hull));
+}
+
 double CRSDistance::maxDistance()
 {
     if(mParameter == nullptr) throw std::runtime_error("Parameter is nullptr.");
+    if (mMaxDistance) return *mMaxDistance;
+    const mat& fp = mParameter->focusPoints;
+    const mat& dp = mParameter->dataPoints;
     double maxD = 0.0;
-    for (uword i = 0; i < mParameter->total; i++)
+    if (mGeographic)
     {
-        double d = max(mCalculator(mParameter->focusPoints.row(i), mParameter->dataPoints));
-        maxD = d > maxD ? d : maxD;
+        BallTree tree(dp, true);
+        for (uword i = 0; i < mParameter->total; i++)
+        {
+            maxD = tree.farthest(fp.row(i), maxD);
+        }
+    }
+    else
+    {
+        // The farthest point in a convex set from any point is one of its vertices.
+        mat fh = fp.rows(ConvexHull(fp));
+        mat dh = dp.rows(ConvexHull(dp));
+        for (uword i = 0; i < fh.n_rows; i++)
+        {
+            double d = max(mCalculator(fh.row(i), dh));
+            maxD = d > maxD ? d : maxD;
+        }
     }
+    mMaxDistance = maxD;
     return maxD;
 }
 
 double CRSDistance::minDistance()
 {
     if(mParameter == nullptr) throw std::runtime_error("Parameter is nullptr.");
+    if (mMinDistance) return *mMinDistance;
+    BallTree tree(mParameter->dataPoints, mGeographic);
     double minD = DBL_MAX;
-    for (uword i = 0; i < mParameter->total; i++)
+    for (uword i = 0; i < mParameter->total && minD > 0.0; i++)
     {
-        double d = min(mCalculator(mParameter->focusPoints.row(i), mParameter->dataPoints));
-        minD = d < minD ? d : minD;
+        minD = tree.nearest(mParameter->focusPoints.row(i), minD);
     }
+    mMinDistance = minD;
     return minD;
 }
 
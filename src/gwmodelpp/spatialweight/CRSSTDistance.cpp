@@ -2,6 +2,7 @@
 #include <assert.h>
 
 #include <exception>
+#include <algorithm>
 
 using namespace std;
 using namespace arma;
@@ -11,20 +12,10 @@ vec CRSSTDistance::OrthogonalSTDistance(Distance* spatial, gwm::OneDimDistance*
 {
     (void)angle;
     vec sdist = spatial->distance(focus);
-    vec tdist;
     if (abs(lambda - 1.0) < 1e-16){
-        tdist = temporal->distance(focus);
+        return sdist;
     }
-    else{
-        tdist = temporal->noAbsdistance(focus);
-    }
-    uvec idx=arma::find(tdist<0);//get index of values under 0
-    // tdist.print("td");
-    // idx.print("idx");
-    vec stdist = (lambda) * sdist + (1-lambda) * tdist + 2 * sqrt(lambda * (1 - lambda) * sdist % tdist);
-    stdist.rows(idx).fill(10000000000000);
-    // stdist.print("std");
-    return stdist;
+    return CombineSTDistance(sdist, temporal->noAbsdistance(focus), lambda, 1.0);
     
     // //former gwmodels code:
     // return sqrt(sdist % sdist + lambda * (tdist % tdist));
@@ -33,16 +24,20 @@ vec CRSSTDistance::OrthogonalSTDistance(Distance* spatial, gwm::OneDimDistance*
 vec CRSSTDistance::ObliqueSTDistance(Distance* spatial, gwm::OneDimDistance* temporal, uword focus, double lambda, double angle)
 {
     vec sdist = spatial->distance(focus);
-    vec tdist;
     if (abs(lambda - 1.0) < 1e-16){
-        tdist = temporal->distance(focus);
+        return sdist;
     }
-    else{
-        tdist = temporal->noAbsdistance(focus);
+    return CombineSTDistance(sdist, temporal->noAbsdistance(focus), lambda, cos(angle));
+}
+
+vec CRSSTDistance::CombineSTDistance(const vec& sdist, const vec& tdist, double lambda, double cosine)
+{
+    if (abs(lambda - 1.0) < 1e-16){
+        return sdist;
     }
-    uvec idx=arma::find(tdist<0);
-    vec stdist = (lambda) * sdist + (1-lambda) * tdist + 2 * sqrt(lambda * (1 - lambda) * sdist % tdist) * cos(angle);
-    stdist.rows(idx).fill(10000000000000);
+    uvec idx=arma::find(tdist<0);//get index of values under 0
+    vec stdist = (lambda) * sdist + (1-lambda) * tdist + 2 * sqrt(lambda * (1 - lambda) * sdist % tdist) * cosine;
+    stdist.rows(idx).fill(LaterDistance);
     return stdist;
 }
 
@@ -52,7 +47,6 @@ CRSSTDistance::CRSSTDistance() :
     mLambda(0.0),
     mAngle(datum::pi / 2.0)
 {
-    mCalculator = &OrthogonalSTDistance;
 }
 
 CRSSTDistance::CRSSTDistance(Distance* spatialDistance, gwm::OneDimDistance* temporalDistance, double lambda) :
@@ -62,7 +56,6 @@ CRSSTDistance::CRSSTDistance(Distance* spatialDistance, gwm::OneDimDistance* tem
     mSpatialDistance = spatialDistance->clone();
     //mSpatialDistance = static_cast<gwm::CRSDistance*>(spatialDistance->clone());
     mTemporalDistance = static_cast<gwm::OneDimDistance*>(temporalDistance->clone());
-    mCalculator = &OrthogonalSTDistance;
 }
 
 CRSSTDistance::CRSSTDistance(Distance* spatialDistance, gwm::OneDimDistance* temporalDistance, double lambda, double angle) :
@@ -72,7 +65,6 @@ CRSSTDistance::CRSSTDistance(Distance* spatialDistance, gwm::OneDimDistance* tem
     mSpatialDistance = spatialDistance->clone();
     //mSpatialDistance = static_cast<gwm::CRSDistance*>(spatialDistance->clone());
     mTemporalDistance = static_cast<gwm::OneDimDistance*>(temporalDistance->clone());
-    mCalculator = (abs(mAngle - datum::pi / 2.0) < 1e-15) ? &OrthogonalSTDistance : &ObliqueSTDistance;
 }
 
 CRSSTDistance::CRSSTDistance(const CRSSTDistance &distance)
@@ -86,18 +78,31 @@ CRSSTDistance::CRSSTDistance(const CRSSTDistance &distance)
     mSpatialDistance = distance.mSpatialDistance->clone();
     //mSpatialDistance = static_cast<gwm::CRSDistance*>(distance.mSpatialDistance->clone());
     mTemporalDistance = static_cast<gwm::OneDimDistance*>(distance.mTemporalDistance->clone());
-    mCalculator=distance.mCalculator;
+    mFocusCoords = distance.mFocusCoords;
+    mDataCoords = distance.mDataCoords;
+    mFocusTimes = distance.mFocusTimes;
+    mDataTimes = distance.mDataTimes;
+    mTimeOrder = distance.mTimeOrder;
+    mSortedTimes = distance.mSortedTimes;
+    mComponentCache = distance.mComponentCache;
+    mSpatialCache = distance.mSpatialCache;
+    if (distance.mParameter)
+    {
+        mParameter = make_unique<Parameter>(*distance.mParameter);
+    }
 }
 
 void CRSSTDistance::makeParameter(initializer_list<DistParamVariant> plist)
 {
+    mMaxDistance.reset();
+    mMinDistance.reset();
     if (plist.size() == 4)
     {
         const mat& sfp = get<mat>(*(plist.begin()));
         const mat& sdp = get<mat>(*(plist.begin() + 1));
         const vec& tfp = get<vec>(*(plist.begin() + 2));
         const vec& tdp = get<vec>(*(plist.begin() + 3));
-        if (sfp.n_rows == sdp.n_rows && sdp.n_rows == tfp.n_rows && tfp.n_rows == tdp.n_rows)
+        if (sfp.n_rows == tfp.n_rows && sdp.n_rows == tdp.n_rows)
         {
             // mSpatialDistance->makeParameter(initializer_list<DistParamVariant>(plist.begin(), plist.begin() + 2));
             // mTemporalDistance->makeParameter(initializer_list<DistParamVariant>(plist.begin() + 2, plist.begin() + 4));
@@ -105,6 +110,22 @@ void CRSSTDistance::makeParameter(initializer_list<DistParamVariant> plist)
             mTemporalDistance->makeParameter({tfp,tdp});
             mParameter = make_unique<Parameter>();
             mParameter->total = sfp.n_rows;
+            mFocusCoords = sfp;
+            mDataCoords = sdp;
+            mFocusTimes = tfp;
+            mDataTimes = tdp;
+            mTimeOrder = stable_sort_index(tdp);
+            mSortedTimes = tdp(mTimeOrder);
+            mSpatialCache.reset();
+            if (mComponentCache && sfp.n_rows * sdp.n_rows <= MaxCacheSize)
+            {
+                mat cache(sdp.n_rows, sfp.n_rows);
+                for (uword i = 0; i < sfp.n_rows; i++)
+                {
+                    cache.col(i) = mSpatialDistance->distance(i);
+                }
+                mSpatialCache = make_shared<const mat>(std::move(cache));
+            }
         }
         else
         {
@@ -119,26 +140,97 @@ void CRSSTDistance::makeParameter(initializer_list<DistParamVariant> plist)
     }
 }
 
+vec CRSSTDistance::distance(uword focus)
+{
+    if(mParameter == nullptr) throw std::runtime_error("Parameter is nullptr.");
+    if (focus >= mParameter->total) throw std::runtime_error("Target is out of bounds of data points.");
+    if (abs(mLambda - 1.0) < 1e-16)
+    {
+        return mSpatialCache ? vec(mSpatialCache->col(focus)) : mSpatialDistance->distance(focus);
+    }
+    uvec idx = admissible(focus);
+    vec stdist(mDataTimes.n_elem);
+    stdist.fill(LaterDistance);
+    if (idx.n_elem > 0)
+    {
+        vec tdist = mFocusTimes(focus) - mDataTimes(idx);
+        stdist(idx) = CombineSTDistance(spatialDistance(focus, idx), tdist, mLambda, CrossCoefficient(mAngle));
+    }
+    return stdist;
+}
+
+uvec CRSSTDistance::admissible(uword focus) const
+{
+    // A data point is later than the focus point if and only if its timestamp is greater.
+    uword k = std::upper_bound(mSortedTimes.begin(), mSortedTimes.end(), mFocusTimes(focus)) - mSortedTimes.begin();
+    return k > 0 ? uvec(mTimeOrder.head(k)) : uvec();
+}
+
+void CRSSTDistance::componentDistance(uword focus, vec& sdist, vec& tdist)
+{
+    if(mParameter == nullptr) throw std::runtime_error("Parameter is nullptr.");
+    if (focus >= mParameter->total) throw std::runtime_error("Target is out of bounds of data points.");
+    sdist = mSpatialCache ? vec(mSpatialCache->col(focus)) : mSpatialDistance->distance(focus);
+    tdist = mFocusTimes(focus) - mDataTimes;
+}
+
+vec CRSSTDistance::spatialDistance(uword focus, const uvec& idx)
+{
+    if (mSpatialCache)
+    {
+        return vec((*mSpatialCache)(idx, uvec({ focus })));
+    }
+    else if (mSpatialDistance->type() == DistanceType::CRSDistance)
+    {
+        const CRSDistance* crs = static_cast<const CRSDistance*>(mSpatialDistance);
+        mat dp = mDataCoords.rows(idx);
+        return crs->geographic() ? CRSDistance::SpatialDistance(mFocusCoords.row(focus), dp) : CRSDistance::EuclideanDistance(mFocusCoords.row(focus), dp);
+    }
+    else
+    {
+        vec sdist = mSpatialDistance->distance(focus);
+        return sdist(idx);
+    }
+}
+
 double CRSSTDistance::maxDistance()
 {
     if(mParameter == nullptr) throw std::runtime_error("Parameter is nullptr.");
+    if (mMaxDistance) return *mMaxDistance;
     double maxD = 0.0;
-    for (uword i = 0; i < mParameter->total; i++)
+    if (abs(mLambda - 1.0) < 1e-16)
     {
-        double d = max(distance(i));
-        maxD = d > maxD ? d : maxD;
+        maxD = mSpatialDistance->maxDistance();
     }
+    else
+    {
+        for (uword i = 0; i < mParameter->total && maxD < LaterDistance; i++)
+        {
+            double d = max(distance(i));
+            maxD = d > maxD ? d : maxD;
+        }
+    }
+    mMaxDistance = maxD;
     return maxD;
 }
 
 double CRSSTDistance::minDistance()
 {
     if(mParameter == nullptr) throw std::runtime_error("Parameter is nullptr.");
+    if (mMinDistance) return *mMinDistance;
     double minD = DBL_MAX;
-    for (uword i = 0; i < mParameter->total; i++)
+    if (abs(mLambda - 1.0) < 1e-16)
     {
-        double d = min(distance(i));
-        minD = d < minD ? d : minD;
+        minD = mSpatialDistance->minDistance();
     }
+    else
+    {
+        for (uword i = 0; i < mParameter->total && minD > 0.0; i++)
+        {
+            double d = min(distance(i));
+            minD = d < minD ? d : minD;
+        }
+    }
+    mMinDistance = minD;
     return minD;
-}
\ No newline at end of file
+}
@@ -7,6 +7,7 @@
 #endif // ENABLE_CUDA
 
 using namespace std;
+using namespace arma;
 using namespace gwm;
 
 unordered_map<Distance::DistanceType, string> Distance::TypeNameMapper =
@@ -16,6 +17,18 @@ unordered_map<Distance::DistanceType, string> Distance::TypeNameMapper =
     std::make_pair(Distance::DistanceType::DMatDistance, "DMatDistance")
 };
 
+mat Distance::distanceBlock(const uvec& focuses)
+{
+    mat dists;
+    for (uword j = 0; j < focuses.n_elem; j++)
+    {
+        vec d = distance(focuses(j));
+        if (j == 0) dists.set_size(d.n_elem, focuses.n_elem);
+        dists.col(j) = d;
+    }
+    return dists;
+}
+
 #ifdef ENABLE_CUDA
 cudaError_t Distance::prepareCuda(size_t gpuId)
 {
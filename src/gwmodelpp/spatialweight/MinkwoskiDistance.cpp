@@ -49,3 +49,10 @@ vec MinkwoskiDistance::distance(uword focus)
         else throw std::runtime_error("Target is out of bounds of data points.");
     }
 }
+
+mat MinkwoskiDistance::distanceBlock(const uvec& focuses)
+{
+    // Rotation does not change Euclidean distances.
+    if (mGeographic || mPoly == 2.0) return CRSDistance::distanceBlock(focuses);
+    else return Distance::distanceBlock(focuses);
+}
@@ -2,6 +2,7 @@
 #include <assert.h>
 
 #include <exception>
+#include <algorithm>
 
 using namespace std;
 using namespace arma;
@@ -20,6 +21,8 @@ OneDimDistance::OneDimDistance(const OneDimDistance &distance) : Distance(distan
 
 void OneDimDistance::makeParameter(initializer_list<DistParamVariant> plist)
 {
+    mMaxDistance.reset();
+    mMinDistance.reset();
     if (plist.size() == 2)
     {
         const mat& fp = get<vec>(*(plist.begin()));
@@ -61,23 +64,36 @@ vec OneDimDistance::noAbsdistance(uword focus)
 double OneDimDistance::maxDistance()
 {
     if (mParameter == nullptr) throw std::runtime_error("Parameter is nullptr.");
+    if (mMaxDistance) return *mMaxDistance;
+    // The farthest data point from any focus is one of the two ends of data points.
+    const vec& dp = mParameter->dataPoints;
+    double dmin = dp.min(), dmax = dp.max();
     double maxD = 0.0;
     for (uword i = 0; i < mParameter->total; i++)
     {
-        double d = max(AbstractDistance(mParameter->focusPoints(i), mParameter->dataPoints));
+        double fi = mParameter->focusPoints(i);
+        double d = std::max(abs(dmin - fi), abs(dmax - fi));
         maxD = d > maxD ? d : maxD;
     }
+    mMaxDistance = maxD;
     return maxD;
 }
 
 double OneDimDistance::minDistance()
 {
     if (mParameter == nullptr) throw std::runtime_error("Parameter is nullptr.");
+    if (mMinDistance) return *mMinDistance;
+    // The nearest data point to any focus is one of its neighbours in sorted data points.
+    vec sorted = sort(mParameter->dataPoints);
+    uword n = sorted.n_elem;
     double minD = DBL_MAX;
-    for (uword i = 0; i < mParameter->total; i++)
+    for (uword i = 0; i < mParameter->total && minD > 0.0; i++)
     {
-        double d = min(AbstractDistance(mParameter->focusPoints(i), mParameter->dataPoints));
-        minD = d < minD ? d : minD;
+        double fi = mParameter->focusPoints(i);
+        uword pos = std::lower_bound(sorted.begin(), sorted.end(), fi) - sorted.begin();
+        if (pos < n) minD = std::min(minD, abs(sorted(pos) - fi));
+        if (pos > 0) minD = std::min(minD, abs(sorted(pos - 1) - fi));
     }
+    mMinDistance = minD;
     return minD;
 }
@@ -4,6 +4,7 @@
 
 #include <vector>
 #include <string>
+#include <sstream>
 #include <armadillo>
 
 
@@ -11,6 +12,7 @@
 #include "gwmodelpp/spatialweight/BandwidthWeight.h"
 #include "gwmodelpp/spatialweight/SpatialWeight.h"
 #include "gwmodelpp/GTWR.h"
+#include "gwmodelpp/ModelArchive.h"
 
 #include "include/londonhp100.h"
 #include "TerminateCheckTelegram.h"
@@ -124,6 +126,43 @@ TEST_CASE("GTWR: londonhp100")
         REQUIRE_THAT(diagnostic.AICc, Catch::Matchers::WithinAbs(2459.9274395074, 1e-8));
         REQUIRE_THAT(diagnostic.RSquare, Catch::Matchers::WithinAbs(0.70005079437906, 1e-8));
         REQUIRE_THAT(diagnostic.RSquareAdjust, Catch::Matchers::WithinAbs(0.66131126771988, 1e-8));
+        mat betas = algorithm.betas();
+        mat predicted;
+        REQUIRE_NOTHROW(predicted = algorithm.predict(londonhp100_coord.rows(0, 9), londonhp100_times.rows(0, 9)));
+        REQUIRE(approx_equal(predicted, betas.rows(0, 9), "both", 1e-8, 1e-8));
+
+        CRSDistance spatialOnly(false);
+        algorithm.setSpatialWeight(SpatialWeight(&bandwidth, &spatialOnly));
+        REQUIRE_THROWS_AS(algorithm.predict(londonhp100_coord.rows(0, 9), londonhp100_times.rows(0, 9)), std::runtime_error);
+    }
+    SECTION("adaptive bandwidth 36 | save and load | prediction without fitting") {
+        CRSSTDistance distance(&sdist, &tdist, 0.05);
+        BandwidthWeight bandwidth(36, true, BandwidthWeight::Gaussian);
+        SpatialWeight spatial(&bandwidth, &distance);
+        algorithm.setSpatialWeight(spatial);
+        algorithm.setHasHatMatrix(true);
+        REQUIRE_NOTHROW(algorithm.fit());
+
+        ModelArchive archive;
+        algorithm.saveModel(archive);
+        REQUIRE(archive.model() == "GTWR");
+        stringstream stream;
+        REQUIRE_NOTHROW(archive.save(stream));
+
+        GTWR loaded;
+        REQUIRE_NOTHROW(loaded.loadModel(ModelArchive::load(stream)));
+        REQUIRE(approx_equal(loaded.betas(), algorithm.betas(), "absdiff", 1e-12));
+        REQUIRE_THAT(loaded.diagnostic().AICc, Catch::Matchers::WithinAbs(2454.3785650481, 1e-8));
+        const CRSSTDistance* loadedDistance = loaded.spatialWeight().distance<CRSSTDistance>();
+        REQUIRE(loadedDistance != nullptr);
+        REQUIRE_THAT(loadedDistance->lambda(), Catch::Matchers::WithinAbs(0.05, 1e-12));
+
+        mat locations = londonhp100_coord.rows(0, 9);
+        vec times = londonhp100_times.rows(0, 9) + 1.0;
+        mat expected = algorithm.predict(locations, times);
+        mat predicted;
+        REQUIRE_NOTHROW(predicted = loaded.predict(locations, times));
+        REQUIRE(approx_equal(predicted, expected, "absdiff", 1e-12));
     }
     SECTION("fixed bandwidth | CV Gaussian bandwidth optimization | lambda=1 ") {
         CRSSTDistance distance(&sdist, &tdist, 1);
@@ -167,6 +206,68 @@ TEST_CASE("GTWR: londonhp100")
         REQUIRE_THAT(diagnostic.RSquare, Catch::Matchers::WithinAbs(0.6825745728157, 1e-8));
         REQUIRE_THAT(diagnostic.RSquareAdjust, Catch::Matchers::WithinAbs(0.6551810065492, 1e-8));
     }
+    SECTION("adaptive bandwidth | joint CV bandwidth and lambda optimization ") {
+        const initializer_list<ParallelType> parallel_list = {
+            ParallelType::SerialOnly
+#ifdef ENABLE_OPENMP
+            , ParallelType::OpenMP
+#endif // ENABLE_OPENMP
+        };
+        auto parallel = GENERATE_REF(values(parallel_list));
+        INFO("Parallel:" << ParallelTypeDict.at(parallel));
+
+        CRSSTDistance distance(&sdist, &tdist, 0.5);
+        BandwidthWeight bandwidth(0, true, BandwidthWeight::Gaussian);
+        SpatialWeight spatial(&bandwidth, &distance);
+        algorithm.setSpatialWeight(spatial);
+        algorithm.setHasHatMatrix(true);
+        algorithm.setIsJointAutoselect(true);
+        algorithm.setBandwidthSelectionCriterion(GTWR::BandwidthSelectionCriterionType::CV);
+        algorithm.setParallelType(parallel);
+        if (parallel == ParallelType::OpenMP)
+        {
+            algorithm.setOmpThreadNum(6);
+        }
+        REQUIRE_NOTHROW(algorithm.fit());
+        double bw = algorithm.spatialWeight().weight<BandwidthWeight>()->bandwidth();
+        double lambda = algorithm.spatialWeight().distance<CRSSTDistance>()->lambda();
+        REQUIRE(bw >= 20);
+        REQUIRE(bw <= 100);
+        REQUIRE(lambda >= 0.0);
+        REQUIRE(lambda <= 1.0);
+
+        // Leave-one-out CV calculated directly at a bandwidth and a lambda.
+        auto cv = [&](double b, double l)
+        {
+            CRSSTDistance d(&sdist, &tdist, l);
+            d.makeParameter({ londonhp100_coord, londonhp100_coord, londonhp100_times, londonhp100_times });
+            BandwidthWeight weight(b, true, BandwidthWeight::Gaussian);
+            double value = 0.0;
+            for (uword i = 0; i < y.n_elem; i++)
+            {
+                vec w = weight.weight(d.distance(i));
+                w(i) = 0.0;
+                mat xtw = trans(x.each_col() % w);
+                vec beta;
+                if (!solve(beta, xtw * x, xtw * y, solve_opts::no_approx)) return DBL_MAX;
+                double r = y(i) - dot(x.row(i), beta);
+                value += r * r;
+            }
+            return isfinite(value) ? value : DBL_MAX;
+        };
+        // The selection must be at least as good as every point of a grid that the search itself does not use.
+        double gridMin = DBL_MAX;
+        for (uword b = 20; b <= 100; b += 10)
+        {
+            for (uword l = 0; l <= 10; l++)
+            {
+                gridMin = std::min(gridMin, cv(double(b), double(l) / 10.0));
+            }
+        }
+        double selected = cv(bw, lambda);
+        REQUIRE(selected < DBL_MAX);
+        REQUIRE(selected <= gridMin * (1.0 + 1e-10));
+    }
     SECTION("adaptive bandwidth | no bandwidth optimization | lambda=0.5 | omp parallel ") {
         CRSSTDistance distance(&sdist, &tdist, 0.5);
         BandwidthWeight bandwidth(46, true, BandwidthWeight::Gaussian);
@@ -186,7 +287,58 @@ TEST_CASE("GTWR: londonhp100")
 }
 
 
+TEST_CASE("CRSSTDistance: time-ordered data points")
+{
+    mat londonhp100_coord, londonhp100_data;
+    vec londonhp100_times;
+    vector<string> londonhp100_fields;
+    if (!read_londonhp100temporal(londonhp100_coord, londonhp100_times, londonhp100_data, londonhp100_fields))
+    {
+        FAIL("Cannot load londonhp100temporal data.");
+    }
+
+    CRSDistance sdist(false);
+    OneDimDistance tdist;
+    sdist.makeParameter({ londonhp100_coord, londonhp100_coord });
+    tdist.makeParameter({ londonhp100_times, londonhp100_times });
+    double angle = GENERATE(arma::datum::pi / 2, arma::datum::pi / 6);
+    bool cache = GENERATE(true, false);
+    CRSSTDistance distance(&sdist, &tdist, 0.05, angle);
+    distance.setComponentCache(cache);
+    distance.makeParameter({ londonhp100_coord, londonhp100_coord, londonhp100_times, londonhp100_times });
+    for (uword i = 0; i < londonhp100_coord.n_rows; i++)
+    {
+        vec expected = CRSSTDistance::CombineSTDistance(sdist.distance(i), tdist.noAbsdistance(i), 0.05, CRSSTDistance::CrossCoefficient(distance.angle()));
+        REQUIRE(approx_equal(distance.distance(i), expected, "absdiff", 1e-8));
+        REQUIRE(distance.admissible(i).n_elem == uvec(find(londonhp100_times <= londonhp100_times(i))).n_elem);
+        vec sdist_i, tdist_i;
+        distance.componentDistance(i, sdist_i, tdist_i);
+        REQUIRE(approx_equal(sdist_i, sdist.distance(i), "absdiff", 1e-8));
+        REQUIRE(approx_equal(tdist_i, tdist.noAbsdistance(i), "absdiff", 1e-8));
+    }
+
+    unique_ptr<Distance> cloned(distance.clone());
+    CRSSTDistance copied(distance);
+    for (uword i = 0; i < londonhp100_coord.n_rows; i++)
+    {
+        vec expected = distance.distance(i);
+        REQUIRE_NOTHROW(cloned->distance(i));
+        REQUIRE(approx_equal(cloned->distance(i), expected, "absdiff", 1e-8));
+        REQUIRE(approx_equal(copied.distance(i), expected, "absdiff", 1e-8));
+    }
+    REQUIRE_THAT(cloned->maxDistance(), Catch::Matchers::WithinAbs(distance.maxDistance(), 1e-8));
 
+    // Copies share the spatial cache, which must survive a copy making new parameters.
+    mat focus = londonhp100_coord.head_rows(10);
+    vec focusTimes = londonhp100_times.head(10);
+    copied.makeParameter({ focus, londonhp100_coord, focusTimes, londonhp100_times });
+    for (uword i = 0; i < londonhp100_coord.n_rows; i++)
+    {
+        vec expected = CRSSTDistance::CombineSTDistance(sdist.distance(i), tdist.noAbsdistance(i), 0.05, CRSSTDistance::CrossCoefficient(distance.angle()));
+        REQUIRE(approx_equal(distance.distance(i), expected, "absdiff", 1e-8));
+    }
+    REQUIRE(approx_equal(copied.distance(9), distance.distance(9), "absdiff", 1e-8));
+}
 
 TEST_CASE("GTWR: cancel")
 {
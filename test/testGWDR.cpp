@@ -70,6 +70,73 @@ TEST_CASE("GWDR: basic flow")
     REQUIRE(algorithm.hasIntercept() == true);
 }
 
+TEST_CASE("GWDR: predict at non-data locations")
+{
+    mat londonhp100_coord, londonhp100_data;
+    vector<string> londonhp100_fields;
+    if (!read_londonhp100(londonhp100_coord, londonhp100_data, londonhp100_fields))
+    {
+        FAIL("Cannot load londonhp100 data.");
+    }
+
+    uword nDim = londonhp100_coord.n_cols;
+    vector<SpatialWeight> spatials;
+    for (size_t i = 0; i < nDim; i++)
+    {
+        OneDimDistance distance;
+        BandwidthWeight bandwidth(36, true, BandwidthWeight::Bisquare);
+        spatials.push_back(SpatialWeight(&bandwidth, &distance));
+    }
+
+    vec y = londonhp100_data.col(0);
+    mat x = join_rows(ones(londonhp100_data.n_rows), londonhp100_data.cols(1, 3));
+
+    const initializer_list<ParallelType> parallelTypes = {
+        ParallelType::SerialOnly,
+#ifdef ENABLE_OPENMP
+        ParallelType::OpenMP,
+#endif // ENABLE_OPENMP
+    };
+    auto parallel = GENERATE_REF(values(parallelTypes));
+
+    GWDR algorithm;
+    algorithm.setCoords(londonhp100_coord);
+    algorithm.setDependentVariable(y);
+    algorithm.setIndependentVariables(x);
+    algorithm.setSpatialWeights(spatials);
+    algorithm.setHasHatMatrix(true);
+    algorithm.setParallelType(parallel);
+    REQUIRE_NOTHROW(algorithm.fit());
+    mat fitted = algorithm.betas();
+
+    // Fitting fills the weight cache for these bandwidths, which must not be used for other locations.
+    mat locations = londonhp100_coord.rows(0, 19);
+    locations.col(0) += 250.0;
+    locations.col(1) -= 150.0;
+    mat predicted;
+    REQUIRE_NOTHROW(predicted = algorithm.predict(locations));
+    REQUIRE(predicted.n_rows == locations.n_rows);
+    REQUIRE(predicted.n_cols == x.n_cols);
+
+    mat expected(locations.n_rows, x.n_cols);
+    for (uword i = 0; i < locations.n_rows; i++)
+    {
+        vec w(x.n_rows, arma::fill::ones);
+        for (uword m = 0; m < nDim; m++)
+        {
+            w = w % spatials[m].weight<BandwidthWeight>()->weight(abs(londonhp100_coord.col(m) - locations(i, m)));
+        }
+        mat xtw = (x.each_col() % w).t();
+        expected.row(i) = solve(xtw * x, xtw * y).t();
+    }
+    REQUIRE(approx_equal(predicted, expected, "both", 1e-6, 1e-8));
+
+    mat atData;
+    REQUIRE_NOTHROW(atData = algorithm.predict(londonhp100_coord));
+    REQUIRE(approx_equal(atData, fitted, "both", 1e-6, 1e-8));
+    REQUIRE_THROWS_AS(algorithm.predict(londonhp100_coord.col(0)), std::runtime_error);
+}
+
 // TEST_CASE("GWDR: basic flow with bandwidth optimization (CV)")
 // {
 //     mat londonhp100_coord, londonhp100_data;
@@ -143,6 +210,97 @@ TEST_CASE("GWDR: basic flow with bandwidth optimization (AIC)")
     REQUIRE_THAT(spatialWeights[1].weight<BandwidthWeight>()->bandwidth(), Catch::Matchers::WithinAbs(189, 1e-12));
 }
 
+TEST_CASE("GWDR: basic flow with bandwidth optimization (LBFGSB)")
+{
+    mat londonhp100_coord, londonhp100_data;
+    vector<string> londonhp100_fields;
+    if (!read_londonhp100(londonhp100_coord, londonhp100_data, londonhp100_fields))
+    {
+        FAIL("Cannot load londonhp100 data.");
+    }
+
+    uword nDim = londonhp100_coord.n_cols;
+    vector<SpatialWeight> spatials;
+    for (size_t i = 0; i < nDim; i++)
+    {
+        OneDimDistance distance;
+        BandwidthWeight bandwidth(0, true, BandwidthWeight::Bisquare);
+        spatials.push_back(SpatialWeight(&bandwidth, &distance));
+    }
+
+    vec y = londonhp100_data.col(0);
+    mat x = join_rows(ones(londonhp100_data.n_rows), londonhp100_data.cols(1, 3));
+
+    const initializer_list<ParallelType> parallelTypes = {
+        ParallelType::SerialOnly,
+#ifdef ENABLE_OPENMP
+        ParallelType::OpenMP,
+#endif // ENABLE_OPENMP
+    };
+    auto parallel = GENERATE_REF(values(parallelTypes));
+    auto criterionType = GENERATE(GWDR::AIC, GWDR::CV);
+
+    GWDR algorithm;
+    algorithm.setCoords(londonhp100_coord);
+    algorithm.setDependentVariable(y);
+    algorithm.setIndependentVariables(x);
+    algorithm.setSpatialWeights(spatials);
+    algorithm.setEnableBandwidthOptimize(true);
+    algorithm.setBandwidthOptimizerType(GWDR::LBFGSB);
+    algorithm.setBandwidthCriterionType(criterionType);
+    algorithm.setHasHatMatrix(true);
+    algorithm.setParallelType(parallel);
+    REQUIRE_NOTHROW(algorithm.fit());
+
+    const vector<SpatialWeight>& spatialWeights = algorithm.spatialWeights();
+    vector<BandwidthWeight*> bws;
+    rowvec optimum(nDim);
+    for (size_t i = 0; i < nDim; i++)
+    {
+        BandwidthWeight* bw = spatialWeights[i].weight<BandwidthWeight>();
+        REQUIRE(bw->bandwidth() >= double(x.n_cols + 1));
+        REQUIRE(bw->bandwidth() <= double(x.n_rows));
+        bws.push_back(bw);
+        optimum(i) = bw->bandwidth();
+    }
+    REQUIRE(isfinite(algorithm.diagnostic().AICc));
+
+    vec criteria = algorithm.bandwidthCriteria(optimum);
+    REQUIRE_THAT(criteria(0), Catch::Matchers::WithinRel(algorithm.bandwidthCriterion(bws), 1e-8));
+
+    // Weights of the first candidate are not cached, as the others share different bandwidths.
+    rowvec shifted = optimum;
+    for (size_t i = 0; i < nDim; i++)
+    {
+        shifted(i) += optimum(i) < double(x.n_rows) ? 1.0 : -1.0;
+    }
+    vec uncached = algorithm.bandwidthCriteria(join_cols(optimum, shifted, shifted));
+    REQUIRE_THAT(uncached(0), Catch::Matchers::WithinRel(criteria(0), 1e-8));
+
+    // The default Nelder-Mead optimizer from the same initial bandwidths gives the reference optimum,
+    // e.g. 80 and 189 under AICc. L-BFGS-B has to reach it in either bandwidths or criterion.
+    GWDR reference;
+    reference.setCoords(londonhp100_coord);
+    reference.setDependentVariable(y);
+    reference.setIndependentVariables(x);
+    reference.setSpatialWeights(spatials);
+    reference.setEnableBandwidthOptimize(true);
+    reference.setBandwidthCriterionType(criterionType);
+    reference.setHasHatMatrix(true);
+    reference.setParallelType(parallel);
+    REQUIRE_NOTHROW(reference.fit());
+    rowvec nmOptimum(nDim);
+    for (size_t i = 0; i < nDim; i++)
+    {
+        nmOptimum(i) = reference.spatialWeights()[i].weight<BandwidthWeight>()->bandwidth();
+    }
+    vec nmCriteria = algorithm.bandwidthCriteria(nmOptimum);
+    bool nearBandwidths = all(abs(optimum - nmOptimum) <= 0.05 * nmOptimum);
+    bool nearCriterion = criteria(0) <= nmCriteria(0) + 1e-3 * abs(nmCriteria(0));
+    INFO("L-BFGS-B: " << optimum << " " << criteria(0) << ", Nelder-Mead: " << nmOptimum << " " << nmCriteria(0));
+    REQUIRE((nearBandwidths || nearCriterion));
+}
+
 TEST_CASE("GWDR: basic flow with independent variable selection")
 {
     mat londonhp100_coord, londonhp100_data;
@@ -30,11 +30,22 @@ TEST_CASE("GWPCA: basic flow")
 
     mat x = londonhp100_data.cols(1, 3);
 
+    const initializer_list<ParallelType> parallel_list = {
+        ParallelType::SerialOnly
+#ifdef ENABLE_OPENMP
+        , ParallelType::OpenMP
+#endif // ENABLE_OPENMP     
+    };
+    auto parallel = GENERATE_REF(values(parallel_list));
+    INFO("Parallel type: " << parallel);
+
     GWPCA algorithm;
     algorithm.setCoords(londonhp100_coord);
     algorithm.setVariables(x);
     algorithm.setSpatialWeight(spatial);
     algorithm.setKeepComponents(2);
+    algorithm.setParallelType(parallel);
+    algorithm.setOmpThreadNum(6);
     REQUIRE_NOTHROW(algorithm.run());
 
     vec p = {0.0, 0.25, 0.5, 0.75, 1.0};
@@ -79,6 +90,80 @@ TEST_CASE("GWPCA: basic flow")
 }
 
 
+
+
+TEST_CASE("GWPCA: scores and Monte Carlo test")
+{
+    mat londonhp100_coord, londonhp100_data;
+    vector<string> londonhp100_fields;
+    if (!read_londonhp100(londonhp100_coord, londonhp100_data, londonhp100_fields))
+    {
+        FAIL("Cannot load londonhp100 data.");
+    }
+
+    CRSDistance distance(false);
+    BandwidthWeight bandwidth(36, true, BandwidthWeight::Gaussian);
+    SpatialWeight spatial(&bandwidth, &distance);
+
+    mat x = londonhp100_data.cols(1, 3);
+
+    const initializer_list<ParallelType> parallel_list = {
+        ParallelType::SerialOnly
+#ifdef ENABLE_OPENMP
+        , ParallelType::OpenMP
+#endif // ENABLE_OPENMP     
+    };
+    auto parallel = GENERATE_REF(values(parallel_list));
+    INFO("Parallel type: " << parallel);
+
+    GWPCA algorithm;
+    algorithm.setCoords(londonhp100_coord);
+    algorithm.setVariables(x);
+    algorithm.setSpatialWeight(spatial);
+    algorithm.setKeepComponents(2);
+    algorithm.setParallelType(parallel);
+    algorithm.setOmpThreadNum(6);
+    algorithm.setHasScores(true);
+    algorithm.setMonteCarloTimes(19);
+    algorithm.setMonteCarloSeed(1);
+    REQUIRE_NOTHROW(algorithm.run());
+
+    const cube& scores = algorithm.scores();
+    REQUIRE(scores.n_rows == x.n_rows);
+    REQUIRE(scores.n_cols == 2);
+    REQUIRE(scores.n_slices == x.n_rows);
+    mat loadings_0 = join_rows(algorithm.loadings().slice(0).row(0).t(), algorithm.loadings().slice(1).row(0).t());
+    REQUIRE(approx_equal(scores.slice(0), mat(x * loadings_0), "reldiff", 1e-8));
+
+    vec replicates = algorithm.monteCarloReplicates();
+    REQUIRE(replicates.n_elem == 19);
+    REQUIRE(algorithm.monteCarloStatistic() > 0.0);
+    REQUIRE(algorithm.monteCarloPValue() > 0.0);
+    REQUIRE(algorithm.monteCarloPValue() <= 1.0);
+
+    // Each replicate is a fit with the t-th sample at the perm(t)-th coordinate.
+    // Its variances are scaled by the weight sum at the last focus point of the data, not of the replicate.
+    distance.makeParameter({ londonhp100_coord, londonhp100_coord });
+    uword n = x.n_rows;
+    double sumw = sum(bandwidth.weight(distance.distance(n - 1)));
+    for (uword r : { 0, 7, 18 })
+    {
+        uvec perm = algorithm.permutation(n, r);
+        REQUIRE(all(sort(perm) == regspace<uvec>(0, n - 1)));
+
+        GWPCA replicate;
+        replicate.setCoords(mat(londonhp100_coord.rows(perm)));
+        replicate.setVariables(x);
+        replicate.setSpatialWeight(spatial);
+        replicate.setKeepComponents(2);
+        REQUIRE_NOTHROW(replicate.run());
+
+        double sumwPerm = sum(bandwidth.weight(distance.distance(perm(n - 1))));
+        double statistic = stddev(vec(square(replicate.sdev().col(0)))) * sumwPerm / sumw;
+        REQUIRE_THAT(statistic, Catch::Matchers::WithinRel(replicates(r), 1e-8));
+    }
+}
+
 TEST_CASE("GWSS: cancel")
 {
     mat londonhp100_coord, londonhp100_data;
@@ -3,9 +3,13 @@
 
 #include <vector>
 #include <string>
+#include <sstream>
 #include <armadillo>
 #include "gwmodelpp/GWRBasic.h"
+#include "gwmodelpp/ModelArchive.h"
+#include "gwmodelpp/GWRPredictor.h"
 #include "gwmodelpp/spatialweight/CRSDistance.h"
+#include "gwmodelpp/spatialweight/MinkwoskiDistance.h"
 #include "gwmodelpp/spatialweight/BandwidthWeight.h"
 #include "gwmodelpp/spatialweight/SpatialWeight.h"
 #include "londonhp100.h"
@@ -239,6 +243,155 @@ TEST_CASE("BasicGWR: LondonHP")
         REQUIRE_THAT(diagnostic.RSquareAdjust, Catch::Matchers::WithinAbs(0.678982114793865, 1e-8));
     }
 
+    SECTION("adaptive bandwidth | save and load | prediction without fitting") {
+        CRSDistance distance(false);
+        BandwidthWeight bandwidth(36, true, BandwidthWeight::Gaussian);
+        SpatialWeight spatial(&bandwidth, &distance);
+
+        GWRBasic algorithm;
+        algorithm.setCoords(londonhp100_coord);
+        algorithm.setDependentVariable(y);
+        algorithm.setIndependentVariables(x);
+        algorithm.setSpatialWeight(spatial);
+        REQUIRE_NOTHROW(algorithm.fit());
+
+        ModelArchive archive;
+        algorithm.saveModel(archive);
+        stringstream stream;
+        REQUIRE_NOTHROW(archive.save(stream));
+
+        GWRBasic loaded;
+        REQUIRE_NOTHROW(loaded.loadModel(ModelArchive::load(stream)));
+        REQUIRE(approx_equal(loaded.betas(), algorithm.betas(), "absdiff", 1e-12));
+        REQUIRE(approx_equal(loaded.betasSE(), algorithm.betasSE(), "absdiff", 1e-12));
+        REQUIRE_THAT(loaded.diagnostic().AICc, Catch::Matchers::WithinAbs(2448.27206524754, 1e-8));
+        REQUIRE(loaded.spatialWeight().weight<BandwidthWeight>()->bandwidth() == 36.0);
+
+        mat locations = londonhp100_coord.rows(0, 9);
+        mat expected = algorithm.predict(locations);
+        mat predicted;
+        REQUIRE_NOTHROW(predicted = loaded.predict(locations));
+        REQUIRE(approx_equal(predicted, expected, "absdiff", 1e-12));
+    }
+
+    SECTION("adaptive bisquare | blocked prediction at data points") {
+        auto parallel = GENERATE_REF(values(parallel_list));
+        INFO("Parallel:" << ParallelTypeDict.at(parallel));
+
+        CRSDistance distance(false);
+        BandwidthWeight bandwidth(36, true, BandwidthWeight::Bisquare);
+        SpatialWeight spatial(&bandwidth, &distance);
+
+        GWRBasic algorithm;
+        algorithm.setCoords(londonhp100_coord);
+        algorithm.setDependentVariable(y);
+        algorithm.setIndependentVariables(x);
+        algorithm.setSpatialWeight(spatial);
+        algorithm.setParallelType(parallel);
+#ifdef ENABLE_CUDA
+        if (parallel == ParallelType::CUDA)
+        {
+            algorithm.setGPUId(0);
+            algorithm.setGroupSize(64);
+        }
+#endif // ENABLE_CUDA
+        REQUIRE_NOTHROW(algorithm.fit());
+        mat betas = algorithm.betas();
+        mat predicted;
+        REQUIRE_NOTHROW(predicted = algorithm.predict(londonhp100_coord));
+        REQUIRE(approx_equal(predicted, betas, "both", 1e-8, 1e-8));
+    }
+
+    SECTION("predictor | adaptive bisquare, fixed bisquare and fixed gaussian") {
+        CRSDistance distance(false);
+        // Fixed bisquare finds neighbours by BallTree::within() rather than the nearest ones.
+        vector<BandwidthWeight> bandwidths = {
+            BandwidthWeight(36, true, BandwidthWeight::Bisquare),
+            BandwidthWeight(5000, false, BandwidthWeight::Bisquare),
+            BandwidthWeight(5000, false, BandwidthWeight::Gaussian)
+        };
+        for (auto&& bandwidth : bandwidths)
+        {
+            SpatialWeight spatial(&bandwidth, &distance);
+            GWRBasic algorithm;
+            algorithm.setCoords(londonhp100_coord);
+            algorithm.setDependentVariable(y);
+            algorithm.setIndependentVariables(x);
+            algorithm.setSpatialWeight(spatial);
+            REQUIRE_NOTHROW(algorithm.fit());
+
+            GWRPredictor predictor(algorithm);
+            mat locations = londonhp100_coord.rows(0, 19) + 100.0;
+            mat predicted = predictor.predict(locations);
+            mat expected = algorithm.predict(locations);
+            REQUIRE(approx_equal(predicted, expected, "both", 1e-8, 1e-8));
+            REQUIRE(approx_equal(predictor.predict(rowvec(locations.row(3))), predicted.row(3), "absdiff", 1e-12));
+        }
+    }
+
+#ifdef ENABLE_OPENMP
+    SECTION("predictor | shared by openmp threads") {
+        CRSDistance distance(false);
+        vector<BandwidthWeight> bandwidths = {
+            BandwidthWeight(36, true, BandwidthWeight::Bisquare),
+            BandwidthWeight(5000, false, BandwidthWeight::Bisquare)
+        };
+        for (auto&& bandwidth : bandwidths)
+        {
+            SpatialWeight spatial(&bandwidth, &distance);
+            GWRBasic algorithm;
+            algorithm.setCoords(londonhp100_coord);
+            algorithm.setDependentVariable(y);
+            algorithm.setIndependentVariables(x);
+            algorithm.setSpatialWeight(spatial);
+            REQUIRE_NOTHROW(algorithm.fit());
+
+            // Each thread uses its own workspace, so one predictor can be queried concurrently.
+            const GWRPredictor predictor(algorithm);
+            mat locations = join_cols(londonhp100_coord, mat(londonhp100_coord + 100.0));
+            mat serial = predictor.predict(locations);
+            mat parallel(locations.n_rows, x.n_cols, arma::fill::zeros);
+#pragma omp parallel for num_threads(8)
+            for (int i = 0; (uword)i < locations.n_rows; i++)
+            {
+                parallel.row(i) = predictor.predict(rowvec(locations.row(i)));
+            }
+            REQUIRE(approx_equal(parallel, serial, "absdiff", 1e-12));
+        }
+    }
+#endif // ENABLE_OPENMP
+
+    SECTION("distance tiles | projected, geographic and minkowski") {
+        CRSDistance projected(false), geographic(true);
+        MinkwoskiDistance euclidean(2.0, 0.5), chess(1.0, 0.5);
+        vector<pair<Distance*, mat>> cases = {
+            { &projected, londonhp100_coord },
+            { &geographic, mat(londonhp100_coord / 10000.0) },
+            { &euclidean, londonhp100_coord },
+            { &chess, londonhp100_coord }
+        };
+        uvec focuses = { 0, 3, 19, 7, 7 };
+        for (auto&& c : cases)
+        {
+            Distance* distance = c.first;
+            const mat& coords = c.second;
+            distance->makeParameter({ mat(coords.rows(0, 19) + 0.01), coords });
+            mat tile = distance->distanceBlock(focuses);
+            REQUIRE(tile.n_rows == coords.n_rows);
+            REQUIRE(tile.n_cols == focuses.n_elem);
+            for (uword j = 0; j < focuses.n_elem; j++)
+            {
+                REQUIRE(approx_equal(tile.col(j), distance->distance(focuses(j)), "both", 1e-12, 1e-12));
+            }
+            distance->makeParameter({ coords, coords });
+            tile = distance->distanceBlock(focuses);
+            for (uword j = 0; j < focuses.n_elem; j++)
+            {
+                REQUIRE(tile(focuses(j), j) == 0.0);
+            }
+        }
+    }
+
 }
 
 
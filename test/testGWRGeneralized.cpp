@@ -3,8 +3,10 @@
 
 #include <vector>
 #include <string>
+#include <sstream>
 #include <armadillo>
 #include "gwmodelpp/GWRGeneralized.h"
+#include "gwmodelpp/ModelArchive.h"
 #include "gwmodelpp/spatialweight/CRSDistance.h"
 #include "gwmodelpp/spatialweight/BandwidthWeight.h"
 #include "gwmodelpp/spatialweight/SpatialWeight.h"
@@ -49,6 +51,48 @@ TEST_CASE("GGWR: basic flow")
     
 }
 
+TEST_CASE("GGWR: save and load")
+{
+    mat londonhp100_coord, londonhp100_data;
+    vector<string> londonhp100_fields;
+    if (!read_londonhp100(londonhp100_coord, londonhp100_data, londonhp100_fields))
+    {
+        FAIL("Cannot load londonhp100 data.");
+    }
+
+    vec y = londonhp100_data.col(0);
+    mat x = join_rows(ones(londonhp100_coord.n_rows), londonhp100_data.cols(1, 3));
+
+    CRSDistance distance(false);
+    BandwidthWeight bandwidth(27, true, BandwidthWeight::Gaussian);
+    SpatialWeight spatial(&bandwidth, &distance);
+
+    GWRGeneralized algorithm;
+    algorithm.setCoords(londonhp100_coord);
+    algorithm.setDependentVariable(y);
+    algorithm.setIndependentVariables(x);
+    algorithm.setSpatialWeight(spatial);
+    algorithm.setHasHatMatrix(true);
+    REQUIRE_NOTHROW(algorithm.fit());
+
+    ModelArchive archive;
+    algorithm.saveModel(archive);
+    REQUIRE(archive.model() == "GWRGeneralized");
+    stringstream stream;
+    REQUIRE_NOTHROW(archive.save(stream));
+
+    GWRGeneralized loaded;
+    REQUIRE_NOTHROW(loaded.loadModel(ModelArchive::load(stream)));
+    REQUIRE(loaded.getFamily() == algorithm.getFamily());
+    REQUIRE(approx_equal(loaded.betas(), algorithm.betas(), "absdiff", 1e-12));
+    REQUIRE(loaded.spatialWeight().weight<BandwidthWeight>()->bandwidth() == 27.0);
+    GWRGeneralizedDiagnostic expected = algorithm.getDiagnostic(), diagnostic = loaded.getDiagnostic();
+    REQUIRE_THAT(diagnostic.AIC, Catch::Matchers::WithinAbs(expected.AIC, 1e-12));
+    REQUIRE_THAT(diagnostic.AICc, Catch::Matchers::WithinAbs(expected.AICc, 1e-12));
+    REQUIRE_THAT(diagnostic.RSquare, Catch::Matchers::WithinAbs(expected.RSquare, 1e-12));
+    REQUIRE_THAT(loaded.getGLMDiagnostic().Dev, Catch::Matchers::WithinAbs(algorithm.getGLMDiagnostic().Dev, 1e-12));
+}
+
 TEST_CASE("GGWR: adaptive bandwidth autoselection of with AIC")
 {
     mat londonhp100_coord, londonhp100_data;
@@ -15,6 +15,45 @@ using namespace std;
 using namespace arma;
 using namespace gwm;
 
+/**
+ * Ridge parameter of one local regression as chosen before the fused solve, from singular values of the column-normalised weighted design.
+ */
+double refLambda(const mat& x, const vec& w, double lambda, bool lambdaAdjust, double cnThresh)
+{
+    uword m = x.n_cols;
+    mat x1w = x.each_col() % w;
+    vec S = svd(mat(x1w.each_row() / sqrt(sum(x1w % x1w, 0))));
+    if (lambdaAdjust && S(0) / S(m - 1) > cnThresh)
+    {
+        return (S(0) - cnThresh * S(m - 1)) / (cnThresh - 1);
+    }
+    return lambda;
+}
+
+/**
+ * Coefficients of one local ridge regression as fitted before the fused solve, on variables scaled by global standard deviations.
+ */
+vec refRidge(const mat& x, const vec& y, const vec& w, double lambda)
+{
+    uword m = x.n_cols;
+    rowvec xsd(m, fill::ones);
+    xsd.cols(1, m - 1) = stddev(x.cols(1, m - 1), 0);
+    mat xws = x.each_col() % sqrt(w);
+    xws.each_row() /= xsd;
+    vec yw = y % sqrt(w);
+    mat a = trans(xws) * xws + lambda * eye(m, m);
+    return solve(a, trans(xws) * yw) / trans(xsd);
+}
+
+/**
+ * Exposes the CV of given settings for tests.
+ */
+class GWRLocalCollinearityCV : public GWRLocalCollinearity
+{
+public:
+    using GWRLocalCollinearity::LcrCV;
+};
+
 TEST_CASE("LocalCollinearityGWR: basic flow")
 {
     mat londonhp100_coord, londonhp100_data;
@@ -114,6 +153,118 @@ TEST_CASE("LocalCollinearityGWR: ")
 
     
 }
+TEST_CASE("LocalCollinearityGWR: lambda adjustment against refitting")
+{
+    mat londonhp100_coord, londonhp100_data;
+    vector<string> londonhp100_fields;
+    if (!read_londonhp100(londonhp100_coord, londonhp100_data, londonhp100_fields))
+    {
+        FAIL("Cannot load londonhp100 data.");
+    }
+
+    CRSDistance distance(false);
+    BandwidthWeight bandwidth(36, true, BandwidthWeight::Gaussian);
+    SpatialWeight spatial(&bandwidth, &distance);
+
+    vec y = londonhp100_data.col(0);
+    mat x = join_rows(ones(londonhp100_coord.n_rows), londonhp100_data.cols(1, 3));
+    uword n = x.n_rows, m = x.n_cols;
+    double lambda = 0.01;
+
+    // Set the threshold between local condition numbers so that only some local ridge parameters are adjusted.
+    distance.makeParameter({ londonhp100_coord, londonhp100_coord });
+    vec cn(n);
+    for (uword i = 0; i < n; i++)
+    {
+        mat x1w = x.each_col() % bandwidth.weight(distance.distance(i));
+        vec S = svd(mat(x1w.each_row() / sqrt(sum(x1w % x1w, 0))));
+        cn(i) = S(0) / S(m - 1);
+    }
+    double cnThresh = median(cn);
+    REQUIRE(cnThresh > 1.0);
+    REQUIRE(any(cn > cnThresh));
+
+    const initializer_list<ParallelType> parallel_list = {
+        ParallelType::SerialOnly
+#ifdef ENABLE_OPENMP
+        , ParallelType::OpenMP
+#endif // ENABLE_OPENMP     
+    };
+    auto parallel = GENERATE_REF(values(parallel_list));
+    INFO("Parallel type: " << parallel);
+
+    SECTION("fit")
+    {
+        mat betas(n, m);
+        double trS = 0.0, trStS = 0.0;
+        for (uword i = 0; i < n; i++)
+        {
+            vec w = bandwidth.weight(distance.distance(i));
+            betas.row(i) = trans(refRidge(x, y, w, refLambda(x, w, lambda, true, cnThresh)));
+            mat x1w = x.each_col() % w;
+            rowvec hatrow = x1w.row(i) * inv(trans(x1w) * x) * trans(x1w);
+            trS += hatrow(i);
+            trStS += sum(hatrow % hatrow);
+        }
+        double rss = sum(square(y - sum(betas % x, 1)));
+        double enp = 2 * trS - trStS, edf = n - enp;
+        double s2 = rss / (n - enp);
+        double aic = n * (log(2 * datum::pi * s2) + 1) + 2 * (enp + 1);
+        double aicc = n * (log(2 * datum::pi * s2)) + n * ((1 + enp / n) / (1 - (enp + 2) / n));
+        double r2 = 1 - rss / sum(square(y - mean(y)));
+
+        GWRLocalCollinearity algorithm;
+        algorithm.setCoords(londonhp100_coord);
+        algorithm.setDependentVariable(y);
+        algorithm.setIndependentVariables(x);
+        algorithm.setSpatialWeight(spatial);
+        algorithm.setLambda(lambda);
+        algorithm.setLambdaAdjust(true);
+        algorithm.setCnThresh(cnThresh);
+        algorithm.setParallelType(parallel);
+        algorithm.setOmpThreadNum(6);
+        REQUIRE_NOTHROW(algorithm.fit());
+
+        REQUIRE(approx_equal(algorithm.betas(), betas, "both", 1e-6, 1e-6));
+        RegressionDiagnostic diagnostic = algorithm.diagnostic();
+        REQUIRE_THAT(diagnostic.RSS, Catch::Matchers::WithinRel(rss, 1e-8));
+        REQUIRE_THAT(diagnostic.ENP, Catch::Matchers::WithinAbs(enp, 1e-6));
+        REQUIRE_THAT(diagnostic.EDF, Catch::Matchers::WithinAbs(edf, 1e-6));
+        REQUIRE_THAT(diagnostic.AIC, Catch::Matchers::WithinAbs(aic, 1e-6));
+        REQUIRE_THAT(diagnostic.AICc, Catch::Matchers::WithinAbs(aicc, 1e-6));
+        REQUIRE_THAT(diagnostic.RSquare, Catch::Matchers::WithinAbs(r2, 1e-8));
+        REQUIRE_THAT(diagnostic.RSquareAdjust, Catch::Matchers::WithinAbs(1 - (1 - r2) * (n - 1) / edf, 1e-8));
+    }
+
+    SECTION("CV")
+    {
+        GWRLocalCollinearityCV algorithm;
+        algorithm.setCoords(londonhp100_coord);
+        algorithm.setDependentVariable(y);
+        algorithm.setIndependentVariables(x);
+        algorithm.setSpatialWeight(spatial);
+        algorithm.setParallelType(parallel);
+        algorithm.setOmpThreadNum(6);
+        REQUIRE_NOTHROW(algorithm.fit());
+
+        auto lambdaAdjust = GENERATE(false, true);
+        INFO("Lambda adjust: " << lambdaAdjust);
+        double cv = 0.0;
+        for (uword i = 0; i < n; i++)
+        {
+            vec w = bandwidth.weight(distance.distance(i));
+            w(i) = 0.0;
+            vec b = refRidge(x, y, w, refLambda(x, w, lambda, lambdaAdjust, cnThresh));
+            double r = y(i) - as_scalar(x.row(i) * b);
+            cv += r * r;
+        }
+        REQUIRE_THAT(algorithm.LcrCV(36, BandwidthWeight::Gaussian, true, lambda, lambdaAdjust, cnThresh), Catch::Matchers::WithinRel(cv, 1e-8));
+        REQUIRE(algorithm.lambda() == 0.0);
+        REQUIRE(algorithm.lambdaAdjust() == false);
+        REQUIRE(algorithm.cnThresh() == 30.0);
+    }
+}
+
 /*
 #ifdef ENABLE_OPENMP
 TEST_CASE("LocalCollinearityGWR: multithread basic flow")
@@ -4,8 +4,10 @@
 
 #include <vector>
 #include <string>
+#include <sstream>
 #include <armadillo>
 #include "gwmodelpp/GWRMultiscale.h"
+#include "gwmodelpp/ModelArchive.h"
 
 #include "gwmodelpp/spatialweight/CRSDistance.h"
 #include "gwmodelpp/spatialweight/BandwidthWeight.h"
@@ -132,6 +134,72 @@ TEST_CASE("MGWR: basic flow")
         REQUIRE_THAT(diagnostic.RSquareAdjust, Catch::Matchers::WithinAbs(0.7118919517893492, 1e-6));
     }
 
+    SECTION("optim bw cv | null init bw | adaptive | bisquare kernel | with hatmatrix probes")
+    {
+        auto parallel = GENERATE_REF(values(parallelTypes));
+        INFO("Parallel type: " << ParallelTypeDict.at(parallel));
+
+        auto fitModel = [&](GWRMultiscale& algorithm, uword probes)
+        {
+            vector<SpatialWeight> spatials;
+            vector<bool> preditorCentered;
+            vector<GWRMultiscale::BandwidthInitilizeType> bandwidthInitialize;
+            vector<GWRMultiscale::BandwidthSelectionCriterionType> bandwidthSelectionApproach;
+            for (size_t i = 0; i < nVar; i++)
+            {
+                CRSDistance distance;
+                BandwidthWeight bandwidth(36, true, BandwidthWeight::Bisquare);
+                spatials.push_back(SpatialWeight(&bandwidth, &distance));
+                preditorCentered.push_back(i != 0);
+                bandwidthInitialize.push_back(GWRMultiscale::BandwidthInitilizeType::Initial);
+                bandwidthSelectionApproach.push_back(GWRMultiscale::BandwidthSelectionCriterionType::AIC);
+            }
+
+            algorithm.setCoords(londonhp100_coord);
+            algorithm.setDependentVariable(y);
+            algorithm.setIndependentVariables(x);
+            algorithm.setSpatialWeights(spatials);
+            algorithm.setHasHatMatrix(true);
+            algorithm.setHatMatrixProbes(probes);
+            algorithm.setHatMatrixProbeSeed(1);
+            algorithm.setCriterionType(GWRMultiscale::BackFittingCriterionType::dCVR);
+            algorithm.setPreditorCentered(preditorCentered);
+            algorithm.setBandwidthInitilize(bandwidthInitialize);
+            algorithm.setBandwidthSelectionApproach(bandwidthSelectionApproach);
+            algorithm.setBandwidthSelectRetryTimes(5);
+            algorithm.setBandwidthSelectThreshold(vector(3, 1e-5));
+            algorithm.setParallelType(parallel);
+            REQUIRE_NOTHROW(algorithm.fit());
+        };
+
+        const uword probes = 30;
+        REQUIRE(probes < londonhp100_coord.n_rows);
+        GWRMultiscale exact, algorithm;
+        fitModel(exact, 0);
+        fitModel(algorithm, probes);
+
+        const vector<SpatialWeight>& spatialWeights = algorithm.spatialWeights();
+        REQUIRE_THAT(spatialWeights[0].weight<BandwidthWeight>()->bandwidth(), Catch::Matchers::WithinAbs(45, 0.1));
+        REQUIRE_THAT(spatialWeights[1].weight<BandwidthWeight>()->bandwidth(), Catch::Matchers::WithinAbs(98, 0.1));
+        REQUIRE_THAT(spatialWeights[2].weight<BandwidthWeight>()->bandwidth(), Catch::Matchers::WithinAbs(98, 0.1));
+
+        // Recover exact tr(S) from AICc and tr(S^TS) from ENP = 2 tr(S) - tr(S^TS).
+        // Hutchinson's estimator with m Rademacher probes has Var[tr(S)] <= 2 tr(S^TS) / m,
+        // so the estimate should lie within 4 standard deviations and AICc within the induced range.
+        RegressionDiagnostic reference = exact.diagnostic(), diagnostic = algorithm.diagnostic();
+        double n = double(londonhp100_coord.n_rows);
+        double k = reference.AICc - n * log(reference.RSS / n) - n * log(2 * M_PI);
+        double trS = (k * (n - 2) - n * n) / (n + k), trStS = 2 * trS - reference.ENP;
+        double delta = 4.0 * sqrt(2.0 * trStS / double(probes));
+        REQUIRE(trS + delta < n - 2);
+        double aiccTolerance = n * (n + trS + delta) / (n - 2 - trS - delta) - n * (n + trS) / (n - 2 - trS);
+        INFO("tr(S): " << trS << ", tr(S^TS): " << trStS << ", AICc tolerance: " << aiccTolerance);
+        REQUIRE_THAT(reference.AICc, Catch::Matchers::WithinAbs(2437.935218705351, 1e-6));
+        REQUIRE_THAT(diagnostic.RSS, Catch::Matchers::WithinRel(reference.RSS, 1e-8));
+        REQUIRE_THAT(diagnostic.AICc, Catch::Matchers::WithinAbs(reference.AICc, aiccTolerance));
+        REQUIRE_THAT(diagnostic.RSquare, Catch::Matchers::WithinAbs(0.7486787930045755, 1e-6));
+    }
+
     SECTION("optim bw cv | null init bw | adaptive | bisquare kernel | without hatmatrix")
     {
         auto parallel = GENERATE_REF(values(parallelTypes));
@@ -257,6 +325,68 @@ TEST_CASE("MGWR: basic flow")
     }
 }
 
+TEST_CASE("MGWR: save and load")
+{
+    mat londonhp100_coord, londonhp100_data;
+    vector<string> londonhp100_fields;
+    if (!read_londonhp100(londonhp100_coord, londonhp100_data, londonhp100_fields))
+    {
+        FAIL("Cannot load londonhp100 data.");
+    }
+
+    vec y = londonhp100_data.col(0);
+    mat x = join_rows(ones(londonhp100_data.n_rows), londonhp100_data.cols(uvec({1, 3})));
+    uword nVar = 3;
+
+    vector<SpatialWeight> spatials;
+    vector<bool> preditorCentered;
+    vector<GWRMultiscale::BandwidthInitilizeType> bandwidthInitialize;
+    vector<GWRMultiscale::BandwidthSelectionCriterionType> bandwidthSelectionApproach;
+    const double bandwidths[] = { 45, 98, 98 };
+    for (size_t i = 0; i < nVar; i++)
+    {
+        CRSDistance distance;
+        BandwidthWeight bandwidth(bandwidths[i], true, BandwidthWeight::Bisquare);
+        spatials.push_back(SpatialWeight(&bandwidth, &distance));
+        preditorCentered.push_back(i != 0);
+        bandwidthInitialize.push_back(GWRMultiscale::BandwidthInitilizeType::Specified);
+        bandwidthSelectionApproach.push_back(GWRMultiscale::BandwidthSelectionCriterionType::AIC);
+    }
+
+    GWRMultiscale algorithm;
+    algorithm.setCoords(londonhp100_coord);
+    algorithm.setDependentVariable(y);
+    algorithm.setIndependentVariables(x);
+    algorithm.setSpatialWeights(spatials);
+    algorithm.setHasHatMatrix(true);
+    algorithm.setCriterionType(GWRMultiscale::BackFittingCriterionType::dCVR);
+    algorithm.setPreditorCentered(preditorCentered);
+    algorithm.setBandwidthInitilize(bandwidthInitialize);
+    algorithm.setBandwidthSelectionApproach(bandwidthSelectionApproach);
+    REQUIRE_NOTHROW(algorithm.fit());
+
+    ModelArchive archive;
+    algorithm.saveModel(archive);
+    REQUIRE(archive.model() == "GWRMultiscale");
+    stringstream stream;
+    REQUIRE_NOTHROW(archive.save(stream));
+
+    GWRMultiscale loaded;
+    REQUIRE_NOTHROW(loaded.loadModel(ModelArchive::load(stream)));
+    REQUIRE(approx_equal(loaded.betas(), algorithm.betas(), "absdiff", 1e-12));
+    REQUIRE(loaded.hasIntercept() == algorithm.hasIntercept());
+    REQUIRE_THAT(loaded.diagnostic().AICc, Catch::Matchers::WithinAbs(algorithm.diagnostic().AICc, 1e-12));
+    REQUIRE_THAT(loaded.diagnostic().RSquare, Catch::Matchers::WithinAbs(algorithm.diagnostic().RSquare, 1e-12));
+    REQUIRE(loaded.spatialWeights().size() == nVar);
+    for (size_t i = 0; i < nVar; i++)
+    {
+        const BandwidthWeight* bw = loaded.spatialWeights()[i].weight<BandwidthWeight>();
+        REQUIRE(bw->bandwidth() == bandwidths[i]);
+        REQUIRE(bw->adaptive());
+        REQUIRE(bw->kernel() == BandwidthWeight::Bisquare);
+    }
+}
+
 TEST_CASE("Multiscale GWR: cancel")
 {
     mat londonhp100_coord, londonhp100_data;
@@ -240,6 +240,85 @@ TEST_CASE("RobustGWR: multithread basic flow")
 }
 #endif
 
+TEST_CASE("RobustGWR: cached local products against a fresh fit")
+{
+    mat londonhp100_coord, londonhp100_data;
+    vector<string> londonhp100_fields;
+    if (!read_londonhp100(londonhp100_coord, londonhp100_data, londonhp100_fields))
+    {
+        FAIL("Cannot load londonhp100 data.");
+    }
+
+    vec y = londonhp100_data.col(0);
+    mat x = join_rows(ones(londonhp100_coord.n_rows), londonhp100_data.cols(1, 3));
+    uword n = x.n_rows, k = x.n_cols;
+
+    const initializer_list<ParallelType> parallel_list = {
+        ParallelType::SerialOnly
+#ifdef ENABLE_OPENMP
+        , ParallelType::OpenMP
+#endif // ENABLE_OPENMP     
+    };
+    auto parallel = GENERATE_REF(values(parallel_list));
+    auto filtered = GENERATE(true, false);
+    auto kernel = GENERATE(BandwidthWeight::Gaussian, BandwidthWeight::Bisquare);
+    INFO("Settings: " << parallel << ", " << filtered << ", " << kernel);
+
+    CRSDistance distance(false);
+    BandwidthWeight bandwidth(36, true, kernel);
+    SpatialWeight spatial(&bandwidth, &distance);
+
+    GWRRobust algorithm;
+    algorithm.setCoords(londonhp100_coord);
+    algorithm.setDependentVariable(y);
+    algorithm.setIndependentVariables(x);
+    algorithm.setSpatialWeight(spatial);
+    algorithm.setHasHatMatrix(true);
+    algorithm.setFiltered(filtered);
+    algorithm.setParallelType(parallel);
+    algorithm.setOmpThreadNum(6);
+    REQUIRE_NOTHROW(algorithm.fit());
+
+    // Refit every local regression from scratch under the second-level weights of the last calibration.
+    vec mask = algorithm.weightMask();
+    REQUIRE(mask.n_elem == n);
+    REQUIRE(any(mask < 1.0));
+    distance.makeParameter({ londonhp100_coord, londonhp100_coord });
+    mat betas(n, k), betasSE(n, k);
+    vec qDiag(n, fill::zeros);
+    double trS = 0.0, trStS = 0.0;
+    for (uword i = 0; i < n; i++)
+    {
+        vec w = bandwidth.weight(distance.distance(i)) % mask;
+        mat xtw = trans(x.each_col() % w);
+        mat xtwx_inv = inv_sympd(xtw * x);
+        betas.row(i) = trans(xtwx_inv * xtw * y);
+        mat ci = xtwx_inv * xtw;
+        betasSE.row(i) = trans(sum(ci % ci, 1));
+        rowvec si = x.row(i) * ci;
+        trS += si(i);
+        trStS += sum(si % si);
+        vec p = - si.t();
+        p(i) += 1.0;
+        qDiag += p % p;
+    }
+    double rss = sum(square(y - sum(betas % x, 1)));
+    double sigmaHat = rss / (n - 2 * trS + trStS);
+    betasSE = sqrt(sigmaHat * betasSE);
+    double aic = n * log(rss / n) + n * log(2 * datum::pi) + n + trS;
+    double aicc = n * log(rss / n) + n * log(2 * datum::pi) + n * ((n + trS) / (n - 2 - trS));
+    double r2 = 1 - rss / sum(square(y - mean(y)));
+
+    REQUIRE(approx_equal(algorithm.betas(), betas, "both", 1e-8, 1e-8));
+    REQUIRE(approx_equal(algorithm.betasSE(), betasSE, "both", 1e-8, 1e-8));
+    RegressionDiagnostic diagnostic = algorithm.diagnostic();
+    REQUIRE_THAT(diagnostic.RSS, Catch::Matchers::WithinRel(rss, 1e-8));
+    REQUIRE_THAT(diagnostic.ENP, Catch::Matchers::WithinAbs(2 * trS - trStS, 1e-8));
+    REQUIRE_THAT(diagnostic.AIC, Catch::Matchers::WithinAbs(aic, 1e-8));
+    REQUIRE_THAT(diagnostic.AICc, Catch::Matchers::WithinAbs(aicc, 1e-8));
+    REQUIRE_THAT(diagnostic.RSquare, Catch::Matchers::WithinAbs(r2, 1e-8));
+}
+
 TEST_CASE("Robust GWR: cancel")
 {
     mat londonhp100_coord, londonhp100_data;
@@ -3,8 +3,10 @@
 
 #include <vector>
 #include <string>
+#include <sstream>
 #include <armadillo>
 #include "gwmodelpp/GWRScalable.h"
+#include "gwmodelpp/ModelArchive.h"
 #include "gwmodelpp/spatialweight/CRSDistance.h"
 #include "gwmodelpp/spatialweight/BandwidthWeight.h"
 #include "gwmodelpp/spatialweight/SpatialWeight.h"
@@ -51,6 +53,55 @@ TEST_CASE("ScalableGWR: basic flow")
     REQUIRE(algorithm.hasIntercept() == true);
 }
 
+TEST_CASE("ScalableGWR: save and load")
+{
+    mat londonhp100_coord, londonhp100_data;
+    vector<string> londonhp100_fields;
+    if (!read_londonhp100(londonhp100_coord, londonhp100_data, londonhp100_fields))
+    {
+        FAIL("Cannot load londonhp100 data.");
+    }
+
+    CRSDistance distance(false);
+    BandwidthWeight bandwidth(60, true, BandwidthWeight::Gaussian);
+    SpatialWeight spatial(&bandwidth, &distance);
+
+    vec y = londonhp100_data.col(0);
+    mat x = join_rows(ones(londonhp100_coord.n_rows), londonhp100_data.cols(1, 3));
+
+    GWRScalable algorithm;
+    algorithm.setCoords(londonhp100_coord);
+    algorithm.setDependentVariable(y);
+    algorithm.setIndependentVariables(x);
+    algorithm.setSpatialWeight(spatial);
+    algorithm.setPolynomial(4);
+    algorithm.setHasHatMatrix(true);
+    algorithm.setParameterOptimizeCriterion(GWRScalable::BandwidthSelectionCriterionType::CV);
+    REQUIRE_NOTHROW(algorithm.fit());
+
+    ModelArchive archive;
+    algorithm.saveModel(archive);
+    REQUIRE(archive.model() == "GWRScalable");
+    stringstream stream;
+    REQUIRE_NOTHROW(archive.save(stream));
+
+    GWRScalable loaded;
+    REQUIRE_NOTHROW(loaded.loadModel(ModelArchive::load(stream)));
+    REQUIRE(loaded.polynomial() == 4);
+    REQUIRE_THAT(loaded.scale(), Catch::Matchers::WithinAbs(algorithm.scale(), 1e-12));
+    REQUIRE_THAT(loaded.penalty(), Catch::Matchers::WithinAbs(algorithm.penalty(), 1e-12));
+    REQUIRE_THAT(loaded.cv(), Catch::Matchers::WithinAbs(algorithm.cv(), 1e-12));
+    REQUIRE(approx_equal(loaded.betas(), algorithm.betas(), "absdiff", 1e-12));
+    REQUIRE_THAT(loaded.diagnostic().AICc, Catch::Matchers::WithinAbs(algorithm.diagnostic().AICc, 1e-12));
+
+    // A loaded model predicts with the archived scale and penalty, which fitting would select again.
+    mat locations = londonhp100_coord.rows(0, 9);
+    mat expected = algorithm.predict(locations);
+    mat predicted;
+    REQUIRE_NOTHROW(predicted = loaded.predict(locations));
+    REQUIRE(approx_equal(predicted, expected, "both", 1e-8, 1e-8));
+}
+
 TEST_CASE("ScalableGWR:  bandwidth  of with AIC")
 {
     mat londonhp100_coord, londonhp100_data;
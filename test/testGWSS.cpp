@@ -5,6 +5,7 @@
 #include <string>
 #include <armadillo>
 #include "gwmodelpp/GWSS.h"
+#include "gwmodelpp/WeightedQuantile.h"
 #include "gwmodelpp/spatialweight/CRSDistance.h"
 #include "gwmodelpp/spatialweight/BandwidthWeight.h"
 #include "gwmodelpp/spatialweight/SpatialWeight.h"
@@ -15,6 +16,30 @@ using namespace std;
 using namespace arma;
 using namespace gwm;
 
+/**
+ * Weighted quantiles by sorting each variable under every weight vector:
+ * the value right before the first sorted value whose cumulative weight exceeds the probability.
+ */
+mat bruteWeightedQuantile(const mat& x, const vec& w, const vec& probs)
+{
+    uword n = x.n_rows;
+    mat q(probs.n_elem, x.n_cols);
+    for (uword j = 0; j < x.n_cols; j++)
+    {
+        uvec order = stable_sort_index(x.col(j));
+        vec xo = x.col(j);
+        xo = xo(order);
+        vec cum = cumsum(w(order));
+        for (uword k = 0; k < probs.n_elem; k++)
+        {
+            uword t = 0;
+            while (t < n && !(cum(t) > probs(k))) t++;
+            q(k, j) = t == n ? xo(n - 1) : xo(t > 0 ? t - 1 : 0);
+        }
+    }
+    return q;
+}
+
 TEST_CASE("GWSS: londonhp100")
 {
     mat londonhp100_coord, londonhp100_data;
@@ -78,6 +103,89 @@ TEST_CASE("GWSS: londonhp100")
         REQUIRE(approx_equal(localcv_q, localcv_q0, "absdiff", 1e-8));
     }
 
+    SECTION("adaptive bisquare | GWAverage | clustered and constant variables")
+    {
+        CRSDistance distance(false);
+        BandwidthWeight bandwidth(10, true, BandwidthWeight::Bisquare);
+        SpatialWeight spatial(&bandwidth, &distance);
+
+        // The first variable jumps by far more than its local spread across a line, the second one is constant.
+        uword n = londonhp100_coord.n_rows;
+        vec east = londonhp100_coord.col(0);
+        mat x(n, 2);
+        for (uword i = 0; i < n; i++)
+        {
+            x(i, 0) = (east(i) > median(east) ? 1e8 : 0.0) + double(i % 5) * 1e-3;
+        }
+        x.col(1).fill(7.3);
+
+        GWSS algorithm;
+        algorithm.setCoords(londonhp100_coord);
+        algorithm.setVariables(x);
+        algorithm.setGWSSMode(GWSS::GWSSMode::Average);
+        algorithm.setSpatialWeight(spatial);
+        REQUIRE_NOTHROW(algorithm.run());
+
+        // Variances about the local means.
+        distance.makeParameter({ londonhp100_coord, londonhp100_coord });
+        mat var(n, 2);
+        for (uword i = 0; i < n; i++)
+        {
+            vec w = bandwidth.weight(distance.distance(i));
+            w /= sum(w);
+            for (uword k = 0; k < 2; k++)
+            {
+                vec c = x.col(k) - dot(w, x.col(k));
+                var(i, k) = dot(w, c % c);
+            }
+        }
+        REQUIRE(algorithm.localVar().is_finite());
+        REQUIRE(algorithm.localSDev().is_finite());
+        REQUIRE(algorithm.localSkewness().col(0).is_finite());
+        REQUIRE(all(vectorise(algorithm.localVar()) >= 0.0));
+        REQUIRE(approx_equal(algorithm.localVar().col(0), var.col(0), "both", 1e-8, 1e-6));
+        REQUIRE(all(algorithm.localVar().col(1) < 1e-20));
+    }
+
+    SECTION("adaptive bisquare | GWAverage | additional quantiles")
+    {
+        CRSDistance distance(false);
+        BandwidthWeight bandwidth(10, true, BandwidthWeight::Bisquare);
+        SpatialWeight spatial(&bandwidth, &distance);
+
+        // Break ties so that the brute-force order is the only possible one.
+        uword n = londonhp100_coord.n_rows;
+        mat x = londonhp100_data.cols(0, 3);
+        x.each_col() += regspace(0, n - 1) * 1e-6;
+        vec probs = { 0.9, 0.05, 0.5, 0.0 };
+
+        GWSS algorithm;
+        algorithm.setCoords(londonhp100_coord);
+        algorithm.setVariables(x);
+        algorithm.setGWSSMode(GWSS::GWSSMode::Average);
+        algorithm.setSpatialWeight(spatial);
+        algorithm.setQuantile(true);
+        REQUIRE_NOTHROW(algorithm.setQuantileProbs(probs));
+        REQUIRE_NOTHROW(algorithm.run());
+        REQUIRE(algorithm.localQuantile().n_slices == probs.n_elem);
+
+        distance.makeParameter({ londonhp100_coord, londonhp100_coord });
+        for (uword i = 0; i < n; i++)
+        {
+            vec w = bandwidth.weight(distance.distance(i));
+            w /= sum(w);
+            mat q = bruteWeightedQuantile(x, w, join_cols(vec({ 0.25, 0.5, 0.75 }), probs));
+            REQUIRE(approx_equal(algorithm.localMedian().row(i), q.row(1), "absdiff", 1e-12));
+            REQUIRE(approx_equal(algorithm.iqr().row(i), q.row(2) - q.row(0), "absdiff", 1e-12));
+            for (uword k = 0; k < probs.n_elem; k++)
+            {
+                REQUIRE(approx_equal(algorithm.localQuantile().slice(k).row(i), q.row(3 + k), "absdiff", 1e-12));
+            }
+        }
+
+        REQUIRE_THROWS_AS(algorithm.setQuantileProbs({ 0.5, 1.5 }), std::runtime_error);
+    }
+
     SECTION("adaptive bandwidth | GWCorrelation | serial")
     {
         CRSDistance distance(false);
@@ -116,6 +224,65 @@ TEST_CASE("GWSS: londonhp100")
         REQUIRE(approx_equal(localscorr_q, localscorr_q0, "absdiff", 1e-1));
     }
 
+    SECTION("adaptive bisquare | GWCorrelation | clustered variables")
+    {
+        CRSDistance distance(false);
+        BandwidthWeight bandwidth(10, true, BandwidthWeight::Bisquare);
+        SpatialWeight spatial(&bandwidth, &distance);
+
+        // The first two variables jump by far more than their local spread across a line.
+        uword n = londonhp100_coord.n_rows;
+        vec east = londonhp100_coord.col(0);
+        vec jump(n);
+        for (uword i = 0; i < n; i++)
+        {
+            jump(i) = east(i) > median(east) ? 1e8 : 0.0;
+        }
+        mat x(n, 3);
+        x.col(0) = jump + londonhp100_data.col(1) * 0.1;
+        x.col(1) = jump + londonhp100_data.col(3) * 0.1;
+        x.col(2) = londonhp100_data.col(2);
+
+        GWSS algorithm;
+        algorithm.setCoords(londonhp100_coord);
+        algorithm.setVariables(x);
+        algorithm.setGWSSMode(GWSS::GWSSMode::Correlation);
+        algorithm.setSpatialWeight(spatial);
+        REQUIRE_NOTHROW(algorithm.run());
+
+        // Statistics about the local means.
+        distance.makeParameter({ londonhp100_coord, londonhp100_coord });
+        mat rx = x;
+        rx.each_col([](vec& c) { c = GWSS::rank(c); });
+        mat var(n, 3), cov(n, 3), corr(n, 3), scorr(n, 3);
+        for (uword i = 0; i < n; i++)
+        {
+            vec w = bandwidth.weight(distance.distance(i));
+            w /= sum(w);
+            for (uword k = 0; k < 3; k++)
+            {
+                vec c = x.col(k) - dot(w, x.col(k));
+                var(i, k) = dot(w, c % c);
+            }
+            uword tag = 0;
+            for (uword j = 0; j < 2; j++)
+            {
+                for (uword k = j + 1; k < 3; k++)
+                {
+                    cov(i, tag) = GWSS::covwt(x.col(j), x.col(k), w);
+                    corr(i, tag) = GWSS::corwt(x.col(j), x.col(k), w);
+                    scorr(i, tag) = GWSS::corwt(rx.col(j), rx.col(k), w);
+                    tag++;
+                }
+            }
+        }
+        REQUIRE(approx_equal(algorithm.localVar(), var, "both", 1e-8, 1e-6));
+        REQUIRE(approx_equal(algorithm.localCov(), cov, "both", 1e-8, 1e-6));
+        REQUIRE(approx_equal(algorithm.localCorr(), corr, "absdiff", 1e-6));
+        REQUIRE(approx_equal(algorithm.localSCorr(), scorr, "absdiff", 1e-6));
+        REQUIRE(all(abs(vectorise(algorithm.localCorr())) <= 1.0 + 1e-12));
+    }
+
     SECTION("adaptive bandwidth | GWCorrelation(first col) | serial")
     {
 
@@ -244,6 +411,56 @@ TEST_CASE("GWSS: londonhp100")
     #endif
 }
 
+TEST_CASE("WeightedQuantile: brute force")
+{
+    mat londonhp100_coord, londonhp100_data;
+    vector<string> londonhp100_fields;
+    if (!read_londonhp100(londonhp100_coord, londonhp100_data, londonhp100_fields))
+    {
+        FAIL("Cannot load londonhp100 data.");
+    }
+
+    uword n = londonhp100_coord.n_rows;
+    mat x = londonhp100_data.cols(0, 3);
+    x.each_col() += regspace(0, n - 1) * 1e-6;
+    vec probs = { 0.75, 0.0, 0.1, 0.5, 0.999, 1.0, 0.25 };
+    WeightedQuantile engine(x, probs);
+    REQUIRE(approx_equal(engine.probs(), probs, "absdiff", 0.0));
+
+    CRSDistance distance(false);
+    distance.makeParameter({ londonhp100_coord, londonhp100_coord });
+
+    // Adaptive bisquare leaves fewer than a quarter of non-zero weights, which takes the binary search path.
+    // Fixed bisquare leaves zero weights but more non-zero ones, which takes the dense path.
+    auto bandwidth = GENERATE(
+        BandwidthWeight(10, true, BandwidthWeight::Bisquare),
+        BandwidthWeight(5000, false, BandwidthWeight::Bisquare),
+        BandwidthWeight(36, true, BandwidthWeight::Gaussian)
+    );
+    INFO("Settings: " << bandwidth.bandwidth() << ", " << bandwidth.adaptive() << ", " << bandwidth.kernel());
+
+    uword nZero = 0;
+    for (uword i = 0; i < n; i++)
+    {
+        vec w = bandwidth.weight(distance.distance(i));
+        w /= sum(w);
+        nZero += sum(w == 0.0);
+        REQUIRE(approx_equal(engine.quantile(w), bruteWeightedQuantile(x, w, probs), "absdiff", 1e-12));
+    }
+    if (bandwidth.kernel() == BandwidthWeight::Bisquare)
+    {
+        REQUIRE(nZero > 0);
+    }
+
+    SECTION("findq")
+    {
+        vec w = bandwidth.weight(distance.distance(0));
+        w /= sum(w);
+        vec q = GWSS::findq(x.col(0), w);
+        REQUIRE(approx_equal(q, bruteWeightedQuantile(x.col(0), w, { 0.25, 0.5, 0.75 }), "absdiff", 1e-12));
+    }
+}
+
 TEST_CASE("GWSS: cancel")
 {
     mat londonhp100_coord, londonhp100_data;
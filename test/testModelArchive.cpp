@@ -0,0 +1,207 @@
+#define CATCH_CONFIG_MAIN
+
+#include <catch2/catch_all.hpp>
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstring>
+#include <cstdint>
+#include <armadillo>
+#include "gwmodelpp/ModelArchive.h"
+#include "gwmodelpp/GWRBasic.h"
+#include "gwmodelpp/GTWR.h"
+#include "gwmodelpp/GWRGeneralized.h"
+#include "gwmodelpp/GWRScalable.h"
+#include "gwmodelpp/GWRMultiscale.h"
+#include "gwmodelpp/spatialweight/CRSDistance.h"
+#include "gwmodelpp/spatialweight/BandwidthWeight.h"
+#include "gwmodelpp/spatialweight/SpatialWeight.h"
+#include "londonhp100.h"
+
+using namespace std;
+using namespace arma;
+using namespace gwm;
+
+TEST_CASE("ModelArchive: buffer and corrupt archives")
+{
+    mat londonhp100_coord, londonhp100_data;
+    vector<string> londonhp100_fields;
+    if (!read_londonhp100(londonhp100_coord, londonhp100_data, londonhp100_fields))
+    {
+        FAIL("Cannot load londonhp100 data.");
+    }
+    vec y = londonhp100_data.col(0);
+    mat x = join_rows(ones(londonhp100_coord.n_rows), londonhp100_data.cols(1, 3));
+
+    CRSDistance distance(false);
+    BandwidthWeight bandwidth(36, true, BandwidthWeight::Gaussian);
+    SpatialWeight spatial(&bandwidth, &distance);
+
+    GWRBasic algorithm;
+    algorithm.setCoords(londonhp100_coord);
+    algorithm.setDependentVariable(y);
+    algorithm.setIndependentVariables(x);
+    algorithm.setSpatialWeight(spatial);
+    REQUIRE_NOTHROW(algorithm.fit());
+
+    ModelArchive archive;
+    algorithm.saveModel(archive);
+    stringstream stream;
+    REQUIRE_NOTHROW(archive.save(stream));
+    const string bytes = stream.str();
+    REQUIRE(bytes.size() % ModelArchive::Alignment == 0);
+
+    auto loadBytes = [](const string& data)
+    {
+        stringstream corrupt(data);
+        return ModelArchive::load(corrupt);
+    };
+    auto read = [&bytes](size_t offset)
+    {
+        uint64_t value;
+        memcpy(&value, &bytes[offset], sizeof(value));
+        return value;
+    };
+    auto patch = [&bytes](size_t offset, uint64_t value)
+    {
+        string data = bytes;
+        memcpy(&data[offset], &value, sizeof(value));
+        return data;
+    };
+    // Layout: magic (8 bytes), version (4), byte order (4), entries (8) at 16, size (8) at 24;
+    // each entry of the table has a name (40 bytes), rows, cols and offset (8 bytes each).
+    const size_t entriesOffset = 16, sizeOffset = 24, firstEntry = ModelArchive::Alignment, entrySize = 64;
+    const size_t rowsField = 40, colsField = 48, offsetField = 56;
+
+    SECTION("memory buffer") {
+        // Matrices of an archive opened from memory refer to it, so the memory must be aligned and kept alive.
+        vector<double> memory(bytes.size() / sizeof(double));
+        memcpy(memory.data(), bytes.data(), bytes.size());
+        GWRBasic loaded;
+        REQUIRE_NOTHROW(loaded.loadModel(ModelArchive::fromBuffer(memory.data(), bytes.size())));
+        REQUIRE(approx_equal(loaded.betas(), algorithm.betas(), "absdiff", 1e-12));
+        REQUIRE_THAT(loaded.diagnostic().AICc, Catch::Matchers::WithinAbs(algorithm.diagnostic().AICc, 1e-12));
+        REQUIRE_THROWS_AS(ModelArchive::fromBuffer(memory.data(), bytes.size() - ModelArchive::Alignment), std::runtime_error);
+        REQUIRE_THROWS_AS(ModelArchive::fromBuffer(memory.data(), 16), std::runtime_error);
+
+        string small = patch(sizeOffset, ModelArchive::Alignment / 2);
+        memcpy(memory.data(), small.data(), small.size());
+        REQUIRE_THROWS_AS(ModelArchive::fromBuffer(memory.data(), bytes.size()), std::runtime_error);
+    }
+
+    SECTION("truncated and broken") {
+        REQUIRE_NOTHROW(loadBytes(bytes));
+        REQUIRE_THROWS_AS(loadBytes("not an archive"), std::runtime_error);
+        REQUIRE_THROWS_AS(loadBytes(bytes.substr(0, bytes.size() - ModelArchive::Alignment)), std::runtime_error);
+        REQUIRE_THROWS_AS(loadBytes(bytes.substr(0, ModelArchive::Alignment / 2)), std::runtime_error);
+        REQUIRE_THROWS_AS(loadBytes(patch(sizeOffset, uint64_t(1) << 60)), std::runtime_error);
+        REQUIRE_THROWS_AS(loadBytes(patch(sizeOffset, 0)), std::runtime_error);
+        REQUIRE_THROWS_AS(loadBytes(patch(entriesOffset, uint64_t(1) << 40)), std::runtime_error);
+        REQUIRE_THROWS_AS(loadBytes(patch(firstEntry + rowsField, uint64_t(1) << 40)), std::runtime_error);
+        REQUIRE_THROWS_AS(loadBytes(patch(firstEntry + offsetField, 0)), std::runtime_error);
+        REQUIRE_THROWS_AS(loadBytes(patch(firstEntry + offsetField, bytes.size() + ModelArchive::Alignment)), std::runtime_error);
+    }
+
+    SECTION("duplicated and overlapping entries") {
+        const uint64_t entries = read(entriesOffset);
+        REQUIRE(entries >= 2);
+
+        string duplicated = bytes;
+        memcpy(&duplicated[firstEntry + entrySize], &bytes[firstEntry], ModelArchive::NameLength);
+        REQUIRE_THROWS_WITH(loadBytes(duplicated), Catch::Matchers::ContainsSubstring("duplicated"));
+
+        vector<size_t> filled;
+        for (uint64_t e = 0; e < entries; e++)
+        {
+            size_t entry = firstEntry + e * entrySize;
+            if (read(entry + rowsField) * read(entry + colsField) > 0) filled.push_back(entry);
+        }
+        REQUIRE(filled.size() >= 2);
+        REQUIRE_THROWS_WITH(loadBytes(patch(filled[1] + offsetField, read(filled[0] + offsetField))), Catch::Matchers::ContainsSubstring("overlap"));
+    }
+}
+
+TEST_CASE("ModelArchive: model mismatch")
+{
+    mat londonhp100_coord, londonhp100_data;
+    vector<string> londonhp100_fields;
+    if (!read_londonhp100(londonhp100_coord, londonhp100_data, londonhp100_fields))
+    {
+        FAIL("Cannot load londonhp100 data.");
+    }
+    vec y = londonhp100_data.col(0);
+    mat x = join_rows(ones(londonhp100_coord.n_rows), londonhp100_data.cols(1, 3));
+
+    CRSDistance distance(false);
+    BandwidthWeight bandwidth(36, true, BandwidthWeight::Gaussian);
+    SpatialWeight spatial(&bandwidth, &distance);
+
+    GWRBasic algorithm;
+    algorithm.setCoords(londonhp100_coord);
+    algorithm.setDependentVariable(y);
+    algorithm.setIndependentVariables(x);
+    algorithm.setSpatialWeight(spatial);
+    REQUIRE_NOTHROW(algorithm.fit());
+
+    ModelArchive archive;
+    algorithm.saveModel(archive);
+    REQUIRE(archive.model() == "GWRBasic");
+
+    GTWR gtwr;
+    REQUIRE_THROWS_AS(gtwr.loadModel(archive), std::runtime_error);
+    GWRGeneralized ggwr;
+    REQUIRE_THROWS_AS(ggwr.loadModel(archive), std::runtime_error);
+    GWRScalable scalable;
+    REQUIRE_THROWS_AS(scalable.loadModel(archive), std::runtime_error);
+    GWRMultiscale mgwr;
+    REQUIRE_THROWS_AS(mgwr.loadModel(archive), std::runtime_error);
+}
+
+TEST_CASE("ModelArchive: broken multiscale spatial weights")
+{
+    mat londonhp100_coord, londonhp100_data;
+    vector<string> londonhp100_fields;
+    if (!read_londonhp100(londonhp100_coord, londonhp100_data, londonhp100_fields))
+    {
+        FAIL("Cannot load londonhp100 data.");
+    }
+    vec y = londonhp100_data.col(0);
+    mat x = join_rows(ones(londonhp100_data.n_rows), londonhp100_data.cols(uvec({1, 3})));
+    uword nVar = 3;
+
+    vector<SpatialWeight> spatials;
+    vector<bool> preditorCentered;
+    vector<GWRMultiscale::BandwidthInitilizeType> bandwidthInitialize;
+    vector<GWRMultiscale::BandwidthSelectionCriterionType> bandwidthSelectionApproach;
+    const double bandwidths[] = { 45, 98, 98 };
+    for (size_t i = 0; i < nVar; i++)
+    {
+        CRSDistance distance;
+        BandwidthWeight bandwidth(bandwidths[i], true, BandwidthWeight::Bisquare);
+        spatials.push_back(SpatialWeight(&bandwidth, &distance));
+        preditorCentered.push_back(i != 0);
+        bandwidthInitialize.push_back(GWRMultiscale::BandwidthInitilizeType::Specified);
+        bandwidthSelectionApproach.push_back(GWRMultiscale::BandwidthSelectionCriterionType::AIC);
+    }
+
+    GWRMultiscale algorithm;
+    algorithm.setCoords(londonhp100_coord);
+    algorithm.setDependentVariable(y);
+    algorithm.setIndependentVariables(x);
+    algorithm.setSpatialWeights(spatials);
+    algorithm.setHasHatMatrix(true);
+    algorithm.setCriterionType(GWRMultiscale::BackFittingCriterionType::dCVR);
+    algorithm.setPreditorCentered(preditorCentered);
+    algorithm.setBandwidthInitilize(bandwidthInitialize);
+    algorithm.setBandwidthSelectionApproach(bandwidthSelectionApproach);
+    REQUIRE_NOTHROW(algorithm.fit());
+
+    ModelArchive archive;
+    algorithm.saveModel(archive);
+
+    ModelArchive broken = archive;
+    broken.set("spatialWeights", double(nVar + 1));
+    GWRMultiscale loaded;
+    REQUIRE_THROWS_AS(loaded.loadModel(broken), std::runtime_error);
+}